@@ -0,0 +1,88 @@
+// room-wide commands over the simulated device transport: a hundred thousand devices answering
+// after 20 ms each, carried by a timer thread and a couple of workers
+//
+// usage: bench_async_devices [--devices n] [--latency ms] [--workers n] [--loss rate]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "core/logger.hpp"
+#include "devices/smart_light.hpp"
+#include "bench_common.hpp"
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 100000;
+    TransportConfig config;
+    config.latencyMillis = 20;
+    config.workers = 2;
+    double lossRate = 0.01;
+    BenchArgs args("bench_async_devices");
+    args.flag("--devices", deviceCount)
+        .flag("--latency", config.latencyMillis)
+        .flag("--workers", config.workers, 1)
+        .flag("--loss", lossRate, 0.0);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Error);
+
+    // one very large room of lights
+    HomeController* home = HomeController::getInstance();
+    home->addRoom("Hall");
+    std::vector<std::string> ids;
+    ids.reserve(deviceCount);
+    Clock::time_point setup = Clock::now();
+    for (std::size_t i = 0; i < deviceCount; ++i) {
+        ids.push_back("L" + std::to_string(i));
+        home->addDevice(std::make_shared<SmartLight>(ids.back(), "Light", "Hall"));
+        home->assignDeviceToRoom(ids.back(), "Hall");
+    }
+    std::cout << "=== " << deviceCount << " devices in one room, " << config.latencyMillis << " ms device latency, "
+              << config.workers << " workers + 1 timer thread ===\n" << std::fixed << std::setprecision(1)
+              << "setup:                 " << millisSince(setup) << " ms\n";
+
+    // every device answers
+    {
+        DeviceTransport transport(config);
+        Clock::time_point start = Clock::now();
+        std::size_t answered = syncWait(home->setRoomPowerAsync(transport, "Hall", true));
+        double elapsed = millisSince(start);
+        std::cout << "room on:               " << elapsed << " ms, " << answered << " answered, "
+                  << std::setprecision(0) << answered / (elapsed / 1000.0) << " commands/s ("
+                  << deviceCount * config.latencyMillis / 1000.0 << " s one at a time)\n" << std::setprecision(1);
+
+        CommandStream commands;
+        commands.reserve(deviceCount);
+        for (std::size_t i = 0; i < deviceCount; ++i) {
+            commands.emplace_back(ids[i], DeviceCommand{CommandType::SetBrightness, static_cast<float>(i % 101), ""});
+        }
+        std::vector<DeviceResult> results;
+        start = Clock::now();
+        std::size_t succeeded = home->applyCommandsAsync(transport, commands, results);
+        elapsed = millisSince(start);
+        std::cout << "brightness batch:      " << elapsed << " ms, " << succeeded << " succeeded\n";
+    }
+
+    // some requests are lost and time out, then are resent once
+    {
+        TransportConfig lossy = config;
+        lossy.lossRate = lossRate;
+        lossy.jitterMillis = 10;
+        lossy.timeoutMillis = 200;
+        lossy.retries = 1;
+        DeviceTransport transport(lossy);
+        Clock::time_point start = Clock::now();
+        std::size_t answered = syncWait(home->setRoomPowerAsync(transport, "Hall", false));
+        double elapsed = millisSince(start);
+        std::cout << "room off, " << std::setprecision(1) << lossRate * 100 << "% loss:  " << elapsed << " ms, "
+                  << answered << " answered, " << transport.getLostCount() << " requests lost, "
+                  << transport.getRequestCount() << " sent\n";
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+// automation rules at scale: compile time, event-to-action latency and throughput with 100k rules
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "controllers/automation_engine.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+#include "bench_common.hpp"
+
+static void reportLatency(const char* label, std::vector<double>& micros, double seconds) {
+    std::cout << std::left << std::setw(26) << label << std::right << std::fixed << std::setprecision(2)
+              << "p50 " << std::setw(7) << percentile(micros, 0.50) << " us"
+              << "  p99 " << std::setw(7) << percentile(micros, 0.99) << " us"
+              << std::setw(10) << micros.size() / seconds / 1e3 << " k events/s\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t homes = 2000; // one camera, thermostat and room of five lights each
+    if (!BenchArgs("bench_automation").flag("--homes", homes).parse(argc, argv)) {
+        return 2;
+    }
+    const size_t lightsPerRoom = 5;
+    const size_t thresholdsPerThermostat = 24; // above and below each
+
+    AutomationEngine engine;
+    std::vector<std::shared_ptr<SecurityCamera>> cameras;
+    std::vector<std::shared_ptr<Thermostat>> thermostats;
+    std::vector<std::shared_ptr<SmartLight>> lights;
+    for (size_t h = 0; h < homes; ++h) {
+        std::string room = "Room" + std::to_string(h);
+        cameras.push_back(std::make_shared<SecurityCamera>("CAM" + std::to_string(h), "Camera", room));
+        thermostats.push_back(std::make_shared<Thermostat>("T" + std::to_string(h), "Thermostat", room));
+        engine.registerDevice(cameras.back());
+        engine.registerDevice(thermostats.back());
+        engine.addRoom(room);
+        for (size_t l = 0; l < lightsPerRoom; ++l) {
+            std::string id = "L" + std::to_string(h) + "_" + std::to_string(l);
+            lights.push_back(std::make_shared<SmartLight>(id, "Light", room));
+            engine.registerDevice(lights.back());
+            engine.addDeviceToRoom(room, id);
+        }
+    }
+
+    // rule texts are built up front so only parsing and indexing is timed
+    std::vector<std::string> texts;
+    for (size_t h = 0; h < homes; ++h) {
+        std::string room = "Room" + std::to_string(h);
+        std::string thermostat = "T" + std::to_string(h);
+        texts.push_back("when motion on CAM" + std::to_string(h) + " and after sunset, set " + room
+                        + " lights to 40% and set " + room + " lights color to Warm White");
+        for (size_t t = 0; t < thresholdsPerThermostat; ++t) {
+            std::string threshold = std::to_string(10 + t);
+            texts.push_back("when temperature on " + thermostat + " above " + threshold
+                            + " then set " + thermostat + " temperature to " + std::to_string(5 + t));
+            texts.push_back("when temperature on " + thermostat + " below " + threshold
+                            + " and " + thermostat + " is off, turn on " + thermostat);
+        }
+    }
+
+    auto start = Clock::now();
+    for (const auto& text : texts) {
+        engine.addRule(text);
+    }
+    double compileSeconds = secondsSince(start);
+    std::cout << "=== Automation with " << engine.getRuleCount() << " rules over "
+              << cameras.size() + thermostats.size() + lights.size() << " devices ===\n"
+              << std::fixed << std::setprecision(2)
+              << "Rule compile: " << compileSeconds * 1000 << " ms (" << texts.size() / compileSeconds / 1e3
+              << " k rules/s)\n\n";
+
+    engine.setTimeOfDay(21 * 60);
+    std::mt19937 rng(7);
+    const size_t events = 200000;
+
+    // motion: five lights get brightness and color per event
+    std::uniform_int_distribution<size_t> pickHome(0, homes - 1);
+    std::vector<double> micros;
+    micros.reserve(events);
+    std::uint64_t actionsBefore = engine.getActionsExecuted();
+    auto runStart = Clock::now();
+    for (size_t i = 0; i < events; ++i) {
+        SecurityCamera& camera = *cameras[pickHome(rng)];
+        auto eventStart = Clock::now();
+        engine.onDeviceChanged(camera, DeviceChange::Motion);
+        micros.push_back(microsSince(eventStart));
+    }
+    double motionSeconds = secondsSince(runStart);
+    std::uint64_t motionActions = engine.getActionsExecuted() - actionsBefore;
+    reportLatency("motion -> lights", micros, motionSeconds);
+
+    // temperature: each reading crosses a few of the 48 thresholds on its thermostat
+    std::uniform_real_distribution<float> reading(8.0f, 36.0f);
+    micros.clear();
+    std::uint64_t evaluatedBefore = engine.getRulesEvaluated();
+    runStart = Clock::now();
+    for (size_t i = 0; i < events; ++i) {
+        Thermostat& thermostat = *thermostats[pickHome(rng)];
+        float value = reading(rng);
+        auto eventStart = Clock::now();
+        thermostat.setTemperature(value);
+        engine.onDeviceChanged(thermostat, DeviceChange::Temperature);
+        micros.push_back(microsSince(eventStart));
+    }
+    double temperatureSeconds = secondsSince(runStart);
+    std::uint64_t evaluated = engine.getRulesEvaluated() - evaluatedBefore;
+    reportLatency("temperature -> setpoint", micros, temperatureSeconds);
+
+    std::cout << "\nMotion actions per event: " << static_cast<double>(motionActions) / events
+              << "\nRules evaluated per temperature event: " << static_cast<double>(evaluated) / events
+              << " (a full scan would check " << engine.getRuleCount() << ")\n"
+              << "Cascades suppressed: " << engine.getCascadesSuppressed() << "\n";
+    return 0;
+}
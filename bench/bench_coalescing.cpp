@@ -0,0 +1,147 @@
+// slider drags against per-device command queues: every light, thermostat and camera receives a
+// stream of brightness, setpoint and rotation writes at 60 frames a second, with the odd power
+// toggle in between, applied one by one and through queues flushed every few frames
+//
+// usage: bench_coalescing [--devices n] [--frames n] [--flush-every frames]
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "controllers/home_controller.hpp"
+#include "core/logger.hpp"
+#include "core/metrics.hpp"
+#include "bench_common.hpp"
+
+// counters read before and after each run
+struct Counts {
+    std::uint64_t recordUsage;
+    std::uint64_t changes;
+};
+
+static Counts readCounts() {
+    MetricsRegistry* registry = MetricsRegistry::getInstance();
+    static const Counter readings = registry->counter("smart_home_energy_readings_total",
+                                                      "Power readings recorded by the energy monitor");
+    static const char* const kinds[] = {"power", "brightness", "color", "temperature", "desired_temperature", "mode",
+                                        "recording", "resolution", "rotation", "motion_detection", "motion"};
+    Counts counts{registry->read(readings), 0};
+    for (const char* kind : kinds) {
+        counts.changes += registry->read(registry->counter("smart_home_device_changes_total", "Device state changes by kind",
+                                                           std::string("change=\"") + kind + "\""));
+    }
+    return counts;
+}
+
+// one frame of the drag for devices prefix0..prefixN
+static void frameCommands(const std::string& prefix, std::size_t devices, int frame, int frames,
+                          std::vector<std::pair<std::string, DeviceCommand>>& out) {
+    out.clear();
+    float progress = static_cast<float>(frame) / static_cast<float>(frames - 1);
+    for (std::size_t i = 0; i < devices; ++i) {
+        std::string id = prefix + std::to_string(i);
+        switch (i % 3) {
+            case 0:
+                out.emplace_back(id, DeviceCommand{CommandType::SetBrightness, progress * 100.0f, ""});
+                break;
+            case 1:
+                out.emplace_back(id, DeviceCommand{CommandType::SetDesiredTemperature, 16.0f + progress * 8.0f, ""});
+                break;
+            default:
+                out.emplace_back(id, DeviceCommand{CommandType::SetRotation, progress * 180.0f, ""});
+                break;
+        }
+        if (frame % 20 == 10 && i % 10 == 0) { // someone flicks the switch mid-drag
+            out.emplace_back(id, DeviceCommand{frame % 40 == 10 ? CommandType::TurnOff : CommandType::TurnOn, 0.0f, ""});
+        }
+    }
+}
+
+static void printRun(const char* label, std::size_t commands, std::size_t applied, const Counts& before,
+                     const Counts& after, double millis) {
+    std::cout << std::left << std::setw(22) << label << std::right << std::setw(10) << commands << std::setw(10) << applied
+              << std::setw(13) << after.recordUsage - before.recordUsage << std::setw(11) << after.changes - before.changes
+              << std::setw(11) << std::fixed << std::setprecision(1) << millis << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 3000;
+    int frames = 60;
+    int flushEvery = 6; // 100 ms at 60 frames a second
+    BenchArgs args("bench_coalescing");
+    args.flag("--devices", deviceCount)
+        .flag("--frames", frames, 2)
+        .flag("--flush-every", flushEvery, 1);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Error);
+
+    // the same devices twice, one set driven directly and one through the queues
+    HomeController* home = HomeController::getInstance();
+    for (const char* prefix : {"D", "Q"}) {
+        for (std::size_t i = 0; i < deviceCount; ++i) {
+            std::string id = prefix + std::to_string(i);
+            std::shared_ptr<Device> device;
+            if (i % 3 == 0) device = std::make_shared<SmartLight>(id, "Light", "Lounge");
+            else if (i % 3 == 1) device = std::make_shared<Thermostat>(id, "Thermostat", "Lounge");
+            else device = std::make_shared<SecurityCamera>(id, "Camera", "Lounge");
+            home->addDevice(device);
+            device->turnOn();
+        }
+    }
+    std::cout << "=== " << deviceCount << " devices, " << frames << " frames of slider drag, queues flushed every "
+              << flushEvery << " frames ===\n"
+              << "                        commands   applied  recordUsage    changes         ms\n";
+
+    std::vector<std::pair<std::string, DeviceCommand>> frame;
+    std::size_t commands = 0;
+    Counts before = readCounts();
+    Clock::time_point start = Clock::now();
+    for (int f = 0; f < frames; ++f) {
+        frameCommands("D", deviceCount, f, frames, frame);
+        for (const auto& entry : frame) {
+            (void)home->applyCommand(entry.first, entry.second);
+        }
+        commands += frame.size();
+    }
+    double directMillis = millisSince(start);
+    Counts afterDirect = readCounts();
+    printRun("applied one by one", commands, commands, before, afterDirect, directMillis);
+
+    std::size_t applied = 0;
+    start = Clock::now();
+    for (int f = 0; f < frames; ++f) {
+        frameCommands("Q", deviceCount, f, frames, frame);
+        for (const auto& entry : frame) {
+            (void)home->queueCommand(entry.first, entry.second);
+        }
+        if ((f + 1) % flushEvery == 0 || f + 1 == frames) {
+            applied += home->flushCommandQueues();
+        }
+    }
+    double queuedMillis = millisSince(start);
+    Counts afterQueued = readCounts();
+    printRun("queued and coalesced", commands, applied, afterDirect, afterQueued, queuedMillis);
+
+    // both sets must end in the same state
+    std::size_t mismatched = 0;
+    for (std::size_t i = 0; i < deviceCount; ++i) {
+        auto direct = home->findDevice("D" + std::to_string(i));
+        auto queued = home->findDevice("Q" + std::to_string(i));
+        std::string status = direct->getDeviceStatus();
+        std::string queuedStatus = queued->getDeviceStatus();
+        mismatched += status.substr(status.find(' ', status.find(direct->getDeviceID()))) !=
+                      queuedStatus.substr(queuedStatus.find(' ', queuedStatus.find(queued->getDeviceID()))) ? 1 : 0;
+    }
+    std::cout << std::setprecision(1) << "mutations applied: " << 100.0 * applied / commands << "% of one by one, "
+              << "recordUsage calls: " << 100.0 * (afterQueued.recordUsage - afterDirect.recordUsage)
+                                              / std::max<std::uint64_t>(1, afterDirect.recordUsage - before.recordUsage)
+              << "%, final states differing: " << mismatched << "\n";
+    return mismatched == 0 ? 0 : 1;
+}
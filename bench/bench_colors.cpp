@@ -0,0 +1,82 @@
+// scene application across many lights: parsed-per-light names vs packed colors vs transition steps
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "devices/light_color.hpp"
+#include "devices/smart_light.hpp"
+#include "bench_common.hpp"
+
+static void report(const char* label, size_t operations, double seconds) {
+    std::cout << std::left << std::setw(34) << label << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << seconds * 1000 << " ms" << std::setw(10) << operations / seconds / 1e6 << " M lights/s\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t lightCount = 1000000;
+    if (!BenchArgs("bench_colors").flag("--lights", lightCount).parse(argc, argv)) {
+        return 2;
+    }
+
+    std::vector<SmartLight> lights;
+    lights.reserve(lightCount);
+    for (size_t i = 0; i < lightCount; ++i) {
+        lights.emplace_back("SL" + std::to_string(i), "Scene Light", "Bench");
+    }
+
+    std::cout << "=== Scene application across " << lightCount << " lights ===\n"
+              << "sizeof(LightColor) = " << sizeof(LightColor) << " bytes (std::string was " << sizeof(std::string) << ")\n"
+              << "sizeof(SmartLight) = " << sizeof(SmartLight) << " bytes\n\n";
+
+    // every light parses the scene's color name, the old string-per-light shape
+    auto start = Clock::now();
+    for (auto& light : lights) {
+        light.setColor(std::string("Warm White"));
+    }
+    report("name parsed per light", lightCount, secondsSince(start));
+
+    // scene color parsed once and stored packed
+    LightColor sceneColor = LightColor::parse("Warm White");
+    start = Clock::now();
+    for (auto& light : lights) {
+        light.setColor(sceneColor);
+    }
+    report("packed color", lightCount, secondsSince(start));
+
+    // ten interpolated steps of an RGB transition
+    LightColor from = LightColor::parse("Blue");
+    LightColor to = LightColor::parse("#FF8000");
+    const int steps = 10;
+    start = Clock::now();
+    for (int step = 1; step <= steps; ++step) {
+        LightColor blended = LightColor::interpolate(from, to, static_cast<double>(step) / steps);
+        for (auto& light : lights) {
+            light.setColor(blended);
+        }
+    }
+    report("RGB transition step", lightCount * steps, secondsSince(start));
+
+    // each light blends from its own start color, as per-light transitions would
+    for (size_t i = 0; i < lights.size(); ++i) {
+        lights[i].setColor(LightColor(static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i >> 16)));
+    }
+    std::vector<LightColor> starts;
+    starts.reserve(lights.size());
+    for (const auto& light : lights) {
+        starts.push_back(light.getColor());
+    }
+    start = Clock::now();
+    for (int step = 1; step <= steps; ++step) {
+        double progress = static_cast<double>(step) / steps;
+        for (size_t i = 0; i < lights.size(); ++i) {
+            lights[i].setColor(LightColor::interpolate(starts[i], to, progress));
+        }
+    }
+    report("per-light transition step", lightCount * steps, secondsSince(start));
+
+    // sanity check so the work cannot be optimised away
+    std::cout << "\nFinal color of light 0: " << lights[0].getColor() << "\n";
+    return 0;
+}
@@ -0,0 +1,248 @@
+// load test for the command server: many pipelining clients over the Unix socket or localhost TCP
+//
+// usage: bench_command_server [--devices n] [--clients n] [--pipeline n] [--seconds s]
+//                             [--tcp] [--connect path|port]
+//
+// Without --connect a server for a generated home runs in this process. With --connect the clients
+// drive a running server, whose home must have the generated device IDs (L0.., T0.., C0..).
+// Each client keeps --pipeline requests in flight and sends the next window when all are answered.
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "controllers/command_server.hpp"
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "core/logger.hpp"
+#include "bench_common.hpp"
+
+// one load client
+struct Client {
+    int fd;
+    std::string input; // partial response line
+    std::string output; // requests not yet sent
+    std::size_t outputOffset;
+    std::deque<Clock::time_point> sentAt; // send time of each request in flight
+    std::size_t nextRequest; // position in the shared request list
+};
+
+// a connected blocking socket, made non-blocking afterwards
+static int connectTo(bool tcp, const std::string& path, int port) {
+    int fd;
+    if (tcp) {
+        fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<std::uint16_t>(port));
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            return -1;
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    } else {
+        fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            return -1;
+        }
+    }
+    int flags = ::fcntl(fd, F_GETFL);
+    ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    return fd;
+}
+
+// queue the next window of requests and send what the socket takes
+static void sendWindow(Client& client, const std::vector<std::string>& requests, std::size_t pipeline) {
+    Clock::time_point now = Clock::now();
+    for (std::size_t i = 0; i < pipeline; ++i) {
+        client.output += requests[client.nextRequest];
+        client.nextRequest = (client.nextRequest + 1) % requests.size();
+        client.sentAt.push_back(now);
+    }
+}
+
+static bool flush(Client& client) {
+    while (client.outputOffset < client.output.size()) {
+        ssize_t sent = ::send(client.fd, client.output.data() + client.outputOffset,
+                              client.output.size() - client.outputOffset, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        client.outputOffset += static_cast<std::size_t>(sent);
+    }
+    client.output.clear();
+    client.outputOffset = 0;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 10000;
+    std::size_t clientCount = 1000;
+    std::size_t pipeline = 16;
+    double seconds = 5.0;
+    bool tcp = false;
+    std::string target;
+    BenchArgs args("bench_command_server");
+    args.flag("--devices", deviceCount)
+        .flag("--clients", clientCount)
+        .flag("--pipeline", pipeline, 1)
+        .flag("--seconds", seconds, 0.0)
+        .flag("--tcp", tcp)
+        .flag("--connect", target);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Warning);
+
+    // room for every client socket, and the server's side of it when it runs here
+    rlimit limit{};
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+
+    // the home and, unless connecting elsewhere, the server
+    HomeSpec spec;
+    spec.lights = deviceCount * 6 / 10;
+    spec.thermostats = deviceCount * 2 / 10;
+    spec.cameras = deviceCount - spec.lights - spec.thermostats;
+    spec.rooms = std::max<std::size_t>(1, deviceCount / 20);
+    GeneratedHome home = generateHome(spec);
+    std::unique_ptr<CommandServer> server;
+    std::string socketPath = target;
+    int port = tcp ? std::atoi(target.c_str()) : -1;
+    if (target.empty()) {
+        populateHome(*HomeController::getInstance(), home);
+        CommandServerConfig config;
+        config.socketPath = tcp ? "" : "/tmp/bench_command_server." + std::to_string(::getpid()) + ".sock";
+        config.tcpPort = tcp ? 0 : -1;
+        server.reset(new CommandServer(*HomeController::getInstance(), config));
+        server->start();
+        socketPath = config.socketPath;
+        port = server->getTcpPort();
+    }
+
+    // requests as protocol lines, from the generated command mix plus status reads
+    std::vector<std::string> requests;
+    CommandStream commands = generateCommands(home, CommandMix(), 100000, 7);
+    for (std::size_t i = 0; i < commands.size(); ++i) {
+        if (i % 10 == 9) {
+            requests.push_back("status " + commands[i].first + "\n");
+        } else {
+            requests.push_back(commands[i].first + " " + formatDeviceCommand(commands[i].second) + "\n");
+        }
+    }
+
+    int epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Client> clients(clientCount);
+    for (std::size_t i = 0; i < clientCount; ++i) {
+        Client& client = clients[i];
+        client.fd = connectTo(tcp, socketPath, port);
+        if (client.fd < 0) {
+            std::cerr << "Cannot connect client " << i << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+        client.outputOffset = 0;
+        client.nextRequest = (i * 7919) % requests.size();
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, client.fd, &event);
+    }
+
+    // closed loop: every client keeps one window in flight until the deadline, then drains
+    std::vector<float> latencies; // microseconds
+    latencies.reserve(static_cast<std::size_t>(seconds * 2000000));
+    std::size_t errors = 0;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    for (auto& client : clients) {
+        sendWindow(client, requests, pipeline);
+        flush(client);
+    }
+    std::size_t inFlight = clientCount * pipeline;
+    std::vector<epoll_event> events(1024);
+    char buffer[65536];
+    while (inFlight > 0) {
+        int ready = ::epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 1000);
+        if (ready <= 0) {
+            if (ready < 0 && errno == EINTR) continue;
+            std::cerr << "Timed out with " << inFlight << " requests unanswered\n";
+            return 1;
+        }
+        bool running = Clock::now() < deadline;
+        for (int e = 0; e < ready; ++e) {
+            Client& client = clients[events[e].data.u64];
+            if (events[e].events & EPOLLOUT) {
+                flush(client);
+            }
+            ssize_t received;
+            while ((received = ::recv(client.fd, buffer, sizeof(buffer), 0)) > 0) {
+                Clock::time_point now = Clock::now();
+                for (ssize_t i = 0; i < received; ++i) {
+                    if (buffer[i] != '\n') {
+                        if (client.input.size() < 3) client.input.push_back(buffer[i]);
+                        continue;
+                    }
+                    errors += client.input.compare(0, 2, "OK") == 0 ? 0 : 1;
+                    client.input.clear();
+                    latencies.push_back(std::chrono::duration<float, std::micro>(now - client.sentAt.front()).count());
+                    client.sentAt.pop_front();
+                    --inFlight;
+                }
+            }
+            if (received == 0) {
+                std::cerr << "Server closed a client connection\n";
+                return 1;
+            }
+            if (client.sentAt.empty() && running) {
+                sendWindow(client, requests, pipeline);
+                inFlight += pipeline;
+            }
+            bool pending = !flush(client) || client.outputOffset < client.output.size();
+            epoll_event event{};
+            event.events = EPOLLIN;
+            if (pending) {
+                event.events |= EPOLLOUT;
+            }
+            event.data.u64 = events[e].data.u64;
+            ::epoll_ctl(epollFd, EPOLL_CTL_MOD, client.fd, &event);
+        }
+    }
+    double elapsed = secondsSince(start);
+
+    for (auto& client : clients) ::close(client.fd);
+    ::close(epollFd);
+    if (server) server->stop();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double fraction) {
+        return latencies.empty() ? 0.0 : latencies[static_cast<std::size_t>(fraction * (latencies.size() - 1))];
+    };
+    std::cout << "=== command server, " << (tcp ? "TCP" : "Unix socket") << ", " << clientCount << " clients, pipeline "
+              << pipeline << " ===\n" << std::fixed << std::setprecision(1)
+              << "requests:     " << latencies.size() << " in " << elapsed << " s (" << errors << " errors)\n"
+              << "requests/s:   " << std::setprecision(0) << latencies.size() / elapsed << "\n" << std::setprecision(1)
+              << "latency p50:  " << percentile(0.50) << " us\n"
+              << "latency p99:  " << percentile(0.99) << " us\n"
+              << "latency max:  " << percentile(1.0) << " us\n";
+    return 0;
+}
@@ -0,0 +1,153 @@
+// throwing setters vs the status-code command API with 0%, 10% and 50% invalid commands
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "core/logger.hpp"
+#include "devices/device_command.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+#include "bench_common.hpp"
+
+struct Target {
+    Device* device;
+    DeviceCommand command;
+};
+
+// a mix of light, thermostat and camera commands, invalidPercent of them out of range
+static std::vector<Target> buildWorkload(const std::vector<std::shared_ptr<Device>>& devices, size_t count, int invalidPercent) {
+    std::mt19937 rng(static_cast<unsigned>(invalidPercent) + 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::vector<Target> workload;
+    workload.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        Device* device = devices[i % devices.size()].get();
+        bool invalid = percent(rng) < invalidPercent;
+        DeviceCommand command{CommandType::TurnOn, 0.0f, ""};
+        switch (i % devices.size() % 3) {
+            case 0: // light
+                if (i & 1) {
+                    command = {CommandType::SetBrightness, invalid ? 150.0f : static_cast<float>(i % 101), ""};
+                } else {
+                    command = {CommandType::SetColor, 0.0f, invalid ? "Ultraviolet" : "Warm White"};
+                }
+                break;
+            case 1: // thermostat
+                command = {CommandType::SetMode, 0.0f, invalid ? "turbo" : "heating"};
+                break;
+            default: // camera
+                if (i & 1) {
+                    command = {CommandType::SetRotation, invalid ? 400.0f : static_cast<float>(i % 361), ""};
+                } else {
+                    command = {CommandType::SetResolution, 0.0f, invalid ? "8K" : "720p"};
+                }
+                break;
+        }
+        workload.push_back(Target{device, command});
+    }
+    return workload;
+}
+
+// the shape bulk callers had to use before: setter, try and catch
+static size_t runThrowing(const std::vector<Target>& workload) {
+    size_t failed = 0;
+    for (const auto& target : workload) {
+        try {
+            const DeviceCommand& command = target.command;
+            switch (command.type) {
+                case CommandType::SetBrightness:
+                    static_cast<SmartLight*>(target.device)->setBrightness(static_cast<int>(command.value));
+                    break;
+                case CommandType::SetColor:
+                    static_cast<SmartLight*>(target.device)->setColor(command.text);
+                    break;
+                case CommandType::SetMode: {
+                    // setMode ignores bad modes, validate like a careful caller would
+                    auto* thermostat = static_cast<Thermostat*>(target.device);
+                    thermostat->setMode(command.text);
+                    if (thermostat->getMode() != command.text) throw std::invalid_argument("bad mode");
+                    break;
+                }
+                case CommandType::SetRotation:
+                    static_cast<SecurityCamera*>(target.device)->setRotation(static_cast<int>(command.value));
+                    break;
+                case CommandType::SetResolution:
+                    static_cast<SecurityCamera*>(target.device)->setResolution(command.text);
+                    break;
+                default:
+                    break;
+            }
+        } catch (const std::exception&) {
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+static size_t runResults(const std::vector<Target>& workload) {
+    size_t failed = 0;
+    for (const auto& target : workload) {
+        failed += target.device->applyCommand(target.command) != DeviceResult::Ok ? 1 : 0;
+    }
+    return failed;
+}
+
+int main(int argc, char* argv[]) {
+    size_t commandCount = 1000000;
+    if (!BenchArgs("bench_commands").flag("--commands", commandCount).parse(argc, argv)) {
+        return 2;
+    }
+
+    std::vector<std::shared_ptr<Device>> devices;
+    for (int i = 0; i < 999; i += 3) {
+        devices.push_back(std::make_shared<SmartLight>("L" + std::to_string(i), "Light", "Bench"));
+        devices.push_back(std::make_shared<Thermostat>("T" + std::to_string(i), "Thermostat", "Bench"));
+        devices.push_back(std::make_shared<SecurityCamera>("C" + std::to_string(i), "Camera", "Bench"));
+    }
+    for (auto& device : devices) {
+        device->turnOn();
+    }
+
+    // error logging goes to /dev/null so the terminal is not part of the measurement
+    std::FILE* devNull = std::fopen("/dev/null", "w");
+    if (!devNull) {
+        std::cerr << "Cannot open /dev/null\n";
+        return 1;
+    }
+    Logger::getInstance()->setSinks(devNull, devNull);
+    std::cout << "=== " << commandCount << " device commands (error logging sent to /dev/null) ===\n"
+              << std::left << std::setw(10) << "invalid" << std::right << std::setw(16) << "throwing M/s"
+              << std::setw(16) << "result M/s" << std::setw(10) << "speedup" << "\n";
+    for (int invalidPercent : {0, 10, 50}) {
+        std::vector<Target> workload = buildWorkload(devices, commandCount, invalidPercent);
+
+        auto start = Clock::now();
+        size_t thrownFailures = runThrowing(workload);
+        double throwingSeconds = secondsSince(start);
+
+        start = Clock::now();
+        size_t resultFailures = runResults(workload);
+        double resultSeconds = secondsSince(start);
+
+        if (thrownFailures != resultFailures) {
+            Logger::getInstance()->setSinks(stdout, stderr);
+            std::cerr << "Failure counts differ: " << thrownFailures << " vs " << resultFailures << "\n";
+            return 1;
+        }
+        std::cout << std::left << std::setw(10) << (std::to_string(invalidPercent) + "%") << std::right
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(16) << commandCount / throwingSeconds / 1e6
+                  << std::setw(16) << commandCount / resultSeconds / 1e6
+                  << std::setw(9) << throwingSeconds / resultSeconds << "x\n";
+    }
+    Logger::getInstance()->setSinks(stdout, stderr);
+    std::fclose(devNull);
+    return 0;
+}
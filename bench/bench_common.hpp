@@ -0,0 +1,162 @@
+#ifndef bench_common_hpp
+#define bench_common_hpp
+
+// helpers shared by the bench programs: timing, percentiles and command-line flags
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+inline double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+inline double millisSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+inline double microsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// time of one call to body(iterations), per iteration
+template <typename Body>
+double nanosPerOp(std::size_t iterations, Body body) {
+    auto start = Clock::now();
+    body(iterations);
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+}
+
+// the sample at fraction (0-1) of the sorted samples, which are reordered
+inline double percentile(std::vector<double>& samples, double fraction) {
+    std::size_t index = static_cast<std::size_t>(fraction * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+// the flags a bench takes, each bound to the variable it sets
+//
+// Numbers must be whole arguments in range of their variable, at least the given minimum. parse()
+// reports an unknown flag, a missing or malformed value to stderr with the usage line and returns
+// false; benches then exit with status 2.
+class BenchArgs {
+    private:
+        struct Flag {
+            std::string name;
+            std::string hint; // shown in the usage line, empty for switches
+            std::function<bool(const std::string&)> set; // false if the value is malformed
+        };
+        std::string program;
+        std::vector<Flag> flags;
+
+        template <typename T>
+        static bool parseNumber(const std::string& text, T& value, T minimum) {
+            if (text.empty()) {
+                return false;
+            }
+            char* end = nullptr;
+            errno = 0;
+            if constexpr (std::is_floating_point_v<T>) {
+                double parsed = std::strtod(text.c_str(), &end);
+                if (errno != 0 || *end != '\0' || !(parsed >= static_cast<double>(minimum))) {
+                    return false; // NaN fails the minimum
+                }
+                value = static_cast<T>(parsed);
+            } else if constexpr (std::is_signed_v<T>) {
+                long long parsed = std::strtoll(text.c_str(), &end, 10);
+                if (errno != 0 || *end != '\0' || parsed < static_cast<long long>(minimum)
+                    || parsed > static_cast<long long>(std::numeric_limits<T>::max())) {
+                    return false;
+                }
+                value = static_cast<T>(parsed);
+            } else {
+                if (text[0] == '-') {
+                    return false; // strtoull would wrap it
+                }
+                unsigned long long parsed = std::strtoull(text.c_str(), &end, 10);
+                if (errno != 0 || *end != '\0' || parsed < static_cast<unsigned long long>(minimum)
+                    || parsed > static_cast<unsigned long long>(std::numeric_limits<T>::max())) {
+                    return false;
+                }
+                value = static_cast<T>(parsed);
+            }
+            return true;
+        }
+
+    public:
+        explicit BenchArgs(std::string programName) : program(std::move(programName)) {}
+
+        // a number or a string; numbers below minimum are rejected
+        template <typename T>
+        BenchArgs& flag(const char* name, T& value, std::type_identity_t<T> minimum = std::numeric_limits<T>::lowest()) {
+            if constexpr (std::is_same_v<T, std::string>) {
+                flags.push_back(Flag{name, "value", [&value](const std::string& text) {
+                    value = text;
+                    return true;
+                }});
+            } else {
+                static_assert(std::is_arithmetic_v<T>, "flags bind numbers or strings");
+                flags.push_back(Flag{name, std::is_floating_point_v<T> ? "x" : "n", [&value, minimum](const std::string& text) {
+                    return parseNumber(text, value, minimum);
+                }});
+            }
+            return *this;
+        }
+
+        // a value with its own parser, which returns false if it is malformed
+        BenchArgs& flag(const char* name, const char* hint, std::function<bool(const std::string&)> parse) {
+            flags.push_back(Flag{name, hint, std::move(parse)});
+            return *this;
+        }
+
+        // a flag without a value that sets value to true
+        BenchArgs& flag(const char* name, bool& value) {
+            flags.push_back(Flag{name, "", [&value](const std::string&) {
+                value = true;
+                return true;
+            }});
+            return *this;
+        }
+
+        std::string usage() const {
+            std::string line = "usage: " + program;
+            for (const Flag& flag : flags) {
+                line += " [" + flag.name + (flag.hint.empty() ? "" : " " + flag.hint) + "]";
+            }
+            return line;
+        }
+
+        bool parse(int argc, char* argv[]) const {
+            for (int i = 1; i < argc; ++i) {
+                std::string name = argv[i];
+                auto found = std::find_if(flags.begin(), flags.end(), [&name](const Flag& flag) { return flag.name == name; });
+                std::string error;
+                if (found == flags.end()) {
+                    error = "Unknown option " + name;
+                } else if (found->hint.empty()) {
+                    found->set(std::string());
+                    continue;
+                } else if (i + 1 >= argc) {
+                    error = "Missing value for " + name;
+                } else if (!found->set(argv[++i])) {
+                    error = "Invalid value for " + name + ": " + argv[i];
+                }
+                if (!error.empty()) {
+                    std::cerr << error << "\n" << usage() << "\n";
+                    return false;
+                }
+            }
+            return true;
+        }
+};
+
+#endif // bench_common_hpp
@@ -0,0 +1,80 @@
+// thermostat control loop: period jitter and tick cost for many thermostats on the dedicated worker
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "controllers/energy_monitor.hpp"
+#include "controllers/thermostat_control.hpp"
+#include "devices/thermostat.hpp"
+#include "bench_common.hpp"
+
+static void runStrategy(const char* label, ControlStrategy strategy, const std::vector<std::shared_ptr<Thermostat>>& thermostats,
+                        std::uint32_t periodMillis, int seconds) {
+    ControlLoopConfig config;
+    config.periodMillis = periodMillis;
+    config.strategy = strategy;
+    ThermostatControlLoop loop(config);
+    for (const auto& thermostat : thermostats) {
+        loop.addThermostat(thermostat);
+    }
+
+    loop.start();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    loop.stop();
+
+    ControlLoopStats stats = loop.getStats();
+    double meanOutput = 0.0;
+    for (const auto& thermostat : thermostats) {
+        meanOutput += thermostat->getControlOutput();
+    }
+    meanOutput /= static_cast<double>(thermostats.size());
+    std::cout << label << "\n" << std::fixed << std::setprecision(1)
+              << "  ticks " << stats.ticks << ", missed " << stats.missedTicks << "\n"
+              << "  jitter p50 " << stats.p50JitterMicros << " us, p99 " << stats.p99JitterMicros
+              << " us, max " << stats.maxJitterMicros << " us\n"
+              << "  tick compute mean " << stats.meanTickMicros / 1000 << " ms, max " << stats.maxTickMicros / 1000
+              << " ms (" << stats.meanTickMicros * 100 / (periodMillis * 1000.0) << "% of the period)\n"
+              << std::setprecision(3) << "  mean output " << meanOutput << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t thermostatCount = 100000;
+    std::uint32_t periodMillis = 100;
+    int seconds = 5;
+    BenchArgs args("bench_control");
+    args.flag("--thermostats", thermostatCount)
+        .flag("--period", periodMillis, 1)
+        .flag("--seconds", seconds, 1);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+
+    // rooms start spread around their setpoints
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> start(14.0f, 26.0f);
+    std::uniform_real_distribution<float> setpoint(18.0f, 23.0f);
+    const char* modes[] = {"heating", "cooling", "auto"};
+    std::vector<std::shared_ptr<Thermostat>> thermostats;
+    thermostats.reserve(thermostatCount);
+    for (size_t i = 0; i < thermostatCount; ++i) {
+        auto thermostat = std::make_shared<Thermostat>("T" + std::to_string(i), "Thermostat", "Bench");
+        thermostat->setTemperature(start(rng));
+        thermostat->setDesiredTemperature(setpoint(rng));
+        thermostat->setMode(modes[i % 3]);
+        thermostat->turnOn();
+        thermostats.push_back(thermostat);
+    }
+
+    std::cout << "=== Control loop for " << thermostatCount << " thermostats at " << periodMillis
+              << " ms for " << seconds << " s ===\n";
+    runStrategy("PID", ControlStrategy::Pid, thermostats, periodMillis, seconds);
+    runStrategy("Hysteresis", ControlStrategy::Hysteresis, thermostats, periodMillis, seconds);
+    std::cout << "\nEnergy monitor total: " << std::setprecision(0)
+              << EnergyMonitor::getInstance()->getTotalSystemUsage() << " W\n";
+    return 0;
+}
@@ -0,0 +1,88 @@
+// bulk device work on the home's work-stealing executor at 1..N threads: a command batch, a
+// room-wide switch, an energy measurement and a thermostat control tick over a generated home
+//
+// usage: bench_executor [--devices n] [--commands n] [--threads max] [--repeat n]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "core/logger.hpp"
+#include "bench_common.hpp"
+
+// best of a few runs, the first one also warms the caches
+template <typename F>
+static double bestMillis(int repeat, F&& work) {
+    double best = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+        Clock::time_point start = Clock::now();
+        work();
+        double elapsed = millisSince(start);
+        best = i == 0 ? elapsed : std::min(best, elapsed);
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 1000000;
+    std::size_t commandCount = 1000000;
+    std::size_t maxThreads = std::max(4u, std::thread::hardware_concurrency());
+    int repeat = 3;
+    BenchArgs args("bench_executor");
+    args.flag("--devices", deviceCount)
+        .flag("--commands", commandCount)
+        .flag("--threads", maxThreads, 1)
+        .flag("--repeat", repeat, 1);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Error);
+
+    // 70% lights, 20% thermostats, 10% cameras in eight large rooms
+    HomeSpec spec;
+    spec.lights = deviceCount * 7 / 10;
+    spec.thermostats = deviceCount * 2 / 10;
+    spec.cameras = deviceCount - spec.lights - spec.thermostats;
+    spec.rooms = 8;
+    Clock::time_point setup = Clock::now();
+    GeneratedHome generated = generateHome(spec);
+    HomeController* home = HomeController::getInstance();
+    populateHome(*home, generated);
+    CommandStream commands = generateCommands(generated, CommandMix(), commandCount, 7);
+    const std::string& room = generated.rooms.front();
+    std::cout << "=== " << deviceCount << " devices, " << commandCount << " commands, "
+              << std::thread::hardware_concurrency() << " hardware threads ===\n" << std::fixed << std::setprecision(1)
+              << "setup: " << millisSince(setup) << " ms\n\n"
+              << "threads  commands ms  speedup  room on+off ms  speedup  energy ms  speedup  control tick ms  speedup  stolen\n";
+
+    double base[4] = {0.0, 0.0, 0.0, 0.0};
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        home->setExecutorThreads(threads);
+        std::vector<DeviceResult> results;
+        double timings[4];
+        timings[0] = bestMillis(repeat, [&] { home->applyCommands(commands, results); });
+        timings[1] = bestMillis(repeat, [&] {
+            home->setRoomPower(room, true);
+            home->setRoomPower(room, false);
+        });
+        double watts = 0.0;
+        timings[2] = bestMillis(repeat, [&] { watts = home->measureEnergy().totalWatts; });
+        timings[3] = bestMillis(repeat, [&] { home->getThermostatControl().runTick(0.1f); });
+        if (threads == 1) {
+            std::copy(timings, timings + 4, base);
+        }
+        std::cout << std::setw(7) << threads;
+        for (int i = 0; i < 4; ++i) {
+            std::cout << std::setw(i == 0 ? 13 : i == 1 ? 16 : i == 2 ? 11 : 17) << timings[i]
+                      << std::setw(8) << base[i] / timings[i] << "x";
+        }
+        std::cout << std::setw(8) << home->getExecutor().getStolenCount() << "   (" << std::setprecision(0) << watts
+                  << " W)\n" << std::setprecision(1);
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+// many small homes in one process: 10k homes of ten devices each, every home fed its own command
+// stream in batches through the host's shards, aggregate throughput against a single shard
+//
+// usage: bench_homes [--homes n] [--devices n] [--commands per-home] [--batch n] [--shards n]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "controllers/home_generator.hpp"
+#include "controllers/home_host.hpp"
+#include "core/logger.hpp"
+#include "bench_common.hpp"
+
+struct RunResult {
+    double setupSeconds = 0.0;
+    double seconds = 0.0;
+    std::size_t succeeded = 0;
+};
+
+// build the homes on their own shards, each home's devices intern their locations in the home's own
+// pool, then post every home's stream batch by batch, interleaved
+// across homes the way requests for many tenants arrive
+static RunResult serve(std::size_t shardCount, std::size_t homeCount, const HomeSpec& spec,
+                       std::size_t commandsPerHome, std::size_t batch) {
+    RunResult result;
+    HomeHost host(shardCount);
+    std::vector<CommandStream> streams(homeCount);
+    std::vector<std::size_t> succeeded(homeCount, 0);
+    auto start = Clock::now();
+    for (std::size_t i = 0; i < homeCount; ++i) {
+        std::size_t id = host.addHome();
+        HomeSpec home = spec;
+        home.seed = static_cast<std::uint32_t>(i + 1);
+        host.post(id, [home, &streams, commandsPerHome, id](HomeController& controller) {
+            HomeSpec own = home;
+            own.strings = &controller.getStringPool(); // homes share no pool, so no lock between shards
+            GeneratedHome generated = generateHome(own);
+            populateHome(controller, generated);
+            streams[id] = generateCommands(generated, CommandMix{}, commandsPerHome, home.seed);
+        });
+    }
+    host.wait();
+    result.setupSeconds = secondsSince(start);
+
+    start = Clock::now();
+    for (std::size_t offset = 0; offset < commandsPerHome; offset += batch) {
+        for (std::size_t id = 0; id < homeCount; ++id) {
+            host.post(id, [&streams, &succeeded, offset, batch, id](HomeController& controller) {
+                const CommandStream& stream = streams[id];
+                CommandStream part(stream.begin() + static_cast<std::ptrdiff_t>(offset),
+                                   stream.begin() + static_cast<std::ptrdiff_t>(std::min(stream.size(), offset + batch)));
+                std::vector<DeviceResult> results;
+                succeeded[id] += controller.applyCommands(part, results);
+            });
+        }
+    }
+    host.wait();
+    result.seconds = secondsSince(start);
+    for (std::size_t id = 0; id < homeCount; ++id) {
+        result.succeeded += succeeded[id];
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t homeCount = 10000;
+    std::size_t devicesPerHome = 10;
+    std::size_t commandsPerHome = 200;
+    std::size_t batch = 20;
+    std::size_t shards = std::max(1u, std::thread::hardware_concurrency());
+    BenchArgs args("bench_homes");
+    args.flag("--homes", homeCount, 1)
+        .flag("--devices", devicesPerHome, 3)
+        .flag("--commands", commandsPerHome, 1)
+        .flag("--batch", batch, 1)
+        .flag("--shards", shards, 1);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Error);
+
+    // 60% lights, 20% thermostats, 20% cameras, a few rooms on one floor
+    HomeSpec spec;
+    spec.thermostats = std::max<std::size_t>(1, devicesPerHome / 5);
+    spec.cameras = std::max<std::size_t>(1, devicesPerHome / 5);
+    spec.lights = devicesPerHome - spec.thermostats - spec.cameras;
+    spec.rooms = std::max<std::size_t>(1, devicesPerHome / 4);
+    spec.zones = 1;
+
+    std::cout << "=== " << homeCount << " homes of " << devicesPerHome << " devices, " << commandsPerHome
+              << " commands each in batches of " << batch << " ===\n"
+              << std::left << std::setw(10) << "shards" << std::right << std::setw(12) << "setup s" << std::setw(12) << "run s"
+              << std::setw(16) << "commands/s" << std::setw(12) << "speedup" << "\n";
+    std::vector<std::size_t> shardCounts = {1};
+    if (shards > 1) shardCounts.push_back(shards);
+    double single = 0.0;
+    bool consistent = true;
+    std::size_t expected = 0;
+    for (std::size_t count : shardCounts) {
+        RunResult result = serve(count, homeCount, spec, commandsPerHome, batch);
+        double rate = static_cast<double>(homeCount * commandsPerHome) / result.seconds;
+        if (count == 1) {
+            single = rate;
+            expected = result.succeeded;
+        }
+        consistent = consistent && result.succeeded == expected;
+        std::cout << std::left << std::setw(10) << count << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << result.setupSeconds << std::setw(12) << result.seconds << std::setprecision(0)
+                  << std::setw(16) << rate << std::setprecision(2) << std::setw(11) << rate / single << "x"
+                  << "   (" << result.succeeded << " succeeded)\n";
+    }
+    return consistent ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+// loading a home from a layout file: a million devices in a thousand rooms written out, then
+// parsed and installed in bulk, against adding devices one at a time through the controller
+//
+// usage: bench_layout [--devices n] [--rooms n] [--compare n] [--file path]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "controllers/home_layout.hpp"
+#include "core/logger.hpp"
+#include "bench_common.hpp"
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 1000000;
+    std::size_t roomCount = 1000;
+    std::size_t compareCount = 100000;
+    std::string path = "/tmp/bench_layout.layout";
+    BenchArgs args("bench_layout");
+    args.flag("--devices", deviceCount)
+        .flag("--rooms", roomCount, 1)
+        .flag("--compare", compareCount)
+        .flag("--file", path);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Warning);
+
+    // 80% lights, 10% thermostats, 10% cameras, most of them on with some state set
+    HomeSpec spec;
+    spec.lights = deviceCount * 8 / 10;
+    spec.thermostats = deviceCount / 10;
+    spec.cameras = deviceCount - spec.lights - spec.thermostats;
+    spec.rooms = roomCount;
+    spec.zones = 10;
+    HomeLayout source;
+    {
+        GeneratedHome generated = generateHome(spec);
+        for (std::size_t i = 0; i < generated.devices.size(); ++i) {
+            Device& device = *generated.devices[i];
+            if (i % 4 != 0) {
+                (void)device.applyCommand(DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+            }
+            (void)device.applyCommand(DeviceCommand{CommandType::SetBrightness, static_cast<float>(i % 101), ""});
+            (void)device.applyCommand(DeviceCommand{CommandType::SetDesiredTemperature, 18.0f + (i % 9) * 0.5f, ""});
+            (void)device.applyCommand(DeviceCommand{CommandType::SetRotation, static_cast<float>(i % 361), ""});
+        }
+        source.rooms = generated.rooms;
+        source.devices = std::move(generated.devices);
+        source.deviceRoom.assign(generated.deviceRoom.begin(), generated.deviceRoom.end());
+    }
+    Clock::time_point start = Clock::now();
+    if (!saveHomeLayout(path, source)) {
+        std::cerr << "cannot write " << path << "\n";
+        return 1;
+    }
+    double writeMillis = millisSince(start);
+    std::ifstream sized(path, std::ios::binary | std::ios::ate);
+    double megabytes = static_cast<double>(sized.tellg()) / (1024.0 * 1024.0);
+    source = HomeLayout();
+
+    std::cout << "=== " << deviceCount << " devices in " << roomCount << " rooms, " << std::fixed << std::setprecision(1)
+              << megabytes << " MiB layout ===\n"
+              << "write:               " << writeMillis << " ms\n";
+
+    // parse and construct the devices, then hand them to the controller
+    HomeController* home = HomeController::getInstance();
+    start = Clock::now();
+    HomeLayout layout = loadHomeLayout(path, &home->getStringPool());
+    double parseMillis = millisSince(start);
+    start = Clock::now();
+    std::size_t added = home->loadLayout(layout);
+    double installMillis = millisSince(start);
+    std::cout << "parse + construct:   " << parseMillis << " ms (" << megabytes / (parseMillis / 1000.0) << " MiB/s)\n"
+              << "install:             " << installMillis << " ms\n"
+              << "total:               " << parseMillis + installMillis << " ms for " << added << " devices, "
+              << std::setprecision(0) << added / ((parseMillis + installMillis) / 1000.0) << " devices/s\n";
+    layout = HomeLayout();
+
+    // the same work one device at a time through the controller's public methods
+    if (compareCount > 0) {
+        std::size_t compareRooms = std::max<std::size_t>(1, compareCount / (deviceCount / roomCount + 1));
+        start = Clock::now();
+        for (std::size_t r = 0; r < compareRooms; ++r) {
+            home->addRoom("Compare Room " + std::to_string(r));
+        }
+        for (std::size_t i = 0; i < compareCount; ++i) {
+            std::string id = "X" + std::to_string(i);
+            home->addDevice(std::make_shared<SmartLight>(id, "Light " + std::to_string(i), "Compare"));
+            home->assignDeviceToRoom(id, "Compare Room " + std::to_string(i % compareRooms));
+            (void)home->applyCommand(id, DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+        }
+        double oneByOne = millisSince(start);
+        std::cout << std::setprecision(1) << "one at a time:       " << oneByOne << " ms for " << compareCount << " devices, "
+                  << std::setprecision(0) << compareCount / (oneByOne / 1000.0) << " devices/s\n";
+    }
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,127 @@
+// load replay: synthesizes a home of configurable size, then drives a generated command stream
+// through HomeController as fast as possible or at a target rate
+//
+// usage: bench_load_replay [--lights n] [--thermostats n] [--cameras n] [--rooms n] [--zones n]
+//                          [--commands n] [--rate commands/s] [--mix toggles,brightness,setpoints,recording]
+//                          [--skew s] [--seed n]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "core/logger.hpp"
+#include "devices/device_command.hpp"
+#include "bench_common.hpp"
+
+struct Options {
+    HomeSpec home{10000, 1000, 1000, 500, 5, 1};
+    CommandMix mix;
+    size_t commands = 1000000;
+    double rate = 0.0; // commands per second, 0 is as fast as possible
+};
+
+static bool parseMix(const std::string& text, CommandMix& mix) {
+    std::vector<double> weights;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        weights.push_back(std::atof(item.c_str()));
+    }
+    if (weights.size() != 4) {
+        return false;
+    }
+    mix.toggles = weights[0];
+    mix.brightness = weights[1];
+    mix.setpoints = weights[2];
+    mix.recording = weights[3];
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    BenchArgs args("bench_load_replay");
+    args.flag("--lights", options.home.lights)
+        .flag("--thermostats", options.home.thermostats)
+        .flag("--cameras", options.home.cameras)
+        .flag("--rooms", options.home.rooms, 1)
+        .flag("--zones", options.home.zones, 1)
+        .flag("--commands", options.commands)
+        .flag("--rate", options.rate, 0.0)
+        .flag("--mix", "toggles,brightness,setpoints,recording", [&options](const std::string& text) {
+            return parseMix(text, options.mix);
+        })
+        .flag("--skew", options.mix.skew, 0.0)
+        .flag("--seed", options.home.seed);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+
+    // routine library messages would dominate a run this size
+    Logger::getInstance()->setLevel(LogLevel::Warning);
+
+    auto start = Clock::now();
+    GeneratedHome home = generateHome(options.home);
+    HomeController* controller = HomeController::getInstance();
+    populateHome(*controller, home);
+    double setupSeconds = secondsSince(start);
+
+    start = Clock::now();
+    CommandStream commands = generateCommands(home, options.mix, options.commands, options.home.seed + 1);
+    double generateSeconds = secondsSince(start);
+
+    std::cout << "=== load replay: " << home.lights << " lights, " << home.thermostats << " thermostats, "
+              << home.cameras << " cameras in " << home.rooms.size() << " rooms ===\n"
+              << std::fixed << std::setprecision(2)
+              << "home setup        " << std::setw(10) << setupSeconds * 1000 << " ms\n"
+              << "command stream    " << std::setw(10) << generateSeconds * 1000 << " ms for "
+              << commands.size() << " commands\n"
+              << "target rate       " << (options.rate > 0.0 ? std::to_string(static_cast<long long>(options.rate)) + "/s"
+                                                             : std::string("as fast as possible")) << "\n";
+
+    // at a target rate, latency counts from when a command was due so a stall is not hidden
+    std::vector<double> latencyMicros;
+    latencyMicros.reserve(commands.size());
+    std::map<DeviceResult, size_t> outcomes;
+    auto runStart = Clock::now();
+    for (size_t i = 0; i < commands.size(); ++i) {
+        Clock::time_point issued;
+        if (options.rate > 0.0) {
+            issued = runStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(i / options.rate));
+            auto now = Clock::now();
+            if (issued > now + std::chrono::microseconds(200)) {
+                std::this_thread::sleep_until(issued - std::chrono::microseconds(100));
+            }
+            while (Clock::now() < issued) {
+            }
+        } else {
+            issued = Clock::now();
+        }
+        DeviceResult result = controller->applyCommand(commands[i].first, commands[i].second);
+        latencyMicros.push_back(microsSince(issued));
+        ++outcomes[result];
+    }
+    double runSeconds = secondsSince(runStart);
+
+    double maxMicros = latencyMicros.empty() ? 0.0 : *std::max_element(latencyMicros.begin(), latencyMicros.end());
+    std::cout << "throughput        " << std::setw(10) << commands.size() / runSeconds / 1e3 << " k commands/s\n";
+    if (!latencyMicros.empty()) {
+        std::cout << "latency           p50 " << percentile(latencyMicros, 0.50) << " us  p90 "
+                  << percentile(latencyMicros, 0.90) << " us  p99 " << percentile(latencyMicros, 0.99)
+                  << " us  p99.9 " << percentile(latencyMicros, 0.999) << " us  max " << maxMicros << " us\n";
+    }
+    std::cout << "results\n";
+    for (const auto& outcome : outcomes) {
+        std::cout << "  " << std::left << std::setw(50) << describeResult(outcome.first) << std::right
+                  << std::setw(10) << outcome.second << "\n";
+    }
+    Logger::getInstance()->flush();
+    return 0;
+}
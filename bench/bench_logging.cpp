@@ -0,0 +1,88 @@
+// HomeController::addDevice for 1M devices with the async logger on and off, against a synchronous endl-per-line baseline
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "controllers/home_controller.hpp"
+#include "core/logger.hpp"
+#include "devices/smart_light.hpp"
+#include "bench_common.hpp"
+
+static std::vector<std::shared_ptr<Device>> makeLights(const std::string& prefix, size_t count) {
+    std::vector<std::shared_ptr<Device>> lights;
+    lights.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        lights.push_back(std::make_shared<SmartLight>(prefix + std::to_string(i), "Bench Light", "Bench"));
+    }
+    return lights;
+}
+
+static void report(const char* label, size_t count, double seconds) {
+    std::cout << std::left << std::setw(36) << label << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << seconds * 1000 << " ms" << std::setw(10) << count / seconds / 1e6 << " M/s\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t deviceCount = 1000000;
+    if (!BenchArgs("bench_logging").flag("--devices", deviceCount).parse(argc, argv)) {
+        return 2;
+    }
+
+    // lines go to /dev/null so the terminal's speed does not decide the result
+    std::FILE* devNull = std::fopen("/dev/null", "w");
+    if (!devNull) {
+        std::cerr << "Cannot open /dev/null\n";
+        return 1;
+    }
+    Logger* logger = Logger::getInstance();
+    logger->setSinks(devNull, devNull);
+    HomeController* controller = HomeController::getInstance();
+    std::cout << "=== addDevice for " << deviceCount << " devices with logging on and off ===\n";
+
+    // what every addDevice used to do: a synchronous line with an endl flush
+    {
+        std::ofstream sink("/dev/null");
+        auto start = Clock::now();
+        for (size_t i = 0; i < deviceCount; ++i) {
+            sink << "Device added successfully." << std::endl;
+        }
+        report("synchronous line + endl only", deviceCount, secondsSince(start));
+    }
+
+    // chunks alternate between logging on and off so both see the controller at the same sizes
+    const size_t chunk = 50000;
+    auto lights = makeLights("D", deviceCount * 2);
+    double onSeconds = 0.0, flushSeconds = 0.0, offSeconds = 0.0;
+    for (size_t begin = 0; begin < lights.size(); begin += chunk) {
+        bool logging = (begin / chunk) % 2 == 0;
+        logger->setLevel(logging ? LogLevel::Info : LogLevel::Warning);
+        size_t end = std::min(lights.size(), begin + chunk);
+        auto start = Clock::now();
+        for (size_t i = begin; i < end; ++i) {
+            controller->addDevice(lights[i]);
+        }
+        double seconds = secondsSince(start);
+        if (logging) {
+            onSeconds += seconds;
+            start = Clock::now();
+            logger->flush();
+            flushSeconds += secondsSince(start);
+        } else {
+            offSeconds += seconds;
+        }
+    }
+    report("addDevice, logging on", deviceCount, onSeconds);
+    report("addDevice, info silenced", deviceCount, offSeconds);
+    std::cout << "  writer still busy after the logging chunks: " << std::setprecision(2) << flushSeconds * 1000 << " ms\n"
+              << "  dropped while the ring was full: " << logger->getDroppedCount() << "\n";
+
+    logger->setSinks(stdout, stderr);
+    std::fclose(devNull);
+    return 0;
+}
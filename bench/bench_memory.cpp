@@ -0,0 +1,75 @@
+// memory footprint of a million-device home: the home's own accounting by device type and
+// subsystem, checked against what malloc actually holds, and against a bytes-per-device target
+//
+// usage: bench_memory [--devices n] [--rooms n] [--target bytes-per-device]
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "controllers/home_layout.hpp"
+#include "core/logger.hpp"
+#include "core/memory_usage.hpp"
+#include "bench_common.hpp"
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// bytes malloc has handed out and not had back, 0 where glibc's counters are not available
+static std::size_t heapInUse() {
+#ifdef __GLIBC__
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 1000000;
+    std::size_t roomCount = 50000;
+    double target = 700.0;
+    BenchArgs args("bench_memory");
+    args.flag("--devices", deviceCount, 1)
+        .flag("--rooms", roomCount, 1)
+        .flag("--target", target, 0.0);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Error);
+
+    // 80% lights, 10% thermostats, 10% cameras, twenty devices to a room, every device in one room
+    // and switched on once so the energy monitor has a record for it
+    std::size_t before = heapInUse();
+    HomeController home;
+    {
+        HomeSpec spec;
+        spec.lights = deviceCount * 8 / 10;
+        spec.thermostats = deviceCount / 10;
+        spec.cameras = deviceCount - spec.lights - spec.thermostats;
+        spec.rooms = roomCount;
+        spec.zones = 10;
+        GeneratedHome generated = generateHome(spec);
+        HomeLayout layout;
+        layout.rooms = generated.rooms;
+        layout.devices = generated.devices;
+        for (std::size_t room : generated.deviceRoom) {
+            layout.deviceRoom.push_back(static_cast<std::int32_t>(room));
+        }
+        home.loadLayout(layout);
+    }
+    home.applyToSelection("all", DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+    std::size_t held = heapInUse() - before;
+
+    MemoryReport report = home.measureMemory();
+    report.print(std::cout);
+    double accounted = report.bytesPerDevice();
+    double measured = static_cast<double>(held) / static_cast<double>(report.deviceCount);
+    std::cout << std::fixed << std::setprecision(1)
+              << "\naccounted:  " << accounted << " bytes/device\n"
+              << "malloc:     " << (held ? measured : 0.0) << " bytes/device, allocator overhead included\n"
+              << "target:     " << target << " bytes/device\n";
+    return std::max(accounted, measured) <= target ? 0 : 1;
+}
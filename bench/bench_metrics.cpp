@@ -0,0 +1,121 @@
+// cost of the metrics subsystem: raw recording, and instrumented library paths with recording on and off
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "controllers/energy_monitor.hpp"
+#include "controllers/home_controller.hpp"
+#include "controllers/room_controller.hpp"
+#include "core/logger.hpp"
+#include "core/metrics.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+#include "bench_common.hpp"
+
+// alternates recording on and off in short chunks so drift and noise hit both sides alike
+template <typename Body>
+static void compare(const char* label, size_t iterations, Body body) {
+    std::vector<double> on, off;
+    body(iterations); // warm up
+    for (int round = 0; round < 20; ++round) {
+        for (bool enabled : {round % 2 == 0, round % 2 != 0}) {
+            MetricsRegistry::setEnabled(enabled);
+            (enabled ? on : off).push_back(nanosPerOp(iterations, body));
+        }
+    }
+    MetricsRegistry::setEnabled(true);
+    std::sort(on.begin(), on.end());
+    std::sort(off.begin(), off.end());
+    double onMedian = on[on.size() / 2], offMedian = off[off.size() / 2];
+    std::cout << std::left << std::setw(34) << label << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << offMedian << std::setw(10) << onMedian
+              << std::setw(9) << (onMedian / offMedian - 1.0) * 100.0 << "%\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t deviceCount = 10000;
+    if (!BenchArgs("bench_metrics").flag("--devices", deviceCount).parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Warning);
+    MetricsRegistry* registry = MetricsRegistry::getInstance();
+
+    // raw recording cost
+    Counter counter = registry->counter("bench_counter_total", "Benchmark counter");
+    Histogram every = registry->histogram("bench_every_seconds", "Benchmark histogram, every call");
+    Histogram sampled = registry->histogram("bench_sampled_seconds", "Benchmark histogram, 1 in 16", "", 16);
+    const size_t rawIterations = 20000000;
+    std::cout << "=== raw recording, ns per call ===\n" << std::fixed << std::setprecision(2)
+              << "Counter::increment              " << nanosPerOp(rawIterations, [&](size_t n) {
+                     for (size_t i = 0; i < n; ++i) counter.increment();
+                 }) << "\n"
+              << "Histogram::record               " << nanosPerOp(rawIterations, [&](size_t n) {
+                     for (size_t i = 0; i < n; ++i) every.record(i & 4095);
+                 }) << "\n"
+              << "ScopedLatency, every call       " << nanosPerOp(rawIterations / 4, [&](size_t n) {
+                     for (size_t i = 0; i < n; ++i) ScopedLatency timer(every);
+                 }) << "\n"
+              << "ScopedLatency, 1 in 16          " << nanosPerOp(rawIterations, [&](size_t n) {
+                     for (size_t i = 0; i < n; ++i) ScopedLatency timer(sampled);
+                 }) << "\n";
+
+    // counts from four threads merge, and exited threads keep their counts
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&counter] {
+            for (int i = 0; i < 100000; ++i) counter.increment();
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    std::cout << "counter after 4 threads x 100000 plus the loop above: " << registry->read(counter) << "\n";
+
+    // instrumented library paths
+    std::vector<std::shared_ptr<SmartLight>> lights;
+    std::vector<std::shared_ptr<Thermostat>> thermostats;
+    HomeController* controller = HomeController::getInstance();
+    auto room = std::make_shared<RoomController>("Bench Room");
+    for (size_t i = 0; i < deviceCount; ++i) {
+        lights.push_back(std::make_shared<SmartLight>("L" + std::to_string(i), "Light", "Bench"));
+        thermostats.push_back(std::make_shared<Thermostat>("T" + std::to_string(i), "Thermostat", "Bench"));
+        lights.back()->turnOn();
+        thermostats.back()->turnOn();
+        controller->addDevice(lights.back());
+        room->addDevice(lights.back());
+    }
+    std::vector<std::string> ids;
+    for (size_t i = 0; i < 4096; ++i) {
+        ids.push_back(lights[(i * 7919) % deviceCount]->getDeviceID());
+    }
+
+    std::cout << "\n=== instrumented paths, " << deviceCount << " devices, ns per op ===\n"
+              << std::left << std::setw(34) << "path" << std::right << std::setw(10) << "off" << std::setw(10) << "on"
+              << std::setw(10) << "cost" << "\n";
+    compare("HomeController::applyCommand", 100000, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            DeviceCommand command{CommandType::SetBrightness, static_cast<float>(i % 101), ""};
+            if (controller->applyCommand(ids[i & 4095], command) != DeviceResult::Ok) std::abort();
+        }
+    });
+    compare("SmartLight::setBrightness", 100000, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) lights[(i * 7919) % deviceCount]->setBrightness(static_cast<int>(i % 101));
+    });
+    compare("Thermostat::setTemperature", 1000000, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) thermostats[(i * 7919) % deviceCount]->setTemperature(15.0f + (i % 15));
+    });
+    compare("RoomController::turnAll (per dev)", deviceCount, [&](size_t n) {
+        for (size_t done = 0; done < n; done += deviceCount) {
+            room->turnAllDevicesOff();
+            room->turnAllDevicesOn();
+        }
+    });
+    compare("EnergyMonitor::recordUsage", 100000, [&](size_t n) {
+        EnergyMonitor* monitor = EnergyMonitor::getInstance();
+        for (size_t i = 0; i < n; ++i) monitor->recordUsage(ids[i & 4095], 1.0);
+    });
+    return 0;
+}
@@ -0,0 +1,117 @@
+// motion detection throughput: frames/second per core at each resolution and with many cameras in parallel
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "devices/security_camera.hpp"
+#include "devices/video_frame.hpp"
+#include "bench_common.hpp"
+
+// pre-render a short clip so frame generation is not part of the measurement
+static std::vector<GrayFrame> renderClip(FrameSize size, int length) {
+    SyntheticFrameSource source(size);
+    std::vector<GrayFrame> clip;
+    clip.reserve(static_cast<size_t>(length));
+    for (int i = 0; i < length; ++i) {
+        source.setMotion(i >= length / 2); // still first half, moving block second half
+        clip.push_back(source.nextFrame());
+    }
+    return clip;
+}
+
+// build a camera with motion detection on
+static std::unique_ptr<SecurityCamera> makeCamera(int index, const std::string& resolution) {
+    auto camera = std::make_unique<SecurityCamera>("SC" + std::to_string(index), "Bench Camera", "Bench");
+    camera->setResolution(resolution);
+    camera->turnOn();
+    camera->enableMotionDetection();
+    return camera;
+}
+
+// one camera on one thread
+static void benchSingleCamera(const std::string& resolution, int frames) {
+    auto clip = renderClip(frameSizeForResolution(resolution), 16);
+    auto camera = makeCamera(0, resolution);
+
+    auto start = Clock::now();
+    for (int i = 0; i < frames; ++i) {
+        camera->processFrame(clip[static_cast<size_t>(i) % clip.size()]);
+    }
+    double seconds = secondsSince(start);
+
+    std::cout << std::left << std::setw(8) << resolution
+              << std::right << std::setw(12) << std::fixed << std::setprecision(1) << frames / seconds << " fps/core"
+              << std::setw(12) << std::setprecision(1)
+              << (static_cast<double>(clip[0].pixelCount()) * frames / seconds) / 1e6 << " Mpix/s"
+              << std::setw(8) << camera->getMotionEventCount() << " motion events\n";
+}
+
+// many cameras spread over all hardware threads
+static void benchParallelCameras(const std::string& resolution, int cameraCount, int framesPerCamera) {
+    auto clip = renderClip(frameSizeForResolution(resolution), 16);
+    std::vector<std::unique_ptr<SecurityCamera>> cameras;
+    for (int i = 0; i < cameraCount; ++i) {
+        cameras.push_back(makeCamera(i, resolution));
+    }
+
+    unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    std::atomic<uint64_t> events{0};
+    std::vector<std::thread> threads;
+
+    auto start = Clock::now();
+    for (unsigned w = 0; w < workers; ++w) {
+        threads.emplace_back([&, w] {
+            uint64_t seen = 0;
+            for (int f = 0; f < framesPerCamera; ++f) {
+                const GrayFrame& frame = clip[static_cast<size_t>(f) % clip.size()];
+                for (size_t c = w; c < cameras.size(); c += workers) {
+                    seen += cameras[c]->processFrame(frame) ? 1 : 0;
+                }
+            }
+            events += seen;
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    double seconds = secondsSince(start);
+    double fps = static_cast<double>(cameraCount) * framesPerCamera / seconds;
+
+    std::cout << std::left << std::setw(8) << resolution
+              << std::right << std::setw(12) << std::fixed << std::setprecision(1) << fps << " fps total"
+              << std::setw(12) << fps / workers << " fps/core"
+              << std::setw(8) << events.load() << " motion events"
+              << "  (" << cameraCount << " cameras, " << workers << " threads)\n";
+}
+
+int main(int argc, char* argv[]) {
+    int frames = 200; // frames for the single camera runs
+    int cameras = 64; // cameras for the parallel runs
+    int framesPerCamera = 16; // frames per camera for the parallel runs
+    BenchArgs args("bench_motion");
+    args.flag("--frames", frames, 1)
+        .flag("--cameras", cameras, 1)
+        .flag("--frames-per-camera", framesPerCamera, 1);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+
+    const std::vector<std::string> resolutions = {"720p", "1080p", "4K"};
+
+    std::cout << "=== Motion detection, single camera ===\n";
+    for (const auto& res : resolutions) {
+        benchSingleCamera(res, frames);
+    }
+
+    std::cout << "\n=== Motion detection, parallel cameras ===\n";
+    for (const auto& res : resolutions) {
+        benchParallelCameras(res, cameras, framesPerCamera);
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+// fan-out throughput of the message broker: a million topics, ten thousand subscribers with
+// exact and wildcard filters, and the cost of device telemetry on the home controller
+//
+// usage: bench_pubsub [--topics n] [--subscribers n] [--messages n]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "controllers/home_controller.hpp"
+#include "core/logger.hpp"
+#include "core/message_broker.hpp"
+#include "devices/smart_light.hpp"
+#include "bench_common.hpp"
+
+int main(int argc, char* argv[]) {
+    std::size_t topicCount = 1000000;
+    std::size_t subscriberCount = 10000;
+    std::size_t messageCount = 2000000;
+    BenchArgs args("bench_pubsub");
+    args.flag("--topics", topicCount, 1)
+        .flag("--subscribers", subscriberCount)
+        .flag("--messages", messageCount);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Warning);
+
+    // home/<room>/<device>/<property>: a thousand rooms, four properties per device
+    static const char* const properties[] = {"power", "brightness", "color", "temperature"};
+    const std::size_t roomCount = 1000;
+    const std::size_t deviceCount = std::max<std::size_t>(1, topicCount / 4);
+    auto roomOf = [&](std::size_t device) { return "Room " + std::to_string(device % roomCount); };
+    std::vector<std::string> topics;
+    topics.reserve(topicCount);
+    for (std::size_t i = 0; i < topicCount; ++i) {
+        std::size_t device = i / 4;
+        topics.push_back("home/" + roomOf(device) + "/D" + std::to_string(device) + "/" + properties[i % 4]);
+    }
+
+    // 80% follow one device, 10% a whole room, 10% one property across a room; a few see everything
+    MessageBroker broker;
+    std::vector<std::shared_ptr<Subscription>> subscribers;
+    std::vector<std::string> filters;
+    for (std::size_t i = 0; i < subscriberCount; ++i) {
+        std::size_t device = (i * 7919) % deviceCount;
+        std::string room = "Room " + std::to_string((i / 10) % roomCount);
+        std::string filter;
+        if (i < 4) {
+            filter = i == 0 ? "#" : "home/+/+/temperature";
+        } else if (i % 10 < 8) {
+            filter = "home/" + roomOf(device) + "/D" + std::to_string(device) + "/+";
+        } else if (i % 10 == 8) {
+            filter = "home/" + room + "/#";
+        } else {
+            filter = "home/" + room + "/+/power";
+        }
+        filters.push_back(filter);
+        subscribers.push_back(broker.subscribe(filter, 256, OverflowPolicy::DropOldest));
+    }
+
+    // publish in a scattered order, draining every queue after each chunk like slow consumers would
+    std::vector<std::shared_ptr<const BrokerMessage>> drained;
+    std::size_t deliveries = 0;
+    std::size_t consumed = 0;
+    const std::size_t chunk = 65536;
+    double publishSeconds = 0.0;
+    Clock::time_point total = Clock::now();
+    for (std::size_t done = 0; done < messageCount; done += chunk) {
+        std::size_t end = std::min(messageCount, done + chunk);
+        Clock::time_point start = Clock::now();
+        for (std::size_t i = done; i < end; ++i) {
+            deliveries += broker.publish(topics[(i * 2654435761u) % topicCount], "1");
+        }
+        publishSeconds += secondsSince(start);
+        for (auto& subscriber : subscribers) {
+            drained.clear();
+            consumed += subscriber->drain(drained);
+        }
+    }
+    double totalSeconds = secondsSince(total);
+    std::uint64_t dropped = 0;
+    for (auto& subscriber : subscribers) dropped += subscriber->getDropped();
+
+    std::cout << "=== broker fan-out, " << topicCount << " topics, " << subscriberCount << " subscribers ===\n"
+              << std::fixed << std::setprecision(0)
+              << "published:        " << messageCount << " messages\n"
+              << "publish rate:     " << messageCount / publishSeconds << " messages/s\n"
+              << "delivery rate:    " << deliveries / publishSeconds << " deliveries/s ("
+              << std::setprecision(2) << static_cast<double>(deliveries) / messageCount << " per message)\n"
+              << std::setprecision(0)
+              << "end to end:       " << consumed / totalSeconds << " consumed/s including draining\n"
+              << "dropped:          " << dropped << "\n";
+
+    // the same matching without the trie: every filter checked against the topic
+    const std::size_t linearSamples = 200;
+    Clock::time_point start = Clock::now();
+    std::size_t linearMatches = 0;
+    for (std::size_t i = 0; i < linearSamples; ++i) {
+        const std::string& topic = topics[(i * 2654435761u) % topicCount];
+        for (const auto& filter : filters) linearMatches += MessageBroker::matches(filter, topic) ? 1 : 0;
+    }
+    std::cout << "linear matching:  " << linearSamples / secondsSince(start) << " messages/s ("
+              << std::setprecision(2) << static_cast<double>(linearMatches) / linearSamples << " per message)\n";
+
+    // home controller telemetry: a device change with nobody subscribed, and with a whole-home subscriber
+    HomeController* controller = HomeController::getInstance();
+    std::vector<std::string> ids;
+    for (std::size_t i = 0; i < 10000; ++i) {
+        auto light = std::make_shared<SmartLight>("L" + std::to_string(i), "Light", "Room " + std::to_string(i % 100));
+        controller->addDevice(light);
+        light->turnOn();
+        ids.push_back(light->getDeviceID());
+    }
+    auto changes = [&](std::size_t n) {
+        Clock::time_point begin = Clock::now();
+        for (std::size_t i = 0; i < n; ++i) {
+            (void)controller->applyCommand(ids[i % ids.size()], DeviceCommand{CommandType::SetBrightness, static_cast<float>(i % 101), ""});
+        }
+        return secondsSince(begin) * 1e9 / n;
+    };
+    const std::size_t commandCount = 500000;
+    changes(commandCount); // warm up
+    double quiet = changes(commandCount);
+    auto everything = controller->getTelemetry().subscribe("home/#", 1 << 20);
+    double observed = changes(commandCount);
+    std::cout << "\n=== HomeController::applyCommand, ns per command ===\n" << std::setprecision(1)
+              << "no subscribers:   " << quiet << "\n"
+              << "home/# consumer:  " << observed << " (" << everything->size() << " messages queued)\n";
+    return 0;
+}
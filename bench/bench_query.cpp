@@ -0,0 +1,130 @@
+// device queries at a million devices: selective queries through the secondary indexes against a
+// full scan of the devices, then the cost of keeping the indexes current under a command stream
+//
+// usage: bench_query [--devices n] [--rooms n] [--commands n] [--repeat n]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "controllers/device_query.hpp"
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "controllers/home_layout.hpp"
+#include "core/logger.hpp"
+#include "bench_common.hpp"
+
+// what a caller without the indexes does: every device, its state read through its own getters
+static std::size_t scan(const std::vector<std::shared_ptr<Device>>& devices, const DeviceQuery& query,
+                        const std::unordered_map<const Device*, std::string>& roomOf) {
+    std::size_t matched = 0;
+    for (const auto& device : devices) {
+        auto* camera = dynamic_cast<SecurityCamera*>(device.get());
+        DeviceKind kind = camera ? DeviceKind::Camera
+                        : dynamic_cast<SmartLight*>(device.get()) ? DeviceKind::Light
+                        : dynamic_cast<Thermostat*>(device.get()) ? DeviceKind::Thermostat : DeviceKind::Other;
+        if (query.kind != DeviceKind::Unknown && kind != query.kind) continue;
+        if (query.on >= 0 && device->getIsOn() != (query.on == 1)) continue;
+        if (query.recording >= 0 && (camera && camera->getIsRecording()) != (query.recording == 1)) continue;
+        if (!query.location.empty() && device->getDeviceLocation() != query.location) continue;
+        if (!query.room.empty()) {
+            auto it = roomOf.find(device.get());
+            if (it == roomOf.end() || it->second != query.room) continue;
+        }
+        if (!query.powerMatches(static_cast<float>(device->getPowerUsage()))) continue;
+        if (device->getDeviceName().compare(0, query.namePrefix.size(), query.namePrefix) != 0) continue;
+        ++matched;
+    }
+    return matched;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 1000000;
+    std::size_t roomCount = 50000;
+    std::size_t commandCount = 1000000;
+    int repeat = 5;
+    BenchArgs args("bench_query");
+    args.flag("--devices", deviceCount)
+        .flag("--rooms", roomCount, 1)
+        .flag("--commands", commandCount)
+        .flag("--repeat", repeat, 1);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Error);
+
+    // 80% lights, 10% thermostats, 10% cameras, twenty devices to a room named after its location,
+    // then a command stream so brightness, setpoints, power and recording vary
+    HomeSpec spec;
+    spec.lights = deviceCount * 8 / 10;
+    spec.thermostats = deviceCount / 10;
+    spec.cameras = deviceCount - spec.lights - spec.thermostats;
+    spec.rooms = roomCount;
+    spec.zones = 10;
+    GeneratedHome generated = generateHome(spec);
+    std::unordered_map<const Device*, std::string> roomOf;
+    HomeLayout layout;
+    layout.rooms = generated.rooms;
+    layout.devices = generated.devices;
+    for (std::size_t i = 0; i < generated.devices.size(); ++i) {
+        layout.deviceRoom.push_back(static_cast<std::int32_t>(generated.deviceRoom[i]));
+        roomOf.emplace(generated.devices[i].get(), generated.rooms[generated.deviceRoom[i]]);
+    }
+    HomeController* home = HomeController::getInstance();
+    auto start = Clock::now();
+    home->loadLayout(layout);
+    double loadMillis = microsSince(start) / 1000.0;
+    std::vector<DeviceResult> results;
+    CommandStream commands = generateCommands(generated, CommandMix{}, commandCount, 7);
+    start = Clock::now();
+    home->applyCommands(commands, results);
+    double commandMicros = microsSince(start);
+    start = Clock::now();
+    std::size_t warm = home->countDevices("power above 0.5");
+    double repairMillis = microsSince(start) / 1000.0;
+    std::vector<std::shared_ptr<Device>> devices = home->getDevices();
+
+    std::cout << "=== " << devices.size() << " devices, " << roomCount << " rooms ===\n" << std::fixed << std::setprecision(1)
+              << "layout load:          " << loadMillis << " ms, indexes included\n"
+              << "command stream:       " << commandCount << " commands, " << commandMicros * 1000.0 / static_cast<double>(commandCount)
+              << " ns each, indexes updated on every change\n"
+              << "first power query:    " << repairMillis << " ms (" << warm << " devices), sorts the power array\n\n";
+
+    const char* queries[] = {
+        "at Zone 3 Room 1234",
+        "in Zone 7 Room 42 and lights",
+        "cameras and recording and power above 0.9",
+        "thermostats and on and power above 40",
+        "lights and power from 0.095 to 0.1",
+        "named Camera 9999",
+        "thermostats and off",
+        "on"
+    };
+    std::cout << std::left << std::setw(44) << "query" << std::right << std::setw(10) << "matches" << std::setw(14) << "index us"
+              << std::setw(14) << "scan us" << std::setw(10) << "speedup" << "\n";
+    bool agree = true;
+    for (const char* text : queries) {
+        DeviceQuery query = DeviceQuery::parse(text);
+        double indexBest = 1e18;
+        double scanBest = 1e18;
+        std::size_t indexed = 0;
+        std::size_t scanned = 0;
+        for (int r = 0; r < repeat; ++r) {
+            start = Clock::now();
+            indexed = home->selectDevices(text).size();
+            indexBest = std::min(indexBest, microsSince(start));
+            start = Clock::now();
+            scanned = scan(devices, query, roomOf);
+            scanBest = std::min(scanBest, microsSince(start));
+        }
+        agree = agree && indexed == scanned;
+        std::cout << std::left << std::setw(44) << text << std::right << std::setw(10) << indexed << std::setw(14) << indexBest
+                  << std::setw(14) << scanBest << std::setw(9) << scanBest / indexBest << "x"
+                  << (indexed == scanned ? "" : "  MISMATCH") << "\n";
+    }
+    return agree ? 0 : 1;
+}
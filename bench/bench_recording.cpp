@@ -0,0 +1,171 @@
+// sustained clip write throughput: many cameras recording with pre-roll to a local directory
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "devices/recording_buffer.hpp"
+#include "devices/security_camera.hpp"
+#include "bench_common.hpp"
+
+// clip handed from the capture loop to a writer thread
+struct WriteJob {
+    size_t camera; // index of the camera and its writer
+    RecordingClip clip; // segments referencing the camera's ring
+};
+
+// queue of clips waiting to be written
+class WriteQueue {
+    private:
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<WriteJob> jobs;
+        bool closed = false;
+
+    public:
+        void push(WriteJob job) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back(std::move(job));
+            }
+            ready.notify_one();
+        }
+
+        bool pop(WriteJob& job) {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return closed || !jobs.empty(); });
+            if (jobs.empty()) return false;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            return true;
+        }
+
+        void close() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+            }
+            ready.notify_all();
+        }
+};
+
+int main(int argc, char* argv[]) {
+    int cameraCount = 64; // cameras recording at once
+    int seconds = 5; // seconds of video per camera
+    int preRollSeconds = 5; // pre-roll buffered before recording starts
+    size_t capacityMiB = 16; // ring capacity per camera
+    std::string resolution = "1080p";
+    std::string directory = ".";
+    bool keepFiles = false;
+    BenchArgs args("bench_recording");
+    args.flag("--cameras", cameraCount, 1)
+        .flag("--seconds", seconds, 1)
+        .flag("--pre-roll", preRollSeconds, 0)
+        .flag("--capacity-mib", capacityMiB, 1)
+        .flag("--resolution", resolution)
+        .flag("--dir", directory)
+        .flag("--keep", keepFiles);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+
+    const int fps = 30;
+    RecordingBufferConfig config;
+    config.capacityBytes = capacityMiB << 20;
+    config.preRollMicros = static_cast<uint64_t>(preRollSeconds) * 1000000u;
+
+    std::vector<std::unique_ptr<SecurityCamera>> cameras;
+    std::vector<std::unique_ptr<SyntheticVideoEncoder>> encoders;
+    std::vector<std::unique_ptr<ClipWriter>> writers;
+    for (int i = 0; i < cameraCount; ++i) {
+        auto camera = std::make_unique<SecurityCamera>("SC" + std::to_string(i), "Bench Camera", "Bench");
+        camera->setResolution(resolution);
+        camera->configureRecordingBuffer(config);
+        camera->turnOn();
+        encoders.push_back(std::make_unique<SyntheticVideoEncoder>(camera->getFrameSize(), fps));
+        writers.push_back(std::make_unique<ClipWriter>(directory + "/bench_clip_" + std::to_string(i) + ".bin"));
+        cameras.push_back(std::move(camera));
+    }
+
+    // fill the pre-roll before anyone starts recording
+    for (int f = 0; f < preRollSeconds * fps; ++f) {
+        for (size_t c = 0; c < cameras.size(); ++c) {
+            size_t size = encoders[c]->encodeNext();
+            cameras[c]->ingestEncodedFrame(encoders[c]->data(), size, encoders[c]->getTimestampMicros(), encoders[c]->isKeyFrame());
+        }
+    }
+    for (auto& camera : cameras) {
+        camera->startRecording();
+    }
+
+    // writer threads own disjoint sets of cameras so each file sees ordered appends
+    unsigned workerCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::unique_ptr<WriteQueue>> queues;
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < workerCount; ++w) {
+        queues.push_back(std::make_unique<WriteQueue>());
+    }
+    for (unsigned w = 0; w < workerCount; ++w) {
+        workers.emplace_back([&, w] {
+            WriteJob job;
+            while (queues[w]->pop(job)) {
+                writers[job.camera]->write(job.clip);
+                job.clip = RecordingClip(); // release the chunks
+            }
+        });
+    }
+
+    // capture and hand off a clip per camera every half second of video
+    size_t peakMemory = 0;
+    auto start = Clock::now();
+    for (int f = 0; f < seconds * fps; ++f) {
+        for (size_t c = 0; c < cameras.size(); ++c) {
+            size_t size = encoders[c]->encodeNext();
+            cameras[c]->ingestEncodedFrame(encoders[c]->data(), size, encoders[c]->getTimestampMicros(), encoders[c]->isKeyFrame());
+            if (f % (fps / 2) == 0) {
+                queues[c % workerCount]->push(WriteJob{c, cameras[c]->takeRecordedClip()});
+            }
+            peakMemory = std::max(peakMemory, cameras[c]->getRecordingMemoryUsage());
+        }
+    }
+    for (size_t c = 0; c < cameras.size(); ++c) {
+        cameras[c]->stopRecording();
+        queues[c % workerCount]->push(WriteJob{c, cameras[c]->takeRecordedClip()});
+    }
+    for (auto& queue : queues) {
+        queue->close();
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed = secondsSince(start);
+
+    uint64_t totalBytes = 0;
+    for (const auto& writer : writers) {
+        totalBytes += writer->getBytesWritten();
+    }
+
+    std::cout << "=== Pre-roll recording, " << cameraCount << " cameras at " << resolution << " ===\n"
+              << std::fixed << std::setprecision(2)
+              << "Video per camera:      " << preRollSeconds << "s pre-roll + " << seconds << "s recorded\n"
+              << "Ring capacity/camera:  " << capacityMiB << " MiB (peak usage " << peakMemory / (1024.0 * 1024.0) << " MiB)\n"
+              << "Bytes written:         " << totalBytes / (1024.0 * 1024.0) << " MiB\n"
+              << "Elapsed:               " << elapsed << " s\n"
+              << "Write throughput:      " << totalBytes / (1024.0 * 1024.0) / elapsed << " MiB/s\n"
+              << "Realtime factor:       " << seconds / elapsed << "x\n";
+
+    if (!keepFiles) {
+        for (const auto& writer : writers) {
+            std::remove(writer->getPath().c_str());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+// fast-forward simulation: a 10k-device home lived through a year on a virtual clock, lights
+// switched at random, cameras recording, thermostats following a daily schedule under closed-loop
+// control with the seasons outside
+//
+// usage: bench_simulation [--devices n] [--days n] [--seed n] [--control-period seconds]
+//                         [--light-toggles per-day] [--recordings per-day]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "controllers/home_simulation.hpp"
+#include "core/logger.hpp"
+#include "bench_common.hpp"
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 10000;
+    std::uint64_t days = 365;
+    SimulationConfig config;
+    BenchArgs args("bench_simulation");
+    args.flag("--devices", deviceCount)
+        .flag("--days", days, 1)
+        .flag("--seed", config.seed)
+        .flag("--control-period", config.controlPeriodSeconds, 1)
+        .flag("--light-toggles", config.lightTogglesPerDay, 0.0)
+        .flag("--recordings", config.recordingsPerDay, 0.0);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Error);
+    config.durationMillis = days * 24 * 3600 * 1000;
+
+    // 80% lights, 10% thermostats, 10% cameras, twenty devices to a room, everything on
+    HomeSpec spec;
+    spec.lights = deviceCount * 8 / 10;
+    spec.thermostats = deviceCount / 10;
+    spec.cameras = deviceCount - spec.lights - spec.thermostats;
+    spec.rooms = std::max<std::size_t>(1, deviceCount / 20);
+    spec.seed = config.seed;
+    HomeController* home = HomeController::getInstance();
+    populateHome(*home, generateHome(spec));
+
+    std::cout << "=== " << deviceCount << " devices, " << days << " days, control step " << config.controlPeriodSeconds
+              << " s, seed " << config.seed << " ===\n";
+    HomeSimulation simulation(*home, config);
+    auto start = std::chrono::steady_clock::now();
+    SimulationResult result = simulation.run();
+    double seconds = secondsSince(start);
+
+    double simulatedDays = static_cast<double>(result.simulatedMillis) / (24.0 * 3600.0 * 1000.0);
+    std::cout << std::fixed << std::setprecision(1)
+              << "device events:       " << result.deviceEvents << "\n"
+              << "control ticks:       " << result.controlTicks << " (" << result.controlTicks * spec.thermostats
+              << " thermostat steps)\n"
+              << "home updates:        " << result.updates << "\n"
+              << "energy:              " << std::setprecision(3) << result.energyWattHours / 1000.0 << " kWh\n"
+              << "mean indoor temp:    " << result.meanIndoorTemperature << " C\n"
+              << std::setprecision(2)
+              << "wall time:           " << seconds << " s, " << std::setprecision(0) << simulatedDays * 86400.0 / seconds
+              << "x real time\n";
+    return 0;
+}
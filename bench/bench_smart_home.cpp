@@ -0,0 +1,421 @@
+// micro-benchmark suite for devices, rooms, the home controller and energy monitoring
+//
+// usage: bench_smart_home [--devices 1000,10000,100000] [--format table|json|csv] [--output file]
+//                         [--filter text] [--min-time seconds] [--repeats n] [--metrics on|off]
+//                         [--metrics-out file]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "controllers/energy_monitor.hpp"
+#include "controllers/home_controller.hpp"
+#include "controllers/room_controller.hpp"
+#include "core/logger.hpp"
+#include "core/metrics.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+#include "bench_common.hpp"
+
+// swallows report output so the terminal is not part of the measurement
+class NullBuffer : public std::streambuf {
+    protected:
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+// a prepared benchmark body, runs the operation `iterations` times
+using Body = std::function<void(size_t iterations)>;
+
+// one benchmark: a name and a setup that builds its state for a device count
+struct Case {
+    std::string name;
+    std::string group; // devices, home, room or energy
+    std::function<Body(size_t deviceCount)> setup;
+};
+
+// one row of output
+struct Result {
+    std::string name;
+    std::string group;
+    size_t devices;
+    size_t iterations; // per sample
+    size_t samples;
+    double medianNanos; // per operation
+    double minNanos;
+    double maxNanos;
+};
+
+struct Options {
+    std::vector<size_t> deviceCounts{1000, 10000, 100000};
+    std::string format = "table";
+    std::string output; // stdout when empty
+    std::string filter; // substring of the benchmark name
+    double minSeconds = 0.05; // per sample
+    size_t repeats = 5;
+    bool metrics = true; // off measures the library without its instrumentation
+    std::string metricsOutput; // Prometheus dump after the run
+};
+
+// devices are shared across cases so larger counts only build what is new
+static std::vector<std::shared_ptr<SmartLight>> lights;
+static std::vector<std::shared_ptr<Thermostat>> thermostats;
+static std::vector<std::shared_ptr<SecurityCamera>> cameras;
+
+static void ensureDevices(size_t count) {
+    for (size_t i = lights.size(); i < count; ++i) {
+        lights.push_back(std::make_shared<SmartLight>("L" + std::to_string(i), "Bench Light", "Bench"));
+        thermostats.push_back(std::make_shared<Thermostat>("T" + std::to_string(i), "Bench Thermostat", "Bench"));
+        cameras.push_back(std::make_shared<SecurityCamera>("C" + std::to_string(i), "Bench Camera", "Bench"));
+        lights.back()->turnOn();
+        thermostats.back()->turnOn();
+        cameras.back()->turnOn();
+    }
+}
+
+// random indices so lookups and mutations do not walk memory in order
+static std::vector<size_t> shuffledIndices(size_t count, size_t length) {
+    std::mt19937 rng(static_cast<unsigned>(count));
+    std::uniform_int_distribution<size_t> pick(0, count - 1);
+    std::vector<size_t> indices(length);
+    for (auto& index : indices) {
+        index = pick(rng);
+    }
+    return indices;
+}
+
+static std::vector<Case> buildCases() {
+    std::vector<Case> cases;
+
+    // device mutation
+    cases.push_back({"light.setBrightness", "devices", [](size_t count) -> Body {
+        ensureDevices(count);
+        auto order = shuffledIndices(count, 4096);
+        return [order](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                lights[order[i & 4095]]->setBrightness(static_cast<int>(i % 101));
+            }
+        };
+    }});
+    cases.push_back({"thermostat.setTemperature", "devices", [](size_t count) -> Body {
+        ensureDevices(count);
+        auto order = shuffledIndices(count, 4096);
+        return [order](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                thermostats[order[i & 4095]]->setTemperature(15.0f + static_cast<float>(i % 15));
+            }
+        };
+    }});
+    cases.push_back({"camera.setRotation", "devices", [](size_t count) -> Body {
+        ensureDevices(count);
+        auto order = shuffledIndices(count, 4096);
+        return [order](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                cameras[order[i & 4095]]->setRotation(static_cast<int>(i % 361));
+            }
+        };
+    }});
+
+    // status rendering, a mix of the three device types
+    cases.push_back({"device.getDeviceStatus", "devices", [](size_t count) -> Body {
+        ensureDevices(count);
+        auto order = shuffledIndices(count, 4096);
+        return [order](size_t iterations) {
+            size_t characters = 0;
+            for (size_t i = 0; i < iterations; ++i) {
+                size_t index = order[i & 4095];
+                switch (i % 3) {
+                    case 0: characters += lights[index]->getDeviceStatus().size(); break;
+                    case 1: characters += thermostats[index]->getDeviceStatus().size(); break;
+                    default: characters += cameras[index]->getDeviceStatus().size(); break;
+                }
+            }
+            if (characters == 0) std::abort();
+        };
+    }});
+
+    // controller lookups, the singleton is topped up to the requested device count
+    cases.push_back({"home.findDevice", "home", [](size_t count) -> Body {
+        ensureDevices(count);
+        static size_t registered = 0;
+        HomeController* controller = HomeController::getInstance();
+        for (; registered < count; ++registered) {
+            controller->addDevice(lights[registered]);
+        }
+        std::vector<std::string> ids;
+        for (size_t index : shuffledIndices(count, 1024)) {
+            ids.push_back(lights[index]->getDeviceID());
+        }
+        return [controller, ids](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                if (!controller->findDevice(ids[i & 1023])) std::abort();
+            }
+        };
+    }});
+
+    cases.push_back({"home.applyCommand", "home", [](size_t count) -> Body {
+        ensureDevices(count);
+        HomeController* controller = HomeController::getInstance();
+        if (!controller->findDevice(lights[count - 1]->getDeviceID())) {
+            for (size_t i = 0; i < count; ++i) {
+                if (!controller->findDevice(lights[i]->getDeviceID())) controller->addDevice(lights[i]);
+            }
+        }
+        std::vector<std::string> ids;
+        for (size_t index : shuffledIndices(count, 1024)) {
+            ids.push_back(lights[index]->getDeviceID());
+        }
+        return [controller, ids](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                DeviceCommand command{CommandType::SetBrightness, static_cast<float>(i % 101), ""};
+                if (controller->applyCommand(ids[i & 1023], command) != DeviceResult::Ok) std::abort();
+            }
+        };
+    }});
+
+    // room bulk operations, one op is one device switched
+    cases.push_back({"room.turnAllDevicesOnOff", "room", [](size_t count) -> Body {
+        ensureDevices(count);
+        auto room = std::make_shared<RoomController>("Bench Room");
+        for (size_t i = 0; i < count; ++i) {
+            room->addDevice(lights[i]);
+        }
+        return [room, count](size_t iterations) {
+            for (size_t done = 0, round = 0; done < iterations; done += count, ++round) {
+                if (round & 1) {
+                    room->turnAllDevicesOn();
+                } else {
+                    room->turnAllDevicesOff();
+                }
+            }
+        };
+    }});
+    cases.push_back({"room.hasDevice", "room", [](size_t count) -> Body {
+        ensureDevices(count);
+        auto room = std::make_shared<RoomController>("Bench Room");
+        for (size_t i = 0; i < count; ++i) {
+            room->addDevice(cameras[i]);
+        }
+        std::vector<std::string> ids;
+        for (size_t index : shuffledIndices(count, 1024)) {
+            ids.push_back(cameras[index]->getDeviceID());
+        }
+        return [room, ids](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                if (!room->hasDevice(ids[i & 1023])) std::abort();
+            }
+        };
+    }});
+
+    // energy monitoring, the singleton keeps the keys of earlier (smaller) runs
+    cases.push_back({"energy.recordUsage", "energy", [](size_t count) -> Body {
+        ensureDevices(count);
+        std::vector<std::string> ids;
+        for (size_t index : shuffledIndices(count, 4096)) {
+            ids.push_back(lights[index]->getDeviceID());
+        }
+        return [ids](size_t iterations) {
+            EnergyMonitor* monitor = EnergyMonitor::getInstance();
+            for (size_t i = 0; i < iterations; ++i) {
+                monitor->recordUsage(ids[i & 4095], 0.5 + static_cast<double>(i % 10));
+            }
+        };
+    }});
+    cases.push_back({"energy.generateReport", "energy", [](size_t count) -> Body {
+        ensureDevices(count);
+        EnergyMonitor* monitor = EnergyMonitor::getInstance();
+        for (size_t i = 0; i < count; ++i) {
+            monitor->recordUsage(lights[i]->getDeviceID(), 1.0);
+        }
+        return [monitor](size_t iterations) {
+            NullBuffer sink;
+            std::streambuf* original = std::cout.rdbuf(&sink);
+            for (size_t i = 0; i < iterations; ++i) {
+                monitor->generateReport();
+            }
+            std::cout.rdbuf(original);
+        };
+    }});
+    cases.push_back({"energy.getTotalSystemUsage", "energy", [](size_t count) -> Body {
+        ensureDevices(count);
+        return [](size_t iterations) {
+            double total = 0.0;
+            for (size_t i = 0; i < iterations; ++i) {
+                total += EnergyMonitor::getInstance()->getTotalSystemUsage();
+            }
+            if (total < 0.0) std::abort();
+        };
+    }});
+    return cases;
+}
+
+static double timeBody(const Body& body, size_t iterations) {
+    auto start = Clock::now();
+    body(iterations);
+    return secondsSince(start);
+}
+
+// grows the iteration count until one sample takes minSeconds, then takes the samples
+static Result measure(const Case& benchmark, size_t deviceCount, const Options& options) {
+    Body body = benchmark.setup(deviceCount);
+    size_t iterations = 1;
+    while (true) {
+        double seconds = timeBody(body, iterations);
+        if (seconds >= options.minSeconds || iterations >= (size_t(1) << 40)) {
+            break;
+        }
+        double scale = seconds > 0.0 ? options.minSeconds / seconds * 1.2 : 10.0;
+        iterations = static_cast<size_t>(iterations * std::min(10.0, std::max(2.0, scale)));
+    }
+    std::vector<double> nanos;
+    for (size_t r = 0; r < options.repeats; ++r) {
+        nanos.push_back(timeBody(body, iterations) * 1e9 / iterations);
+    }
+    std::sort(nanos.begin(), nanos.end());
+    return Result{benchmark.name, benchmark.group, deviceCount, iterations, nanos.size(),
+                  nanos[nanos.size() / 2], nanos.front(), nanos.back()};
+}
+
+static std::string isoTimestamp() {
+    std::time_t now = std::time(nullptr);
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    return text;
+}
+
+static void writeTable(std::ostream& out, const std::vector<Result>& results) {
+    out << std::left << std::setw(30) << "benchmark" << std::right << std::setw(10) << "devices"
+        << std::setw(14) << "median ns" << std::setw(14) << "min ns" << std::setw(14) << "M ops/s" << "\n";
+    for (const auto& result : results) {
+        out << std::left << std::setw(30) << result.name << std::right << std::setw(10) << result.devices
+            << std::fixed << std::setprecision(1) << std::setw(14) << result.medianNanos
+            << std::setw(14) << result.minNanos << std::setprecision(3) << std::setw(14)
+            << 1e3 / result.medianNanos << "\n";
+    }
+}
+
+static void writeCsv(std::ostream& out, const std::vector<Result>& results) {
+    out << "benchmark,group,devices,iterations,samples,median_ns,min_ns,max_ns,ops_per_second\n";
+    for (const auto& result : results) {
+        out << result.name << ',' << result.group << ',' << result.devices << ',' << result.iterations << ','
+            << result.samples << ',' << std::fixed << std::setprecision(3) << result.medianNanos << ','
+            << result.minNanos << ',' << result.maxNanos << ',' << std::setprecision(1)
+            << 1e9 / result.medianNanos << "\n";
+    }
+}
+
+static void writeJson(std::ostream& out, const std::vector<Result>& results, const Options& options) {
+    out << "{\n  \"suite\": \"bench_smart_home\",\n  \"timestamp\": \"" << isoTimestamp() << "\",\n"
+        << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+        << "  \"metrics\": " << (options.metrics ? "true" : "false") << ",\n"
+        << "  \"min_time_seconds\": " << options.minSeconds << ",\n  \"repeats\": " << options.repeats << ",\n"
+        << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        out << "    {\"benchmark\": \"" << result.name << "\", \"group\": \"" << result.group
+            << "\", \"devices\": " << result.devices << ", \"iterations\": " << result.iterations
+            << ", \"samples\": " << result.samples << std::fixed << std::setprecision(3)
+            << ", \"median_ns\": " << result.medianNanos << ", \"min_ns\": " << result.minNanos
+            << ", \"max_ns\": " << result.maxNanos << std::setprecision(1)
+            << ", \"ops_per_second\": " << 1e9 / result.medianNanos << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+static std::vector<size_t> parseCounts(const std::string& text) {
+    std::vector<size_t> counts;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        size_t count = static_cast<size_t>(std::atoll(item.c_str()));
+        if (count > 0) {
+            counts.push_back(count);
+        }
+    }
+    return counts;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    BenchArgs args("bench_smart_home");
+    args.flag("--devices", "1000,10000", [&options](const std::string& text) {
+            options.deviceCounts = parseCounts(text);
+            return !options.deviceCounts.empty();
+        })
+        .flag("--format", "table|json|csv", [&options](const std::string& text) {
+            options.format = text;
+            return text == "table" || text == "json" || text == "csv";
+        })
+        .flag("--output", options.output)
+        .flag("--filter", options.filter)
+        .flag("--min-time", options.minSeconds, 0.0)
+        .flag("--repeats", options.repeats, 1)
+        .flag("--metrics", "on|off", [&options](const std::string& text) {
+            options.metrics = text == "on";
+            return text == "on" || text == "off";
+        })
+        .flag("--metrics-out", options.metricsOutput);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    // ascending so the shared singletons only ever grow
+    std::sort(options.deviceCounts.begin(), options.deviceCounts.end());
+
+    // library logging is not part of any measurement
+    std::FILE* devNull = std::fopen("/dev/null", "w");
+    if (!devNull) {
+        std::cerr << "Cannot open /dev/null\n";
+        return 1;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Warning);
+    Logger::getInstance()->setSinks(devNull, devNull);
+    MetricsRegistry::setEnabled(options.metrics);
+
+    std::vector<Case> cases = buildCases();
+    std::vector<Result> results;
+    for (size_t deviceCount : options.deviceCounts) {
+        for (const auto& benchmark : cases) {
+            if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) {
+                continue;
+            }
+            results.push_back(measure(benchmark, deviceCount, options));
+            std::cerr << "  " << benchmark.name << " @ " << deviceCount << " done\n";
+        }
+    }
+    Logger::getInstance()->setSinks(stdout, stderr);
+    std::fclose(devNull);
+
+    if (!options.metricsOutput.empty() && !MetricsRegistry::getInstance()->writePrometheusFile(options.metricsOutput)) {
+        std::cerr << "Cannot write " << options.metricsOutput << "\n";
+    }
+
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file) {
+            std::cerr << "Cannot write " << options.output << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = options.output.empty() ? std::cout : file;
+    if (options.format == "json") {
+        writeJson(out, results, options);
+    } else if (options.format == "csv") {
+        writeCsv(out, results);
+    } else {
+        writeTable(out, results);
+    }
+    return 0;
+}
@@ -0,0 +1,187 @@
+// status reads at a million devices while a writer applies command batches: readers on published
+// snapshots, which never take the device mutex, against readers that lock it the way status
+// readers did before, and the writer's throughput in each case
+//
+// usage: bench_snapshot [--devices n] [--rooms n] [--readers n] [--batch n] [--seconds s]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "controllers/home_layout.hpp"
+#include "core/epoch.hpp"
+#include "core/logger.hpp"
+#include "bench_common.hpp"
+
+struct PhaseResult {
+    double readsPerSecond = 0.0;
+    double commandsPerSecond = 0.0;
+    std::uint64_t versions = 0; // published during the phase
+};
+
+// a status read: one room's devices, on or off and their draw
+static double readRoomFromSnapshot(const HomeController& home, std::size_t room) {
+    PinnedSnapshot snapshot = home.readSnapshot();
+    const RoomView& view = snapshot->getRooms()[room];
+    double watts = 0.0;
+    for (std::uint32_t slot : view.slots) {
+        const DeviceView& device = snapshot->at(slot);
+        watts += device.on ? device.power : 0.0f;
+    }
+    return watts;
+}
+
+// the same read through the query index, then holding the device mutex over the devices
+static double readRoomLocked(HomeController& home, const std::string& query) {
+    std::vector<std::shared_ptr<Device>> selected = home.selectDevices(query);
+    std::lock_guard<std::mutex> guard(home.getDeviceMutex());
+    double watts = 0.0;
+    for (const auto& device : selected) {
+        watts += device->getIsOn() ? device->getPowerUsage() : 0.0;
+    }
+    return watts;
+}
+
+// readers for the given time, with or without a writer streaming command batches
+static PhaseResult runPhase(HomeController& home, const CommandStream& commands, const std::vector<std::string>& roomQueries,
+                            std::size_t readers, std::size_t batch, double seconds, bool locked, bool writing) {
+    std::atomic<bool> stop{false};
+    std::atomic<std::uint64_t> reads{0};
+    std::uint64_t versionBefore = home.readSnapshot()->getVersion();
+    std::vector<std::thread> threads;
+    for (std::size_t r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            std::mt19937 random(static_cast<std::uint32_t>(r + 1));
+            std::uniform_int_distribution<std::size_t> pick(0, roomQueries.size() - 1);
+            std::uint64_t done = 0;
+            double sink = 0.0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                std::size_t room = pick(random);
+                sink += locked ? readRoomLocked(home, roomQueries[room]) : readRoomFromSnapshot(home, room);
+                ++done;
+            }
+            reads += done + (sink < 0.0 ? 1 : 0);
+        });
+    }
+    std::size_t applied = 0;
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    if (writing) {
+        std::vector<DeviceResult> results;
+        std::size_t offset = 0;
+        while (Clock::now() < deadline) {
+            CommandStream part(commands.begin() + static_cast<std::ptrdiff_t>(offset),
+                               commands.begin() + static_cast<std::ptrdiff_t>(offset + batch));
+            home.applyCommands(part, results);
+            applied += batch;
+            offset = offset + 2 * batch <= commands.size() ? offset + batch : 0;
+        }
+    } else {
+        std::this_thread::sleep_until(deadline);
+    }
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double elapsed = secondsSince(start);
+    PhaseResult result;
+    result.readsPerSecond = static_cast<double>(reads.load()) / elapsed;
+    result.commandsPerSecond = static_cast<double>(applied) / elapsed;
+    result.versions = home.readSnapshot()->getVersion() - versionBefore;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 1000000;
+    std::size_t roomCount = 50000;
+    std::size_t readers = 2;
+    std::size_t batch = 1024;
+    double seconds = 2.0;
+    BenchArgs args("bench_snapshot");
+    args.flag("--devices", deviceCount, 10)
+        .flag("--rooms", roomCount, 1)
+        .flag("--readers", readers, 1)
+        .flag("--batch", batch, 1)
+        .flag("--seconds", seconds, 0.1);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Error);
+
+    // 80% lights, 10% thermostats, 10% cameras, twenty devices to a room
+    HomeSpec spec;
+    spec.lights = deviceCount * 8 / 10;
+    spec.thermostats = deviceCount / 10;
+    spec.cameras = deviceCount - spec.lights - spec.thermostats;
+    spec.rooms = roomCount;
+    GeneratedHome generated = generateHome(spec);
+    HomeLayout layout;
+    layout.rooms = generated.rooms;
+    layout.devices = generated.devices;
+    for (std::size_t room : generated.deviceRoom) {
+        layout.deviceRoom.push_back(static_cast<std::int32_t>(room));
+    }
+    HomeController* home = HomeController::getInstance();
+    home->loadLayout(layout);
+    CommandStream commands = generateCommands(generated, CommandMix{}, std::max<std::size_t>(4 * batch, 1000000), 11);
+    batch = std::min(batch, commands.size() / 2);
+    std::vector<std::string> roomQueries;
+    for (const auto& room : generated.rooms) {
+        roomQueries.push_back("in " + room);
+    }
+
+    // the first read publishes every device, later versions copy the chunks a batch touched
+    auto start = Clock::now();
+    std::size_t published = home->readSnapshot()->getDeviceCount();
+    double firstMillis = millisSince(start);
+    std::vector<DeviceResult> results;
+    double publishMicros = 0.0;
+    const int publishes = 20;
+    for (int p = 0; p < publishes; ++p) {
+        for (std::size_t i = 0; i < batch; ++i) {
+            (void)home->applyCommand(commands[p * batch + i].first, commands[p * batch + i].second);
+        }
+        start = Clock::now();
+        home->publishSnapshot();
+        publishMicros += microsSince(start);
+    }
+    MemoryReport memory = home->measureMemory();
+    std::size_t snapshotBytes = 0;
+    for (const auto& subsystem : memory.subsystems) {
+        snapshotBytes += subsystem.name == "snapshots" ? subsystem.bytes : 0;
+    }
+
+    std::cout << "=== " << published << " devices, " << roomCount << " rooms, " << readers << " readers, batches of "
+              << batch << " commands ===\n" << std::fixed << std::setprecision(1)
+              << "first publish:        " << firstMillis << " ms, " << static_cast<double>(snapshotBytes) / 1048576.0
+              << " MiB a version\n"
+              << "publish after batch:  " << publishMicros / publishes << " us, chunks the batch touched\n\n";
+
+    PhaseResult alone = runPhase(*home, commands, roomQueries, readers, batch, seconds, false, false);
+    PhaseResult writerAlone = runPhase(*home, commands, roomQueries, 0, batch, seconds, false, true);
+    PhaseResult snapshot = runPhase(*home, commands, roomQueries, readers, batch, seconds, false, true);
+    PhaseResult locked = runPhase(*home, commands, roomQueries, readers, batch, seconds, true, true);
+    EpochDomain::getInstance()->reclaim();
+
+    std::cout << std::left << std::setw(34) << "phase" << std::right << std::setw(14) << "reads/s" << std::setw(16)
+              << "commands/s" << std::setw(11) << "versions" << "\n";
+    auto row = [](const char* name, const PhaseResult& result) {
+        std::cout << std::left << std::setw(34) << name << std::right << std::setprecision(0) << std::setw(14)
+                  << result.readsPerSecond << std::setw(16) << result.commandsPerSecond << std::setw(11) << result.versions << "\n";
+    };
+    row("snapshot readers, no writer", alone);
+    row("writer, no readers", writerAlone);
+    row("snapshot readers + writer", snapshot);
+    row("locked readers + writer", locked);
+    std::cout << "versions retired and freed: " << EpochDomain::getInstance()->getReclaimedCount() << ", pending "
+              << EpochDomain::getInstance()->getRetiredCount() << "\n";
+    return 0;
+}
@@ -0,0 +1,108 @@
+// encode and decode throughput of the binary telemetry format, against the status strings it replaces
+//
+// usage: bench_telemetry [--devices n] [--rounds n]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "core/logger.hpp"
+#include "devices/device_telemetry.hpp"
+#include "bench_common.hpp"
+
+// best of a few rounds, in seconds
+template <typename Work>
+static double bestOf(std::size_t rounds, Work work) {
+    double best = 1e300;
+    for (std::size_t i = 0; i < rounds; ++i) {
+        Clock::time_point start = Clock::now();
+        work();
+        best = std::min(best, secondsSince(start));
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 1000000;
+    std::size_t rounds = 3;
+    BenchArgs args("bench_telemetry");
+    args.flag("--devices", deviceCount)
+        .flag("--rounds", rounds, 1);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Warning);
+
+    // a generated home with every device on and some state changed from the defaults
+    HomeSpec spec;
+    spec.lights = deviceCount * 6 / 10;
+    spec.thermostats = deviceCount * 2 / 10;
+    spec.cameras = deviceCount - spec.lights - spec.thermostats;
+    spec.rooms = std::max<std::size_t>(1, deviceCount / 20);
+    GeneratedHome home = generateHome(spec);
+    HomeController* controller = HomeController::getInstance();
+    populateHome(*controller, home);
+    CommandStream commands = generateCommands(home, CommandMix(), deviceCount, 3);
+    std::vector<DeviceResult> results;
+    controller->applyCommands(commands, results);
+
+    // the text status every device already has
+    std::size_t textBytes = 0;
+    double textSeconds = bestOf(rounds, [&] {
+        textBytes = 0;
+        for (const auto& device : home.devices) textBytes += device->getDeviceStatus().size();
+    });
+
+    // binary encoding into a reused batch
+    TelemetryBatchWriter writer(deviceCount * 32);
+    double encodeSeconds = bestOf(rounds, [&] {
+        writer.clear();
+        for (const auto& device : home.devices) writer.add(*device);
+        writer.finish();
+    });
+    const std::vector<std::uint8_t>& batch = writer.finish();
+
+    // zero-copy decode, touching the fields an ingester would
+    double checksum = 0.0;
+    std::size_t decoded = 0;
+    double decodeSeconds = bestOf(rounds, [&] {
+        checksum = 0.0;
+        decoded = 0;
+        TelemetryBatchReader reader(batch.data(), batch.size());
+        TelemetryRecord record;
+        while (reader.next(record)) {
+            checksum += record.getPowerUsage() + record.getDeviceID().size();
+            switch (record.getType()) {
+                case TelemetryDeviceType::Light: checksum += record.getBrightness() + record.getColor().getRed(); break;
+                case TelemetryDeviceType::Thermostat: checksum += record.getTemperature() + record.getDesiredTemperature(); break;
+                case TelemetryDeviceType::Camera: checksum += record.getRotation() + (record.getIsRecording() ? 1 : 0); break;
+                case TelemetryDeviceType::Unknown: break;
+            }
+            ++decoded;
+        }
+    });
+
+    // a whole-home snapshot through the controller, under its device lock
+    TelemetryBatchWriter snapshot(deviceCount * 32);
+    double snapshotSeconds = bestOf(rounds, [&] {
+        snapshot.clear();
+        controller->snapshotTelemetry(snapshot);
+    });
+
+    double devices = static_cast<double>(home.devices.size());
+    std::cout << "=== device telemetry, " << home.devices.size() << " devices ===\n" << std::fixed << std::setprecision(1)
+              << "status strings:   " << devices / textSeconds / 1e6 << " M devices/s, "
+              << static_cast<double>(textBytes) / devices << " bytes/device\n"
+              << "binary encode:    " << devices / encodeSeconds / 1e6 << " M devices/s, "
+              << static_cast<double>(batch.size()) / devices << " bytes/device, "
+              << batch.size() / encodeSeconds / 1e6 << " MB/s\n"
+              << "binary decode:    " << decoded / decodeSeconds / 1e6 << " M devices/s, "
+              << batch.size() / decodeSeconds / 1e6 << " MB/s (checksum " << std::setprecision(0) << checksum << ")\n"
+              << std::setprecision(1)
+              << "home snapshot:    " << devices / snapshotSeconds / 1e6 << " M devices/s\n";
+    return 0;
+}
@@ -0,0 +1,121 @@
+// timer wheel throughput (schedule, cancel, fire) and light fade step accuracy
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "controllers/scheduler.hpp"
+#include "core/timer_wheel.hpp"
+#include "devices/smart_light.hpp"
+#include "bench_common.hpp"
+
+// schedule, cancel and fire millions of one-shot timers
+static void benchThroughput(size_t timerCount, uint64_t horizonMillis) {
+    TimerWheel wheel;
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<uint64_t> delay(1, horizonMillis);
+    std::vector<TimerId> ids;
+    ids.reserve(timerCount);
+
+    uint64_t fired = 0;
+    uint64_t late = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i < timerCount; ++i) {
+        uint64_t due = delay(rng);
+        ids.push_back(wheel.schedule(due, [&fired, &late, &wheel, due] {
+            ++fired;
+            late += wheel.now() != due ? 1 : 0;
+        }));
+    }
+    double scheduleSeconds = secondsSince(start);
+
+    // cancel every fourth timer
+    std::shuffle(ids.begin(), ids.end(), rng);
+    start = Clock::now();
+    size_t cancelled = 0;
+    for (size_t i = 0; i < ids.size(); i += 4) {
+        cancelled += wheel.cancel(ids[i]) ? 1 : 0;
+    }
+    double cancelSeconds = secondsSince(start);
+
+    // advance in one-second steps, as a driver loop would
+    start = Clock::now();
+    for (uint64_t t = 1000; t <= horizonMillis + 1000; t += 1000) {
+        wheel.advanceTo(t);
+    }
+    double fireSeconds = secondsSince(start);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Timers:           " << timerCount << " over " << horizonMillis / 1000 << " s\n"
+              << "Schedule:         " << timerCount / scheduleSeconds / 1e6 << " M/s\n"
+              << "Cancel:           " << cancelled / cancelSeconds / 1e6 << " M/s (" << cancelled << " cancelled)\n"
+              << "Fire:             " << fired / fireSeconds / 1e6 << " M/s (" << fired << " fired, "
+              << late << " off their tick)\n"
+              << "Still pending:    " << wheel.getPendingCount() << "\n";
+}
+
+// fade many lights while the clock moves in irregular jumps, check every level against the ideal line
+static void benchFadeAccuracy(size_t lightCount) {
+    Scheduler scheduler;
+    std::vector<std::shared_ptr<SmartLight>> lights;
+    for (size_t i = 0; i < lightCount; ++i) {
+        auto light = std::make_shared<SmartLight>("SL" + std::to_string(i), "Fade Light", "Bench");
+        light->turnOn();
+        lights.push_back(light);
+    }
+
+    const uint64_t duration = 30000; // 30 s fade
+    const uint64_t step = 100; // 100 ms steps
+    for (auto& light : lights) {
+        scheduler.fadeBrightness(light, 100, duration, step);
+    }
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<uint64_t> jump(1, 250);
+    int maxError = 0;
+    size_t samples = 0;
+    auto start = Clock::now();
+    while (scheduler.now() < duration) {
+        scheduler.advanceBy(jump(rng));
+        uint64_t covered = std::min(duration, scheduler.now() / step * step);
+        int expected = static_cast<int>(std::lround(100.0 * static_cast<double>(covered) / duration));
+        for (const auto& light : lights) {
+            maxError = std::max(maxError, std::abs(light->getBrightness() - expected));
+        }
+        ++samples;
+    }
+    double seconds = secondsSince(start);
+
+    size_t finished = static_cast<size_t>(std::count_if(lights.begin(), lights.end(),
+        [](const std::shared_ptr<SmartLight>& light) { return light->getBrightness() == 100; }));
+    std::cout << "Lights faded:     " << lightCount << " (30 s, 100 ms steps)\n"
+              << "Fade steps/s:     " << std::setprecision(2) << lightCount * (duration / step) / seconds / 1e6 << " M/s\n"
+              << "Max step error:   " << maxError << "% over " << samples << " samples\n"
+              << "Reached target:   " << finished << "/" << lightCount << "\n"
+              << "Pending after:    " << scheduler.getPendingCount() << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t timers = 2000000;
+    size_t lights = 10000;
+    uint64_t horizonSeconds = 600;
+    BenchArgs args("bench_timers");
+    args.flag("--timers", timers)
+        .flag("--lights", lights)
+        .flag("--horizon", horizonSeconds, 1);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+
+    std::cout << "=== Timer wheel throughput ===\n";
+    benchThroughput(timers, horizonSeconds * 1000);
+    std::cout << "\n=== Fade accuracy ===\n";
+    benchFadeAccuracy(lights);
+    return 0;
+}
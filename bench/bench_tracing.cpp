@@ -0,0 +1,91 @@
+// cost of tracing spans when disabled and enabled, and a sample trace of room-wide operations
+//
+// usage: bench_tracing [--devices n] [--output trace.json]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "controllers/room_controller.hpp"
+#include "core/logger.hpp"
+#include "core/tracing.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+#include "bench_common.hpp"
+
+// median of alternating rounds so noise hits both sides alike
+template <typename Body>
+static void compare(const char* label, size_t iterations, Body body) {
+    Tracer* tracer = Tracer::getInstance();
+    std::vector<double> off, on;
+    body(iterations); // warm up
+    for (int round = 0; round < 10; ++round) {
+        tracer->stop();
+        off.push_back(nanosPerOp(iterations, body));
+        tracer->start(); // also drops the previous round's events
+        on.push_back(nanosPerOp(iterations, body));
+    }
+    tracer->stop();
+    std::sort(off.begin(), off.end());
+    std::sort(on.begin(), on.end());
+    std::cout << std::left << std::setw(34) << label << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << off[off.size() / 2] << std::setw(10) << on[on.size() / 2] << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t deviceCount = 10000;
+    std::string output;
+    BenchArgs args("bench_tracing");
+    args.flag("--devices", deviceCount)
+        .flag("--output", output);
+    if (!args.parse(argc, argv)) {
+        return 2;
+    }
+    Logger::getInstance()->setLevel(LogLevel::Warning);
+    Tracer* tracer = Tracer::getInstance();
+    tracer->setThreadName("bench");
+
+    std::cout << "=== tracing cost, ns per op ===\n"
+              << std::left << std::setw(34) << "path" << std::right << std::setw(10) << "disabled" << std::setw(10)
+              << "enabled" << "\n";
+    compare("empty TraceSpan", 200000, [](size_t n) {
+        for (size_t i = 0; i < n; ++i) TraceSpan span("bench", "bench");
+    });
+
+    std::vector<std::shared_ptr<SmartLight>> lights;
+    std::vector<std::shared_ptr<Thermostat>> thermostats;
+    auto room = std::make_shared<RoomController>("Living Room");
+    for (size_t i = 0; i < deviceCount; ++i) {
+        lights.push_back(std::make_shared<SmartLight>("L" + std::to_string(i), "Light", "Living Room"));
+        thermostats.push_back(std::make_shared<Thermostat>("T" + std::to_string(i), "Thermostat", "Living Room"));
+        room->addDevice(lights.back());
+        thermostats.back()->turnOn();
+    }
+    compare("Thermostat::setTemperature", 200000, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) thermostats[i % deviceCount]->setTemperature(15.0f + (i % 15));
+    });
+    compare("RoomController::turnAll (per dev)", deviceCount * 2, [&](size_t n) {
+        for (size_t done = 0; done < n; done += deviceCount * 2) {
+            room->turnAllDevicesOff();
+            room->turnAllDevicesOn();
+        }
+    });
+
+    // a sample trace: one room switched off and on, with the energy recording under each device
+    tracer->start();
+    room->turnAllDevicesOff();
+    room->turnAllDevicesOn();
+    tracer->stop();
+    std::cout << "sample trace: " << tracer->getEventCount() << " events\n";
+    if (!output.empty()) {
+        if (!tracer->writeChromeTraceFile(output)) {
+            std::cerr << "Cannot write " << output << "\n";
+            return 1;
+        }
+        std::cout << "written to " << output << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+#ifndef automation_engine_hpp
+#define automation_engine_hpp
+
+// includes
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "devices/device.hpp"
+#include "devices/light_color.hpp"
+
+// what a device is, so actions and conditions can skip dynamic casts
+enum class DeviceKind : std::uint8_t {
+    Unknown, // referenced by a rule but not registered yet
+    Light,
+    Thermostat,
+    Camera,
+    Other
+};
+
+// rules engine: rules are parsed once into flat condition/action records and indexed by trigger
+//
+// rule syntax (keywords are case-insensitive, device IDs and room names are not):
+//   when <trigger> [and <condition>]... , <action> [and <action>]...    ("then" may replace the comma)
+// triggers:   motion on <ID> | temperature on <ID> above|below <N> | <ID> turns on|off | at HH:MM
+// conditions: after|before sunset|sunrise | after|before HH:MM | temperature on <ID> above|below <N> | <ID> is on|off
+// actions:    set <target> to <N>% | set <target> color to <color> | set <target> temperature to <N>
+//             turn on|off <target> | start|stop recording on <target>
+// targets:    <room> lights | <room> (every device in the room) | <ID>
+// "after sunset" holds from sunset until the next sunrise.
+class AutomationEngine {
+    private:
+        enum class TriggerKind : std::uint8_t { Motion, TemperatureAbove, TemperatureBelow, TurnsOn, TurnsOff, Time };
+        enum class ConditionKind : std::uint8_t { AfterMinute, BeforeMinute, Dark, Light, TemperatureAbove, TemperatureBelow, IsOn, IsOff };
+        enum class ActionKind : std::uint8_t { SetBrightness, SetColor, SetTemperature, TurnOn, TurnOff, StartRecording, StopRecording };
+
+        // per-device trigger buckets
+        enum TriggerBucket { MotionBucket, TurnsOnBucket, TurnsOffBucket, BucketCount };
+
+        // rules a device triggers, only devices named in a rule trigger have one
+        struct SlotTriggers {
+            std::array<std::vector<std::uint32_t>, BucketCount> buckets; // rules triggered by each event
+            std::vector<std::pair<float, std::uint32_t>> aboveTriggers; // temperature thresholds, sorted lazily
+            std::vector<std::pair<float, std::uint32_t>> belowTriggers; // temperature thresholds, sorted lazily
+            bool thresholdsSorted = true; // are the threshold lists sorted?
+        };
+        static const std::uint32_t noTriggers = 0xffffffffu;
+
+        // device known to the engine, by registration or by being named in a rule
+        struct DeviceSlot {
+            const std::string* id; // device ID, the key in slotById, whose nodes never move
+            Device* device; // null until registered or after removal
+            DeviceKind kind; // device type
+            float lastTemperature; // last temperature seen, for crossing detection
+            std::uint32_t triggers; // index into triggerSets, noTriggers for none
+        };
+
+        // set of device slots an action applies to
+        struct TargetGroup {
+            std::string room; // room name, empty for a single device
+            bool lightsOnly; // only lights in the room
+            std::vector<std::uint32_t> members; // device slots
+        };
+
+        struct CompiledCondition {
+            ConditionKind kind;
+            std::uint32_t slot; // device for state conditions
+            float threshold; // temperature threshold
+            std::uint16_t minute; // minute of day for time conditions
+        };
+
+        struct CompiledAction {
+            ActionKind kind;
+            std::uint32_t group; // target group
+            float value; // brightness or temperature
+            LightColor color; // color for SetColor
+        };
+
+        struct CompiledRule {
+            std::string text; // rule as written
+            std::uint32_t conditionBegin; // first condition in the flat list
+            std::uint32_t actionBegin; // first action in the flat list
+            std::uint16_t conditionCount;
+            std::uint16_t actionCount;
+            bool enabled; // false once removed
+        };
+
+        std::vector<DeviceSlot> slots; // all devices, indexed by slot
+        std::vector<SlotTriggers> triggerSets; // trigger lists of the slots that have them
+        std::unordered_map<std::string, std::uint32_t> slotById; // device ID to slot
+        std::unordered_map<const Device*, std::uint32_t> slotByDevice; // registered device to slot
+        std::vector<TargetGroup> groups; // action targets
+        std::unordered_map<std::string, std::uint32_t> groupByKey; // target text to group
+        std::unordered_map<std::string, std::vector<std::uint32_t>> roomMembers; // room name to device slots
+        std::vector<bool> memberMarks; // by slot, registerDevices' scratch, all clear between calls
+        std::vector<CompiledRule> rules; // rules by id
+        std::vector<CompiledCondition> conditions; // flat condition storage
+        std::vector<CompiledAction> actions; // flat action storage
+        std::vector<std::vector<std::uint32_t>> timeTriggers; // rules triggered at each minute of day, sized by the first time rule
+
+        std::uint16_t minuteOfDay; // current time of day
+        std::uint16_t replayMinutes; // furthest step ahead whose time triggers fire
+        std::uint16_t sunriseMinute; // sunrise, minutes after midnight
+        std::uint16_t sunsetMinute; // sunset, minutes after midnight
+        int dispatchDepth; // nesting of rule-triggered changes
+        std::uint64_t rulesEvaluated; // rules whose conditions were checked
+        std::uint64_t rulesFired; // rules whose actions ran
+        std::uint64_t actionsExecuted; // device commands issued
+        std::uint64_t actionsFailed; // device commands the device rejected
+        std::uint64_t cascadesSuppressed; // changes ignored because rules were triggering rules too deeply
+
+        std::uint32_t slotFor(const std::string& id); // find or create the slot for a device ID
+        SlotTriggers& triggersOf(std::uint32_t slot); // the slot's trigger lists, created on first use
+        std::uint32_t registerSlot(const std::shared_ptr<Device>& device); // registerDevice, returning the slot
+        std::uint32_t groupFor(const std::string& target); // find or create a target group
+        void fireRules(const std::vector<std::uint32_t>& ruleIds); // evaluate and run a trigger bucket
+        void fireRule(std::uint32_t ruleId); // evaluate one rule
+        bool conditionHolds(const CompiledCondition& condition) const; // evaluate a condition
+        void runAction(const CompiledAction& action); // apply an action to its targets
+        void onTemperature(std::uint32_t slot, float temperature); // fire crossed thresholds
+
+    public:
+        AutomationEngine();
+
+        // rules
+        std::uint32_t addRule(const std::string& text); // parse and index a rule, throws invalid_argument
+        bool removeRule(std::uint32_t ruleId); // disable a rule
+        std::size_t getRuleCount() const; // enabled rules
+        std::vector<std::pair<std::uint32_t, std::string>> listRules() const; // enabled rules with their ids
+
+        // home layout
+        void registerDevice(const std::shared_ptr<Device>& device); // make a device available to rules
+        void reserveDevices(std::size_t count); // room for this many more devices
+        void registerDevices(const std::vector<std::shared_ptr<Device>>& devices, const std::string& room); // many at once, into room unless it is empty
+        void unregisterDevice(const Device& device); // device removed from the home
+        void addRoom(const std::string& room); // make a room name usable as a target
+        void addDeviceToRoom(const std::string& room, const std::string& deviceId); // room membership
+        void removeDeviceFromRoom(const std::string& room, const std::string& deviceId);
+        void removeRoom(const std::string& room); // forget a room's members
+
+        // events
+        void onDeviceChanged(Device& device, DeviceChange change); // state change from a device
+        void setTimeOfDay(int minute); // advance the clock, firing time triggers passed on the way unless it jumps
+        void setReplayLimit(int minutes); // steps further ahead, or back, jump; 12 hours by default
+        void setSunTimes(int sunrise, int sunset); // minutes after midnight
+
+        // statistics
+        std::uint64_t getRulesEvaluated() const;
+        std::uint64_t getRulesFired() const;
+        std::uint64_t getActionsExecuted() const;
+        std::uint64_t getActionsFailed() const;
+        std::uint64_t getCascadesSuppressed() const;
+        std::size_t getMemoryUsage() const; // bytes of the slots, rules and indexes, devices excluded
+};
+
+#endif // automation_engine_hpp
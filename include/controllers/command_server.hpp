@@ -0,0 +1,85 @@
+#ifndef command_server_hpp
+#define command_server_hpp
+
+// includes
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class HomeController;
+
+// where the server listens and how much it buffers
+struct CommandServerConfig {
+    std::string socketPath = "/tmp/smart_home.sock"; // Unix domain socket, empty for none
+    int tcpPort = -1; // 127.0.0.1 port, -1 for none, 0 for any free port
+    int backlog = 4096; // pending connections per listening socket
+    std::size_t maxLineLength = 4096; // longer requests are answered with an error and the client is closed
+    std::size_t maxPendingOutput = 1 << 20; // stop reading a client whose responses pile up past this
+};
+
+// line protocol server for controlling the home from other processes
+//
+// One request per line, one response line per request, in order, so clients may pipeline:
+//   ping                      -> OK pong
+//   status <ID>               -> OK <device status>
+//   <ID> <verb> [argument]    -> OK | ERR <reason>     (verbs as in parseDeviceCommand)
+// A single thread runs an epoll loop over every client. All complete lines from one read are handled
+// under the home controller's device mutex, the same one the console and thermostat control take.
+// While a client's pending responses exceed maxPendingOutput its remaining lines wait and it is not read.
+class CommandServer {
+    private:
+        // one client, indexed by its descriptor
+        struct Connection {
+            int fd;
+            std::string input; // received bytes not yet handled
+            std::string output; // responses not yet sent
+            std::size_t outputOffset; // bytes of output already sent
+            std::uint32_t events; // epoll interest
+            bool closeAfterFlush; // protocol error or peer closed, close once the responses are sent
+        };
+
+        HomeController& controller;
+        CommandServerConfig config;
+        int epollFd; // -1 while stopped
+        int unixFd; // listening Unix socket, -1 for none
+        int tcpFd; // listening TCP socket, -1 for none
+        int wakeFd; // eventfd that interrupts the loop on stop
+        int boundTcpPort; // port actually bound
+        std::vector<std::unique_ptr<Connection>> connections; // by descriptor, null for free slots
+        std::thread worker; // runs the event loop
+        std::atomic<bool> stopRequested;
+        std::atomic<std::size_t> openConnections;
+        std::atomic<std::uint64_t> requestCount;
+
+        void openListeners(); // throws runtime_error
+        void closeAll(); // every socket and the epoll instance
+        void eventLoop();
+        void acceptClients(int listenFd); // accept until the backlog is empty
+        void readClient(Connection& connection); // receive and handle complete lines
+        void handleLines(Connection& connection); // complete lines in the input to responses, under the device mutex
+        std::string handleRequestLocked(const std::string& line); // handleRequest with the device mutex held
+        bool flushClient(Connection& connection); // send queued responses and answer held-back lines, false if the client is gone
+        void updateInterest(Connection& connection); // read and/or write interest from the buffers
+        void closeClient(Connection& connection);
+
+    public:
+        CommandServer(HomeController& home, const CommandServerConfig& serverConfig = CommandServerConfig());
+        ~CommandServer(); // stops the server
+        CommandServer(const CommandServer&) = delete; // owns sockets and a thread
+        CommandServer& operator=(const CommandServer&) = delete;
+
+        void start(); // open the sockets and start the loop, throws runtime_error if a socket cannot be opened
+        void stop(); // close every client and join the loop
+        bool isRunning() const;
+
+        std::string handleRequest(const std::string& line); // one request to its response, without the newline
+        int getTcpPort() const; // bound TCP port, -1 without TCP
+        std::size_t getConnectionCount() const; // clients connected now
+        std::uint64_t getRequestCount() const; // requests handled since construction
+};
+
+#endif // command_server_hpp
@@ -0,0 +1,138 @@
+#ifndef device_query_hpp
+#define device_query_hpp
+
+// includes
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "controllers/automation_engine.hpp"
+#include "devices/device.hpp"
+
+// a parsed device selection, every clause must hold
+//
+// query syntax (keywords are case-insensitive, names are not):
+//   all | <clause> [and <clause>]...
+// clauses: lights | thermostats | cameras | on | off | recording | not recording
+//          at <location> | in <room> | named <prefix>
+//          power above|below <N> | power from <N> to <N>    (watts, from/to inclusive)
+// names may be double-quoted, e.g. in "Bed and Breakfast", so an " and " inside them does not
+// split the clause
+struct DeviceQuery {
+    std::string text; // query as written
+    DeviceKind kind = DeviceKind::Unknown; // Unknown for any kind
+    std::int8_t on = -1; // 1 on, 0 off, -1 either
+    std::int8_t recording = -1; // 1 recording, 0 not, -1 either
+    std::string location; // exact deviceLocation, empty for any
+    std::string room; // room membership, empty for any
+    std::string namePrefix; // device name starts with this, empty for any
+    float minPower = -std::numeric_limits<float>::infinity();
+    float maxPower = std::numeric_limits<float>::infinity();
+    bool minInclusive = true;
+    bool maxInclusive = true;
+    bool contradictory = false; // two clauses that cannot both hold, nothing matches
+
+    static DeviceQuery parse(const std::string& text); // throws invalid_argument naming the clause
+    bool hasPowerRange() const;
+    bool powerMatches(float watts) const;
+};
+
+// secondary indexes over the home's devices, kept current by the home's change observer
+//
+// Every device has a dense slot. Kind, on and recording are bitsets over the slots, locations and
+// rooms are hash maps to slot lists, power is a sorted (watts, slot) array. A query starts from the
+// smallest candidate set one index gives and checks the other clauses against per-slot copies of
+// the indexed state, so no device is touched until the results are returned.
+//
+// Changes cost O(1): the power array is repaired on the first query that ranges over power after
+// changes, by dropping the changed slots and merging them back in sorted. Power is as of each
+// device's last reported change; thermostats under closed-loop control report at the home's next
+// update, like they do for automation rules and telemetry. Callers hold the home's device mutex.
+class DeviceIndex {
+    private:
+        // the slots at one location or in one room, unordered
+        struct Members {
+            std::string name;
+            std::vector<std::uint32_t> slots;
+        };
+
+        std::vector<std::shared_ptr<Device>> devices; // by slot, null when free
+        std::vector<DeviceKind> kinds; // by slot
+        std::vector<float> power; // by slot, watts at the last change
+        std::vector<const std::string*> names; // by slot, the device's own name, for name prefixes
+        std::vector<std::uint32_t> locationOf; // by slot, index into locations
+        std::vector<std::uint32_t> locationPosition; // by slot, position in its location's slot list
+        std::vector<std::uint32_t> roomOf; // by slot, index into rooms of the first room, noIndex for none
+        std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> moreRooms; // slots in several rooms, the others
+        std::vector<std::uint32_t> freeSlots; // slots of removed devices, reused first
+        std::unordered_map<const Device*, std::uint32_t> slotByDevice;
+
+        std::vector<std::uint64_t> liveBits; // slot holds a device
+        std::vector<std::uint64_t> onBits;
+        std::vector<std::uint64_t> recordingBits;
+        static const std::size_t kindSlots = static_cast<std::size_t>(DeviceKind::Other) + 1;
+        std::vector<std::uint64_t> kindBits[kindSlots]; // one bitset per DeviceKind
+        std::size_t liveCount; // set bits in each bitset
+        std::size_t onCount;
+        std::size_t recordingCount;
+        std::size_t kindCount[kindSlots];
+
+        std::vector<Members> locations; // by location index
+        std::unordered_map<std::string, std::uint32_t> locationByName;
+        std::vector<Members> rooms; // by room index, emptied when the room is removed
+        std::vector<std::uint32_t> freeRooms; // indexes of removed rooms, reused first
+        std::unordered_map<std::string, std::uint32_t> roomByName;
+
+        std::vector<std::pair<float, std::uint32_t>> powerOrder; // sorted by watts, then slot
+        std::vector<std::uint32_t> powerDirty; // slots changed since the last repair
+        std::vector<std::uint64_t> powerDirtyBits; // the same slots as a bitset
+
+        std::uint32_t allocateSlot(); // a free or new slot, bitsets grown to fit
+        void setBit(std::vector<std::uint64_t>& bits, std::size_t& count, std::uint32_t slot, bool value);
+        void placeInLocation(std::uint32_t slot, const std::string& location);
+        void leaveLocation(std::uint32_t slot);
+        void refresh(std::uint32_t slot); // re-read the device's indexed state
+        void markPowerDirty(std::uint32_t slot);
+        bool inRoom(std::uint32_t slot, std::uint32_t room) const;
+        std::uint32_t roomIndex(const std::string& room); // the room's entry, added if new
+        void joinRoom(std::uint32_t slot, std::uint32_t room); // a slot already in the room is left alone
+        void leaveRoom(std::uint32_t slot, std::uint32_t room); // the slot must be in the room
+        void repairPowerOrder(); // merge changed slots back into powerOrder
+        std::vector<std::uint32_t> matchingSlots(const DeviceQuery& query); // sorted
+        bool matches(std::uint32_t slot, const DeviceQuery& query, std::uint32_t location, std::uint32_t room) const;
+
+    public:
+        static const std::uint32_t noSlot = std::numeric_limits<std::uint32_t>::max();
+
+        DeviceIndex();
+
+        // home layout, devices are indexed from their current state; slots are returned for callers
+        // that keep per-slot state of their own, noSlot for devices not indexed
+        void reserve(std::size_t count); // room for this many more devices
+        std::uint32_t add(const std::shared_ptr<Device>& device); // a device already indexed is left alone
+        std::uint32_t remove(const Device& device); // the freed slot
+        void addToRoom(const std::string& room, const Device& device); // devices not indexed are ignored
+        void addSlotsToRoom(const std::string& room, const std::vector<std::uint32_t>& slots); // bulk form, slots from add()
+        void removeRoom(const std::string& room);
+
+        // device state changed, called from the home's observer; returns the device's slot
+        std::uint32_t onDeviceChanged(const Device& device, DeviceChange change);
+
+        // queries, results in slot order
+        std::vector<std::shared_ptr<Device>> select(const DeviceQuery& query);
+        std::size_t count(const DeviceQuery& query);
+        std::size_t size() const; // indexed devices
+
+        // slots, for callers copying device state in slot order
+        std::size_t getSlotCount() const; // in use or free
+        const std::shared_ptr<Device>& deviceAt(std::uint32_t slot) const; // null for a free slot
+        DeviceKind kindAt(std::uint32_t slot) const;
+        const std::vector<std::uint32_t>& roomSlots(const std::string& room) const; // in the order devices joined, empty for no room
+        std::size_t getMemoryUsage() const; // bytes of the indexes, devices excluded
+};
+
+#endif // device_query_hpp
@@ -2,9 +2,13 @@
 #define energy_monitor_hpp
 
 // includes
-#include <map>
+#include <cstddef>
+#include <unordered_map>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
+#include "core/clock.hpp"
 #include "devices/device.hpp"
 
 // EnergyMonitor class
@@ -12,22 +16,46 @@ class EnergyMonitor {
     // private members
     private:
 
-    // current and total usage of devices in the system
-    std::map<std::string, double> currentUsage;
-    std::map<std::string, double> totalUsage;
-    static EnergyMonitor* instance; 
-    EnergyMonitor() = default; 
+    // one device's readings: the latest, their sum, and the energy drawn between readings
+    struct UsageRecord {
+        double current = 0.0; // latest reading in watts
+        double total = 0.0; // sum of all readings
+        double wattHours = 0.0; // energy up to sinceMillis
+        std::uint64_t sinceMillis = 0; // clock time of the latest reading
+    };
+
+    // usage of devices in the system, one hash lookup per reading, sorted only for display
+    std::unordered_map<std::string, UsageRecord> usageByDevice;
+    double systemTotal; // sum of every device's total, kept as readings arrive
+    mutable std::mutex usageMutex; // usage may be recorded from the thermostat control worker
+    HomeClock* clock; // time readings are integrated over, not owned
+    void record(UsageRecord& entry, double watts, std::uint64_t now); // fold in a reading taken at now
+    std::vector<std::pair<std::string, UsageRecord>> sortedUsage() const; // copied under the lock, sorted by device ID after it
 
     public:
-    // get instance
+    // one per home; getInstance() is the process default, used by the default home and by devices
+    // that belong to no home
+    EnergyMonitor();
+    EnergyMonitor(const EnergyMonitor&) = delete;
+    EnergyMonitor& operator=(const EnergyMonitor&) = delete;
     static EnergyMonitor* getInstance();
 
     // energy tracking 
     void recordUsage(const std::string& deviceName, double usage);
+    void recordUsageBatch(const std::vector<std::pair<std::string, double>>& readings); // many devices under one lock
+    void reserveDevices(std::size_t count); // room for this many more devices with readings
     double getCurrentUsage(const std::string& deviceID) const;
     double getTotalUsage(const std::string& deviceID) const;
     double getTotalSystemUsage() const;
 
+    // energy over time: each reading holds until the next one, integrated on the clock
+    void setClock(HomeClock* newClock); // null for the system clock, energy so far is kept
+    HomeClock& getClock() const;
+    double getEnergyWattHours(const std::string& deviceID) const; // up to now
+    double getTotalEnergyWattHours() const;
+    std::size_t getDeviceCount() const; // devices with readings
+    std::size_t getMemoryUsage() const; // bytes of the per-device records
+
     // energy reporting
     void displayCurrentUsage() const;
     void displayTotalUsage() const;
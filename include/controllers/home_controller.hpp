@@ -1,19 +1,104 @@
 #ifndef HOME_CONTROLLER_HPP
 #define HOME_CONTROLLER_HPP
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include "devices/device.hpp"
 #include "devices/smart_light.hpp"
 #include "devices/thermostat.hpp"
 #include "devices/security_camera.hpp"
+#include "devices/device_telemetry.hpp"
+#include "devices/command_queue.hpp"
 #include "controllers/room_controller.hpp"
+#include "controllers/scheduler.hpp"
+#include "controllers/automation_engine.hpp"
+#include "controllers/device_query.hpp"
+#include "controllers/energy_monitor.hpp"
+#include "controllers/home_layout.hpp"
+#include "controllers/home_snapshot.hpp"
+#include "controllers/thermostat_control.hpp"
+#include "core/clock.hpp"
+#include "core/memory_usage.hpp"
+#include "core/message_broker.hpp"
+#include "core/string_pool.hpp"
+#include "core/task.hpp"
+#include "core/thread_pool.hpp"
+#include "devices/device_transport.hpp"
 
-class HomeController {
+// one home: its devices, rooms, rules, timers and energy monitor
+//
+// Homes share no mutable state, so a process can host many of them, each driven from one thread at
+// a time (see HomeHost). getInstance() is the process's default home, which reports to the default
+// EnergyMonitor; the console and the single-home tools use it.
+//
+// Public methods take the home's device mutex themselves. It is not recursive: code already holding
+// it, such as scheduler timer callbacks and the command server's request batches, uses the *Locked
+// methods. Device changes reach onDeviceChanged with it held, or from a single thread.
+class HomeController : public DeviceObserver {
 private:
     static HomeController* instance;
+
+    // Guards the devices and their lookups, rooms, indexes, rules, queues and scheduler; the
+    // thermostat control worker takes it around each tick
+    mutable std::mutex deviceMutex;
     std::vector<std::shared_ptr<Device>> devices;
-    HomeController() = default;
+    std::unordered_map<std::string_view, std::shared_ptr<Device>> deviceIndex; // the device's own ID to device, for lookups at scale
+
+    // Energy monitoring, every device of the home reports here
+    std::unique_ptr<EnergyMonitor> ownedEnergy; // null when the monitor was passed in
+    EnergyMonitor* energy;
+
+    // Interned device locations, every device of the home keeps its location here
+    std::unique_ptr<StringPool> ownedStrings; // null when the pool was passed in
+    StringPool* strings;
+
+    // Scheduling, the scheduler's time is the clock's time minus clockOffset
+    Scheduler scheduler;
+    HomeClock* clock; // not owned
+    std::int64_t clockOffset;
+
+    // Automation rules, fed by device state changes
+    AutomationEngine automation;
+    void handleAutomationRules();
+
+    // Secondary indexes for device queries, kept current by the same state changes
+    DeviceIndex queryIndex;
+    void handleDeviceSelection();
+
+    // Versioned copies of device and room state for readers that must not hold the device mutex,
+    // published on the first read, then after bulk operations and scheduler updates
+    mutable SnapshotPublisher snapshots;
+    void publishChanges(); // a new version if anything changed and anyone reads; the caller holds the lock
+
+    // Queued commands per device, superseded writes coalesced until the next flush
+    std::unordered_map<std::string, DeviceCommandQueue> commandQueues;
+    std::vector<std::string> queuedDevices; // devices with pending commands, in the order they were first queued
+
+    // Device telemetry, published as home/<location>/<device>/<property> while anyone subscribes
+    MessageBroker telemetry;
+    void publishTelemetry(const Device& device, DeviceChange change);
+
+    // Diagnostics: metrics in Prometheus text format and Chrome traces
+    void handleDiagnostics();
+
+    // Shared executor for bulk device work; its tasks run while the caller holds the device mutex
+    // and never take it themselves, device changes they cause are replayed once the work is done.
+    // Started on first use, so small homes hosted by the thousand run no threads of their own
+    mutable std::unique_ptr<WorkStealingPool> executor;
+    mutable std::mutex executorMutex; // guards starting and replacing the executor, taken after the device mutex
+    WorkStealingPool& pool() const;
+    void runDeviceShards(std::size_t shardCount, const std::function<void(std::size_t)>& work);
+
+    // Closed-loop thermostat control on its own worker thread
+    ThermostatControlLoop thermostatControl;
 
     // Device control handlers
     void handleSmartLightControl(const std::shared_ptr<SmartLight> light);
@@ -24,23 +109,97 @@ private:
     std::vector<std::unique_ptr<RoomController>> rooms;
 
 public:
+    explicit HomeController(EnergyMonitor* monitor = nullptr,
+                            StringPool* pool = nullptr); // null for an energy monitor or a string pool of its own
+    ~HomeController() override; // stops the control worker and executor, devices are handed back
+    HomeController(const HomeController&) = delete;
+    HomeController& operator=(const HomeController&) = delete;
     static HomeController* getInstance();
     void addDevice(std::shared_ptr<Device> device);
     void removeDevice(const std::string& deviceId);
-    void showDevices() const;
+    std::size_t loadLayout(const HomeLayout& layout); // rooms and devices in bulk, returns devices added
+    void showDevices() const; // every change so far
+    void showDevices(const HomeSnapshot& snapshot) const; // as of the given version
     void showMenu() const;
     void handleDeviceControl(const std::shared_ptr<Device> device);
+    std::shared_ptr<Device> findDevice(const std::string& deviceId) const;
+    std::shared_ptr<Device> findDeviceLocked(const std::string& deviceId) const; // the caller holds getDeviceMutex()
+    std::mutex& getDeviceMutex() const; // held while reading or changing the home's devices
+    std::vector<std::shared_ptr<Device>> getDevices() const; // every device, in the order they were added
+
+    // Device queries, e.g. "lights and on and in Kitchen"; see DeviceQuery for the syntax, malformed
+    // queries throw invalid_argument
+    std::vector<std::shared_ptr<Device>> selectDevices(const std::string& query);
+    std::size_t countDevices(const std::string& query);
+
+    // Snapshots: an immutable view of every device and room, read lock-free while writers go on; single
+    // device changes show from the next publish, bulk operations publish when they finish
+    PinnedSnapshot readSnapshot() const; // the latest version, the first read publishes one
+    PinnedSnapshot readCurrentSnapshot() const; // pending changes published first, under the device mutex
+    std::uint64_t publishSnapshot(); // publish pending changes now, returns the version readers see
+    std::size_t applyToSelection(const std::string& query, const DeviceCommand& command); // devices that accepted it
+    DeviceResult applyCommand(const std::string& deviceId, const DeviceCommand& command); // non-throwing device command
+    DeviceResult applyCommandLocked(const std::string& deviceId, const DeviceCommand& command); // the caller holds getDeviceMutex()
+    std::size_t applyCommands(const std::vector<std::pair<std::string, DeviceCommand>>& commands,
+                              std::vector<DeviceResult>& results); // batch of commands, returns how many succeeded
+
+    // Queued device commands: bursts such as slider drags are coalesced per device, then applied by
+    // flushCommandQueues(), which updateScheduler() also calls
+    DeviceResult queueCommand(const std::string& deviceId, const DeviceCommand& command); // Ok once queued
+    std::size_t flushCommandQueues(); // apply every pending command, returns how many were applied
+    std::size_t flushCommandQueuesLocked(); // the caller holds getDeviceMutex()
+    std::size_t getPendingCommandCount() const;
+
+    // Asynchronous device I/O: commands travel over a transport and complete when the device answers
+    Task<DeviceResult> applyCommandAsync(DeviceTransport& transport, std::string deviceId, DeviceCommand command);
+    std::size_t applyCommandsAsync(DeviceTransport& transport, const std::vector<std::pair<std::string, DeviceCommand>>& commands,
+                                   std::vector<DeviceResult>& results); // all in flight at once, blocks until every one completes
+    Task<std::size_t> setRoomPowerAsync(DeviceTransport& transport, std::string roomName, bool on); // devices that answered
 
     // Room control methods
     void addRoom(const std::string& roomName);
     void removeRoom(const std::string& roomName);
-    void listRooms() const;
+    void listRooms() const; // every change so far
     void assignDeviceToRoom(const std::string& deviceId, const std::string& roomName);
     void handleRoomControl();
+    std::size_t setRoomPower(const std::string& roomName, bool on); // devices switched, split across the executor
 
     // Energy monitoring methods
     void showEnergyMenu() const;
     void handleEnergyMonitoring();
+    EnergySnapshot measureEnergy() const; // every device's current draw, summed on the executor
+    EnergyMonitor& getEnergyMonitor() const;
+    StringPool& getStringPool() const; // for devices built for this home, e.g. by generateHome
+    MemoryReport measureMemory() const; // bytes by device type and by subsystem
+
+    // Executor methods
+    WorkStealingPool& getExecutor();
+    void setExecutorThreads(std::size_t threads); // replace the executor, 0 for one worker per hardware thread
+
+    // Clock methods
+    void setClock(HomeClock* newClock); // null for the system clock; also drives the energy monitor
+    HomeClock& getClock() const;
+
+    // Scheduling methods; timers run under the device mutex
+    Scheduler& getScheduler();
+    TimerId scheduleDeviceOn(const std::string& deviceId, std::uint64_t delayMillis);
+    TimerId scheduleDeviceOff(const std::string& deviceId, std::uint64_t delayMillis);
+    TimerId fadeLight(const std::string& deviceId, int targetBrightness, std::uint64_t durationMillis);
+    void updateScheduler();
+
+    // Thermostat control methods
+    ThermostatControlLoop& getThermostatControl();
+
+    // Automation methods
+    AutomationEngine& getAutomation();
+    std::uint32_t addAutomationRule(const std::string& ruleText);
+    std::vector<std::pair<std::uint32_t, std::string>> listAutomationRules() const;
+    bool removeAutomationRule(std::uint32_t ruleId);
+    void onDeviceChanged(Device& device, DeviceChange change) override;
+
+    // Telemetry methods
+    MessageBroker& getTelemetry(); // published under the device mutex, so subscribe with a Drop policy, not Block
+    std::size_t snapshotTelemetry(TelemetryBatchWriter& batch); // every device's state in binary, returns records added
     void run();
 };
 
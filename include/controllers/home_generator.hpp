@@ -0,0 +1,59 @@
+#ifndef home_generator_hpp
+#define home_generator_hpp
+
+// includes
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "devices/device.hpp"
+#include "devices/device_command.hpp"
+
+class HomeController;
+class StringPool;
+
+// size and shape of a synthetic home
+struct HomeSpec {
+    std::size_t lights = 20;
+    std::size_t thermostats = 4;
+    std::size_t cameras = 4;
+    std::size_t rooms = 8; // devices are spread round-robin over the rooms
+    std::size_t zones = 2; // rooms are grouped into zones, e.g. floors, which prefix the room names
+    std::uint32_t seed = 1;
+    StringPool* strings = nullptr; // the device locations are interned here, e.g. the home's pool, null for the process default
+};
+
+// relative weights of the command kinds in a generated stream
+struct CommandMix {
+    double toggles = 40.0; // turn any device on or off
+    double brightness = 30.0; // light brightness changes
+    double setpoints = 20.0; // thermostat desired temperature
+    double recording = 10.0; // camera recording start and stop
+    double skew = 1.0; // Zipf exponent for picking devices, 0 is uniform, higher favours a few busy devices
+};
+
+// devices and rooms of a synthetic home, not yet attached to a controller
+struct GeneratedHome {
+    std::vector<std::shared_ptr<Device>> devices; // lights, then thermostats, then cameras
+    std::vector<std::string> rooms; // "Zone 1 Room 3"
+    std::vector<std::size_t> deviceRoom; // room index for each device
+    std::size_t lights = 0;
+    std::size_t thermostats = 0;
+    std::size_t cameras = 0;
+};
+
+// a command stream, in the shape HomeController::applyCommands takes
+using CommandStream = std::vector<std::pair<std::string, DeviceCommand>>;
+
+// build the devices and rooms for a spec, devices are named L0.., T0.., C0..
+GeneratedHome generateHome(const HomeSpec& spec);
+
+// add the rooms and devices to a controller and turn every device on
+void populateHome(HomeController& controller, const GeneratedHome& home);
+
+// a reproducible stream of count commands with the given mix
+CommandStream generateCommands(const GeneratedHome& home, const CommandMix& mix, std::size_t count, std::uint32_t seed);
+
+#endif // home_generator_hpp
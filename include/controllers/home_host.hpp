@@ -0,0 +1,69 @@
+#ifndef home_host_hpp
+#define home_host_hpp
+
+// includes
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "controllers/home_controller.hpp"
+
+// many independent homes in one process, sharded over worker threads
+//
+// Every home has its own devices, rooms, rules and energy monitor and belongs to one shard, home
+// id % shards. A shard is one thread with a FIFO queue: work posted for a home runs on its shard in
+// the order it was posted and never alongside other work for that home, so homes need no locking
+// between each other and no work is stolen across shards. A task that throws is logged and counted,
+// the shard carries on. The destructor runs what is queued, then joins the threads.
+class HomeHost {
+    private:
+        using HomeTask = std::function<void(HomeController&)>;
+
+        // one worker thread and the work queued for its homes
+        struct Shard {
+            std::mutex lock;
+            std::condition_variable workAvailable;
+            std::condition_variable drained; // queue empty and nothing running
+            std::deque<std::pair<HomeController*, HomeTask>> tasks;
+            bool running = false; // a batch is being worked through
+            bool stopping = false;
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::vector<std::unique_ptr<HomeController>> homes; // by home ID
+        mutable std::mutex homesMutex; // guards homes, not the homes themselves
+        std::atomic<std::uint64_t> executedCount;
+        std::atomic<std::uint64_t> failedCount;
+
+        void run(std::size_t index); // shard loop
+        HomeController& home(std::size_t id) const; // throws out_of_range for unknown IDs
+
+    public:
+        explicit HomeHost(std::size_t shardCount = 0); // 0 for one shard per hardware thread
+        ~HomeHost();
+        HomeHost(const HomeHost&) = delete;
+        HomeHost& operator=(const HomeHost&) = delete;
+
+        std::size_t addHome(); // an empty home with its own energy monitor, returns its ID
+        HomeController& getHome(std::size_t id); // for setup before work is posted, or from the home's own tasks
+
+        // queue work for one home on its shard, throws out_of_range for unknown IDs
+        void post(std::size_t id, HomeTask task);
+        void wait(); // until every shard's queue is drained
+
+        // state
+        std::size_t getShardCount() const { return shards.size(); }
+        std::size_t getHomeCount() const;
+        std::size_t getShardOf(std::size_t id) const { return id % shards.size(); }
+        std::uint64_t getExecutedCount() const { return executedCount.load(std::memory_order_relaxed); }
+        std::uint64_t getFailedCount() const { return failedCount.load(std::memory_order_relaxed); } // tasks that threw
+};
+
+#endif // home_host_hpp
@@ -0,0 +1,47 @@
+#ifndef home_layout_hpp
+#define home_layout_hpp
+
+// includes
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+#include "devices/device.hpp"
+
+class StringPool;
+
+// a home described by a layout file: rooms, devices in their initial state and room assignments
+//
+// One declaration per line, fields separated by spaces, double quotes around fields that contain
+// spaces, # to the end of the line is a comment:
+//
+//   room Bedroom
+//   room "Living Room"
+//   light SL1 "Bedroom Light" Bedroom room=Bedroom on brightness=40 color="warm white"
+//   thermostat ST1 "Living Room Thermostat" "Living Room" room="Living Room" on setpoint=21.5 mode=heating
+//   camera SC1 "Front Door Camera" "Front Door" on resolution=4K rotation=90 motion=on record
+//
+// A device line is its type, ID, name and location, then an optional room=<room> declared on an
+// earlier line, then its state as commands in the text form of parseDeviceCommand with = between
+// verb and argument, applied in order. The devices are parsed unmetered, so restoring their state
+// sends no power readings; HomeController::loadLayout meters them and takes one reading per device
+// that is on.
+struct HomeLayout {
+    std::vector<std::string> rooms;
+    std::vector<std::shared_ptr<Device>> devices;
+    std::vector<std::int32_t> deviceRoom; // index into rooms for each device, -1 for none
+};
+
+// parsing throws invalid_argument naming the line for malformed lines, unknown rooms, duplicate IDs
+// and state the device rejects; the input is read in large blocks, not line by line. The device
+// locations are interned in pool, pass the pool of the home the layout is for, null for the process
+// default
+HomeLayout parseHomeLayout(std::istream& in, StringPool* pool = nullptr);
+HomeLayout loadHomeLayout(const std::string& path, StringPool* pool = nullptr); // also throws runtime_error if the file cannot be read
+
+// the layout text that parseHomeLayout reads back to the same devices and rooms
+void writeHomeLayout(std::ostream& out, const HomeLayout& layout);
+bool saveHomeLayout(const std::string& path, const HomeLayout& layout); // false if the file cannot be written
+
+#endif // home_layout_hpp
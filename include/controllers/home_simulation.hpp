@@ -0,0 +1,68 @@
+#ifndef home_simulation_hpp
+#define home_simulation_hpp
+
+// includes
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "controllers/home_controller.hpp"
+#include "core/clock.hpp"
+
+// what a simulated home does and for how long
+struct SimulationConfig {
+    std::uint64_t durationMillis = 365ull * 24 * 3600 * 1000; // a year
+    std::uint32_t seed = 1; // same seed, same home, same result
+    std::uint32_t startMinute = 0; // time of day the run starts at
+    std::uint32_t controlPeriodSeconds = 300; // thermostat control step, a typical heating cycle
+    std::uint32_t updatePeriodSeconds = 900; // how often temperatures are published and time-of-day rules run
+    double lightTogglesPerDay = 2.0; // each light is switched at random about this often, on and off once a day
+    double recordingsPerDay = 2.0; // each camera starts recording about this often
+    std::uint32_t recordingMinutes = 10; // and stops after this long
+    float daySetpoint = 21.0f; // thermostat schedule, every thermostat wakes and sleeps within half an hour of these times
+    float nightSetpoint = 17.0f;
+    int wakeMinute = 7 * 60;
+    int sleepMinute = 22 * 60 + 30;
+    float winterAmbient = 2.0f; // outside temperature follows the seasons, coldest in mid January
+    float summerAmbient = 18.0f;
+};
+
+// totals of a run
+struct SimulationResult {
+    std::uint64_t simulatedMillis = 0;
+    std::uint64_t deviceEvents = 0; // switches, recordings and setpoint changes
+    std::uint64_t controlTicks = 0;
+    std::uint64_t updates = 0; // scheduler updates of the home
+    double energyWattHours = 0.0; // drawn by every monitored device during the run
+    double meanIndoorTemperature = 0.0; // thermostat temperatures averaged over the updates
+};
+
+// discrete-event fast-forward of a home on a virtual clock
+//
+// Device events, thermostat schedules and control ticks are timers on the home's scheduler; the
+// clock jumps from one update to the next and the timer wheel skips the idle milliseconds in
+// between, so time costs nothing where nothing happens. The control loop's worker is paused and its
+// gains are set for the longer control step. The home's clock, control settings and worker are
+// restored afterwards, device state is left as the simulation ended it.
+class HomeSimulation {
+    private:
+        HomeController& home;
+        SimulationConfig config;
+        VirtualClock clock;
+        std::mt19937 random; // same sequence on every standard library, unlike the distributions
+        std::vector<TimerId> timers; // pending simulation timers, one slot per recurring event
+        std::int64_t clockOffset; // clock time minus scheduler time during a run
+        SimulationResult result;
+
+        double uniform(); // in [0, 1)
+        std::uint64_t exponentialDelay(double perDay); // time to the next random event
+        void scheduleLight(std::size_t slot, std::shared_ptr<Device> light, double perDay);
+        void scheduleCamera(std::size_t slot, std::shared_ptr<Device> camera, double perDay);
+        void apply(const std::shared_ptr<Device>& device, CommandType type, float value = 0.0f);
+        float ambientAt(std::uint64_t millis) const; // seasonal outside temperature
+
+    public:
+        HomeSimulation(HomeController& home, const SimulationConfig& config = SimulationConfig()); // throws invalid_argument for zero periods
+        SimulationResult run(); // simulate the whole duration
+};
+
+#endif // home_simulation_hpp
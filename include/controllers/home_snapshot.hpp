@@ -0,0 +1,150 @@
+#ifndef home_snapshot_hpp
+#define home_snapshot_hpp
+
+// includes
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "controllers/automation_engine.hpp"
+#include "controllers/device_query.hpp"
+#include "controllers/room_controller.hpp"
+#include "core/epoch.hpp"
+#include "devices/device.hpp"
+#include "devices/light_color.hpp"
+#include "devices/thermostat.hpp"
+#include "devices/video_frame.hpp"
+
+// live power draw of the home, measured device by device
+struct EnergySnapshot {
+    double totalWatts = 0.0;
+    std::size_t deviceCount = 0;
+    std::size_t devicesOn = 0;
+    std::map<std::string, double> wattsByLocation; // sorted for reports
+};
+
+// one device's state as of a snapshot, copied from the device when it changed; views hold nothing
+// of the device, so a version stays readable after the device is gone
+struct DeviceView {
+    std::string id; // empty for a free slot
+    std::string name;
+    std::string location; // copied, the home's string pool may reuse or free its entry
+    std::shared_ptr<const std::string> otherStatus; // getDeviceStatus() of devices of other kinds
+    DeviceKind kind = DeviceKind::Unknown;
+    bool live = false; // false for a free slot
+    bool on = false;
+    bool recording = false; // cameras
+    bool motionDetection = false;
+    bool closedLoop = false; // thermostats
+    ThermostatMode mode = ThermostatMode::Auto;
+    CameraResolution resolution = CameraResolution::Hd1080;
+    std::uint8_t brightness = 0; // lights, percent
+    LightColor color;
+    std::int16_t rotation = 0; // cameras, degrees
+    float power = 0.0f; // watts
+    float temperature = 0.0f; // thermostats, measured
+    float desiredTemperature = 0.0f;
+    float controlOutput = 0.0f; // heating/cooling output under closed-loop control
+
+    std::string status() const; // what the device's getDeviceStatus() said at the time, formatted on demand
+};
+
+// one room as of a snapshot
+struct RoomView {
+    std::string name;
+    std::vector<std::uint32_t> slots; // its devices' slots, in the order they were assigned
+};
+
+// an immutable, versioned copy of a home's device and room state, read without the home's lock
+//
+// Devices sit at their query index slots (see DeviceIndex), chunkSize slots to a chunk. A version
+// copies the chunks whose devices changed since the previous one and shares every other chunk, and
+// the room list, with it; in a copied chunk only the changed devices are read again, the other
+// views come from the previous chunk. Publishing after a batch costs the changed chunks plus a
+// pointer per chunk. Chunks carry no reference counts: the publisher retires a replaced chunk to the epoch
+// domain together with the last version that holds it. Read through a PinnedSnapshot, which keeps
+// the version and its chunks alive.
+class HomeSnapshot {
+    public:
+        static const std::size_t chunkSize = 16; // small, a batch of random commands touches a chunk per command
+        using Chunk = std::vector<DeviceView>;
+
+    private:
+        std::uint64_t version;
+        std::vector<const Chunk*> chunks; // owned by the publisher, shared between versions
+        std::shared_ptr<const std::vector<RoomView>> rooms;
+        std::size_t slotCount;
+        std::size_t deviceCount;
+        friend class SnapshotPublisher;
+
+    public:
+        HomeSnapshot(); // version 0, no devices, no rooms
+
+        std::uint64_t getVersion() const; // from 1, one up per publish
+        std::size_t getSlotCount() const;
+        std::size_t getDeviceCount() const; // free slots excluded
+        const DeviceView& at(std::size_t slot) const; // throws out_of_range past getSlotCount()
+        const DeviceView* findNth(std::size_t n) const; // the n-th device from 0 in slot order, null past the end
+        const std::vector<RoomView>& getRooms() const; // in the order they were added
+
+        // every device in slot order
+        template <typename F>
+        void forEachDevice(F&& visit) const {
+            for (const auto& chunk : chunks) {
+                for (const DeviceView& view : *chunk) {
+                    if (view.live) {
+                        visit(view);
+                    }
+                }
+            }
+        }
+
+        EnergySnapshot measureEnergy() const; // draw as of the snapshot, device by device
+        std::size_t getMemoryUsage() const; // bytes of the version, chunks shared with other versions included
+};
+
+// a version held for reading: valid and unchanged until this is destroyed, whatever writers do
+class PinnedSnapshot {
+    private:
+        EpochDomain::ReadGuard guard;
+        const HomeSnapshot* snapshot;
+
+    public:
+        PinnedSnapshot(EpochDomain::ReadGuard guard, const HomeSnapshot* snapshot);
+        const HomeSnapshot& operator*() const;
+        const HomeSnapshot* operator->() const;
+};
+
+// builds a home's versions from its query index and rooms, publishing them for lock-free readers
+//
+// Everything but load() is called under the home's device mutex. Changes are tracked per chunk once
+// the first version is published; homes nobody reads pay one branch per change.
+class SnapshotPublisher {
+    private:
+        RcuPointer<HomeSnapshot> latest;
+        const HomeSnapshot* published; // the latest, retired only by the next publish
+        std::vector<std::uint64_t> dirtySlots; // bitset by slot, a chunk is a half word
+        bool devicesDirty;
+        bool roomsDirty;
+        void retireChunks(std::vector<const HomeSnapshot::Chunk*> chunks); // freed once no reader holds a version with them
+
+    public:
+        SnapshotPublisher();
+        ~SnapshotPublisher(); // the latest version and its chunks are retired
+        SnapshotPublisher(const SnapshotPublisher&) = delete;
+        SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+        bool isPublishing() const; // a version is out
+        bool hasChanges() const; // since the latest version
+        void deviceChanged(std::uint32_t slot); // DeviceIndex::noSlot is ignored
+        void roomsChanged();
+        std::uint64_t publish(const DeviceIndex& index, const std::vector<std::unique_ptr<RoomController>>& rooms); // returns the version
+        std::uint64_t getVersion() const; // 0 before the first publish
+
+        const HomeSnapshot* load(const EpochDomain::ReadGuard& guard) const; // null before the first publish
+        std::size_t getMemoryUsage() const; // bytes of the latest version
+};
+
+#endif // home_snapshot_hpp
@@ -3,10 +3,16 @@
 #define room_controller_hpp
 
 // includes
+#include <cstddef>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 #include <memory>
+#include "core/task.hpp"
 #include "devices/device.hpp"
+#include "devices/device_transport.hpp"
 
 using namespace std;
 
@@ -15,6 +21,9 @@ class RoomController {
     private:
     string roomName; // room name
     vector<shared_ptr<Device>> roomDevices; // devices in room
+    unordered_set<string_view> deviceIds; // IDs of roomDevices, viewing the devices' own, once the room is too large to scan
+    static const size_t scannedRoomSize = 32; // rooms up to this size are searched without deviceIds
+    bool claimId(const Device& device); // false if the room already has a device with its ID
 
 
     public:
@@ -23,16 +32,23 @@ class RoomController {
 
     // room management
     void addDevice(shared_ptr<Device> device); // add device to room
+    size_t addDevices(const vector<shared_ptr<Device>>& devices); // add many devices with one log line, returns how many were new
     void removeDevice(const string& deviceID); // remove device from room
     void listDevices() const; // list all devices in room
     void turnAllDevicesOn(); // turn all devices on
     void turnAllDevicesOff(); // turn all devices off
+    // every device at once over a transport, returns how many answered; the task holds copies of
+    // the name and device list, so the room may go while it runs
+    Task<size_t> setAllDevicesPowerAsync(DeviceTransport& transport, bool on, std::mutex* deviceMutex = nullptr);
+    static Task<size_t> setDevicesPowerAsync(DeviceTransport& transport, string roomName, vector<shared_ptr<Device>> devices,
+                                             bool on, std::mutex* deviceMutex = nullptr); // the same for a copied device list
 
     // getters
     string getRoomName() const; // get room name
     size_t getDeviceCount() const; // get number of devices in room
     bool hasDevice(const string& deviceId) const; // check if room has device
     vector<shared_ptr<Device>> getDevices() const; // get all devices in room
+    size_t getMemoryUsage() const; // bytes of the room and its lists, devices excluded
 };
 
 #endif
\ No newline at end of file
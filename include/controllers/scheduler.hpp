@@ -0,0 +1,44 @@
+#ifndef scheduler_hpp
+#define scheduler_hpp
+
+// includes
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "core/timer_wheel.hpp"
+#include "devices/device.hpp"
+#include "devices/smart_light.hpp"
+
+// millisecond scheduler for delayed device commands, repeating schedules and light fades
+class Scheduler {
+    private:
+        TimerWheel wheel; // one tick per millisecond
+
+    public:
+        Scheduler(std::uint64_t startMillis = 0); // scheduler whose clock starts at the given time
+        Scheduler(const Scheduler&) = delete; // fade callbacks refer back to the scheduler
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        // generic timers
+        TimerId runAfter(std::uint64_t delayMillis, std::function<void()> action); // run once after a delay
+        TimerId runAt(std::uint64_t atMillis, std::function<void()> action); // run once at an absolute time
+        TimerId runEvery(std::uint64_t periodMillis, std::function<void()> action, std::uint64_t firstDelayMillis = 0); // run repeatedly
+        bool cancel(TimerId id); // cancel a timer, schedule or fade
+        bool isPending(TimerId id) const; // has the timer still work to do?
+
+        // device commands
+        TimerId turnOnAfter(const std::shared_ptr<Device>& device, std::uint64_t delayMillis); // delayed turn on
+        TimerId turnOffAfter(const std::shared_ptr<Device>& device, std::uint64_t delayMillis); // delayed turn off
+        TimerId fadeBrightness(const std::shared_ptr<SmartLight>& light, int targetBrightness,
+                               std::uint64_t durationMillis, std::uint64_t stepMillis = 100); // linear fade
+        TimerId fadeColor(const std::shared_ptr<SmartLight>& light, LightColor targetColor,
+                          std::uint64_t durationMillis, std::uint64_t stepMillis = 100); // color transition
+
+        // time
+        std::size_t advanceTo(std::uint64_t nowMillis); // run everything due up to this time, returns timers fired
+        std::size_t advanceBy(std::uint64_t millis); // move the clock forward
+        std::uint64_t now() const; // current scheduler time
+        std::size_t getPendingCount() const; // timers waiting to fire
+};
+
+#endif // scheduler_hpp
@@ -0,0 +1,137 @@
+#ifndef thermostat_control_hpp
+#define thermostat_control_hpp
+
+// includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "core/thread_pool.hpp"
+#include "devices/thermostat.hpp"
+
+// how thermostat outputs are computed
+enum class ControlStrategy {
+    Pid, // proportional-integral-derivative, proportional output
+    Hysteresis // on/off relay with a dead band around the setpoint
+};
+
+// control loop settings, temperatures in degrees celsius and rates per second
+struct ControlLoopConfig {
+    std::uint32_t periodMillis = 1000; // control period
+    ControlStrategy strategy = ControlStrategy::Pid;
+    float kp = 0.8f; // output per degree of error
+    float ki = 0.02f; // output per degree-second of accumulated error
+    float kd = 0.0f; // output per degree-per-second of temperature change
+    float hysteresisBand = 0.5f; // relay switches at setpoint +/- band
+    std::uint32_t energyReportTicks = 10; // ticks averaged into each EnergyMonitor update
+    bool simulatePlant = true; // move room temperatures with a first-order thermal model
+    float ambientTemperature = 15.0f; // temperature rooms drift towards
+    float heatingRate = 0.05f; // degrees per second at full output
+    float lossRate = 0.002f; // fraction of the gap to ambient lost per second
+};
+
+// timing of the worker, jitter is wake-up time minus the tick deadline
+struct ControlLoopStats {
+    std::uint64_t ticks = 0; // ticks run
+    std::uint64_t missedTicks = 0; // deadlines skipped because a tick ran late
+    double p50JitterMicros = 0.0;
+    double p99JitterMicros = 0.0;
+    double maxJitterMicros = 0.0;
+    double meanTickMicros = 0.0; // time spent computing a tick
+    double maxTickMicros = 0.0;
+};
+
+// runs PID or hysteresis control for every registered thermostat at a fixed rate on its own thread
+//
+// the loop does not own the thermostats: the worker holds the owner's device mutex (setDeviceMutex)
+// around each tick, so code that changes a registered thermostat under that mutex never races it.
+// Temperature changes made by the plant model are not reported from the worker,
+// publishTemperatureChanges() hands them over on the caller's thread.
+class ThermostatControlLoop {
+    private:
+        // controller state for one thermostat
+        struct Channel {
+            std::shared_ptr<Thermostat> thermostat; // controlled device
+            float integral; // accumulated error, PID only
+            float lastTemperature; // previous measurement, for the derivative
+            std::int8_t relay; // relay state, 1 heating, -1 cooling, hysteresis only
+            bool temperatureMoved; // plant changed the temperature since the last publish
+            double energyAccumulator; // power summed since the last energy report
+        };
+
+        ControlLoopConfig config; // settings
+        std::vector<Channel> channels; // controlled thermostats
+        std::unordered_map<std::string_view, std::size_t> channelById; // the channel's own device ID to channel
+        std::vector<std::pair<std::string, double>> energyBatch; // reused report buffer
+        std::uint32_t ticksSinceReport; // ticks since the last energy report
+        float plantDecay; // share of the gap to the settled temperature left after this tick, the same for every channel
+        mutable std::mutex mutex; // guards channels, settings and timing, taken after the device mutex
+        std::mutex* deviceMutex; // the owner's, held by the worker during a tick, null when the loop is used alone
+        WorkStealingPool* executor; // splits large ticks across its workers, not owned, may be null
+        EnergyMonitor* energyMonitor; // receives the energy reports, not owned, null for the process default
+
+        // worker
+        std::thread worker; // runs the loop while started
+        std::mutex wakeMutex; // guards stopRequested for the condition variable
+        std::condition_variable wake; // interrupts the sleep between ticks on stop
+        bool stopRequested; // worker should exit
+        std::atomic<bool> running; // worker is running
+
+        // timing samples
+        static const std::size_t jitterSampleCount = 4096; // ring of recent samples
+        std::vector<float> jitterSamples; // recent wake-up jitter in microseconds
+        std::size_t jitterNext; // next ring position
+        std::uint64_t tickCount; // ticks run
+        std::uint64_t workerTicks; // ticks run by the worker
+        std::uint64_t missedTicks; // deadlines skipped
+        double maxJitterMicros; // worst jitter seen
+        double totalTickMicros; // compute time of all worker ticks
+        double maxTickMicros; // worst tick compute time
+
+        void workerLoop(); // sleep until each deadline and run a tick
+        float computeOutput(Channel& channel, const Thermostat& thermostat, float dtSeconds); // controller step
+        void stepChannel(Channel& channel, float dtSeconds); // control and plant step, touches only this channel
+        void reportEnergy(); // send averaged power to the EnergyMonitor in one batch
+
+    public:
+        ThermostatControlLoop(const ControlLoopConfig& config = ControlLoopConfig());
+        ~ThermostatControlLoop(); // stops the worker
+        ThermostatControlLoop(const ThermostatControlLoop&) = delete; // owns a thread
+        ThermostatControlLoop& operator=(const ThermostatControlLoop&) = delete;
+
+        // thermostats
+        void addThermostat(const std::shared_ptr<Thermostat>& thermostat); // start controlling a thermostat
+        bool removeThermostat(const std::string& deviceId); // stop controlling a thermostat
+        std::size_t getThermostatCount() const;
+
+        // settings
+        void setConfig(const ControlLoopConfig& newConfig); // throws invalid_argument for a zero period
+        ControlLoopConfig getConfig() const;
+
+        // running
+        void start(); // start the worker thread
+        void stop(); // stop and join the worker thread
+        bool isRunning() const;
+        void runTick(float dtSeconds); // one control step for all thermostats, also usable without the worker; the caller holds the device mutex
+        void setDeviceMutex(std::mutex* mutex); // guards the thermostats, set before start()
+        void setExecutor(WorkStealingPool* pool); // pool for ticks over many thermostats, null to run them inline
+        void setEnergyMonitor(EnergyMonitor* monitor); // the home's monitor, null for the process default
+        std::size_t publishTemperatureChanges(const std::function<void(Thermostat&)>& publish); // hand over plant changes, under the device mutex
+
+        // timing
+        ControlLoopStats getStats() const;
+        void resetStats();
+        std::size_t getMemoryUsage() const; // bytes of the channels and buffers, thermostats excluded
+};
+
+#endif // thermostat_control_hpp
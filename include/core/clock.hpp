@@ -0,0 +1,48 @@
+#ifndef clock_hpp
+#define clock_hpp
+
+// includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// source of time for everything in the home that depends on it: energy integration, the scheduler
+// and time-of-day rules
+//
+// Components hold a HomeClock pointer and fall back to systemClock(); tests and simulations
+// swap in a VirtualClock that only moves when it is told to, so a year can pass in seconds.
+class HomeClock {
+    public:
+        virtual ~HomeClock() = default;
+        virtual std::uint64_t nowMillis() const = 0; // milliseconds since the clock's epoch, never decreases
+        virtual int minuteOfDay() const = 0; // minutes after local midnight, 0 to 1439
+};
+
+// the steady clock for elapsed time and the local wall clock for the time of day
+class SystemClock : public HomeClock {
+    private:
+        std::chrono::steady_clock::time_point epoch; // nowMillis() is 0 here
+
+    public:
+        SystemClock();
+        std::uint64_t nowMillis() const override;
+        int minuteOfDay() const override;
+};
+
+// manually driven time, starting at midnight of day 0 unless told otherwise
+class VirtualClock : public HomeClock {
+    private:
+        std::atomic<std::uint64_t> millis; // current time, read from any thread
+        int startMinute; // time of day at millisecond 0
+
+    public:
+        VirtualClock(std::uint64_t startMillis = 0, int startMinuteOfDay = 0); // throws invalid_argument outside 0..1439
+        std::uint64_t nowMillis() const override;
+        int minuteOfDay() const override;
+        void advanceTo(std::uint64_t nowMillis); // earlier times are ignored, time never runs backwards
+        void advanceBy(std::uint64_t deltaMillis);
+};
+
+HomeClock& systemClock(); // process-wide system clock, the default for every component
+
+#endif // clock_hpp
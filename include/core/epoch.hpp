@@ -0,0 +1,105 @@
+#ifndef epoch_hpp
+#define epoch_hpp
+
+// includes
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// process-wide epoch-based reclamation for read-mostly data published through atomic pointers
+//
+// A reader pins the current epoch in its thread's own slot for the length of a read, so reads
+// write no shared cache line and never wait for writers or for each other. A writer that replaces
+// a published object retires the old one with the epoch it was unpublished in; it is freed once
+// every pinned slot has moved past that epoch, i.e. once no reader can still hold it. Writers never
+// wait for readers either: a long read only holds back reclamation. Reads nest on one thread.
+class EpochDomain {
+    private:
+        // one thread's pinned epoch, alone on its cache line; slots are reused by later threads and
+        // never freed, writers walk them without a lock
+        struct alignas(64) ReaderSlot {
+            std::atomic<std::uint64_t> epoch; // pinned epoch, idle outside reads
+            std::atomic<bool> claimed; // owned by a live thread
+            ReaderSlot* next; // set before the slot is linked
+        };
+
+        // an unpublished object and the epoch it was retired in
+        struct Retired {
+            std::uint64_t epoch;
+            std::function<void()> reclaim;
+        };
+
+        static const std::uint64_t idle = ~std::uint64_t(0);
+        std::atomic<std::uint64_t> globalEpoch;
+        std::atomic<ReaderSlot*> slots; // newest first
+        mutable std::mutex retiredMutex;
+        std::vector<Retired> retired; // oldest first
+        std::atomic<std::uint64_t> reclaimedCount;
+        EpochDomain();
+
+        ReaderSlot* claimSlot(); // a free slot, or a new one linked in
+        void release(ReaderSlot* slot); // the owning thread exited
+        void enter(); // pin the current epoch, unless this thread already reads
+        void leave();
+        friend struct EpochThreadState;
+
+    public:
+        // a pinned read; objects loaded through an RcuPointer while it lives stay valid
+        class ReadGuard {
+            private:
+                EpochDomain* domain; // null once moved from
+            public:
+                explicit ReadGuard(EpochDomain& domain);
+                ReadGuard(ReadGuard&& other) noexcept;
+                ReadGuard(const ReadGuard&) = delete;
+                ReadGuard& operator=(const ReadGuard&) = delete;
+                ReadGuard& operator=(ReadGuard&&) = delete;
+                ~ReadGuard();
+        };
+
+        static EpochDomain* getInstance();
+        EpochDomain(const EpochDomain&) = delete;
+        EpochDomain& operator=(const EpochDomain&) = delete;
+
+        ReadGuard read(); // pin the current epoch on this thread
+        void retire(std::function<void()> reclaim); // run reclaim once no current reader can hold the object
+        std::size_t reclaim(); // advance the epoch and free what no reader can hold, returns how many
+        std::uint64_t getEpoch() const;
+        std::size_t getRetiredCount() const; // retired, not freed yet
+        std::uint64_t getReclaimedCount() const;
+};
+
+// a pointer to an immutable object, loaded by readers inside a read and replaced by writers
+//
+// Writers serialise among themselves (the owner's lock); the object a publish replaces is retired
+// to the domain and deleted once the readers that might hold it have left.
+template <typename T>
+class RcuPointer {
+    private:
+        std::atomic<const T*> current;
+
+    public:
+        RcuPointer() : current(nullptr) {}
+        RcuPointer(const RcuPointer&) = delete;
+        RcuPointer& operator=(const RcuPointer&) = delete;
+        ~RcuPointer() { retire(current.exchange(nullptr)); } // readers may still hold it
+
+        // the published object, null before the first publish; valid while the guard lives
+        const T* load(const EpochDomain::ReadGuard&) const { return current.load(std::memory_order_seq_cst); }
+
+        // replace the published object, readers see it from their next load
+        void publish(std::unique_ptr<const T> next) { retire(current.exchange(next.release(), std::memory_order_seq_cst)); }
+
+    private:
+        void retire(const T* old) {
+            if (old) {
+                EpochDomain::getInstance()->retire([old] { delete old; });
+            }
+        }
+};
+
+#endif // epoch_hpp
@@ -0,0 +1,129 @@
+#ifndef logger_hpp
+#define logger_hpp
+
+// includes
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// message severity, messages below the logger's level are dropped before formatting
+enum class LogLevel : std::uint8_t {
+    Debug,
+    Info, // routine progress, e.g. "Device added successfully."
+    Warning,
+    Error,
+    Off // nothing is logged
+};
+
+// leveled logger: producers format into a lock-free ring and a background thread writes the lines
+//
+// info and debug go to the info sink (stdout), warnings and errors to the error sink (stderr).
+// When the ring is full, debug and info messages are dropped and counted while warnings and
+// errors wait for space. Interactive code calls flush() before prompting so output stays in order.
+class Logger {
+    private:
+        static const std::size_t slotCount = 8192; // ring capacity, a power of two
+        static const std::size_t messageBytes = 240; // longer messages are truncated
+
+        // one ring entry, the sequence number says whether it is free, filled or being written
+        struct Slot {
+            std::atomic<std::uint64_t> sequence;
+            LogLevel level;
+            std::uint16_t length;
+            char text[messageBytes];
+        };
+
+        std::unique_ptr<Slot[]> slots; // the ring
+        alignas(64) std::atomic<std::uint64_t> enqueuePosition; // next slot for producers
+        alignas(64) std::uint64_t dequeuePosition; // next slot for the writer, writer thread only
+        std::vector<char> infoBuffer; // lines gathered for the info sink, writer thread only
+        std::vector<char> errorBuffer; // lines gathered for the error sink, writer thread only
+        alignas(64) std::atomic<std::uint64_t> writtenCount; // messages the writer has finished
+        std::atomic<std::uint64_t> droppedCount; // messages lost to a full ring
+        std::atomic<LogLevel> level; // lowest level that is logged
+
+        // sinks
+        std::mutex sinkMutex; // guards the sink pointers against the writer
+        std::FILE* infoSink; // debug and info lines
+        std::FILE* errorSink; // warning and error lines
+
+        // writer thread
+        std::thread writer; // drains the ring
+        std::mutex wakeMutex; // for the condition variable
+        std::condition_variable wake; // wakes the writer early
+        std::atomic<bool> writerSleeping; // producers only notify a sleeping writer
+        std::atomic<bool> stopRequested; // writer should drain and exit
+        std::once_flag writerStarted; // the thread starts with the first message
+
+        Logger();
+        void writerLoop(); // drain the ring until stopped
+        std::size_t drain(); // write everything queued, returns lines written
+        void enqueue(LogLevel messageLevel, const char* text, std::size_t length); // copy a formatted line into the ring
+
+        // argument formatting into a fixed buffer
+        static void append(char*& out, char* end, const char* text, std::size_t length);
+        static void appendArg(char*& out, char* end, const std::string& value);
+        static void appendArg(char*& out, char* end, const char* value);
+        static void appendArg(char*& out, char* end, char value);
+        static void appendArg(char*& out, char* end, bool value);
+        static void appendArg(char*& out, char* end, long long value);
+        static void appendArg(char*& out, char* end, unsigned long long value);
+        static void appendArg(char*& out, char* end, double value);
+        template <typename T>
+        static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+        appendArg(char*& out, char* end, T value) { appendArg(out, end, static_cast<long long>(value)); }
+        template <typename T>
+        static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+        appendArg(char*& out, char* end, T value) { appendArg(out, end, static_cast<unsigned long long>(value)); }
+        static void appendArg(char*& out, char* end, float value) { appendArg(out, end, static_cast<double>(value)); }
+
+    public:
+        static Logger* getInstance(); // process-wide logger, drained at exit
+        ~Logger(); // writes whatever is still queued
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        // settings
+        void setLevel(LogLevel newLevel); // e.g. Warning to silence info messages in batch runs
+        LogLevel getLevel() const;
+        bool isEnabled(LogLevel messageLevel) const; // would a message at this level be logged?
+        void setSinks(std::FILE* info, std::FILE* error); // where lines are written, stdout and stderr by default
+
+        // logging, arguments are concatenated like a stream insertion
+        template <typename... Args>
+        void log(LogLevel messageLevel, const Args&... args) {
+            if (!isEnabled(messageLevel)) {
+                return;
+            }
+            char buffer[messageBytes];
+            char* out = buffer;
+            char* end = buffer + messageBytes;
+            int expand[] = {0, (appendArg(out, end, args), 0)...};
+            (void)expand;
+            enqueue(messageLevel, buffer, static_cast<std::size_t>(out - buffer));
+        }
+
+        // delivery
+        void flush(); // wait until every queued line is written
+        std::uint64_t getDroppedCount() const; // messages lost because the ring was full
+};
+
+// shorthands for the process-wide logger
+template <typename... Args>
+void logDebug(const Args&... args) { Logger::getInstance()->log(LogLevel::Debug, args...); }
+template <typename... Args>
+void logInfo(const Args&... args) { Logger::getInstance()->log(LogLevel::Info, args...); }
+template <typename... Args>
+void logWarning(const Args&... args) { Logger::getInstance()->log(LogLevel::Warning, args...); }
+template <typename... Args>
+void logError(const Args&... args) { Logger::getInstance()->log(LogLevel::Error, args...); }
+
+#endif // logger_hpp
@@ -0,0 +1,50 @@
+#ifndef memory_usage_hpp
+#define memory_usage_hpp
+
+// includes
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// heap bytes held by standard containers, estimated from their sizes and libstdc++'s layouts: a
+// string's buffer once it outgrows the 15-byte small-string buffer, a vector's capacity, a hash
+// table's bucket array and one node per element (next pointer, element, cached hash). Malloc's own
+// per-block overhead is not counted, so these are lower bounds on what the allocator hands out.
+inline std::size_t heapBytes(const std::string& text) {
+    return text.capacity() > 15 ? text.capacity() + 1 : 0;
+}
+
+template <typename T>
+std::size_t heapBytes(const std::vector<T>& items) {
+    return items.capacity() * sizeof(T);
+}
+
+template <typename Table>
+std::size_t hashTableBytes(const Table& table) {
+    return table.bucket_count() * sizeof(void*) + table.size() * (2 * sizeof(void*) + sizeof(typename Table::value_type));
+}
+
+// the control block make_shared places in front of the object: vtable pointer and two counts
+const std::size_t sharedControlBlockBytes = sizeof(void*) + 2 * sizeof(int);
+
+// bytes held by a home, by device type and by subsystem
+struct MemoryReport {
+    struct Entry {
+        std::string name;
+        std::size_t count; // devices, or the elements a subsystem holds
+        std::size_t bytes;
+    };
+
+    std::vector<Entry> deviceTypes; // device objects with their strings, buffers and control blocks
+    std::vector<Entry> subsystems; // the home's containers and indexes, the devices themselves excluded
+    std::size_t deviceCount = 0;
+
+    std::size_t deviceBytes() const;
+    std::size_t subsystemBytes() const;
+    std::size_t totalBytes() const;
+    double bytesPerDevice() const; // total over the device count, 0 without devices
+    void print(std::ostream& out) const; // both tables, bytes per device on every line; out keeps its formatting
+};
+
+#endif // memory_usage_hpp
@@ -0,0 +1,120 @@
+#ifndef message_broker_hpp
+#define message_broker_hpp
+
+// includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// one published message, shared by every subscriber it is delivered to
+struct BrokerMessage {
+    std::string topic; // e.g. home/Kitchen/L1/brightness
+    std::string payload; // e.g. 40
+    std::uint64_t sequence; // publish order across the broker
+};
+
+// what a full subscription queue does with a new message
+enum class OverflowPolicy {
+    DropOldest, // make room by discarding the oldest queued message
+    DropNewest, // discard the new message
+    Block // the publisher waits up to the broker's block timeout, then drops the new message; not for
+          // home telemetry, whose publisher holds the home's device mutex and would stall its commands
+};
+
+// bounded queue of messages for one subscriber, filled by publishers and drained by the subscriber
+class Subscription : public std::enable_shared_from_this<Subscription> {
+    private:
+        friend class MessageBroker;
+
+        std::vector<std::string> filters; // topic filters, e.g. home/+/L1/#
+        std::vector<std::shared_ptr<const BrokerMessage>> ring; // capacity slots
+        std::size_t head; // next message to take
+        std::size_t count; // messages queued
+        OverflowPolicy policy;
+        std::uint64_t delivered; // messages queued so far
+        std::uint64_t dropped; // messages lost to a full queue
+        mutable std::mutex lock;
+        std::condition_variable notEmpty; // woken by publishers
+        std::condition_variable notFull; // woken by the subscriber, Block policy only
+
+        bool offer(const std::shared_ptr<const BrokerMessage>& message, std::chrono::milliseconds blockTimeout);
+
+    public:
+        Subscription(std::size_t capacity, OverflowPolicy overflow);
+        Subscription(const Subscription&) = delete;
+        Subscription& operator=(const Subscription&) = delete;
+
+        // draining
+        std::shared_ptr<const BrokerMessage> poll(); // next message, null if the queue is empty
+        std::shared_ptr<const BrokerMessage> waitFor(std::chrono::milliseconds timeout); // null on timeout
+        std::size_t drain(std::vector<std::shared_ptr<const BrokerMessage>>& out); // take everything queued, returns how many
+
+        // state
+        std::size_t size() const; // messages queued
+        std::size_t capacity() const;
+        std::uint64_t getDelivered() const;
+        std::uint64_t getDropped() const;
+        std::vector<std::string> getFilters() const;
+};
+
+// in-process publish/subscribe with MQTT-style topics
+//
+// Topics are levels separated by '/'. A filter level '+' matches exactly one level and a final
+// '#' matches any number of levels, zero included, so home/# also matches home. Filters are kept
+// in a trie, so publishing costs one walk over the topic's levels however many filters there are.
+// A subscriber receives a message once even when several of its filters match. Block subscribers
+// are offered the message after the trie lock is released, so one waiting publisher does not hold
+// up subscribe, unsubscribe or other publishers.
+class MessageBroker {
+    private:
+        // one filter level
+        struct Node {
+            std::unordered_map<std::string, std::unique_ptr<Node>> children; // literal levels
+            std::unique_ptr<Node> anyLevel; // '+'
+            std::vector<Subscription*> exact; // filters ending here
+            std::vector<Subscription*> anyTail; // filters ending here with '#'
+        };
+
+        mutable std::shared_mutex trieMutex; // publishers share, subscribe and unsubscribe are exclusive
+        Node root;
+        std::vector<std::shared_ptr<Subscription>> subscriptions; // keeps subscribers alive while attached
+        std::atomic<std::size_t> subscriptionCount; // checked by hasSubscribers without the lock
+        std::atomic<std::uint64_t> nextSequence;
+        std::atomic<std::uint64_t> publishedCount;
+        std::chrono::milliseconds blockTimeout; // longest a Block publisher waits for room
+
+        static bool validFilter(const std::string& filter);
+        void collect(const Node& node, const std::vector<std::string>& levels, std::size_t depth,
+                     std::vector<Subscription*>& matches) const; // subscribers whose filters match
+        bool removeFilter(Node& node, const std::vector<std::string>& levels, std::size_t depth, Subscription* subscriber);
+
+    public:
+        MessageBroker(std::chrono::milliseconds publisherBlockTimeout = std::chrono::milliseconds(100));
+        MessageBroker(const MessageBroker&) = delete;
+        MessageBroker& operator=(const MessageBroker&) = delete;
+
+        // subscribing, filters that are not valid MQTT filters throw invalid_argument
+        std::shared_ptr<Subscription> subscribe(const std::string& filter, std::size_t capacity = 1024,
+                                                OverflowPolicy policy = OverflowPolicy::DropOldest);
+        void addFilter(const std::shared_ptr<Subscription>& subscription, const std::string& filter);
+        void unsubscribe(const std::shared_ptr<Subscription>& subscription); // detach from every filter
+
+        // publishing
+        std::size_t publish(const std::string& topic, const std::string& payload); // returns subscribers that got it
+        bool hasSubscribers() const { return subscriptionCount.load(std::memory_order_relaxed) > 0; }
+
+        // state
+        std::size_t getSubscriptionCount() const;
+        std::uint64_t getPublishedCount() const;
+        static bool matches(const std::string& filter, const std::string& topic); // filter check without a trie
+};
+
+#endif // message_broker_hpp
@@ -0,0 +1,216 @@
+#ifndef metrics_hpp
+#define metrics_hpp
+
+// includes
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// per-thread latency buckets, log-linear like an HDR histogram: 16 sub-buckets per power of two
+struct HistogramCells {
+    static const int subBucketBits = 4; // about 6% relative error
+    static const int maxValueBits = 40; // values are nanoseconds, larger ones land in the last bucket
+    static const std::size_t bucketCount = (maxValueBits - subBucketBits + 1) << subBucketBits;
+
+    std::atomic<std::uint64_t> buckets[bucketCount];
+    std::atomic<std::uint64_t> sum; // of recorded values
+
+    static std::size_t bucketFor(std::uint64_t value); // bucket index of a value
+    static std::uint64_t bucketLowerBound(std::size_t bucket); // smallest value in a bucket
+    static std::uint64_t bucketUpperBound(std::size_t bucket); // smallest value in the next bucket
+};
+
+// everything one thread records, only that thread writes it
+struct MetricsThreadBlock {
+    static const std::size_t maxCounters = 512;
+    static const std::size_t maxHistograms = 64;
+
+    std::atomic<std::uint64_t> counters[maxCounters];
+    std::atomic<HistogramCells*> histograms[maxHistograms]; // allocated on first use
+    std::uint32_t sampleTick; // drives 1-in-N latency sampling
+};
+
+MetricsThreadBlock& localMetricsBlock(); // the calling thread's block
+
+// monotonically increasing count, recorded per thread without atomic read-modify-write
+class Counter {
+    private:
+        std::uint32_t index; // slot in every thread block
+
+    public:
+        explicit Counter(std::uint32_t slot) : index(slot) {}
+        void increment(std::uint64_t amount = 1) const;
+        std::uint32_t getIndex() const { return index; }
+};
+
+// a value that goes up and down, shared by all threads
+class Gauge {
+    private:
+        std::atomic<double>* value;
+
+    public:
+        explicit Gauge(std::atomic<double>* cell) : value(cell) {}
+        void set(double newValue) const { value->store(newValue, std::memory_order_relaxed); }
+        void add(double amount) const;
+        double get() const { return value->load(std::memory_order_relaxed); }
+};
+
+// latency distribution in nanoseconds, timed calls may be sampled 1 in sampleEvery
+class Histogram {
+    private:
+        std::uint32_t index; // slot in every thread block
+        std::uint32_t sampleMask; // sampleEvery - 1, a power of two
+
+    public:
+        Histogram(std::uint32_t slot, std::uint32_t mask) : index(slot), sampleMask(mask) {}
+        void record(std::uint64_t nanos) const;
+        bool shouldSample() const; // advance the thread's sample tick, true when this call is timed
+        std::uint32_t getIndex() const { return index; }
+};
+
+// merged view of a histogram over all threads
+struct HistogramSnapshot {
+    std::vector<std::uint64_t> buckets;
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    double percentile(double fraction) const; // nanoseconds, the midpoint of the bucket holding the rank
+};
+
+// times a scope into a histogram when the histogram samples this call and metrics are on
+class ScopedLatency {
+    private:
+        const Histogram& histogram;
+        std::chrono::steady_clock::time_point start;
+        bool active;
+
+    public:
+        explicit ScopedLatency(const Histogram& target);
+        ~ScopedLatency();
+        ScopedLatency(const ScopedLatency&) = delete;
+        ScopedLatency& operator=(const ScopedLatency&) = delete;
+};
+
+// process-wide metrics: counters, gauges and histograms, written as Prometheus text
+//
+// Recording touches only the calling thread's block: plain relaxed loads and stores, no locks and no
+// shared cache lines. Readers sum the blocks. A thread's block is recycled when the thread exits so
+// its counts are kept. Registering the same name and labels again returns the same metric.
+class MetricsRegistry {
+    private:
+        enum class Kind { Counter, Gauge, Histogram };
+
+        // one labelled series of a family
+        struct Series {
+            std::string labels; // e.g. result="ok", empty for none
+            std::uint32_t slot; // counter or histogram index, or gauge position
+            std::uint32_t sampleEvery; // histograms only
+        };
+
+        // metrics sharing a name
+        struct Family {
+            Kind kind;
+            std::string help;
+            std::vector<Series> series;
+        };
+
+        static std::atomic<bool> enabled; // recording switch, checked on every call
+
+        mutable std::mutex registryMutex; // guards everything below
+        std::map<std::string, Family> families; // by name, sorted for stable output
+        std::deque<std::atomic<double>> gauges; // deque keeps gauge addresses stable
+        std::vector<std::unique_ptr<MetricsThreadBlock>> blocks; // every block ever handed out
+        std::vector<MetricsThreadBlock*> freeBlocks; // blocks of exited threads
+        std::uint32_t counterCount;
+        std::uint32_t histogramCount;
+
+        MetricsRegistry();
+        const Series& registerSeries(const std::string& name, const std::string& help, const std::string& labels,
+                                     Kind kind, std::uint32_t sampleEvery);
+        std::uint64_t sumCounter(std::uint32_t slot) const; // caller holds registryMutex
+        HistogramSnapshot mergeHistogram(std::uint32_t slot) const; // caller holds registryMutex
+
+    public:
+        static MetricsRegistry* getInstance();
+
+        // registration, names follow Prometheus rules, labels are written as name="value" pairs
+        Counter counter(const std::string& name, const std::string& help, const std::string& labels = "");
+        Gauge gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+        Histogram histogram(const std::string& name, const std::string& help, const std::string& labels = "",
+                            std::uint32_t sampleEvery = 1); // sampleEvery is rounded up to a power of two
+
+        // reading
+        std::uint64_t read(const Counter& counter) const;
+        HistogramSnapshot read(const Histogram& histogram) const;
+        void writePrometheus(std::ostream& out) const; // text exposition format 0.0.4
+        bool writePrometheusFile(const std::string& path) const; // false if the file cannot be written
+
+        // recording switch, e.g. off to measure the instrumentation's cost
+        static void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+        static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+        // used by the recording fast path
+        MetricsThreadBlock* acquireThreadBlock(); // a fresh or recycled block for the calling thread
+        void releaseThreadBlock(MetricsThreadBlock* block); // the thread is exiting
+        HistogramCells* allocateCells(MetricsThreadBlock& block, std::uint32_t slot);
+};
+
+// the pointer is constant-initialised, so reaching it needs no guard check
+inline MetricsThreadBlock& localMetricsBlock() {
+    static thread_local MetricsThreadBlock* block = nullptr;
+    if (!block) {
+        block = MetricsRegistry::getInstance()->acquireThreadBlock();
+    }
+    return *block;
+}
+
+// only the owning thread writes its cells, so an add is a load and a store
+inline void addRelaxed(std::atomic<std::uint64_t>& cell, std::uint64_t amount) {
+    cell.store(cell.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void Counter::increment(std::uint64_t amount) const {
+    if (MetricsRegistry::isEnabled()) {
+        addRelaxed(localMetricsBlock().counters[index], amount);
+    }
+}
+
+inline void Histogram::record(std::uint64_t nanos) const {
+    MetricsThreadBlock& block = localMetricsBlock();
+    HistogramCells* cells = block.histograms[index].load(std::memory_order_relaxed);
+    if (!cells) {
+        cells = MetricsRegistry::getInstance()->allocateCells(block, index);
+    }
+    addRelaxed(cells->buckets[HistogramCells::bucketFor(nanos)], 1);
+    addRelaxed(cells->sum, nanos);
+}
+
+inline bool Histogram::shouldSample() const {
+    MetricsThreadBlock& block = localMetricsBlock();
+    return (block.sampleTick++ & sampleMask) == 0;
+}
+
+inline ScopedLatency::ScopedLatency(const Histogram& target)
+    : histogram(target)
+    , active(MetricsRegistry::isEnabled() && target.shouldSample())
+{
+    if (active) {
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+inline ScopedLatency::~ScopedLatency() {
+    if (active) {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        histogram.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+}
+
+#endif // metrics_hpp
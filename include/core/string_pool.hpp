@@ -0,0 +1,35 @@
+#ifndef string_pool_hpp
+#define string_pool_hpp
+
+// includes
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+// interned strings: equal strings share one copy, kept for the life of the pool
+//
+// For values many objects repeat, like device locations: each holder keeps a pointer instead of its
+// own string, and equal values compare by address. A pool only grows, so it suits small sets of
+// distinct values, not per-object ones like IDs or device names, which would each pay for a pool
+// entry on top of the string and stay after a rename. Each home has its own, which goes with the
+// home, so homes never share the lock and locations sent to one home are not kept for the
+// process's life; getInstance() is the process default, used by the default home and by devices in
+// no home.
+class StringPool {
+    private:
+        std::unordered_set<std::string> strings; // nodes never move, so references stay valid
+        mutable std::mutex mutex;
+
+    public:
+        StringPool() = default;
+        static StringPool* getInstance();
+        StringPool(const StringPool&) = delete;
+        StringPool& operator=(const StringPool&) = delete;
+
+        const std::string& intern(const std::string& text); // the pooled copy of text, added if new
+        std::size_t size() const; // distinct strings
+        std::size_t getMemoryUsage() const; // bytes held by the pool
+};
+
+#endif // string_pool_hpp
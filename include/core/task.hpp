@@ -0,0 +1,175 @@
+#ifndef task_hpp
+#define task_hpp
+
+// includes
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// lazily started coroutine producing a T; it runs when awaited and resumes its awaiter when done
+//
+// A Task owns its coroutine. T must not be void, device operations return a DeviceResult.
+template <typename T>
+class [[nodiscard]] Task {
+    public:
+        struct promise_type {
+            std::optional<T> value;
+            std::exception_ptr error;
+            std::coroutine_handle<> continuation; // the awaiting coroutine
+
+            // resumes the awaiter without growing the stack
+            struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> done) noexcept {
+                    std::coroutine_handle<> next = done.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+                void await_resume() const noexcept {}
+            };
+
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+            void return_value(T result) { value.emplace(std::move(result)); }
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> coroutine;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) : coroutine(handle) {}
+
+    public:
+        Task(Task&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+        Task& operator=(Task&& other) noexcept {
+            if (this != &other) {
+                if (coroutine) coroutine.destroy();
+                coroutine = std::exchange(other.coroutine, nullptr);
+            }
+            return *this;
+        }
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+        ~Task() {
+            if (coroutine) coroutine.destroy();
+        }
+
+        // co_await runs the task and gives its result, or rethrows what it threw
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+            coroutine.promise().continuation = awaiter;
+            return coroutine;
+        }
+        T await_resume() {
+            if (coroutine.promise().error) {
+                std::rethrow_exception(coroutine.promise().error);
+            }
+            return std::move(*coroutine.promise().value);
+        }
+};
+
+// coroutine that starts at once and frees itself when it finishes, used to drive tasks
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); } // drivers catch everything
+    };
+};
+
+// counts finished tasks and resumes the waiting coroutine after the last one
+class TaskLatch {
+    private:
+        std::atomic<std::size_t> remaining; // tasks still running, plus one for the waiter
+        std::coroutine_handle<> waiter;
+        std::mutex errorLock;
+        std::exception_ptr error; // first failure
+
+    public:
+        explicit TaskLatch(std::size_t count) : remaining(count + 1) {}
+
+        void fail(std::exception_ptr failure) {
+            std::lock_guard<std::mutex> guard(errorLock);
+            if (!error) error = failure;
+        }
+        void arrive() { // the latch may be gone once this returns
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) waiter.resume();
+        }
+        std::exception_ptr getError() const { return error; }
+
+        // co_await suspends until every task arrived
+        bool await_ready() const noexcept { return remaining.load(std::memory_order_acquire) == 1; }
+        bool await_suspend(std::coroutine_handle<> handle) noexcept {
+            waiter = handle;
+            return remaining.fetch_sub(1, std::memory_order_acq_rel) != 1; // the tasks finished meanwhile, carry on
+        }
+        void await_resume() const noexcept {}
+};
+
+// run one task into its slot and check in with the latch
+template <typename T>
+DetachedTask driveTask(Task<T> task, T& slot, TaskLatch& latch) {
+    try {
+        slot = co_await task;
+    } catch (...) {
+        latch.fail(std::current_exception());
+    }
+    latch.arrive();
+}
+
+// run every task concurrently, results in the same order; rethrows the first failure once all are done
+template <typename T>
+Task<std::vector<T>> whenAll(std::vector<Task<T>> tasks) {
+    std::vector<T> results(tasks.size());
+    TaskLatch latch(tasks.size());
+    for (std::size_t i = 0; i < tasks.size(); ++i) {
+        driveTask(std::move(tasks[i]), results[i], latch);
+    }
+    co_await latch;
+    if (latch.getError()) {
+        std::rethrow_exception(latch.getError());
+    }
+    co_return std::move(results);
+}
+
+// block the calling thread until a task finishes, for code outside coroutines
+template <typename T>
+T syncWait(Task<T> task) {
+    struct State {
+        std::mutex lock;
+        std::condition_variable finished;
+        bool done = false;
+        std::optional<T> value;
+        std::exception_ptr error;
+    } state;
+    [](Task<T> work, State& waiting) -> DetachedTask {
+        std::optional<T> value;
+        std::exception_ptr error;
+        try {
+            value.emplace(co_await work);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> guard(waiting.lock); // the waiter cannot return before this unlocks
+        waiting.value = std::move(value);
+        waiting.error = error;
+        waiting.done = true;
+        waiting.finished.notify_one();
+    }(std::move(task), state);
+    std::unique_lock<std::mutex> guard(state.lock);
+    state.finished.wait(guard, [&state] { return state.done; });
+    if (state.error) {
+        std::rethrow_exception(state.error);
+    }
+    return std::move(*state.value);
+}
+
+#endif // task_hpp
@@ -0,0 +1,90 @@
+#ifndef thread_pool_hpp
+#define thread_pool_hpp
+
+// includes
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// work-stealing executor: every worker has its own deque, takes its newest task first and, when
+// its deque is empty, steals the oldest task of another worker
+//
+// Work for a device shard can be queued on a preferred worker (shard % workers) so the same
+// devices tend to stay in the same cache; an idle worker still steals it. parallelFor lets the
+// calling thread work through the chunks too, so it never waits on a busy pool and may be called
+// from inside a task. shutdown() runs what is queued, then joins the workers.
+class WorkStealingPool {
+    private:
+        // one worker's queue, guarded by its own lock so owners and thieves rarely meet
+        struct Worker {
+            std::mutex lock;
+            std::deque<std::function<void()>> tasks; // owner pops the back, thieves take the front
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<std::size_t> queued; // tasks in all deques
+        std::atomic<std::size_t> sleepers; // workers waiting for work
+        std::atomic<std::size_t> nextWorker; // round robin for tasks without affinity
+        std::atomic<bool> stopping; // no new tasks, workers exit once the deques are empty
+        std::mutex sleepMutex;
+        std::condition_variable workAvailable;
+        std::atomic<std::uint64_t> executedCount;
+        std::atomic<std::uint64_t> stolenCount;
+
+        void run(std::size_t index); // worker loop
+        bool takeTask(std::size_t index, std::function<void()>& task); // own deque first, then steal
+        void push(std::size_t index, std::function<void()> task); // queue on a worker and wake one sleeper
+
+        // wrap a callable so its result or exception reaches a future
+        template <typename F>
+        auto enqueue(std::size_t index, F&& work) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+            using Result = std::invoke_result_t<std::decay_t<F>>;
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(work));
+            std::future<Result> result = task->get_future();
+            push(index, [task] { (*task)(); });
+            return result;
+        }
+
+    public:
+        explicit WorkStealingPool(std::size_t threads = 0); // 0 for one worker per hardware thread
+        ~WorkStealingPool(); // shutdown()
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        // tasks, both throw runtime_error after shutdown
+        template <typename F>
+        auto submit(F&& work) { // on the next worker in turn
+            return enqueue(nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size(), std::forward<F>(work));
+        }
+        template <typename F>
+        auto submitTo(std::size_t affinity, F&& work) { // preferably on worker affinity % workers
+            return enqueue(affinity % workers.size(), std::forward<F>(work));
+        }
+
+        // body(begin, end) over [0, count) in chunks of grain, chunk i queued on worker i % workers;
+        // returns when every chunk has run and rethrows the first exception a chunk threw
+        void parallelFor(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body);
+
+        void shutdown(); // run the queued tasks, join the workers; later tasks are rejected
+
+        // state
+        std::size_t getWorkerCount() const { return workers.size(); }
+        std::uint64_t getExecutedCount() const { return executedCount.load(std::memory_order_relaxed); }
+        std::uint64_t getStolenCount() const { return stolenCount.load(std::memory_order_relaxed); } // tasks run by another worker
+        static int currentWorker(); // index of the calling pool thread, -1 elsewhere
+};
+
+#endif // thread_pool_hpp
@@ -0,0 +1,77 @@
+#ifndef timer_wheel_hpp
+#define timer_wheel_hpp
+
+// includes
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// handle returned by TimerWheel::schedule, stays unique after the timer is gone
+using TimerId = std::uint64_t;
+
+// hierarchical timer wheel: four levels of 256 slots each, O(1) schedule and cancel
+class TimerWheel {
+    private:
+        static const int levelBits = 8; // slots per level = 2^levelBits
+        static const int slotsPerLevel = 1 << levelBits;
+        static const int levelCount = 4; // covers 2^32 ticks, later timers wait in the overflow list
+        static const std::uint32_t none = 0xFFFFFFFFu; // end of list
+
+        // list heads past the wheel slots
+        static const std::uint32_t overflowList = levelCount * slotsPerLevel;
+        static const std::uint32_t firingList = overflowList + 1;
+        static const std::uint32_t listCount = firingList + 1;
+
+        // where a node currently is when it is not in a list
+        static const std::uint32_t freeNode = 0xFFFFFFFFu; // on the free list
+        static const std::uint32_t runningNode = 0xFFFFFFFEu; // callback executing
+        static const std::uint32_t cancelledNode = 0xFFFFFFFDu; // cancelled while its callback ran
+
+        // pooled timer, linked into exactly one slot list
+        struct Node {
+            std::uint64_t expiry; // tick the timer fires at
+            std::uint64_t period; // re-arm interval, 0 for one-shot timers
+            std::uint32_t prev; // previous node in the list
+            std::uint32_t next; // next node in the list
+            std::uint32_t list; // list the node is in, or one of the states above
+            std::uint32_t generation; // bumped on reuse so stale ids are rejected
+            std::function<void()> callback; // action to run
+        };
+
+        std::deque<Node> nodes; // node pool, deque keeps addresses stable while callbacks schedule more timers
+        std::uint32_t freeHead; // first free node
+        std::array<std::uint32_t, listCount> heads; // first node of every list
+        std::array<std::uint64_t, slotsPerLevel / 64> levelZeroOccupied; // bitmap of non-empty level-0 slots
+        std::uint64_t current; // next tick to process, every earlier timer has fired
+        std::size_t pending; // timers waiting to fire
+
+        std::uint32_t allocateNode(); // take a node from the pool
+        void releaseNode(std::uint32_t index); // return a node to the pool
+        void link(std::uint32_t index); // file a node under the slot for its expiry
+        void pushFront(std::uint32_t list, std::uint32_t index); // add a node to a list
+        void unlink(std::uint32_t index); // remove a node from its list
+        void cascade(int level); // spread the current slot of a level over the levels below
+        std::size_t runTick(std::uint64_t tick); // fire every timer due at a tick, returns how many fired
+        std::uint64_t nextBusyTick(std::uint64_t limit) const; // next level-0 tick with timers, or limit
+        bool levelZeroEmpty() const; // no timer due within the current block
+        std::uint64_t nextCascadeTick(std::uint64_t limit) const; // next block boundary with timers to cascade, or past limit
+
+    public:
+        TimerWheel(std::uint64_t startTick = 0); // wheel starting at the given tick
+
+        // run the callback once after delayTicks, or every periodTicks after that when periodTicks > 0
+        TimerId schedule(std::uint64_t delayTicks, std::function<void()> callback, std::uint64_t periodTicks = 0);
+        bool cancel(TimerId id); // stop a pending timer, false if it already fired or was cancelled
+        bool isPending(TimerId id) const; // has the timer still to fire?
+
+        std::size_t advanceTo(std::uint64_t tick); // fire every timer due up to and including tick, returns how many fired
+
+        // getters
+        std::uint64_t now() const; // last processed tick
+        std::size_t getPendingCount() const; // timers waiting to fire
+};
+
+#endif // timer_wheel_hpp
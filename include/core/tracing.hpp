@@ -0,0 +1,113 @@
+#ifndef tracing_hpp
+#define tracing_hpp
+
+// includes
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// one finished span, a Chrome "complete" event
+struct TraceEvent {
+    const char* name; // string literal, e.g. "RoomController::turnAllDevicesOn"
+    const char* category; // string literal, e.g. "room"
+    std::string detail; // optional argument, e.g. the device ID
+    std::uint64_t startNanos; // since the tracer's epoch
+    std::uint64_t durationNanos;
+};
+
+// events recorded by one thread, the lock is only contended while a dump runs
+struct TraceThreadBuffer {
+    std::mutex lock;
+    std::vector<TraceEvent> events;
+    std::string threadName;
+    std::uint32_t threadIndex; // tid in the trace
+    std::uint64_t dropped; // events past the per-thread cap
+};
+
+// scoped spans written as Chrome trace-event JSON (chrome://tracing, Perfetto)
+//
+// Off by default. A disabled span costs one relaxed load and a branch. While enabled, each thread
+// appends finished spans to its own buffer, capped at maxEventsPerThread. stop() keeps the events
+// until they are written or cleared.
+class Tracer {
+    private:
+        static std::atomic<bool> enabled; // checked by every span
+
+        mutable std::mutex registryMutex; // guards the buffer list
+        std::vector<std::unique_ptr<TraceThreadBuffer>> buffers; // one per thread that recorded, kept after exit
+        std::chrono::steady_clock::time_point epoch; // ts 0 in the trace
+
+        Tracer();
+        TraceThreadBuffer& localBuffer(); // the calling thread's buffer
+
+    public:
+        static const std::size_t maxEventsPerThread = 1 << 20;
+
+        static Tracer* getInstance();
+
+        // runtime switch
+        void start(); // clears earlier events and starts recording
+        void stop();
+        static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+        // recording
+        void record(const char* name, const char* category, std::string detail,
+                    std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+        void setThreadName(const std::string& name); // shown as the thread's row title in the viewer
+
+        // output
+        std::size_t getEventCount() const;
+        void clear();
+        void writeChromeTrace(std::ostream& out) const; // {"traceEvents": [...]}
+        bool writeChromeTraceFile(const std::string& path) const; // false if the file cannot be written
+};
+
+// times its scope as one span while tracing is enabled
+class TraceSpan {
+    private:
+        const char* name;
+        const char* category;
+        std::string detail;
+        std::chrono::steady_clock::time_point begin;
+        bool active;
+
+    public:
+        TraceSpan(const char* spanName, const char* spanCategory)
+            : name(spanName)
+            , category(spanCategory)
+            , active(Tracer::isEnabled())
+        {
+            if (active) {
+                begin = std::chrono::steady_clock::now();
+            }
+        }
+
+        // the detail is only copied while tracing
+        TraceSpan(const char* spanName, const char* spanCategory, const std::string& spanDetail)
+            : TraceSpan(spanName, spanCategory)
+        {
+            if (active) {
+                detail = spanDetail;
+            }
+        }
+
+        ~TraceSpan() {
+            if (active) {
+                Tracer::getInstance()->record(name, category, std::move(detail), begin, std::chrono::steady_clock::now());
+            }
+        }
+
+        bool isActive() const { return active; }
+        void setDetail(const std::string& spanDetail) { if (active) detail = spanDetail; } // e.g. a result known at the end
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+#endif // tracing_hpp
@@ -0,0 +1,39 @@
+#ifndef async_device_hpp
+#define async_device_hpp
+
+// includes
+#include <memory>
+#include <mutex>
+#include <string>
+#include "core/task.hpp"
+#include "devices/device.hpp"
+#include "devices/device_command.hpp"
+#include "devices/device_transport.hpp"
+
+// Awaitable device commands. Each one sends the command over the transport and suspends until the
+// device answers, then applies it to the device and gives the result: the same DeviceResult as
+// Device::applyCommand, or Timeout when every attempt was lost. Resumption happens on a transport
+// worker thread, so callers sharing devices with other threads pass the mutex that guards them.
+
+// send any command, the building block of the rest
+Task<DeviceResult> applyCommandAsync(DeviceTransport& transport, std::shared_ptr<Device> device, DeviceCommand command,
+                                     std::mutex* deviceMutex = nullptr);
+
+// every device
+Task<DeviceResult> turnOnAsync(DeviceTransport& transport, std::shared_ptr<Device> device);
+Task<DeviceResult> turnOffAsync(DeviceTransport& transport, std::shared_ptr<Device> device);
+
+// lights
+Task<DeviceResult> setBrightnessAsync(DeviceTransport& transport, std::shared_ptr<Device> device, int level);
+Task<DeviceResult> setColorAsync(DeviceTransport& transport, std::shared_ptr<Device> device, const std::string& color);
+
+// thermostats
+Task<DeviceResult> setTemperatureAsync(DeviceTransport& transport, std::shared_ptr<Device> device, float temperature);
+Task<DeviceResult> setDesiredTemperatureAsync(DeviceTransport& transport, std::shared_ptr<Device> device, float temperature);
+Task<DeviceResult> setModeAsync(DeviceTransport& transport, std::shared_ptr<Device> device, const std::string& mode);
+
+// cameras
+Task<DeviceResult> startRecordingAsync(DeviceTransport& transport, std::shared_ptr<Device> device);
+Task<DeviceResult> stopRecordingAsync(DeviceTransport& transport, std::shared_ptr<Device> device);
+
+#endif // async_device_hpp
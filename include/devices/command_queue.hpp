@@ -0,0 +1,46 @@
+#ifndef command_queue_hpp
+#define command_queue_hpp
+
+// includes
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "devices/device.hpp"
+#include "devices/device_command.hpp"
+
+// pending commands for one device, applied together by flush()
+//
+// Brightness, color, temperature, setpoint and rotation writes are last-writer-wins: a valid write
+// replaces the pending write of the same kind in place, so a slider drag reaches the device as one
+// command. Every other command (power, recording, mode, resolution, motion detection) is applied in
+// order and separates writes before it from writes after it, so the device ends in the state the
+// commands would have left one by one. A write the device would reject replaces nothing and is
+// applied in turn to report its error.
+class DeviceCommandQueue {
+    private:
+        std::vector<DeviceCommand> pending; // in arrival order, superseded writes already removed
+        std::size_t segmentStart; // first command after the last ordered command
+        std::uint64_t queuedCount; // commands pushed
+        std::uint64_t coalescedCount; // writes replaced by a later one
+        std::uint64_t appliedCount; // commands applied by flush
+
+    public:
+        DeviceCommandQueue();
+
+        static bool isCoalescable(CommandType type); // last-writer-wins writes
+
+        // queue
+        bool push(const Device& device, const DeviceCommand& command); // true if it replaced a pending write
+        std::size_t flush(Device& device, std::vector<DeviceResult>* results = nullptr); // apply in order, returns succeeded
+        void clear(); // drop the pending commands
+
+        // state
+        std::size_t size() const { return pending.size(); }
+        bool empty() const { return pending.empty(); }
+        const std::vector<DeviceCommand>& getPending() const { return pending; }
+        std::uint64_t getQueuedCount() const { return queuedCount; }
+        std::uint64_t getCoalescedCount() const { return coalescedCount; }
+        std::uint64_t getAppliedCount() const { return appliedCount; }
+};
+
+#endif // command_queue_hpp
@@ -5,26 +5,64 @@
 // include libraries
 #include <string>
 #include <iostream>
+#include "devices/device_command.hpp"
+#include "core/metrics.hpp"
 
 // using namespace
 using namespace std;
 
+class Device;
+class EnergyMonitor;
+class StringPool;
+
+// kinds of device state change reported to observers
+enum class DeviceChange {
+    Power, // turned on or off
+    Brightness, // light brightness
+    Color, // light color
+    Temperature, // measured temperature
+    DesiredTemperature, // thermostat setpoint
+    Mode, // thermostat mode
+    Recording, // camera recording started or stopped
+    Resolution, // camera resolution
+    Rotation, // camera rotation
+    MotionDetection, // camera motion detection enabled or disabled
+    Motion, // camera saw motion
+    Name, // device renamed
+    Location // device moved to another location
+};
+
+// smart_home_device_changes_total, one counter per DeviceChange
+extern const Counter deviceChangeCounters[];
+
+// receives device state changes, e.g. the home controller feeding automation rules
+class DeviceObserver {
+    public:
+        virtual ~DeviceObserver() = default;
+        virtual void onDeviceChanged(Device& device, DeviceChange change) = 0; // called after the change
+};
+
 // Device class
 class Device {
 
     protected: // protected members are accessible within the class and its derived classes
 
         string deviceID; // unique identifier for the device
-        string deviceName; // name of the device
-        string deviceLocation; // location of the device
+        string deviceName; // name of the device, owned: names are mostly unique, so a pool entry would cost more than the string
+        const string* deviceLocation; // location of the device, interned since many devices share one
+        StringPool* locationPool; // holds deviceLocation, null for the process default
         bool isOn; // flag to indicate if the device is on or off
+        bool metered; // power readings are reported, off while a layout restores the device's state
         double powerConsumption; // power consumption of the device
+        DeviceObserver* observer; // notified of state changes, may be null
+        EnergyMonitor* energyMonitor; // receives power readings, null for the process default
 
     
     public: // public members are accessible from outside the class
 
         Device(); // default constructor
-        Device(const string& id, const string& name, const string& location); // parameterized constructor
+        Device(const string& id, const string& name, const string& location,
+               StringPool* pool = nullptr); // parameterized constructor, the location interned in pool
 
         // virtual destructor important for inheritance
         virtual ~Device() = default; 
@@ -36,20 +74,37 @@ class Device {
         virtual string getDeviceStatus() const = 0; // get the status of the device
 
         // getters for device properties and status
-        string getDeviceID() const; // get the device ID
-        string getDeviceName() const; // get the device name
-        string getDeviceLocation() const; // get the device location
+        const string& getDeviceID() const; // get the device ID
+        const string& getDeviceName() const; // get the device name
+        const string& getDeviceLocation() const; // get the device location, equal locations share one string
         bool getIsOn() const; // get the isOn flag
+        virtual size_t getMemoryUsage() const = 0; // bytes of the object and the buffers it owns, shared strings excluded
 
         // setters for device properties and status
         void setDeviceLocation(const string& newLocation); // set the device location
         void setDeviceName(const string& newName); // set the device name
+        void setObserver(DeviceObserver* newObserver); // set or clear the state change observer
+        void setEnergyMonitor(EnergyMonitor* monitor); // the home's monitor, null for the process default
+        void setStringPool(StringPool* pool); // the home's pool, null for the process default; the location moves there
+        void setMetered(bool report); // false drops power readings until set again
+
+        // non-throwing command entry point for bulk and batch callers
+        virtual DeviceResult applyCommand(const DeviceCommand& command); // turn on/off here, the rest in derived classes
+        virtual DeviceResult checkCommand(const DeviceCommand& command) const; // applyCommand's verdict on the argument alone, no state read or changed
 
     // protected methods for derived classes
     protected:
         // set the device status
         void setIsOn(bool status);
         void setPowerConsumption(double power);
+        EnergyMonitor& energy() const; // where power readings go
+        void reportUsage(double watts); // a power reading to energy(), unless unmetered
+        size_t stringMemoryUsage() const; // heap bytes of the ID and name
+        // count a state change and tell the observer about it
+        void notifyChange(DeviceChange change) {
+            deviceChangeCounters[static_cast<size_t>(change)].increment();
+            if (observer) observer->onDeviceChanged(*this, change);
+        }
 
         
 };
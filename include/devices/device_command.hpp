@@ -0,0 +1,58 @@
+#ifndef device_command_hpp
+#define device_command_hpp
+
+// includes
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// outcome of a device mutation on the non-throwing API
+enum class [[nodiscard]] DeviceResult : std::uint8_t {
+    Ok,
+    InvalidBrightness, // outside 0-100
+    InvalidColor, // not a name, #RRGGBB or temperature
+    InvalidTemperature, // outside 0-50C
+    InvalidMode, // not heating, cooling or auto
+    InvalidResolution, // not 720p, 1080p or 4K
+    InvalidRotation, // outside 0-360 degrees
+    DeviceOff, // the device must be on for this command
+    NotSupported, // the device type has no such command
+    UnknownDevice, // no device with that ID
+    Timeout // the device did not answer over the transport
+};
+
+// message for a result, the same text the throwing setters use
+const char* describeResult(DeviceResult result);
+
+// device mutations that can be queued, batched or sent from scripts
+enum class CommandType : std::uint8_t {
+    TurnOn,
+    TurnOff,
+    SetBrightness, // value: 0-100
+    SetColor, // text: color name, #RRGGBB or temperature
+    SetTemperature, // value: measured temperature
+    SetDesiredTemperature, // value: setpoint
+    SetMode, // text: heating, cooling or auto
+    StartRecording,
+    StopRecording,
+    SetResolution, // text: 720p, 1080p or 4K
+    SetRotation, // value: degrees
+    EnableMotionDetection,
+    DisableMotionDetection
+};
+
+// one command for one device
+struct DeviceCommand {
+    CommandType type; // what to do
+    float value; // numeric argument
+    std::string text; // text argument
+};
+
+// command from its text form, as sent to the command server: a verb and the rest of the line
+//   on | off | brightness <0-100> | color <color> | temperature <C> | setpoint <C> | mode <mode>
+//   record | stop | resolution <res> | rotation <degrees> | motion on|off
+// false for an unknown verb, a missing or malformed number, or an argument where none is taken
+bool parseDeviceCommand(std::string_view verb, std::string_view argument, DeviceCommand& command);
+std::string formatDeviceCommand(const DeviceCommand& command); // the text parseDeviceCommand reads, e.g. "brightness 40"
+
+#endif // device_command_hpp
@@ -0,0 +1,117 @@
+#ifndef device_telemetry_hpp
+#define device_telemetry_hpp
+
+// includes
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "devices/device.hpp"
+#include "devices/light_color.hpp"
+
+// Binary device state, version 1. Every field is little-endian and read with byte copies, so a
+// record can sit at any offset of a received buffer.
+//
+// record:  0 version  1 type  2 flags  3 ID length  4 record size (u16)  6 reserved (u16)
+//          8 power usage in watts (f32)  12 device ID  then the type's fields, offsets from there:
+//   light:       0 brightness  1 red  2 green  3 blue  4 white temperature / 100  (8 bytes)
+//   thermostat:  0 temperature (f32)  4 desired (f32)  8 control output (f32)  12 mode  (16 bytes)
+//   camera:      0 motion events (u64)  8 rotation (u16)  10 resolution  (12 bytes)
+// batch:   0 "SHTB"  4 version  5-7 reserved  8 record count (u32)  12 record bytes (u32)  then records
+//
+// A reader still gets the ID and power of a record whose type it does not know, and steps over the
+// rest by the record size. A new version may change the layout, so readers reject other versions.
+const std::uint8_t telemetryVersion = 1;
+
+// what a record describes
+enum class TelemetryDeviceType : std::uint8_t {
+    Unknown = 0, // power and ID only
+    Light = 1,
+    Thermostat = 2,
+    Camera = 3
+};
+
+// record flags
+enum TelemetryFlag : std::uint8_t {
+    TelemetryOn = 1, // device is on
+    TelemetryRecording = 2, // camera is recording
+    TelemetryMotionDetection = 4, // camera motion detection is enabled
+    TelemetryClosedLoop = 8 // thermostat output comes from the control loop
+};
+
+// append one device's full state, throws invalid_argument if its ID is longer than 255 bytes
+std::size_t encodeTelemetry(const Device& device, std::vector<std::uint8_t>& out); // returns bytes written
+
+// read-only view of one encoded record, valid while the buffer it points into is
+class TelemetryRecord {
+    private:
+        const std::uint8_t* data; // first byte of the record
+
+        const std::uint8_t* fields() const { return data + 12 + data[3]; } // after the device ID
+
+    public:
+        TelemetryRecord() : data(nullptr) {}
+
+        // decoding without copying, checks the version, the sizes and that the type's fields are present
+        static bool tryDecode(const std::uint8_t* bytes, std::size_t length, TelemetryRecord& record); // false if malformed
+        static TelemetryRecord decode(const std::uint8_t* bytes, std::size_t length); // throws invalid_argument if malformed
+
+        // every device
+        std::uint8_t getVersion() const { return data[0]; }
+        TelemetryDeviceType getType() const; // Unknown for types this reader does not know
+        std::size_t getSize() const; // bytes in the record
+        std::string_view getDeviceID() const;
+        bool getIsOn() const { return (data[2] & TelemetryOn) != 0; }
+        float getPowerUsage() const;
+
+        // lights
+        int getBrightness() const { return fields()[0]; }
+        LightColor getColor() const { return LightColor(fields()[1], fields()[2], fields()[3], fields()[4]); }
+
+        // thermostats
+        float getTemperature() const;
+        float getDesiredTemperature() const;
+        float getControlOutput() const;
+        const char* getMode() const; // heating, cooling or auto
+        bool isClosedLoop() const { return (data[2] & TelemetryClosedLoop) != 0; }
+
+        // cameras
+        bool getIsRecording() const { return (data[2] & TelemetryRecording) != 0; }
+        bool getMotionDetection() const { return (data[2] & TelemetryMotionDetection) != 0; }
+        std::uint64_t getMotionEventCount() const;
+        int getRotation() const;
+        const char* getResolution() const; // 720p, 1080p or 4K
+};
+
+// many records behind one header, built up in a reusable buffer
+class TelemetryBatchWriter {
+    private:
+        std::vector<std::uint8_t> buffer; // header, then records
+        std::uint32_t recordCount;
+
+    public:
+        explicit TelemetryBatchWriter(std::size_t reserveBytes = 0);
+
+        void add(const Device& device); // append the device's state
+        void clear(); // drop the records, keep the memory
+        const std::vector<std::uint8_t>& finish(); // fill in the header, returns the encoded batch
+        std::uint32_t getRecordCount() const { return recordCount; }
+};
+
+// iterates the records of an encoded batch without copying them
+class TelemetryBatchReader {
+    private:
+        const std::uint8_t* data; // first byte of the batch
+        std::size_t end; // one past the last record
+        std::size_t offset; // next record
+        std::uint32_t recordCount;
+        std::uint32_t recordsRead;
+
+    public:
+        TelemetryBatchReader(const std::uint8_t* bytes, std::size_t length); // throws invalid_argument on a bad header
+
+        bool next(TelemetryRecord& record); // false after the last record, throws invalid_argument on a malformed one
+        std::uint32_t getRecordCount() const { return recordCount; }
+};
+
+#endif // device_telemetry_hpp
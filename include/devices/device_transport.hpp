@@ -0,0 +1,86 @@
+#ifndef device_transport_hpp
+#define device_transport_hpp
+
+// includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "core/timer_wheel.hpp"
+
+// how the simulated link to the devices behaves
+struct TransportConfig {
+    std::uint32_t latencyMillis = 20; // request to reply
+    std::uint32_t jitterMillis = 0; // up to this much extra per request, uniformly spread
+    double lossRate = 0.0; // chance that a request or its reply is lost, 0-1
+    std::uint32_t timeoutMillis = 200; // how long a sender waits for a lost reply
+    std::uint32_t retries = 0; // times a command is resent after a timeout
+    std::size_t workers = 2; // threads resuming the coroutines whose replies arrived
+    std::uint32_t seed = 1; // loss and jitter are reproducible for a seed
+};
+
+// simulated network between the controller and its devices
+//
+// A coroutine that awaits exchange() is suspended until the reply's latency has passed, or the
+// timeout when the request is lost, and then resumed on one of the transport's worker threads.
+// Nothing is blocked while requests are in flight, so a few threads carry any number of them.
+// Replies are timed by a timer wheel in milliseconds. The transport must outlive every exchange.
+class DeviceTransport {
+    public:
+        // awaitable round trip, true if the device answered
+        class Exchange {
+            private:
+                DeviceTransport& transport;
+                bool answered;
+
+            public:
+                explicit Exchange(DeviceTransport& link) : transport(link), answered(false) {}
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> sender);
+                bool await_resume() const noexcept { return answered; }
+        };
+
+    private:
+        TransportConfig config;
+        std::mutex lock; // guards everything below
+        std::condition_variable timersChanged; // wakes the timer thread when the first timer arrives or on stop
+        std::condition_variable readyChanged; // wakes the workers
+        TimerWheel wheel; // reply arrivals, in milliseconds since start
+        std::deque<std::coroutine_handle<>> ready; // senders whose reply or timeout is due
+        std::mt19937 random;
+        std::chrono::steady_clock::time_point start;
+        bool running;
+        std::thread timerThread;
+        std::vector<std::thread> workers;
+        std::atomic<std::uint64_t> requestCount;
+        std::atomic<std::uint64_t> lostCount;
+        std::atomic<std::size_t> inFlight;
+
+        std::uint64_t nowMillis() const;
+        void runTimers(); // timer thread: move due senders to the ready queue
+        void runWorker(); // worker thread: resume ready senders
+        void send(bool& answered, std::coroutine_handle<> sender); // decide the outcome and schedule the resume
+
+    public:
+        explicit DeviceTransport(const TransportConfig& transportConfig = TransportConfig());
+        ~DeviceTransport(); // stops the threads, coroutines still waiting are never resumed
+        DeviceTransport(const DeviceTransport&) = delete;
+        DeviceTransport& operator=(const DeviceTransport&) = delete;
+
+        Exchange exchange() { return Exchange(*this); } // co_await for one request and its reply
+
+        // state
+        const TransportConfig& getConfig() const { return config; }
+        std::uint64_t getRequestCount() const { return requestCount.load(std::memory_order_relaxed); }
+        std::uint64_t getLostCount() const { return lostCount.load(std::memory_order_relaxed); }
+        std::size_t getInFlight() const { return inFlight.load(std::memory_order_relaxed); } // exchanges not yet resumed
+};
+
+#endif // device_transport_hpp
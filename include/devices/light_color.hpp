@@ -0,0 +1,57 @@
+#ifndef light_color_hpp
+#define light_color_hpp
+
+// includes
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// hue in degrees, saturation and value in 0-1
+struct HsvColor {
+    float hue; // 0-360
+    float saturation; // 0-1
+    float value; // 0-1
+};
+
+// light color packed into four bytes: red, green, blue and an optional white temperature
+class LightColor {
+    private:
+        std::uint8_t red; // red channel
+        std::uint8_t green; // green channel
+        std::uint8_t blue; // blue channel
+        std::uint8_t kelvinCode; // white temperature in hundreds of kelvin, 0 for plain RGB
+
+    public:
+        constexpr LightColor() : red(255), green(255), blue(255), kelvinCode(0) {} // white
+        constexpr LightColor(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t kelvinHundreds = 0)
+            : red(r), green(g), blue(b), kelvinCode(kelvinHundreds) {}
+
+        // conversions
+        static LightColor fromKelvin(int kelvin); // white of a color temperature (1000-25500 K)
+        static LightColor fromHsv(const HsvColor& hsv); // RGB from hue, saturation and value
+        static LightColor parse(const std::string& text); // name, #RRGGBB or 2700K, throws on bad input
+        static bool tryParse(const std::string& text, LightColor& result); // non-throwing parse
+        HsvColor toHsv() const; // hue, saturation and value
+        std::string toString() const; // name when one matches, otherwise #RRGGBB or the temperature
+        const char* name() const; // table name of this color, nullptr if it has none
+
+        // transitions
+        static LightColor interpolate(const LightColor& from, const LightColor& to, double progress); // blend, progress 0-1
+
+        // getters
+        constexpr std::uint8_t getRed() const { return red; }
+        constexpr std::uint8_t getGreen() const { return green; }
+        constexpr std::uint8_t getBlue() const { return blue; }
+        constexpr int getKelvin() const { return kelvinCode * 100; } // 0 when not a white temperature
+        constexpr std::uint32_t toRgb() const { return (std::uint32_t(red) << 16) | (std::uint32_t(green) << 8) | blue; }
+
+        // operator overloading
+        constexpr bool operator==(const LightColor& other) const {
+            return red == other.red && green == other.green && blue == other.blue && kelvinCode == other.kelvinCode;
+        }
+        constexpr bool operator!=(const LightColor& other) const { return !(*this == other); }
+};
+
+std::ostream& operator<<(std::ostream& os, const LightColor& color);
+
+#endif // light_color_hpp
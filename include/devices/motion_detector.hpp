@@ -0,0 +1,52 @@
+#ifndef motion_detector_hpp
+#define motion_detector_hpp
+
+// includes
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "devices/video_frame.hpp"
+
+// emitted when a camera sees motion in a frame
+struct MotionEvent {
+    std::string cameraID; // camera that saw the motion
+    std::uint64_t frameNumber; // frame the motion was detected in
+    std::size_t changedPixels; // pixels that differed from the background
+    double changedRatio; // changed pixels as a fraction of the frame
+};
+
+// frame differencing against a running-average background model
+class MotionDetector {
+    private:
+        FrameSize size; // expected frame dimensions
+        std::vector<std::uint8_t> background; // background model
+        bool hasBackground; // has the first frame seeded the model?
+        std::uint8_t pixelThreshold; // per-pixel difference that counts as a change
+        double triggerRatio; // fraction of changed pixels that counts as motion
+        std::size_t lastChangedPixels; // changed pixels in the last frame
+
+    public:
+        MotionDetector(
+            FrameSize frameSize, // frame dimensions
+            std::uint8_t threshold = 25, // per-pixel difference threshold
+            double ratio = 0.005 // fraction of the frame that must change
+        );
+
+        // difference the frame against the background and blend it in, returns true on motion
+        bool processFrame(const GrayFrame& frame);
+        void reset(); // forget the background model
+
+        // getters
+        FrameSize getFrameSize() const; // expected frame dimensions
+        std::size_t getLastChangedPixels() const; // changed pixels in the last frame
+        double getLastChangedRatio() const; // changed fraction of the last frame
+        std::size_t getMemoryUsage() const; // bytes of the detector and its background model
+};
+
+// count pixels differing from the background by more than the threshold and
+// move the background a quarter of the way towards the frame
+std::size_t diffAndUpdateBackground(const std::uint8_t* frame, std::uint8_t* background,
+                                    std::size_t count, std::uint8_t threshold);
+
+#endif // motion_detector_hpp
@@ -0,0 +1,129 @@
+#ifndef recording_buffer_hpp
+#define recording_buffer_hpp
+
+// includes
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "devices/video_frame.hpp"
+
+// memory limits for a camera's pre-roll buffer
+struct RecordingBufferConfig {
+    std::size_t capacityBytes = 16u << 20; // most memory the ring may hold
+    std::size_t chunkBytes = 1u << 20; // allocation unit, frames never straddle chunks
+    std::uint64_t preRollMicros = 5000000; // how far back a new recording reaches
+};
+
+// block of encoded frame bytes, shared between the ring and any clips still being written
+struct RecordingChunk {
+    std::unique_ptr<std::uint8_t[]> bytes; // frame storage
+    std::size_t capacity; // size of the allocation
+    std::size_t used; // bytes filled so far
+};
+
+// contiguous run of frames inside one chunk
+struct ClipSegment {
+    std::shared_ptr<const RecordingChunk> chunk; // keeps the bytes alive until written
+    std::size_t offset; // start of the run in the chunk
+    std::size_t length; // bytes in the run
+
+    const std::uint8_t* data() const { return chunk->bytes.get() + offset; }
+};
+
+// frames handed off from the ring without copying
+struct RecordingClip {
+    std::vector<ClipSegment> segments; // runs in playback order
+    std::uint64_t firstSequence = 0; // sequence number of the first frame
+    std::size_t frameCount = 0; // frames in the clip
+    std::size_t byteCount = 0; // total payload bytes
+
+    bool empty() const { return frameCount == 0; }
+};
+
+// ring of the last few seconds of encoded frames
+class RecordingBuffer {
+    private:
+        // where a frame lives inside the ring
+        struct FrameRecord {
+            std::uint64_t chunkSequence; // chunk holding the frame
+            std::size_t offset; // start of the frame in the chunk
+            std::size_t size; // frame bytes
+            std::uint64_t timestampMicros; // capture time
+            bool keyFrame; // can playback start here?
+        };
+
+        RecordingBufferConfig config; // memory limits
+        std::size_t ringBytes; // bytes allocated by chunks in the ring
+        std::deque<std::shared_ptr<RecordingChunk>> chunks; // oldest chunk first
+        std::uint64_t firstChunkSequence; // sequence of chunks.front()
+        std::deque<FrameRecord> frames; // oldest frame first
+        std::uint64_t firstFrameSequence; // sequence of frames.front()
+        std::vector<std::shared_ptr<RecordingChunk>> freeChunks; // evicted chunks no clip refers to
+        std::uint64_t evictedFrames; // frames pushed out of the ring
+
+        void startChunk(std::size_t minimumBytes); // reuse or allocate the next chunk
+        void evictOldestChunk(); // drop the oldest chunk and its frames
+
+    public:
+        explicit RecordingBuffer(const RecordingBufferConfig& bufferConfig = RecordingBufferConfig());
+
+        // copy an encoded frame into the ring, evicting the oldest frames when full
+        void appendFrame(const std::uint8_t* data, std::size_t size, std::uint64_t timestampMicros, bool keyFrame);
+
+        // sequence of the key frame that covers the pre-roll window
+        std::uint64_t getPreRollStart() const;
+        // frames from the pre-roll start up to the newest frame
+        RecordingClip extractPreRoll() const;
+        // frames with sequence numbers in [fromSequence, toSequence)
+        RecordingClip extractRange(std::uint64_t fromSequence, std::uint64_t toSequence) const;
+
+        // getters
+        std::uint64_t getNextSequence() const; // sequence the next frame will get
+        std::uint64_t getOldestSequence() const; // oldest frame still buffered
+        std::size_t getFrameCount() const; // frames in the ring
+        std::size_t getMemoryUsage() const; // bytes allocated by the ring and its free list
+        std::uint64_t getEvictedFrames() const; // frames lost to the capacity limit
+        const RecordingBufferConfig& getConfig() const; // memory limits
+};
+
+// stand-in for the camera encoder: group-of-pictures sized frames at a fixed rate
+class SyntheticVideoEncoder {
+    private:
+        std::vector<std::uint8_t> payload; // reused frame bytes
+        std::size_t keyFrameBytes; // size of a key frame
+        std::size_t deltaFrameBytes; // size of a delta frame
+        int framesPerSecond; // capture rate
+        int gopLength; // frames between key frames
+        std::uint64_t frameCount; // frames encoded so far
+
+    public:
+        SyntheticVideoEncoder(FrameSize frameSize, int fps = 30, int gop = 30);
+
+        std::size_t encodeNext(); // encode the next frame, returns its size
+        const std::uint8_t* data() const; // bytes of the last frame
+        bool isKeyFrame() const; // was the last frame a key frame?
+        std::uint64_t getTimestampMicros() const; // capture time of the last frame
+};
+
+// appends clips to a file straight from the ring chunks
+class ClipWriter {
+    private:
+        int fd; // output file descriptor
+        std::string path; // output file
+        std::uint64_t bytesWritten; // payload written so far
+
+    public:
+        explicit ClipWriter(const std::string& filePath); // create or truncate the file
+        ~ClipWriter();
+        ClipWriter(const ClipWriter&) = delete;
+        ClipWriter& operator=(const ClipWriter&) = delete;
+
+        void write(const RecordingClip& clip); // gather-write every segment
+        std::uint64_t getBytesWritten() const; // payload written so far
+        const std::string& getPath() const; // output file
+};
+
+#endif // recording_buffer_hpp
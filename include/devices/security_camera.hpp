@@ -3,7 +3,13 @@
 
 // includes
 #include "devices/device.hpp"
+#include "devices/motion_detector.hpp"
+#include "devices/recording_buffer.hpp"
+#include "devices/video_frame.hpp"
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <memory>
 
 using namespace std;
 
@@ -12,16 +18,27 @@ class SecurityCamera : public Device {
     private:
         // private members
         bool isRecording; // is the camera currently recording?
-        string resolution; // resolution of the camera (e.g. 1080p, 4K)
+        CameraResolution resolution; // resolution of the camera (e.g. 1080p, 4K)
         int angleRotation; // rotation of the camera (e.g. 90 degrees)
         bool motionDetection; // motion detection status
+        unique_ptr<MotionDetector> motionDetector; // background model, sized for the resolution
+        function<void(const MotionEvent&)> motionCallback; // called for every motion event
+        uint64_t motionEventCount; // motion events emitted so far
+        RecordingBufferConfig recordingConfig; // pre-roll buffer limits
+        unique_ptr<RecordingBuffer> recordingBuffer; // last few seconds of encoded frames
+        uint64_t recordingCursor; // next frame to hand off to the clip writer
+        uint64_t recordingEnd; // frame after the last one of a stopped recording
+        bool recordOnMotion; // start recording when motion is detected
+
+        void endRecording(); // clear isRecording, keeping the end of the clip for takeRecordedClip
 
     public:
         // constructor
         SecurityCamera(
             const string& id, // device id
             const string& name, // name of device
-            const string& location // location of device
+            const string& location, // location of device
+            StringPool* pool = nullptr // interns the location, null for the process default
         );
 
         // override virtual functions
@@ -29,18 +46,44 @@ class SecurityCamera : public Device {
         void turnOff() override; // turn off the camera
         double getPowerUsage() const override; // get power consumption of the camera
         string getDeviceStatus() const override; // get device status
+        static string formatStatus(const string& id, bool on, bool recording, CameraResolution resolution, // getDeviceStatus() of given state
+                                   int rotation, bool motionDetection);
+        size_t getMemoryUsage() const override; // object, motion detector and pre-roll buffer
 
         // camera specific functions
         void startRecording(); // start recording
         void stopRecording(); // stop recording
         void setResolution(const string& res); // set resolution of the camera
+        void setResolution(CameraResolution res); // set resolution without parsing
         void setRotation(int angle); // set angle of the camera
         void enableMotionDetection(); // enable motion detection
         void disableMotionDetection(); // disable motion detection
 
+        // non-throwing versions, invalid input is returned instead of thrown and logged
+        DeviceResult tryStartRecording(); // DeviceOff unless the camera is on
+        DeviceResult trySetResolution(const string& res); // InvalidResolution unless 720p, 1080p or 4K
+        DeviceResult trySetRotation(int angle); // InvalidRotation outside 0-360
+        DeviceResult tryEnableMotionDetection(); // DeviceOff unless the camera is on
+        DeviceResult applyCommand(const DeviceCommand& command) override; // recording, resolution, rotation and detection commands
+        DeviceResult checkCommand(const DeviceCommand& command) const override;
+
+        // motion pipeline
+        bool processFrame(const GrayFrame& frame); // run a frame through motion detection
+        void setMotionCallback(function<void(const MotionEvent&)> callback); // receive motion events
+        FrameSize getFrameSize() const; // frame size for the current resolution
+        uint64_t getMotionEventCount() const; // motion events emitted so far
+        void setRecordOnMotion(bool enabled); // start recording when motion fires
+
+        // pre-roll recording
+        void configureRecordingBuffer(const RecordingBufferConfig& config); // set buffer limits, drops buffered frames
+        void ingestEncodedFrame(const uint8_t* data, size_t size, uint64_t timestampMicros, bool keyFrame); // buffer an encoded frame
+        RecordingClip takeRecordedClip(); // recorded frames not yet handed off, pre-roll included
+        size_t getRecordingMemoryUsage() const; // bytes held by the pre-roll buffer
+
         // getters
         bool getIsRecording() const; // get recording status
         string getResolution() const; // get resolution of the camera
+        CameraResolution getCameraResolution() const; // get resolution without formatting it
         int getRotation() const; // get angle of the camera
         bool getMotionDetection() const; // get motion detection status
 
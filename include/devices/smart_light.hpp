@@ -3,6 +3,7 @@
 
 // includes
 #include "devices/device.hpp"
+#include "devices/light_color.hpp"
 #include <iostream> 
 
 using std::string;
@@ -13,14 +14,15 @@ class SmartLight : public Device {
     // private members
     private:
         int brightness; // 0-100
-        string color; // white, red, green, blue
+        LightColor color; // packed RGB or white temperature
 
     // public methods
     public: 
         SmartLight( // constructor
             const string& id, // unique identifier
             const string& name, // name of the device
-            const string& location // location of the device
+            const string& location, // location of the device
+            StringPool* pool = nullptr // interns the location, null for the process default
         );
 
         // override virtual functions
@@ -28,12 +30,21 @@ class SmartLight : public Device {
         void turnOff() override; // turn off the light device
         double getPowerUsage() const override; // get the power usage
         string getDeviceStatus() const override; // get the device status
+        static string formatStatus(const string& id, bool on, int brightness, LightColor color); // getDeviceStatus() of given state
+        size_t getMemoryUsage() const override; // get the bytes the light holds
 
         // smartlight specific functions
         void setBrightness(int brightness); // set the brightness
-        void setColor(const string& color); // set the color
+        void setColor(const string& color); // set the color from a name, #RRGGBB or temperature
+        void setColor(LightColor newColor); // set the color without parsing
         int getBrightness() const; // get the brightness
-        string getColor() const; // get the color
+
+        // non-throwing versions, invalid input is returned instead of thrown and logged
+        DeviceResult trySetBrightness(int level); // InvalidBrightness outside 0-100
+        DeviceResult trySetColor(const string& color); // InvalidColor if it does not parse
+        DeviceResult applyCommand(const DeviceCommand& command) override; // brightness and color commands
+        DeviceResult checkCommand(const DeviceCommand& command) const override;
+        LightColor getColor() const; // get the color
 
         // operator overloading declarations
         SmartLight& operator+(int brightnessIncrement); // brightness increment operator overloading
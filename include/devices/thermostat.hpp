@@ -7,20 +7,33 @@
 
 using namespace std;
 
+// thermostat operating mode, in the order telemetry codes it
+enum class ThermostatMode : uint8_t {
+    Auto, // heats or cools towards the setpoint
+    Heating, // heats only
+    Cooling // cools only
+};
+
+const char* thermostatModeName(ThermostatMode mode); // "auto", "heating" or "cooling"
+bool parseThermostatMode(const string& text, ThermostatMode& mode); // false for anything else
+
 // Thermostat class
 class Thermostat : public Device { // inherit from Device class
     private: 
         // private members
         float temperature; // temperature of the room
-        string mode; // heating, cooling or auto
+        ThermostatMode mode; // heating, cooling or auto
         float desiredTemperature; // desired temperature of the room
+        float controlOutput; // heating (+) or cooling (-) output from the control loop, -1 to 1
+        bool closedLoop; // is a control loop driving the output?
 
     public:
         // constructor
         Thermostat(
             const string& id, // unique identifier
             const string& name, // name of the device
-            const string& location // location of the device
+            const string& location, // location of the device
+            StringPool* pool = nullptr // interns the location, null for the process default
         );
 
         // override functions from Device class
@@ -28,17 +41,35 @@ class Thermostat : public Device { // inherit from Device class
         void turnOff() override; // override turnOff function from Device class
         double getPowerUsage() const override; // override getPowerUsage function from Device class
         string getDeviceStatus() const override; // override getDeviceStatus function from Device class
+        static string formatStatus(const string& id, bool on, float temperature, float desiredTemperature, // getDeviceStatus() of given state
+                                   ThermostatMode mode, bool closedLoop, float controlOutput);
+        size_t getMemoryUsage() const override; // override getMemoryUsage function from Device class
 
         // additional functions
         void setTemperature(float temp); // set the temperature of the room
         void setMode(const string& newMode); // set the mode of the thermostat
+        void setMode(ThermostatMode newMode); // set the mode without parsing
         void setDesiredTemperature(float temp); // set the desired temperature of the room
-        
+
+        // non-throwing versions, invalid input is returned instead of being ignored
+        DeviceResult trySetTemperature(float temp); // InvalidTemperature outside 0-50C
+        DeviceResult trySetMode(const string& newMode); // InvalidMode unless heating, cooling or auto
+        DeviceResult trySetDesiredTemperature(float temp); // InvalidTemperature outside 0-50C
+        DeviceResult applyCommand(const DeviceCommand& command) override; // temperature and mode commands
+        DeviceResult checkCommand(const DeviceCommand& command) const override;
+
+        // control loop
+        void applyControlOutput(float output); // drive the heating/cooling output, clamped to what the mode allows
+        void releaseControl(); // back to the open-loop power estimate
+        void updateTemperatureReading(float temp); // new measurement from the control loop, observers are told later
 
         // getters
         float getTemperature() const; // get the temperature of the room
         string getMode() const; // get the mode of the thermostat
+        ThermostatMode getThermostatMode() const; // get the mode without formatting it
         float getDesiredTemperature() const; // get the desired temperature of the room
+        float getControlOutput() const; // get the heating/cooling output
+        bool isClosedLoop() const; // is a control loop driving the output?
 
 };
 
@@ -0,0 +1,101 @@
+#ifndef video_frame_hpp
+#define video_frame_hpp
+
+// includes
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// frame dimensions in pixels
+struct FrameSize {
+    int width; // pixels per row
+    int height; // number of rows
+
+    std::size_t pixelCount() const { return static_cast<std::size_t>(width) * static_cast<std::size_t>(height); }
+    bool operator==(const FrameSize& other) const { return width == other.width && height == other.height; }
+    bool operator!=(const FrameSize& other) const { return !(*this == other); }
+};
+
+// camera resolutions, in the order telemetry codes them
+enum class CameraResolution : std::uint8_t {
+    Hd720, // 720p
+    Hd1080, // 1080p
+    Uhd4K // 4K
+};
+
+const char* cameraResolutionName(CameraResolution resolution); // "720p", "1080p" or "4K"
+bool parseCameraResolution(const std::string& text, CameraResolution& resolution); // false for anything else
+
+// map a camera resolution (720p, 1080p, 4K) to its frame size
+FrameSize frameSizeForResolution(const std::string& resolution);
+FrameSize frameSizeForResolution(CameraResolution resolution);
+
+// 8-bit grayscale frame, one byte per pixel in row-major order
+class GrayFrame {
+    private:
+        FrameSize size; // frame dimensions
+        std::vector<std::uint8_t> pixels; // luma values
+        std::uint64_t frameNumber; // sequence number assigned by the source
+
+    public:
+        GrayFrame(); // empty frame
+        GrayFrame(FrameSize frameSize, std::uint8_t fill = 0); // frame filled with a constant value
+
+        // getters
+        FrameSize getSize() const; // get the frame dimensions
+        std::uint64_t getFrameNumber() const; // get the sequence number
+        const std::uint8_t* data() const; // read-only pixel access
+        std::uint8_t* data(); // writable pixel access
+        std::size_t pixelCount() const; // number of pixels in the frame
+
+        // setters
+        void setFrameNumber(std::uint64_t number); // set the sequence number
+};
+
+// source of frames for the motion pipeline
+class FrameSource {
+    public:
+        virtual ~FrameSource() = default;
+        virtual const GrayFrame& nextFrame() = 0; // produce the next frame
+        virtual FrameSize getFrameSize() const = 0; // dimensions of produced frames
+};
+
+// deterministic synthetic scene: static gradient with sensor noise and an optional moving block
+class SyntheticFrameSource : public FrameSource {
+    private:
+        GrayFrame frame; // reused output frame
+        std::vector<std::uint8_t> scene; // static background scene
+        std::vector<std::uint8_t> noise; // precomputed noise pattern, cycled per frame
+        std::uint64_t framesProduced; // frames generated so far
+        bool motion; // draw the moving block?
+
+    public:
+        SyntheticFrameSource(FrameSize frameSize, std::uint32_t seed = 1); // build scene and noise table
+
+        const GrayFrame& nextFrame() override; // render the next frame
+        FrameSize getFrameSize() const override; // dimensions of produced frames
+
+        void setMotion(bool enabled); // start or stop the moving block
+        bool getMotion() const; // is the moving block drawn?
+};
+
+// cycles through a list of binary PGM (P5) image files
+class ImageFileFrameSource : public FrameSource {
+    private:
+        std::vector<GrayFrame> frames; // decoded images
+        std::size_t nextIndex; // next image to return
+        std::uint64_t framesProduced; // frames returned so far
+
+    public:
+        explicit ImageFileFrameSource(const std::vector<std::string>& paths); // load all images up front
+
+        const GrayFrame& nextFrame() override; // return the next image
+        FrameSize getFrameSize() const override; // dimensions of the images
+};
+
+// read and write 8-bit binary PGM images
+GrayFrame loadPgmFrame(const std::string& path);
+void savePgmFrame(const GrayFrame& frame, const std::string& path);
+
+#endif // video_frame_hpp
@@ -1,42 +1,93 @@
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
-#include "devices/device.hpp"
-#include "devices/security_camera.hpp"
-#include "devices/smart_light.hpp"
-#include "devices/thermostat.hpp"
+#include <sstream>
+#include <string>
 #include "controllers/home_controller.hpp"
-#include "controllers/room_controller.hpp"
+#include "controllers/home_layout.hpp"
+#include "controllers/command_server.hpp"
+#include "demo_layout.hpp"
 
 using namespace std;
 
-int main() {
-    cout << "Smart home system starting up..." << endl;
+static const char* const usage = "usage: smart_home_system [--layout file] [--socket path] [--tcp port]";
 
-    // Create a smart light device instance
-    HomeController* controller = HomeController::getInstance();
-    
-    // add some devices
-    cout << "Adding devices...\n";
+// a TCP port, false unless the whole text is a number from 0 to 65535
+static bool parsePort(const string& text, int& port) {
+    if (text.empty() || text[0] == '-') {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    unsigned long parsed = strtoul(text.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' || parsed > 65535) {
+        return false;
+    }
+    port = static_cast<int>(parsed);
+    return true;
+}
 
-    // add some devices to the controller
-    controller->addDevice(make_shared<SmartLight>("SL1", "Bedroom Light", "Bedroom"));
-    controller->addDevice(make_shared<SmartLight>("SL2", "Living Room Light", "Living Room"));
-    controller->addDevice(make_shared<Thermostat>("ST1", "Living Room Thermostat", "Living Room"));
-    controller->addDevice(make_shared<SecurityCamera>("SC1", "Front Door Camera", "Front Door"));
+int main(int argc, char* argv[]) {
+    // every flag takes a value; unknown flags, missing or malformed values exit with status 2
+    string layoutPath; // empty for the built-in demo home
+    CommandServerConfig serverConfig;
+    serverConfig.socketPath = "";
+    for (int i = 1; i < argc; ++i) {
+        string flag = argv[i];
+        string error;
+        if (flag != "--layout" && flag != "--socket" && flag != "--tcp") {
+            error = "Unknown option " + flag;
+        } else if (i + 1 >= argc) {
+            error = "Missing value for " + flag;
+        } else {
+            string value = argv[++i];
+            if (flag == "--layout") {
+                layoutPath = value;
+            } else if (flag == "--socket") {
+                serverConfig.socketPath = value;
+            } else if (!parsePort(value, serverConfig.tcpPort)) {
+                error = "Invalid value for " + flag + ": " + value;
+            }
+        }
+        if (!error.empty()) {
+            cerr << error << "\n" << usage << endl;
+            return 2;
+        }
+    }
 
-    // add some rooms
-    cout << "Adding rooms...\n";
-    controller->addRoom("Bedroom");
-    controller->addRoom("Living Room");
-    controller->addRoom("Kitchen");
+    cout << "Smart home system starting up..." << endl;
+    HomeController* controller = HomeController::getInstance();
 
-    cout << "Devices added...\n";
+    // the demo home is layouts/demo.layout, built into the binary; --layout loads another home
+    try {
+        if (layoutPath.empty()) {
+            cout << "Loading the demo home...\n";
+            istringstream demo(demoLayoutText);
+            controller->loadLayout(parseHomeLayout(demo, &controller->getStringPool()));
+        } else {
+            cout << "Loading layout " << layoutPath << "...\n";
+            controller->loadLayout(loadHomeLayout(layoutPath, &controller->getStringPool()));
+        }
+    } catch (const exception& e) {
+        cerr << "Cannot load layout: " << e.what() << endl;
+        return 1;
+    }
 
-    // run the control loop
-    cout << "Control loop running...\n";
-    cout << "Test devices added and running..." << endl;
+    // optional command server, so other processes can control the devices while the menu runs
+    CommandServer server(*controller, serverConfig);
+    if (!serverConfig.socketPath.empty() || serverConfig.tcpPort >= 0) {
+        try {
+            server.start();
+            cout << "Command server running...\n";
+        } catch (const exception& e) {
+            cerr << "Cannot start command server: " << e.what() << endl;
+        }
+    }
 
     // run the controller
+    cout << "Control loop running...\n";
     controller->run();
+    server.stop();
 
     return 0;
-}
\ No newline at end of file
+}
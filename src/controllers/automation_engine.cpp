@@ -0,0 +1,767 @@
+// includes
+#include "controllers/automation_engine.hpp"
+#include "core/logger.hpp"
+#include "core/memory_usage.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// rules triggering rules stop after this many nested changes
+const int maxDispatchDepth = 4;
+
+// keeps the dispatch depth balanced when an action throws
+struct DepthGuard {
+    int& depth;
+    explicit DepthGuard(int& d) : depth(d) { ++depth; }
+    ~DepthGuard() { --depth; }
+};
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string trim(const std::string& text) {
+    std::size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return "";
+    std::size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+std::vector<std::string> splitWords(const std::string& text) {
+    std::istringstream in(text);
+    std::vector<std::string> words;
+    std::string word;
+    while (in >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+// split on a keyword surrounded by spaces, matched case-insensitively
+std::vector<std::string> splitOnKeyword(const std::string& text, const std::string& keyword) {
+    std::vector<std::string> parts;
+    std::string lower = lowercase(text);
+    std::string needle = " " + keyword + " ";
+    std::size_t start = 0;
+    while (true) {
+        std::size_t at = lower.find(needle, start);
+        if (at == std::string::npos) {
+            parts.push_back(trim(text.substr(start)));
+            return parts;
+        }
+        parts.push_back(trim(text.substr(start, at - start)));
+        start = at + needle.size();
+    }
+}
+
+std::string joinWords(const std::vector<std::string>& words, std::size_t begin, std::size_t end) {
+    std::string joined;
+    for (std::size_t i = begin; i < end; ++i) {
+        if (!joined.empty()) joined += ' ';
+        joined += words[i];
+    }
+    return joined;
+}
+
+[[noreturn]] void ruleError(const std::string& message, const std::string& clause) {
+    throw std::invalid_argument("Invalid rule: " + message + " in \"" + clause + "\"");
+}
+
+// HH:MM to minutes after midnight
+std::uint16_t parseMinute(const std::string& text, const std::string& clause) {
+    int hours = 0, minutes = 0;
+    char colon = 0;
+    std::istringstream in(text);
+    if (!(in >> hours >> colon >> minutes) || colon != ':' || hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+        ruleError("expected a time as HH:MM", clause);
+    }
+    return static_cast<std::uint16_t>(hours * 60 + minutes);
+}
+
+float parseNumber(const std::string& text, const std::string& clause) {
+    std::string digits = text;
+    while (!digits.empty() && (digits.back() == '%' || digits.back() == 'C' || digits.back() == 'c')) {
+        digits.pop_back();
+    }
+    try {
+        std::size_t used = 0;
+        float value = std::stof(digits, &used);
+        if (used != digits.size()) ruleError("expected a number", clause);
+        return value;
+    } catch (const std::logic_error&) {
+        ruleError("expected a number", clause);
+    }
+}
+
+bool isWord(const std::vector<std::string>& words, std::size_t index, const char* keyword) {
+    return index < words.size() && lowercase(words[index]) == keyword;
+}
+
+} // namespace
+
+// constructor, default sun times are 07:00 and 19:00
+AutomationEngine::AutomationEngine()
+    : minuteOfDay(12 * 60)
+    , replayMinutes(12 * 60)
+    , sunriseMinute(7 * 60)
+    , sunsetMinute(19 * 60)
+    , dispatchDepth(0)
+    , rulesEvaluated(0)
+    , rulesFired(0)
+    , actionsExecuted(0)
+    , actionsFailed(0)
+    , cascadesSuppressed(0)
+{}
+
+// device IDs named in rules get a slot even before the device exists
+std::uint32_t AutomationEngine::slotFor(const std::string& id) {
+    auto [it, inserted] = slotById.try_emplace(id, static_cast<std::uint32_t>(slots.size()));
+    if (!inserted) {
+        return it->second;
+    }
+    std::uint32_t slot = it->second;
+    DeviceSlot entry;
+    entry.id = &it->first;
+    entry.device = nullptr;
+    entry.kind = DeviceKind::Unknown;
+    entry.lastTemperature = std::numeric_limits<float>::quiet_NaN();
+    entry.triggers = noTriggers;
+    slots.push_back(std::move(entry));
+    return slot;
+}
+
+AutomationEngine::SlotTriggers& AutomationEngine::triggersOf(std::uint32_t slot) {
+    if (slots[slot].triggers == noTriggers) {
+        slots[slot].triggers = static_cast<std::uint32_t>(triggerSets.size());
+        triggerSets.emplace_back();
+    }
+    return triggerSets[slots[slot].triggers];
+}
+
+// "<room> lights", a known room name, or a single device ID
+std::uint32_t AutomationEngine::groupFor(const std::string& target) {
+    std::string lower = lowercase(target);
+    TargetGroup group;
+    std::string key;
+    if (lower.size() > 7 && lower.compare(lower.size() - 7, 7, " lights") == 0) {
+        group.room = target.substr(0, target.size() - 7);
+        group.lightsOnly = true;
+        key = "lights:" + group.room;
+    } else if (roomMembers.count(target)) {
+        group.room = target;
+        group.lightsOnly = false;
+        key = "room:" + target;
+    } else {
+        group.lightsOnly = false;
+        key = "device:" + target;
+    }
+
+    auto it = groupByKey.find(key);
+    if (it != groupByKey.end()) {
+        return it->second;
+    }
+    if (group.room.empty()) {
+        group.members.push_back(slotFor(target));
+    } else {
+        auto members = roomMembers.find(group.room);
+        if (members != roomMembers.end()) {
+            group.members = members->second;
+        }
+    }
+    std::uint32_t index = static_cast<std::uint32_t>(groups.size());
+    groups.push_back(std::move(group));
+    groupByKey.emplace(key, index);
+    return index;
+}
+
+// parse the rule text into flat records and file it under its trigger
+std::uint32_t AutomationEngine::addRule(const std::string& text) {
+    std::string rule = trim(text);
+    std::string lower = lowercase(rule);
+    if (lower.compare(0, 5, "when ") != 0) {
+        ruleError("rules start with \"when\"", rule);
+    }
+
+    // "when <trigger and conditions>, <actions>" or "... then <actions>"
+    std::size_t split = lower.find(" then ");
+    std::size_t actionStart = split == std::string::npos ? std::string::npos : split + 6;
+    if (split == std::string::npos) {
+        split = lower.find(',');
+        actionStart = split == std::string::npos ? std::string::npos : split + 1;
+    }
+    if (split == std::string::npos) {
+        ruleError("missing \",\" or \"then\" before the actions", rule);
+    }
+    std::vector<std::string> clauses = splitOnKeyword(rule.substr(5, split - 5), "and");
+    std::vector<std::string> actionClauses = splitOnKeyword(rule.substr(actionStart), "and");
+
+    std::uint32_t ruleId = static_cast<std::uint32_t>(rules.size());
+    std::size_t conditionMark = conditions.size();
+    std::size_t actionMark = actions.size();
+
+    try {
+        // trigger
+        const std::string& triggerText = clauses.front();
+        std::vector<std::string> words = splitWords(triggerText);
+        TriggerKind trigger;
+        std::uint32_t triggerSlot = 0;
+        float threshold = 0.0f;
+        std::uint16_t triggerMinute = 0;
+        if (words.size() == 3 && isWord(words, 0, "motion") && isWord(words, 1, "on")) {
+            trigger = TriggerKind::Motion;
+            triggerSlot = slotFor(words[2]);
+        } else if (words.size() == 5 && isWord(words, 0, "temperature") && isWord(words, 1, "on")
+                   && (isWord(words, 3, "above") || isWord(words, 3, "below"))) {
+            trigger = isWord(words, 3, "above") ? TriggerKind::TemperatureAbove : TriggerKind::TemperatureBelow;
+            triggerSlot = slotFor(words[2]);
+            threshold = parseNumber(words[4], triggerText);
+        } else if (words.size() == 3 && isWord(words, 1, "turns") && (isWord(words, 2, "on") || isWord(words, 2, "off"))) {
+            trigger = isWord(words, 2, "on") ? TriggerKind::TurnsOn : TriggerKind::TurnsOff;
+            triggerSlot = slotFor(words[0]);
+        } else if (words.size() == 2 && isWord(words, 0, "at")) {
+            trigger = TriggerKind::Time;
+            triggerMinute = parseMinute(words[1], triggerText);
+        } else {
+            ruleError("unknown trigger", triggerText);
+        }
+
+        // conditions
+        for (std::size_t c = 1; c < clauses.size(); ++c) {
+            words = splitWords(clauses[c]);
+            CompiledCondition condition{ConditionKind::Dark, 0, 0.0f, 0};
+            if (words.size() == 2 && (isWord(words, 0, "after") || isWord(words, 0, "before"))) {
+                bool after = isWord(words, 0, "after");
+                if (isWord(words, 1, "sunset")) {
+                    condition.kind = after ? ConditionKind::Dark : ConditionKind::Light;
+                } else if (isWord(words, 1, "sunrise")) {
+                    condition.kind = after ? ConditionKind::Light : ConditionKind::Dark;
+                } else {
+                    condition.kind = after ? ConditionKind::AfterMinute : ConditionKind::BeforeMinute;
+                    condition.minute = parseMinute(words[1], clauses[c]);
+                }
+            } else if (words.size() == 5 && isWord(words, 0, "temperature") && isWord(words, 1, "on")
+                       && (isWord(words, 3, "above") || isWord(words, 3, "below"))) {
+                condition.kind = isWord(words, 3, "above") ? ConditionKind::TemperatureAbove : ConditionKind::TemperatureBelow;
+                condition.slot = slotFor(words[2]);
+                condition.threshold = parseNumber(words[4], clauses[c]);
+            } else if (words.size() == 3 && isWord(words, 1, "is") && (isWord(words, 2, "on") || isWord(words, 2, "off"))) {
+                condition.kind = isWord(words, 2, "on") ? ConditionKind::IsOn : ConditionKind::IsOff;
+                condition.slot = slotFor(words[0]);
+            } else {
+                ruleError("unknown condition", clauses[c]);
+            }
+            conditions.push_back(condition);
+        }
+
+        // actions
+        for (const auto& clause : actionClauses) {
+            words = splitWords(clause);
+            CompiledAction action{ActionKind::TurnOn, 0, 0.0f, LightColor()};
+            if (words.size() >= 4 && isWord(words, 0, "set")) {
+                // the last "to" separates target and value, colors may be several words so look from the left too
+                std::size_t to = words.size();
+                for (std::size_t i = 2; i + 1 < words.size(); ++i) {
+                    if (isWord(words, i, "to") && (isWord(words, i - 1, "color") || isWord(words, i - 1, "temperature"))) {
+                        to = i;
+                        break;
+                    }
+                }
+                if (to == words.size()) {
+                    for (std::size_t i = words.size() - 2; i >= 2; --i) {
+                        if (isWord(words, i, "to")) { to = i; break; }
+                    }
+                }
+                if (to == words.size()) {
+                    ruleError("expected \"to\"", clause);
+                }
+                std::string value = joinWords(words, to + 1, words.size());
+                if (isWord(words, to - 1, "color")) {
+                    action.kind = ActionKind::SetColor;
+                    action.group = groupFor(joinWords(words, 1, to - 1));
+                    if (!LightColor::tryParse(value, action.color)) {
+                        ruleError("unknown color", clause);
+                    }
+                } else if (isWord(words, to - 1, "temperature")) {
+                    action.kind = ActionKind::SetTemperature;
+                    action.group = groupFor(joinWords(words, 1, to - 1));
+                    action.value = parseNumber(value, clause);
+                } else {
+                    action.kind = ActionKind::SetBrightness;
+                    action.group = groupFor(joinWords(words, 1, to));
+                    action.value = parseNumber(value, clause);
+                    if (!(action.value >= 0 && action.value <= 100)) { // false for NaN, which lround cannot take
+                        ruleError("brightness must be between 0 and 100", clause);
+                    }
+                }
+            } else if (words.size() >= 3 && isWord(words, 0, "turn") && (isWord(words, 1, "on") || isWord(words, 1, "off"))) {
+                action.kind = isWord(words, 1, "on") ? ActionKind::TurnOn : ActionKind::TurnOff;
+                action.group = groupFor(joinWords(words, 2, words.size()));
+            } else if (words.size() >= 4 && (isWord(words, 0, "start") || isWord(words, 0, "stop"))
+                       && isWord(words, 1, "recording") && isWord(words, 2, "on")) {
+                action.kind = isWord(words, 0, "start") ? ActionKind::StartRecording : ActionKind::StopRecording;
+                action.group = groupFor(joinWords(words, 3, words.size()));
+            } else {
+                ruleError("unknown action", clause);
+            }
+            actions.push_back(action);
+        }
+
+        // file the rule under its trigger
+        switch (trigger) {
+            case TriggerKind::Motion:
+                triggersOf(triggerSlot).buckets[MotionBucket].push_back(ruleId);
+                break;
+            case TriggerKind::TurnsOn:
+                triggersOf(triggerSlot).buckets[TurnsOnBucket].push_back(ruleId);
+                break;
+            case TriggerKind::TurnsOff:
+                triggersOf(triggerSlot).buckets[TurnsOffBucket].push_back(ruleId);
+                break;
+            case TriggerKind::TemperatureAbove:
+                triggersOf(triggerSlot).aboveTriggers.emplace_back(threshold, ruleId);
+                triggersOf(triggerSlot).thresholdsSorted = false;
+                break;
+            case TriggerKind::TemperatureBelow:
+                triggersOf(triggerSlot).belowTriggers.emplace_back(threshold, ruleId);
+                triggersOf(triggerSlot).thresholdsSorted = false;
+                break;
+            case TriggerKind::Time:
+                timeTriggers.resize(24 * 60);
+                timeTriggers[triggerMinute].push_back(ruleId);
+                break;
+        }
+    } catch (...) {
+        conditions.resize(conditionMark);
+        actions.resize(actionMark);
+        throw;
+    }
+
+    CompiledRule compiled;
+    compiled.text = rule;
+    compiled.conditionBegin = static_cast<std::uint32_t>(conditionMark);
+    compiled.actionBegin = static_cast<std::uint32_t>(actionMark);
+    compiled.conditionCount = static_cast<std::uint16_t>(conditions.size() - conditionMark);
+    compiled.actionCount = static_cast<std::uint16_t>(actions.size() - actionMark);
+    compiled.enabled = true;
+    rules.push_back(std::move(compiled));
+    return ruleId;
+}
+
+// removed rules stay in the trigger index but are skipped
+bool AutomationEngine::removeRule(std::uint32_t ruleId) {
+    if (ruleId >= rules.size() || !rules[ruleId].enabled) {
+        return false;
+    }
+    rules[ruleId].enabled = false;
+    return true;
+}
+
+std::size_t AutomationEngine::getRuleCount() const {
+    return static_cast<std::size_t>(std::count_if(rules.begin(), rules.end(),
+        [](const CompiledRule& rule) { return rule.enabled; }));
+}
+
+std::vector<std::pair<std::uint32_t, std::string>> AutomationEngine::listRules() const {
+    std::vector<std::pair<std::uint32_t, std::string>> list;
+    for (std::uint32_t i = 0; i < rules.size(); ++i) {
+        if (rules[i].enabled) {
+            list.emplace_back(i, rules[i].text);
+        }
+    }
+    return list;
+}
+
+// bind a device to its slot and remember its type
+void AutomationEngine::registerDevice(const std::shared_ptr<Device>& device) {
+    (void)registerSlot(device);
+}
+
+std::uint32_t AutomationEngine::registerSlot(const std::shared_ptr<Device>& device) {
+    std::uint32_t slot = slotFor(device->getDeviceID());
+    DeviceSlot& entry = slots[slot];
+    if (entry.device) {
+        slotByDevice.erase(entry.device);
+    }
+    entry.device = device.get();
+    if (auto thermostat = dynamic_cast<Thermostat*>(device.get())) {
+        entry.kind = DeviceKind::Thermostat;
+        entry.lastTemperature = thermostat->getTemperature();
+    } else if (dynamic_cast<SmartLight*>(device.get())) {
+        entry.kind = DeviceKind::Light;
+    } else if (dynamic_cast<SecurityCamera*>(device.get())) {
+        entry.kind = DeviceKind::Camera;
+    } else {
+        entry.kind = DeviceKind::Other;
+    }
+    slotByDevice[device.get()] = slot;
+    return slot;
+}
+
+// called once before many registrations, growing per call would copy the slots again and again
+void AutomationEngine::reserveDevices(std::size_t count) {
+    slots.reserve(slots.size() + count);
+    slotById.reserve(slotById.size() + count);
+    slotByDevice.reserve(slotByDevice.size() + count);
+}
+
+// registration and room membership in one pass, the membership check of addDeviceToRoom is a scan
+void AutomationEngine::registerDevices(const std::vector<std::shared_ptr<Device>>& devices, const std::string& room) {
+    if (room.empty()) {
+        for (const auto& device : devices) {
+            (void)registerSlot(device);
+        }
+        return;
+    }
+    auto& members = roomMembers[room];
+    memberMarks.resize(slots.size() + devices.size()); // large enough for every new slot
+    for (std::uint32_t slot : members) {
+        memberMarks[slot] = true;
+    }
+    std::size_t firstNew = members.size();
+    members.reserve(members.size() + devices.size());
+    for (const auto& device : devices) {
+        std::uint32_t slot = registerSlot(device);
+        if (!memberMarks[slot]) {
+            memberMarks[slot] = true;
+            members.push_back(slot);
+        }
+    }
+    for (std::uint32_t slot : members) {
+        memberMarks[slot] = false;
+    }
+    for (const char* prefix : {"room:", "lights:"}) {
+        auto it = groupByKey.find(prefix + room);
+        if (it != groupByKey.end()) {
+            auto& group = groups[it->second].members;
+            group.insert(group.end(), members.begin() + static_cast<std::ptrdiff_t>(firstNew), members.end());
+        }
+    }
+}
+
+// rules naming the device keep their slot, it simply has nothing to act on
+void AutomationEngine::unregisterDevice(const Device& device) {
+    auto it = slotByDevice.find(&device);
+    if (it == slotByDevice.end()) {
+        return;
+    }
+    slots[it->second].device = nullptr;
+    slotByDevice.erase(it);
+}
+
+void AutomationEngine::addRoom(const std::string& room) {
+    roomMembers[room];
+}
+
+// keep room groups that rules already target in step with the room
+void AutomationEngine::addDeviceToRoom(const std::string& room, const std::string& deviceId) {
+    std::uint32_t slot = slotFor(deviceId);
+    auto& members = roomMembers[room];
+    if (std::find(members.begin(), members.end(), slot) != members.end()) {
+        return;
+    }
+    members.push_back(slot);
+    for (const char* prefix : {"room:", "lights:"}) {
+        auto it = groupByKey.find(prefix + room);
+        if (it != groupByKey.end()) {
+            groups[it->second].members.push_back(slot);
+        }
+    }
+}
+
+void AutomationEngine::removeDeviceFromRoom(const std::string& room, const std::string& deviceId) {
+    auto id = slotById.find(deviceId);
+    auto members = roomMembers.find(room);
+    if (id == slotById.end() || members == roomMembers.end()) {
+        return;
+    }
+    std::uint32_t slot = id->second;
+    members->second.erase(std::remove(members->second.begin(), members->second.end(), slot), members->second.end());
+    for (const char* prefix : {"room:", "lights:"}) {
+        auto it = groupByKey.find(prefix + room);
+        if (it != groupByKey.end()) {
+            auto& list = groups[it->second].members;
+            list.erase(std::remove(list.begin(), list.end(), slot), list.end());
+        }
+    }
+}
+
+void AutomationEngine::removeRoom(const std::string& room) {
+    roomMembers.erase(room);
+    for (const char* prefix : {"room:", "lights:"}) {
+        auto it = groupByKey.find(prefix + room);
+        if (it != groupByKey.end()) {
+            groups[it->second].members.clear();
+        }
+    }
+}
+
+// only the trigger bucket for this device and change is looked at
+void AutomationEngine::onDeviceChanged(Device& device, DeviceChange change) {
+    if (change != DeviceChange::Motion && change != DeviceChange::Power && change != DeviceChange::Temperature) {
+        return;
+    }
+    auto it = slotByDevice.find(&device);
+    if (it == slotByDevice.end()) {
+        return;
+    }
+    if (dispatchDepth >= maxDispatchDepth) {
+        ++cascadesSuppressed;
+        return;
+    }
+    DepthGuard guard(dispatchDepth);
+
+    DeviceSlot& slot = slots[it->second];
+    switch (change) {
+        case DeviceChange::Motion:
+            if (slot.triggers != noTriggers) {
+                fireRules(triggerSets[slot.triggers].buckets[MotionBucket]);
+            }
+            break;
+        case DeviceChange::Power:
+            if (slot.triggers != noTriggers) {
+                fireRules(triggerSets[slot.triggers].buckets[device.getIsOn() ? TurnsOnBucket : TurnsOffBucket]);
+            }
+            break;
+        case DeviceChange::Temperature:
+            if (slot.kind == DeviceKind::Thermostat) {
+                onTemperature(it->second, static_cast<Thermostat&>(device).getTemperature());
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// thresholds are sorted so only the rules whose threshold was crossed are touched
+void AutomationEngine::onTemperature(std::uint32_t slotIndex, float temperature) {
+    DeviceSlot& device = slots[slotIndex];
+    float previous = device.lastTemperature;
+    device.lastTemperature = temperature;
+    if (std::isnan(previous) || previous == temperature || device.triggers == noTriggers) {
+        return;
+    }
+    SlotTriggers& slot = triggerSets[device.triggers];
+    if (!slot.thresholdsSorted) {
+        std::sort(slot.aboveTriggers.begin(), slot.aboveTriggers.end());
+        std::sort(slot.belowTriggers.begin(), slot.belowTriggers.end());
+        slot.thresholdsSorted = true;
+    }
+
+    std::vector<std::uint32_t> crossed;
+    auto byThreshold = [](const std::pair<float, std::uint32_t>& entry, float value) { return entry.first < value; };
+    auto thresholdAfter = [](float value, const std::pair<float, std::uint32_t>& entry) { return value < entry.first; };
+    if (temperature > previous) {
+        // "above t" became true for previous <= t < temperature
+        auto first = std::lower_bound(slot.aboveTriggers.begin(), slot.aboveTriggers.end(), previous, byThreshold);
+        auto last = std::lower_bound(first, slot.aboveTriggers.end(), temperature, byThreshold);
+        for (; first != last; ++first) crossed.push_back(first->second);
+    } else {
+        // "below t" became true for temperature < t <= previous
+        auto first = std::upper_bound(slot.belowTriggers.begin(), slot.belowTriggers.end(), temperature, thresholdAfter);
+        auto last = std::upper_bound(first, slot.belowTriggers.end(), previous, thresholdAfter);
+        for (; first != last; ++first) crossed.push_back(first->second);
+    }
+    fireRules(crossed);
+}
+
+// walk forward minute by minute so time triggers are not skipped; a set further ahead than the
+// replay limit, which includes any set backwards, is a jump and fires nothing
+void AutomationEngine::setTimeOfDay(int minute) {
+    if (minute < 0 || minute >= 24 * 60) {
+        throw std::invalid_argument("Time of day must be between 00:00 and 23:59");
+    }
+    int ahead = (minute - minuteOfDay + 24 * 60) % (24 * 60);
+    if (ahead > replayMinutes) {
+        minuteOfDay = static_cast<std::uint16_t>(minute);
+        return;
+    }
+    while (minuteOfDay != minute) {
+        minuteOfDay = static_cast<std::uint16_t>((minuteOfDay + 1) % (24 * 60));
+        if (!timeTriggers.empty() && !timeTriggers[minuteOfDay].empty()) {
+            DepthGuard guard(dispatchDepth);
+            fireRules(timeTriggers[minuteOfDay]);
+        }
+    }
+}
+
+void AutomationEngine::setReplayLimit(int minutes) {
+    if (minutes < 0 || minutes >= 24 * 60) {
+        throw std::invalid_argument("Replay limit must be between 0 and 1439 minutes");
+    }
+    replayMinutes = static_cast<std::uint16_t>(minutes);
+}
+
+void AutomationEngine::setSunTimes(int sunrise, int sunset) {
+    if (sunrise < 0 || sunset >= 24 * 60 || sunrise >= sunset) {
+        throw std::invalid_argument("Sunrise must come before sunset within the day");
+    }
+    sunriseMinute = static_cast<std::uint16_t>(sunrise);
+    sunsetMinute = static_cast<std::uint16_t>(sunset);
+}
+
+void AutomationEngine::fireRules(const std::vector<std::uint32_t>& ruleIds) {
+    for (std::size_t i = 0; i < ruleIds.size(); ++i) {
+        fireRule(ruleIds[i]);
+    }
+}
+
+void AutomationEngine::fireRule(std::uint32_t ruleId) {
+    const CompiledRule& rule = rules[ruleId];
+    if (!rule.enabled) {
+        return;
+    }
+    ++rulesEvaluated;
+    for (std::uint32_t c = 0; c < rule.conditionCount; ++c) {
+        if (!conditionHolds(conditions[rule.conditionBegin + c])) {
+            return;
+        }
+    }
+    ++rulesFired;
+    for (std::uint32_t a = 0; a < rule.actionCount; ++a) {
+        runAction(actions[rule.actionBegin + a]);
+    }
+}
+
+bool AutomationEngine::conditionHolds(const CompiledCondition& condition) const {
+    switch (condition.kind) {
+        case ConditionKind::AfterMinute:
+            return minuteOfDay >= condition.minute;
+        case ConditionKind::BeforeMinute:
+            return minuteOfDay < condition.minute;
+        case ConditionKind::Dark:
+            return minuteOfDay >= sunsetMinute || minuteOfDay < sunriseMinute;
+        case ConditionKind::Light:
+            return minuteOfDay >= sunriseMinute && minuteOfDay < sunsetMinute;
+        case ConditionKind::TemperatureAbove:
+        case ConditionKind::TemperatureBelow: {
+            const DeviceSlot& slot = slots[condition.slot];
+            if (!slot.device || slot.kind != DeviceKind::Thermostat) return false;
+            float temperature = static_cast<const Thermostat*>(slot.device)->getTemperature();
+            return condition.kind == ConditionKind::TemperatureAbove ? temperature > condition.threshold
+                                                                     : temperature < condition.threshold;
+        }
+        case ConditionKind::IsOn:
+        case ConditionKind::IsOff: {
+            const DeviceSlot& slot = slots[condition.slot];
+            if (!slot.device) return false;
+            return slot.device->getIsOn() == (condition.kind == ConditionKind::IsOn);
+        }
+    }
+    return false;
+}
+
+// one failing device does not stop the rest of the group
+void AutomationEngine::runAction(const CompiledAction& action) {
+    const TargetGroup& group = groups[action.group];
+    for (std::uint32_t member : group.members) {
+        const DeviceSlot& slot = slots[member];
+        Device* device = slot.device;
+        if (!device || (group.lightsOnly && slot.kind != DeviceKind::Light)) {
+            continue;
+        }
+        try {
+            DeviceResult result = DeviceResult::Ok;
+            switch (action.kind) {
+                case ActionKind::SetBrightness:
+                    if (slot.kind != DeviceKind::Light) continue;
+                    if (!device->getIsOn()) device->turnOn();
+                    result = static_cast<SmartLight*>(device)->trySetBrightness(static_cast<int>(std::lround(action.value)));
+                    break;
+                case ActionKind::SetColor:
+                    if (slot.kind != DeviceKind::Light) continue;
+                    static_cast<SmartLight*>(device)->setColor(action.color);
+                    break;
+                case ActionKind::SetTemperature:
+                    if (slot.kind != DeviceKind::Thermostat) continue;
+                    result = static_cast<Thermostat*>(device)->trySetDesiredTemperature(action.value);
+                    break;
+                case ActionKind::TurnOn:
+                    device->turnOn();
+                    break;
+                case ActionKind::TurnOff:
+                    device->turnOff();
+                    break;
+                case ActionKind::StartRecording:
+                    if (slot.kind != DeviceKind::Camera) continue;
+                    if (!device->getIsOn()) device->turnOn();
+                    result = static_cast<SecurityCamera*>(device)->tryStartRecording();
+                    break;
+                case ActionKind::StopRecording:
+                    if (slot.kind != DeviceKind::Camera) continue;
+                    static_cast<SecurityCamera*>(device)->stopRecording();
+                    break;
+            }
+            if (result == DeviceResult::Ok) {
+                ++actionsExecuted;
+            } else {
+                ++actionsFailed;
+            }
+        } catch (const std::exception& e) {
+            ++actionsFailed;
+            logError("Automation action failed on ", *slot.id, ": ", e.what());
+        }
+    }
+}
+
+std::uint64_t AutomationEngine::getRulesEvaluated() const {
+    return rulesEvaluated;
+}
+
+std::uint64_t AutomationEngine::getRulesFired() const {
+    return rulesFired;
+}
+
+std::uint64_t AutomationEngine::getActionsExecuted() const {
+    return actionsExecuted;
+}
+
+std::uint64_t AutomationEngine::getActionsFailed() const {
+    return actionsFailed;
+}
+
+std::uint64_t AutomationEngine::getCascadesSuppressed() const {
+    return cascadesSuppressed;
+}
+
+std::size_t AutomationEngine::getMemoryUsage() const {
+    std::size_t bytes = heapBytes(slots) + heapBytes(triggerSets) + hashTableBytes(slotById) + hashTableBytes(slotByDevice)
+                      + heapBytes(groups) + hashTableBytes(groupByKey) + hashTableBytes(roomMembers) + heapBytes(rules)
+                      + heapBytes(conditions) + heapBytes(actions) + heapBytes(timeTriggers)
+                      + memberMarks.capacity() / 8; // one bit per slot
+    for (const auto& entry : slotById) {
+        bytes += heapBytes(entry.first);
+    }
+    for (const auto& triggers : triggerSets) {
+        for (const auto& bucket : triggers.buckets) {
+            bytes += heapBytes(bucket);
+        }
+        bytes += heapBytes(triggers.aboveTriggers) + heapBytes(triggers.belowTriggers);
+    }
+    for (const auto& group : groups) {
+        bytes += heapBytes(group.room) + heapBytes(group.members);
+    }
+    for (const auto& entry : groupByKey) {
+        bytes += heapBytes(entry.first);
+    }
+    for (const auto& room : roomMembers) {
+        bytes += heapBytes(room.first) + heapBytes(room.second);
+    }
+    for (const auto& rule : rules) {
+        bytes += heapBytes(rule.text);
+    }
+    for (const auto& minute : timeTriggers) {
+        bytes += heapBytes(minute);
+    }
+    return bytes;
+}
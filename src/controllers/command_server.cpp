@@ -0,0 +1,401 @@
+// includes
+#include "controllers/command_server.hpp"
+#include "controllers/home_controller.hpp"
+#include "core/logger.hpp"
+#include "core/metrics.hpp"
+#include "core/tracing.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// server metrics
+struct ServerMetrics {
+    Counter requestsOk;
+    Counter requestsFailed;
+    Counter accepted;
+    Gauge connections;
+};
+
+static const ServerMetrics& serverMetrics() {
+    static const ServerMetrics metrics = [] {
+        MetricsRegistry* registry = MetricsRegistry::getInstance();
+        return ServerMetrics{
+            registry->counter("smart_home_server_requests_total", "Command server requests by result", "result=\"ok\""),
+            registry->counter("smart_home_server_requests_total", "Command server requests by result", "result=\"error\""),
+            registry->counter("smart_home_server_connections_total", "Command server clients accepted"),
+            registry->gauge("smart_home_server_connections", "Command server clients connected")};
+    }();
+    return metrics;
+}
+
+// epoll data: clients use their descriptor, listening sockets are tagged above 32 bits
+static const std::uint64_t listenerTag = 1ull << 32;
+static const std::uint64_t wakeTag = 1ull << 33;
+
+CommandServer::CommandServer(HomeController& home, const CommandServerConfig& serverConfig)
+    : controller(home)
+    , config(serverConfig)
+    , epollFd(-1)
+    , unixFd(-1)
+    , tcpFd(-1)
+    , wakeFd(-1)
+    , boundTcpPort(-1)
+    , stopRequested(false)
+    , openConnections(0)
+    , requestCount(0)
+{}
+
+CommandServer::~CommandServer() {
+    stop();
+}
+
+// a non-blocking listening socket, throws with the failing call in the message
+static int listenOn(int family, const sockaddr* address, socklen_t length, int backlog) {
+    int fd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    }
+    int one = 1;
+    if (family == AF_INET) {
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (::bind(fd, address, length) < 0 || ::listen(fd, backlog) < 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error(std::string("bind/listen: ") + std::strerror(error));
+    }
+    return fd;
+}
+
+void CommandServer::openListeners() {
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        throw std::runtime_error(std::string("epoll/eventfd: ") + std::strerror(errno));
+    }
+    if (!config.socketPath.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (config.socketPath.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Socket path too long: " + config.socketPath);
+        }
+        std::strcpy(address.sun_path, config.socketPath.c_str());
+        ::unlink(config.socketPath.c_str()); // left behind by an earlier run
+        unixFd = listenOn(AF_UNIX, reinterpret_cast<sockaddr*>(&address), sizeof(address), config.backlog);
+    }
+    if (config.tcpPort >= 0) {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<std::uint16_t>(config.tcpPort));
+        tcpFd = listenOn(AF_INET, reinterpret_cast<sockaddr*>(&address), sizeof(address), config.backlog);
+        socklen_t length = sizeof(address);
+        ::getsockname(tcpFd, reinterpret_cast<sockaddr*>(&address), &length);
+        boundTcpPort = ntohs(address.sin_port);
+    }
+    for (int fd : {unixFd, tcpFd, wakeFd}) {
+        if (fd < 0) {
+            continue;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = fd == wakeFd ? wakeTag : listenerTag | static_cast<std::uint64_t>(fd);
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void CommandServer::start() {
+    if (isRunning()) {
+        return;
+    }
+    try {
+        openListeners();
+    } catch (...) {
+        closeAll();
+        throw;
+    }
+    stopRequested.store(false);
+    worker = std::thread(&CommandServer::eventLoop, this);
+    logInfo("Command server listening on ", config.socketPath.empty() ? "-" : config.socketPath,
+            boundTcpPort >= 0 ? " and 127.0.0.1:" + std::to_string(boundTcpPort) : std::string());
+}
+
+void CommandServer::stop() {
+    if (!worker.joinable()) {
+        return;
+    }
+    stopRequested.store(true);
+    std::uint64_t one = 1;
+    ssize_t written = ::write(wakeFd, &one, sizeof(one));
+    (void)written;
+    worker.join();
+    closeAll();
+}
+
+bool CommandServer::isRunning() const {
+    return worker.joinable();
+}
+
+void CommandServer::closeAll() {
+    for (auto& connection : connections) {
+        if (connection) {
+            closeClient(*connection);
+        }
+    }
+    connections.clear();
+    for (int* fd : {&unixFd, &tcpFd, &wakeFd, &epollFd}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+    if (!config.socketPath.empty()) {
+        ::unlink(config.socketPath.c_str());
+    }
+    boundTcpPort = -1;
+}
+
+void CommandServer::eventLoop() {
+    Tracer::getInstance()->setThreadName("command server");
+    std::vector<epoll_event> events(256);
+    while (!stopRequested.load()) {
+        int ready = ::epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logError("Command server epoll_wait failed: ", std::strerror(errno));
+            return;
+        }
+        for (int i = 0; i < ready; ++i) {
+            std::uint64_t tag = events[i].data.u64;
+            if (tag == wakeTag) {
+                continue; // stopRequested is checked by the loop
+            }
+            if (tag & listenerTag) {
+                acceptClients(static_cast<int>(tag & 0xffffffffu));
+                continue;
+            }
+            int fd = static_cast<int>(tag);
+            Connection* connection = fd < static_cast<int>(connections.size()) ? connections[fd].get() : nullptr;
+            if (!connection) {
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && !flushClient(*connection)) {
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                readClient(*connection);
+            }
+        }
+    }
+}
+
+void CommandServer::acceptClients(int listenFd) {
+    const ServerMetrics& metrics = serverMetrics();
+    while (true) {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE) {
+                logWarning("Command server out of descriptors, ", openConnections.load(), " clients connected");
+            }
+            return; // EAGAIN, or try again on the next readiness event
+        }
+        if (listenFd == tcpFd) {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // responses are small
+        }
+        if (fd >= static_cast<int>(connections.size())) {
+            connections.resize(fd + 1);
+        }
+        connections[fd].reset(new Connection{fd, std::string(), std::string(), 0, EPOLLIN, false});
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = static_cast<std::uint64_t>(fd);
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        openConnections.fetch_add(1, std::memory_order_relaxed);
+        metrics.accepted.increment();
+        metrics.connections.add(1.0);
+    }
+}
+
+void CommandServer::readClient(Connection& connection) {
+    char buffer[16384];
+    bool peerClosed = false;
+    while (connection.output.size() - connection.outputOffset < config.maxPendingOutput) {
+        ssize_t received = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection.input.append(buffer, static_cast<std::size_t>(received));
+            handleLines(connection); // before the next read, so a full output stops reading
+            if (connection.closeAfterFlush) {
+                break;
+            }
+            if (static_cast<std::size_t>(received) < sizeof(buffer)) {
+                break; // drained, saves a recv that would return EAGAIN
+            }
+            continue;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        peerClosed = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+        break;
+    }
+    if (peerClosed) {
+        connection.closeAfterFlush = true; // answer what was sent, then close
+    }
+    flushClient(connection);
+}
+
+void CommandServer::handleLines(Connection& connection) {
+    std::size_t begin = 0;
+    std::size_t end;
+    if (connection.input.find('\n') != std::string::npos) {
+        TraceSpan span("CommandServer::handleLines", "server");
+        std::lock_guard<std::mutex> guard(controller.getDeviceMutex());
+        while (connection.output.size() - connection.outputOffset < config.maxPendingOutput &&
+               (end = connection.input.find('\n', begin)) != std::string::npos) {
+            std::size_t length = end - begin;
+            if (length > 0 && connection.input[end - 1] == '\r') {
+                --length;
+            }
+            connection.output += handleRequestLocked(connection.input.substr(begin, length));
+            connection.output += '\n';
+            begin = end + 1;
+        }
+    }
+    connection.input.erase(0, begin);
+    // only the partial line after the last newline counts, complete lines are held back while the output is full
+    std::size_t lastNewline = connection.input.rfind('\n');
+    std::size_t partial = connection.input.size() - (lastNewline == std::string::npos ? 0 : lastNewline + 1);
+    if (partial > config.maxLineLength) {
+        connection.output += "ERR Request too long\n";
+        connection.input.clear();
+        connection.closeAfterFlush = true;
+    }
+}
+
+bool CommandServer::flushClient(Connection& connection) {
+    while (true) {
+        while (connection.outputOffset < connection.output.size()) {
+            ssize_t sent = ::send(connection.fd, connection.output.data() + connection.outputOffset,
+                                  connection.output.size() - connection.outputOffset, MSG_NOSIGNAL);
+            if (sent > 0) {
+                connection.outputOffset += static_cast<std::size_t>(sent);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            closeClient(connection);
+            return false;
+        }
+        if (connection.outputOffset < connection.output.size()) {
+            break; // socket full, the rest goes on EPOLLOUT
+        }
+        connection.output.clear();
+        connection.outputOffset = 0;
+        if (connection.input.find('\n') == std::string::npos) {
+            if (connection.closeAfterFlush) {
+                closeClient(connection);
+                return false;
+            }
+            break;
+        }
+        handleLines(connection); // lines held back while the output was full
+    }
+    updateInterest(connection);
+    return true;
+}
+
+// write interest while responses are queued, read interest while there is room for more
+void CommandServer::updateInterest(Connection& connection) {
+    std::size_t pending = connection.output.size() - connection.outputOffset;
+    std::uint32_t events = 0;
+    if (pending > 0) {
+        events |= EPOLLOUT;
+    }
+    if (pending < config.maxPendingOutput && !connection.closeAfterFlush) {
+        events |= EPOLLIN;
+    }
+    if (events != connection.events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = static_cast<std::uint64_t>(connection.fd);
+        ::epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = events;
+    }
+}
+
+void CommandServer::closeClient(Connection& connection) {
+    int fd = connection.fd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    openConnections.fetch_sub(1, std::memory_order_relaxed);
+    serverMetrics().connections.add(-1.0);
+    connections[fd].reset(); // destroys connection
+}
+
+// splits off the first space-separated word
+static std::string nextWord(const std::string& line, std::size_t& position) {
+    while (position < line.size() && line[position] == ' ') ++position;
+    std::size_t begin = position;
+    while (position < line.size() && line[position] != ' ') ++position;
+    return line.substr(begin, position - begin);
+}
+
+std::string CommandServer::handleRequest(const std::string& line) {
+    std::lock_guard<std::mutex> guard(controller.getDeviceMutex());
+    return handleRequestLocked(line);
+}
+
+std::string CommandServer::handleRequestLocked(const std::string& line) {
+    const ServerMetrics& metrics = serverMetrics();
+    requestCount.fetch_add(1, std::memory_order_relaxed);
+    std::size_t position = 0;
+    std::string first = nextWord(line, position);
+    std::string second = nextWord(line, position);
+    while (position < line.size() && line[position] == ' ') ++position;
+    std::string rest = line.substr(position); // may hold spaces, e.g. a color name
+    std::string response;
+    if (first == "ping" && second.empty()) {
+        response = "OK pong";
+    } else if (first == "status" && !second.empty() && rest.empty()) {
+        auto device = controller.findDeviceLocked(second);
+        response = device ? "OK " + device->getDeviceStatus() : std::string("ERR ") + describeResult(DeviceResult::UnknownDevice);
+    } else {
+        DeviceCommand command;
+        if (first.empty() || !parseDeviceCommand(second, rest, command)) {
+            response = "ERR Malformed request";
+        } else {
+            DeviceResult result = controller.applyCommandLocked(first, command);
+            response = result == DeviceResult::Ok ? "OK" : std::string("ERR ") + describeResult(result);
+        }
+    }
+    (response[0] == 'O' ? metrics.requestsOk : metrics.requestsFailed).increment();
+    return response;
+}
+
+int CommandServer::getTcpPort() const {
+    return boundTcpPort;
+}
+
+std::size_t CommandServer::getConnectionCount() const {
+    return openConnections.load(std::memory_order_relaxed);
+}
+
+std::uint64_t CommandServer::getRequestCount() const {
+    return requestCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,605 @@
+// includes
+#include "controllers/device_query.hpp"
+#include "core/memory_usage.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const std::uint32_t noIndex = std::numeric_limits<std::uint32_t>::max();
+
+// a location or room this small is checked slot by slot, without repairing the power array
+const std::size_t smallCandidateSet = 1024;
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string trim(const std::string& text) {
+    std::size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return "";
+    std::size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+[[noreturn]] void queryError(const std::string& message, const std::string& clause) {
+    throw std::invalid_argument("Invalid query: " + message + " in \"" + clause + "\"");
+}
+
+// clauses are separated by " and ", matched case-insensitively outside double-quoted names
+std::vector<std::string> splitClauses(const std::string& text) {
+    std::vector<std::string> clauses;
+    std::string lower = lowercase(text);
+    std::size_t start = 0;
+    bool quoted = false;
+    for (std::size_t i = 0; i < lower.size(); ++i) {
+        if (lower[i] == '"') {
+            quoted = !quoted;
+        } else if (!quoted && lower.compare(i, 5, " and ") == 0) {
+            clauses.push_back(trim(text.substr(start, i - start)));
+            start = i + 5;
+            i += 4;
+        }
+    }
+    if (quoted) {
+        queryError("unterminated quote", text);
+    }
+    clauses.push_back(trim(text.substr(start)));
+    return clauses;
+}
+
+float parseWatts(const std::string& text, const std::string& clause) {
+    std::string digits = text;
+    if (!digits.empty() && (digits.back() == 'W' || digits.back() == 'w')) {
+        digits.pop_back();
+    }
+    try {
+        std::size_t used = 0;
+        float value = std::stof(digits, &used);
+        if (used != digits.size()) queryError("expected watts", clause);
+        return value;
+    } catch (const std::logic_error&) {
+        queryError("expected watts", clause);
+    }
+}
+
+// the text after a keyword, case kept, without the quotes around a quoted name
+std::string argument(const std::string& clause, std::size_t keywordLength) {
+    std::string name = trim(clause.substr(keywordLength));
+    if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
+        return name.substr(1, name.size() - 2);
+    }
+    return name;
+}
+
+bool testBit(const std::vector<std::uint64_t>& bits, std::uint32_t slot) {
+    return (bits[slot >> 6] >> (slot & 63)) & 1u;
+}
+
+DeviceKind kindOf(const Device& device) {
+    if (dynamic_cast<const SmartLight*>(&device)) return DeviceKind::Light;
+    if (dynamic_cast<const Thermostat*>(&device)) return DeviceKind::Thermostat;
+    if (dynamic_cast<const SecurityCamera*>(&device)) return DeviceKind::Camera;
+    return DeviceKind::Other;
+}
+
+} // namespace
+
+// one clause at a time, a clause that repeats a field must agree with it
+DeviceQuery DeviceQuery::parse(const std::string& text) {
+    DeviceQuery query;
+    query.text = text;
+    if (trim(text).empty()) {
+        queryError("empty query", text);
+    }
+    auto require = [&query](auto& field, auto value, auto unset) {
+        if (field != unset && field != value) query.contradictory = true;
+        field = value;
+    };
+    for (const std::string& clause : splitClauses(text)) {
+        std::string lower = lowercase(clause);
+        std::istringstream words(lower);
+        std::string first;
+        words >> first;
+        if (lower == "all") {
+            continue;
+        } else if (lower == "lights" || lower == "light") {
+            require(query.kind, DeviceKind::Light, DeviceKind::Unknown);
+        } else if (lower == "thermostats" || lower == "thermostat") {
+            require(query.kind, DeviceKind::Thermostat, DeviceKind::Unknown);
+        } else if (lower == "cameras" || lower == "camera") {
+            require(query.kind, DeviceKind::Camera, DeviceKind::Unknown);
+        } else if (lower == "on" || lower == "off") {
+            require(query.on, static_cast<std::int8_t>(lower == "on"), static_cast<std::int8_t>(-1));
+        } else if (lower == "recording" || lower == "not recording") {
+            require(query.recording, static_cast<std::int8_t>(lower == "recording"), static_cast<std::int8_t>(-1));
+        } else if (first == "at" || first == "in" || first == "named") {
+            std::string name = argument(clause, first.size());
+            if (name.empty()) queryError("expected a name", clause);
+            if (first == "at") {
+                require(query.location, name, std::string());
+            } else if (first == "in") {
+                if (!query.room.empty() && query.room != name) queryError("one room per query", clause);
+                query.room = name;
+            } else if (query.namePrefix.empty() || name.compare(0, query.namePrefix.size(), query.namePrefix) == 0) {
+                query.namePrefix = name; // the longer of two nested prefixes
+            } else if (query.namePrefix.compare(0, name.size(), name) != 0) {
+                query.contradictory = true;
+            }
+        } else if (first == "power") {
+            std::vector<std::string> rest;
+            for (std::string word; words >> word;) {
+                rest.push_back(word);
+            }
+            if (rest.size() == 2 && (rest[0] == "above" || rest[0] == "below")) {
+                float watts = parseWatts(rest[1], clause);
+                if (rest[0] == "above" && (watts > query.minPower || (watts == query.minPower && query.minInclusive))) {
+                    query.minPower = watts;
+                    query.minInclusive = false;
+                } else if (rest[0] == "below" && (watts < query.maxPower || (watts == query.maxPower && query.maxInclusive))) {
+                    query.maxPower = watts;
+                    query.maxInclusive = false;
+                }
+            } else if (rest.size() == 4 && rest[0] == "from" && rest[2] == "to") {
+                float low = parseWatts(rest[1], clause);
+                float high = parseWatts(rest[3], clause);
+                if (low > query.minPower) {
+                    query.minPower = low;
+                    query.minInclusive = true;
+                }
+                if (high < query.maxPower) {
+                    query.maxPower = high;
+                    query.maxInclusive = true;
+                }
+            } else {
+                queryError("expected power above|below <N> or power from <N> to <N>", clause);
+            }
+        } else {
+            queryError("unknown clause", clause);
+        }
+    }
+    if (query.minPower > query.maxPower ||
+        (query.minPower == query.maxPower && !(query.minInclusive && query.maxInclusive))) {
+        query.contradictory = true;
+    }
+    return query;
+}
+
+bool DeviceQuery::hasPowerRange() const {
+    return minPower != -std::numeric_limits<float>::infinity() || maxPower != std::numeric_limits<float>::infinity();
+}
+
+bool DeviceQuery::powerMatches(float watts) const {
+    return (minInclusive ? watts >= minPower : watts > minPower) && (maxInclusive ? watts <= maxPower : watts < maxPower);
+}
+
+DeviceIndex::DeviceIndex()
+    : liveCount(0)
+    , onCount(0)
+    , recordingCount(0)
+    , kindCount{}
+{}
+
+// called once before many additions, e.g. a layout
+void DeviceIndex::reserve(std::size_t count) {
+    std::size_t slots = devices.size() + count;
+    devices.reserve(slots);
+    kinds.reserve(slots);
+    power.reserve(slots);
+    names.reserve(slots);
+    locationOf.reserve(slots);
+    locationPosition.reserve(slots);
+    roomOf.reserve(slots);
+    slotByDevice.reserve(slotByDevice.size() + count);
+    powerDirty.reserve(powerDirty.size() + count);
+}
+
+std::uint32_t DeviceIndex::allocateSlot() {
+    if (!freeSlots.empty()) {
+        std::uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    std::uint32_t slot = static_cast<std::uint32_t>(devices.size());
+    devices.emplace_back();
+    kinds.push_back(DeviceKind::Unknown);
+    power.push_back(0.0f);
+    names.push_back(nullptr);
+    locationOf.push_back(noIndex);
+    locationPosition.push_back(0);
+    roomOf.push_back(noIndex);
+    std::size_t words = (devices.size() + 63) / 64;
+    if (liveBits.size() < words) {
+        liveBits.resize(words);
+        onBits.resize(words);
+        recordingBits.resize(words);
+        powerDirtyBits.resize(words);
+        for (auto& bits : kindBits) {
+            bits.resize(words);
+        }
+    }
+    return slot;
+}
+
+void DeviceIndex::setBit(std::vector<std::uint64_t>& bits, std::size_t& count, std::uint32_t slot, bool value) {
+    std::uint64_t mask = std::uint64_t{1} << (slot & 63);
+    std::uint64_t& word = bits[slot >> 6];
+    if (((word & mask) != 0) == value) {
+        return;
+    }
+    word ^= mask;
+    value ? ++count : --count;
+}
+
+void DeviceIndex::placeInLocation(std::uint32_t slot, const std::string& location) {
+    auto [it, inserted] = locationByName.try_emplace(location, static_cast<std::uint32_t>(locations.size()));
+    if (inserted) {
+        locations.push_back(Members{location, {}});
+    }
+    Members& members = locations[it->second];
+    locationOf[slot] = it->second;
+    locationPosition[slot] = static_cast<std::uint32_t>(members.slots.size());
+    members.slots.push_back(slot);
+}
+
+// swap with the last slot of the location, so leaving is O(1)
+void DeviceIndex::leaveLocation(std::uint32_t slot) {
+    std::vector<std::uint32_t>& slots = locations[locationOf[slot]].slots;
+    std::uint32_t moved = slots.back();
+    slots[locationPosition[slot]] = moved;
+    locationPosition[moved] = locationPosition[slot];
+    slots.pop_back();
+    locationOf[slot] = noIndex;
+}
+
+void DeviceIndex::markPowerDirty(std::uint32_t slot) {
+    if (!testBit(powerDirtyBits, slot)) {
+        powerDirtyBits[slot >> 6] |= std::uint64_t{1} << (slot & 63);
+        powerDirty.push_back(slot);
+    }
+}
+
+bool DeviceIndex::inRoom(std::uint32_t slot, std::uint32_t room) const {
+    if (roomOf[slot] == room) {
+        return true;
+    }
+    if (roomOf[slot] == noIndex || moreRooms.empty()) {
+        return false;
+    }
+    auto more = moreRooms.find(slot);
+    return more != moreRooms.end() && std::find(more->second.begin(), more->second.end(), room) != more->second.end();
+}
+
+// a slot's other rooms move up when it leaves its first
+void DeviceIndex::leaveRoom(std::uint32_t slot, std::uint32_t room) {
+    auto more = moreRooms.find(slot);
+    if (roomOf[slot] == room) {
+        if (more == moreRooms.end()) {
+            roomOf[slot] = noIndex;
+            return;
+        }
+        roomOf[slot] = more->second.back();
+        more->second.pop_back();
+    } else {
+        more->second.erase(std::find(more->second.begin(), more->second.end(), room));
+    }
+    if (more->second.empty()) {
+        moreRooms.erase(more);
+    }
+}
+
+void DeviceIndex::refresh(std::uint32_t slot) {
+    const Device& device = *devices[slot];
+    setBit(onBits, onCount, slot, device.getIsOn());
+    if (kinds[slot] == DeviceKind::Camera) {
+        setBit(recordingBits, recordingCount, slot, static_cast<const SecurityCamera&>(device).getIsRecording());
+    }
+    float watts = static_cast<float>(device.getPowerUsage());
+    if (watts != power[slot]) {
+        power[slot] = watts;
+        markPowerDirty(slot);
+    }
+}
+
+std::uint32_t DeviceIndex::add(const std::shared_ptr<Device>& device) {
+    auto [it, inserted] = slotByDevice.try_emplace(device.get(), 0);
+    if (!inserted) {
+        return it->second;
+    }
+    std::uint32_t slot = allocateSlot();
+    it->second = slot;
+    devices[slot] = device;
+    kinds[slot] = kindOf(*device);
+    names[slot] = &device->getDeviceName();
+    placeInLocation(slot, device->getDeviceLocation());
+    setBit(liveBits, liveCount, slot, true);
+    setBit(kindBits[static_cast<std::size_t>(kinds[slot])], kindCount[static_cast<std::size_t>(kinds[slot])], slot, true);
+    power[slot] = static_cast<float>(device->getPowerUsage());
+    markPowerDirty(slot);
+    refresh(slot);
+    return slot;
+}
+
+// the slot is freed at once, its power entry is dropped by the next repair
+std::uint32_t DeviceIndex::remove(const Device& device) {
+    auto it = slotByDevice.find(&device);
+    if (it == slotByDevice.end()) {
+        return noSlot;
+    }
+    std::uint32_t slot = it->second;
+    slotByDevice.erase(it);
+    while (roomOf[slot] != noIndex) {
+        std::vector<std::uint32_t>& slots = rooms[roomOf[slot]].slots;
+        slots.erase(std::find(slots.begin(), slots.end(), slot));
+        leaveRoom(slot, roomOf[slot]);
+    }
+    leaveLocation(slot);
+    setBit(liveBits, liveCount, slot, false);
+    setBit(onBits, onCount, slot, false);
+    setBit(recordingBits, recordingCount, slot, false);
+    setBit(kindBits[static_cast<std::size_t>(kinds[slot])], kindCount[static_cast<std::size_t>(kinds[slot])], slot, false);
+    markPowerDirty(slot);
+    devices[slot].reset();
+    names[slot] = nullptr;
+    freeSlots.push_back(slot);
+    return slot;
+}
+
+void DeviceIndex::addToRoom(const std::string& room, const Device& device) {
+    auto it = slotByDevice.find(&device);
+    if (it != slotByDevice.end()) {
+        joinRoom(it->second, roomIndex(room));
+    }
+}
+
+// one room lookup for all, the slots come from add() so no device is looked up again
+void DeviceIndex::addSlotsToRoom(const std::string& room, const std::vector<std::uint32_t>& slots) {
+    std::uint32_t index = roomIndex(room);
+    rooms[index].slots.reserve(rooms[index].slots.size() + slots.size());
+    for (std::uint32_t slot : slots) {
+        if (slot != noSlot) {
+            joinRoom(slot, index);
+        }
+    }
+}
+
+// a removed room's entry is reused first
+std::uint32_t DeviceIndex::roomIndex(const std::string& room) {
+    auto [it, inserted] = roomByName.try_emplace(room, static_cast<std::uint32_t>(rooms.size()));
+    if (!inserted) {
+        return it->second;
+    }
+    if (freeRooms.empty()) {
+        rooms.push_back(Members{room, {}});
+    } else {
+        it->second = freeRooms.back();
+        freeRooms.pop_back();
+        rooms[it->second].name = room;
+    }
+    return it->second;
+}
+
+void DeviceIndex::joinRoom(std::uint32_t slot, std::uint32_t room) {
+    if (inRoom(slot, room)) {
+        return;
+    }
+    if (roomOf[slot] == noIndex) {
+        roomOf[slot] = room;
+    } else {
+        moreRooms[slot].push_back(room);
+    }
+    rooms[room].slots.push_back(slot);
+}
+
+// the room's entry is emptied and freed for the next room added, so rooms added and removed over
+// time do not grow the index
+void DeviceIndex::removeRoom(const std::string& room) {
+    auto it = roomByName.find(room);
+    if (it == roomByName.end()) {
+        return;
+    }
+    Members& members = rooms[it->second];
+    for (std::uint32_t slot : members.slots) {
+        leaveRoom(slot, it->second);
+    }
+    members = Members();
+    freeRooms.push_back(it->second);
+    roomByName.erase(it);
+}
+
+std::uint32_t DeviceIndex::onDeviceChanged(const Device& device, DeviceChange change) {
+    auto it = slotByDevice.find(&device);
+    if (it == slotByDevice.end()) {
+        return noSlot;
+    }
+    std::uint32_t slot = it->second;
+    switch (change) {
+        case DeviceChange::Location:
+            leaveLocation(slot);
+            placeInLocation(slot, device.getDeviceLocation());
+            break;
+        case DeviceChange::Name:
+            break; // names point at the device's own, already changed
+        case DeviceChange::Motion:
+            break; // recording on motion reports its own change
+        default:
+            refresh(slot);
+            break;
+    }
+    return slot;
+}
+
+// stale entries out in one pass, the changed slots sorted on their own and merged back in
+void DeviceIndex::repairPowerOrder() {
+    if (powerDirty.empty()) {
+        return;
+    }
+    powerOrder.erase(std::remove_if(powerOrder.begin(), powerOrder.end(),
+        [this](const std::pair<float, std::uint32_t>& entry) { return testBit(powerDirtyBits, entry.second); }),
+        powerOrder.end());
+    std::size_t middle = powerOrder.size();
+    for (std::uint32_t slot : powerDirty) {
+        powerDirtyBits[slot >> 6] &= ~(std::uint64_t{1} << (slot & 63));
+        if (devices[slot]) {
+            powerOrder.emplace_back(power[slot], slot);
+        }
+    }
+    powerDirty.clear();
+    std::sort(powerOrder.begin() + static_cast<std::ptrdiff_t>(middle), powerOrder.end());
+    std::inplace_merge(powerOrder.begin(), powerOrder.begin() + static_cast<std::ptrdiff_t>(middle), powerOrder.end());
+}
+
+bool DeviceIndex::matches(std::uint32_t slot, const DeviceQuery& query, std::uint32_t location, std::uint32_t room) const {
+    if (!devices[slot]) return false;
+    if (query.kind != DeviceKind::Unknown && kinds[slot] != query.kind) return false;
+    if (query.on >= 0 && testBit(onBits, slot) != (query.on == 1)) return false;
+    if (query.recording >= 0 && testBit(recordingBits, slot) != (query.recording == 1)) return false;
+    if (location != noIndex && locationOf[slot] != location) return false;
+    if (room != noIndex && !inRoom(slot, room)) return false;
+    if (!query.powerMatches(power[slot])) return false;
+    return names[slot]->compare(0, query.namePrefix.size(), query.namePrefix) == 0;
+}
+
+// the smallest of: the location's or room's slots, the power range, or the bitsets ANDed a word at a time
+std::vector<std::uint32_t> DeviceIndex::matchingSlots(const DeviceQuery& query) {
+    std::vector<std::uint32_t> result;
+    if (query.contradictory) {
+        return result;
+    }
+    std::uint32_t location = noIndex;
+    std::uint32_t room = noIndex;
+    const std::vector<std::uint32_t>* candidates = nullptr;
+    if (!query.location.empty()) {
+        auto it = locationByName.find(query.location);
+        if (it == locationByName.end()) return result;
+        location = it->second;
+        candidates = &locations[location].slots;
+    }
+    if (!query.room.empty()) {
+        auto it = roomByName.find(query.room);
+        if (it == roomByName.end()) return result;
+        room = it->second;
+        if (!candidates || rooms[room].slots.size() < candidates->size()) {
+            candidates = &rooms[room].slots;
+        }
+    }
+
+    // the bitset scan visits every word but only the slots that pass the bit clauses
+    std::size_t bitEstimate = liveCount;
+    if (query.kind != DeviceKind::Unknown) bitEstimate = std::min(bitEstimate, kindCount[static_cast<std::size_t>(query.kind)]);
+    if (query.on >= 0) bitEstimate = std::min(bitEstimate, query.on ? onCount : liveCount - onCount);
+    if (query.recording >= 0) bitEstimate = std::min(bitEstimate, query.recording ? recordingCount : liveCount - recordingCount);
+
+    if (query.hasPowerRange() && (!candidates || candidates->size() > smallCandidateSet)) {
+        repairPowerOrder();
+        auto low = std::partition_point(powerOrder.begin(), powerOrder.end(),
+            [&query](const std::pair<float, std::uint32_t>& entry) {
+                return query.minInclusive ? entry.first < query.minPower : entry.first <= query.minPower;
+            });
+        auto high = std::partition_point(low, powerOrder.end(),
+            [&query](const std::pair<float, std::uint32_t>& entry) {
+                return query.maxInclusive ? entry.first <= query.maxPower : entry.first < query.maxPower;
+            });
+        std::size_t inRange = static_cast<std::size_t>(high - low);
+        if ((!candidates || inRange < candidates->size()) && inRange < bitEstimate) {
+            for (auto it = low; it != high; ++it) {
+                if (matches(it->second, query, location, room)) result.push_back(it->second);
+            }
+            std::sort(result.begin(), result.end());
+            return result;
+        }
+    }
+    if (candidates && candidates->size() <= bitEstimate) {
+        for (std::uint32_t slot : *candidates) {
+            if (matches(slot, query, location, room)) result.push_back(slot);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    const std::vector<std::uint64_t>* kindMask = query.kind != DeviceKind::Unknown ? &kindBits[static_cast<std::size_t>(query.kind)] : nullptr;
+    std::uint64_t onFlip = query.on == 0 ? ~std::uint64_t{0} : 0;
+    std::uint64_t recordingFlip = query.recording == 0 ? ~std::uint64_t{0} : 0;
+    for (std::size_t w = 0; w < liveBits.size(); ++w) {
+        std::uint64_t word = liveBits[w];
+        if (kindMask) word &= (*kindMask)[w];
+        if (query.on >= 0) word &= onBits[w] ^ onFlip;
+        if (query.recording >= 0) word &= recordingBits[w] ^ recordingFlip;
+        while (word) {
+            std::uint32_t slot = static_cast<std::uint32_t>(w * 64 + static_cast<std::size_t>(std::countr_zero(word)));
+            word &= word - 1;
+            if (matches(slot, query, location, room)) result.push_back(slot);
+        }
+    }
+    return result;
+}
+
+std::vector<std::shared_ptr<Device>> DeviceIndex::select(const DeviceQuery& query) {
+    std::vector<std::uint32_t> slots = matchingSlots(query);
+    std::vector<std::shared_ptr<Device>> selected;
+    selected.reserve(slots.size());
+    for (std::uint32_t slot : slots) {
+        selected.push_back(devices[slot]);
+    }
+    return selected;
+}
+
+std::size_t DeviceIndex::count(const DeviceQuery& query) {
+    return matchingSlots(query).size();
+}
+
+std::size_t DeviceIndex::size() const {
+    return liveCount;
+}
+
+std::size_t DeviceIndex::getSlotCount() const {
+    return devices.size();
+}
+
+const std::shared_ptr<Device>& DeviceIndex::deviceAt(std::uint32_t slot) const {
+    return devices[slot];
+}
+
+DeviceKind DeviceIndex::kindAt(std::uint32_t slot) const {
+    return kinds[slot];
+}
+
+const std::vector<std::uint32_t>& DeviceIndex::roomSlots(const std::string& room) const {
+    static const std::vector<std::uint32_t> none;
+    auto it = roomByName.find(room);
+    return it != roomByName.end() ? rooms[it->second].slots : none;
+}
+
+std::size_t DeviceIndex::getMemoryUsage() const {
+    std::size_t bytes = heapBytes(devices) + heapBytes(kinds) + heapBytes(power) + heapBytes(names) + heapBytes(locationOf)
+                      + heapBytes(locationPosition) + heapBytes(roomOf) + heapBytes(freeSlots) + hashTableBytes(slotByDevice)
+                      + hashTableBytes(moreRooms) + heapBytes(liveBits) + heapBytes(onBits) + heapBytes(recordingBits)
+                      + heapBytes(locations) + hashTableBytes(locationByName) + heapBytes(rooms) + heapBytes(freeRooms)
+                      + hashTableBytes(roomByName)
+                      + heapBytes(powerOrder) + heapBytes(powerDirty) + heapBytes(powerDirtyBits);
+    for (const auto& bits : kindBits) {
+        bytes += heapBytes(bits);
+    }
+    for (const auto& more : moreRooms) {
+        bytes += heapBytes(more.second);
+    }
+    for (const auto* members : {&locations, &rooms}) {
+        for (const auto& entry : *members) {
+            bytes += heapBytes(entry.name) + heapBytes(entry.slots);
+        }
+    }
+    for (const auto* names : {&locationByName, &roomByName}) {
+        for (const auto& entry : *names) {
+            bytes += heapBytes(entry.first);
+        }
+    }
+    return bytes;
+}
@@ -1,8 +1,12 @@
 // includes 
 #include "controllers/energy_monitor.hpp"
 #include "devices/device.hpp"
+#include "core/memory_usage.hpp"
+#include "core/metrics.hpp"
+#include "core/tracing.hpp"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
 // using statements
 using std::cout;
@@ -10,56 +14,160 @@ using std::endl;
 using std::fixed;
 using std::setprecision;
 
-// initialize instance to nullptr
-EnergyMonitor* EnergyMonitor::instance = nullptr; 
+EnergyMonitor::EnergyMonitor() : systemTotal(0.0), clock(&systemClock()) {}
 
-// get energy monitor instance and create it if it doesn't exist
+// get the default energy monitor, created on first use from any thread and never destroyed
 EnergyMonitor* EnergyMonitor::getInstance() {
-    if (!instance) {
-        instance = new EnergyMonitor();
-    }
+    static EnergyMonitor* const instance = new EnergyMonitor();
     return instance;
 }
 
+static const double millisPerHour = 3600.0 * 1000.0;
+
+// readings recorded, registered on first use
+static const Counter& readingsCounter() {
+    static const Counter counter = MetricsRegistry::getInstance()->counter(
+        "smart_home_energy_readings_total", "Power readings recorded by the energy monitor");
+    return counter;
+}
+
+// the previous reading held from when it was taken until now
+void EnergyMonitor::record(UsageRecord& entry, double watts, std::uint64_t now) {
+    if (now > entry.sinceMillis) {
+        entry.wattHours += entry.current * static_cast<double>(now - entry.sinceMillis) / millisPerHour;
+    }
+    entry.sinceMillis = now;
+    entry.current = watts;
+    entry.total += watts;
+    systemTotal += watts;
+}
+
 // record usage for a device
 void EnergyMonitor::recordUsage(
     const std::string& deviceID, double usage) {
+        TraceSpan span("EnergyMonitor::recordUsage", "energy", deviceID);
         // record usage for device and update total usage
-        currentUsage[deviceID] = usage;
-        totalUsage[deviceID] += usage;
+        readingsCounter().increment();
+        std::lock_guard<std::mutex> lock(usageMutex);
+        record(usageByDevice[deviceID], usage, clock->nowMillis());
+}
+
+// record usage for many devices, e.g. one control loop report
+void EnergyMonitor::recordUsageBatch(
+    const std::vector<std::pair<std::string, double>>& readings) {
+        TraceSpan span("EnergyMonitor::recordUsageBatch", "energy");
+        readingsCounter().increment(readings.size());
+        std::lock_guard<std::mutex> lock(usageMutex);
+        std::uint64_t now = clock->nowMillis();
+        for (const auto& reading : readings) {
+            record(usageByDevice[reading.first], reading.second, now);
+        }
+}
+
+// called once before many new devices report, e.g. a whole layout
+void EnergyMonitor::reserveDevices(
+    std::size_t count) {
+        std::lock_guard<std::mutex> lock(usageMutex);
+        usageByDevice.reserve(usageByDevice.size() + count);
 }
 
 // get current usage for a device 
 double EnergyMonitor::getCurrentUsage(
     const std::string& deviceID) const {
         // return current usage for device
-        auto it = currentUsage.find(deviceID);
-        return (it != currentUsage.end()) ? it->second : 0.0;
+        std::lock_guard<std::mutex> lock(usageMutex);
+        auto it = usageByDevice.find(deviceID);
+        return (it != usageByDevice.end()) ? it->second.current : 0.0;
 }
 
 // get total usage for a device
 double EnergyMonitor::getTotalUsage(
     const std::string& deviceID) const {
         // return total usage for device
-        auto it = totalUsage.find(deviceID);
-        return (it != totalUsage.end()) ? it->second : 0.0;
+        std::lock_guard<std::mutex> lock(usageMutex);
+        auto it = usageByDevice.find(deviceID);
+        return (it != usageByDevice.end()) ? it->second.total : 0.0;
 }
 
 // get total system usage
 double EnergyMonitor::getTotalSystemUsage() const {
-    // initialize total usage to 0
+    // running sum, no walk over the devices
+    std::lock_guard<std::mutex> lock(usageMutex);
+    return systemTotal;
+}
+
+// readings taken so far stay integrated up to their own timestamps on the old clock
+void EnergyMonitor::setClock(HomeClock* newClock) {
+    std::lock_guard<std::mutex> lock(usageMutex);
+    clock = newClock ? newClock : &systemClock();
+    std::uint64_t now = clock->nowMillis();
+    for (auto& pair : usageByDevice) {
+        pair.second.sinceMillis = now;
+    }
+}
+
+HomeClock& EnergyMonitor::getClock() const {
+    std::lock_guard<std::mutex> lock(usageMutex);
+    return *clock;
+}
+
+// get energy used by a device, including the latest reading up to now
+double EnergyMonitor::getEnergyWattHours(const std::string& deviceID) const {
+    std::lock_guard<std::mutex> lock(usageMutex);
+    auto it = usageByDevice.find(deviceID);
+    if (it == usageByDevice.end()) {
+        return 0.0;
+    }
+    std::uint64_t now = clock->nowMillis();
+    const UsageRecord& entry = it->second;
+    return entry.wattHours + (now > entry.sinceMillis ? entry.current * static_cast<double>(now - entry.sinceMillis) / millisPerHour : 0.0);
+}
+
+// get energy used by all devices up to now
+double EnergyMonitor::getTotalEnergyWattHours() const {
+    std::lock_guard<std::mutex> lock(usageMutex);
+    std::uint64_t now = clock->nowMillis();
     double total = 0.0;
-    // iterate through devices and sum total usage
-    for (const auto& pair : totalUsage) {
-        total += pair.second;
+    for (const auto& pair : usageByDevice) {
+        const UsageRecord& entry = pair.second;
+        total += entry.wattHours + (now > entry.sinceMillis ? entry.current * static_cast<double>(now - entry.sinceMillis) / millisPerHour : 0.0);
     }
     return total;
 }
 
+// get the number of devices with readings
+std::size_t EnergyMonitor::getDeviceCount() const {
+    std::lock_guard<std::mutex> lock(usageMutex);
+    return usageByDevice.size();
+}
+
+// get the bytes of the per-device records
+std::size_t EnergyMonitor::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(usageMutex);
+    std::size_t bytes = hashTableBytes(usageByDevice);
+    for (const auto& usage : usageByDevice) {
+        bytes += heapBytes(usage.first);
+    }
+    return bytes;
+}
+
+// reports print from a copy, so readings are recorded while the console writes
+std::vector<std::pair<std::string, EnergyMonitor::UsageRecord>> EnergyMonitor::sortedUsage() const {
+    std::vector<std::pair<std::string, UsageRecord>> sorted;
+    {
+        std::lock_guard<std::mutex> lock(usageMutex);
+        sorted.assign(usageByDevice.begin(), usageByDevice.end());
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    return sorted;
+}
+
 // display current usage for all devices
 void EnergyMonitor::displayCurrentUsage() const {
+    TraceSpan span("EnergyMonitor::displayCurrentUsage", "console");
     cout << "\n=== Current Device Usage ===\n";
-    if (currentUsage.empty()) {
+    auto usage = sortedUsage();
+    if (usage.empty()) {
         cout << "No devices currently in use.\n";
         return;
     }
@@ -69,9 +177,9 @@ void EnergyMonitor::displayCurrentUsage() const {
     cout << fixed << setprecision(2);
 
     // for each device, display power usage
-    for (const auto& pair : currentUsage) {
-        cout << "Device: " << pair.first << " | Usage: " << pair.second << " watts\n";
-        totalPower += pair.second;
+    for (const auto& pair : usage) {
+        cout << "Device: " << pair.first << " | Usage: " << pair.second.current << " watts\n";
+        totalPower += pair.second.current;
     }
 
     cout << "Total Current Power Usage: " << totalPower << " W\n";
@@ -79,9 +187,11 @@ void EnergyMonitor::displayCurrentUsage() const {
 
 // display total usage for all devices being used
 void EnergyMonitor::displayTotalUsage() const {
+    TraceSpan span("EnergyMonitor::displayTotalUsage", "console");
     cout << "\n=== Total Device Usage ===\n";
+    auto usage = sortedUsage();
     // check if there are devices in use
-    if (totalUsage.empty()) {
+    if (usage.empty()) {
         cout << "No devices currently in use.\n";
         return;
     }
@@ -91,9 +201,9 @@ void EnergyMonitor::displayTotalUsage() const {
     cout << fixed << setprecision(2);
 
     // for each device, display total energy usage
-    for (const auto& pair : totalUsage) {
-        cout << "Device: " << pair.first << " | Usage: " << pair.second << " watts\n";
-        totalEnergy += pair.second;
+    for (const auto& pair : usage) {
+        cout << "Device: " << pair.first << " | Usage: " << pair.second.total << " watts\n";
+        totalEnergy += pair.second.total;
     }
 
     cout << "Total Energy Consumed: " << totalEnergy << " W\n";
@@ -101,6 +211,10 @@ void EnergyMonitor::displayTotalUsage() const {
 
 // generate energy report for all devices
 void EnergyMonitor::generateReport() const {
+    TraceSpan span("EnergyMonitor::generateReport", "console");
+    static const Histogram duration = MetricsRegistry::getInstance()->histogram(
+        "smart_home_energy_report_duration_seconds", "Time to build and print an energy report");
+    ScopedLatency timer(duration);
     cout << "\n=== Energy Report ===\n";
     cout << fixed << setprecision(2);
 
@@ -117,6 +231,12 @@ void EnergyMonitor::generateReport() const {
     // system summary 
     cout << "\nSystem Summary:\n";
     cout << "---------------\n";
-    cout << "Total Devices Monitored: " << currentUsage.size() << "\n";
+    std::size_t monitored;
+    {
+        std::lock_guard<std::mutex> lock(usageMutex);
+        monitored = usageByDevice.size();
+    }
+    cout << "Total Devices Monitored: " << monitored << "\n";
     cout << "Total System Power Usage: " << getTotalSystemUsage() << " W\n";
+    cout << "Energy Consumed: " << getTotalEnergyWattHours() / 1000.0 << " kWh\n";
 }
@@ -4,11 +4,18 @@
 #include "devices/thermostat.hpp"
 #include "controllers/room_controller.hpp"
 #include "controllers/energy_monitor.hpp"
+#include "core/logger.hpp"
+#include "core/metrics.hpp"
+#include "core/string_pool.hpp"
+#include "core/tracing.hpp"
+#include "devices/async_device.hpp"
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
 #include <memory>
 #include <limits>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -26,51 +33,582 @@ using std::exception;
 using std::numeric_limits;
 using std::vector;
 
+// held while touching devices the thermostat control worker or the command server also uses
+using DeviceLock = std::lock_guard<std::mutex>;
+
+// batches below this size run on the calling thread, handing them out costs more than it saves
+static const size_t parallelBatchThreshold = 1024;
+
+// device shards per executor worker, so a worker that finishes early can steal from a slow one
+static const size_t shardsPerWorker = 4;
+
+// device changes made by executor tasks, held back until the caller replays them under the lock
+struct DeferredChange {
+    Device* device;
+    DeviceChange change;
+};
+
+static thread_local vector<DeferredChange>* deferredChanges = nullptr;
+
+// routes the calling thread's device changes into a shard's buffer for one scope
+struct DeferChanges {
+    vector<DeferredChange>* previous;
+    explicit DeferChanges(vector<DeferredChange>& buffer) : previous(deferredChanges) { deferredChanges = &buffer; }
+    ~DeferChanges() { deferredChanges = previous; }
+};
+
 // singleton instance
 HomeController* HomeController::instance = nullptr;
 
-// singleton instance getter method
+// constructor, the scheduler clock starts now
+HomeController::HomeController(EnergyMonitor* monitor, StringPool* pool)
+    : ownedEnergy(monitor ? nullptr : make_unique<EnergyMonitor>())
+    , energy(monitor ? monitor : ownedEnergy.get())
+    , ownedStrings(pool ? nullptr : make_unique<StringPool>())
+    , strings(pool ? pool : ownedStrings.get())
+    , clock(&systemClock())
+    , clockOffset(static_cast<std::int64_t>(systemClock().nowMillis()))
+{
+    thermostatControl.setEnergyMonitor(energy);
+    thermostatControl.setDeviceMutex(&deviceMutex);
+}
+
+// devices can outlive the home, they report to the default monitor again, lose their observer and
+// keep their location in the default pool
+HomeController::~HomeController() {
+    thermostatControl.stop();
+    if (executor) {
+        executor->shutdown();
+    }
+    DeviceLock guard(deviceMutex);
+    for (const auto& device : devices) {
+        device->setObserver(nullptr);
+        device->setEnergyMonitor(nullptr);
+        device->setStringPool(nullptr);
+    }
+}
+
+// default home instance getter method, on the default energy monitor and string pool
 HomeController* HomeController::getInstance() {
     if (instance == nullptr) {
-        instance = new HomeController();
+        instance = new HomeController(EnergyMonitor::getInstance(), StringPool::getInstance());
     }
     return instance;
 }
 
+// Function to start the executor on first use
+WorkStealingPool& HomeController::pool() const {
+    std::lock_guard<std::mutex> guard(executorMutex);
+    if (!executor) {
+        executor = make_unique<WorkStealingPool>();
+    }
+    return *executor;
+}
+
 // function to add a device
 void HomeController::addDevice(shared_ptr<Device> device) {
+    TraceSpan span("HomeController::addDevice", "home", device->getDeviceID());
+    DeviceLock guard(deviceMutex);
+    device->setStringPool(strings); // before the snapshot takes the location
     devices.push_back(device);
-    cout << "Device added successfully.\n";
+    deviceIndex.emplace(device->getDeviceID(), device); // the first device with an ID keeps it
+    automation.registerDevice(device);
+    snapshots.deviceChanged(queryIndex.add(device));
+    device->setObserver(this);
+    device->setEnergyMonitor(energy);
+    if (auto thermostat = dynamic_pointer_cast<Thermostat>(device)) {
+        thermostatControl.addThermostat(thermostat);
+    }
+    if (devices.size() == parallelBatchThreshold) {
+        thermostatControl.setExecutor(&pool()); // large enough for control ticks to be split
+    }
+    logInfo("Device added successfully.");
 }
 
 // function to remove a device
 void HomeController::removeDevice(const string& deviceID) {
+    TraceSpan span("HomeController::removeDevice", "home", deviceID);
+    DeviceLock guard(deviceMutex);
     auto initialSize = devices.size();
+    deviceIndex.erase(deviceID); // first, its key views the ID of a device about to go
     devices.erase(
         remove_if(devices.begin(), devices.end(),
-            [&deviceID](const auto& device) {
-                return device->getDeviceID() == deviceID;
+            [this, &deviceID](const auto& device) {
+                if (device->getDeviceID() != deviceID) {
+                    return false;
+                }
+                automation.unregisterDevice(*device);
+                snapshots.deviceChanged(queryIndex.remove(*device));
+                snapshots.roomsChanged(); // it leaves its rooms
+                thermostatControl.removeThermostat(deviceID);
+                device->setObserver(nullptr);
+                device->setEnergyMonitor(nullptr);
+                device->setStringPool(nullptr);
+                return true;
             }
         ),
         devices.end()
     );
     if (devices.size() < initialSize) {
-        cout << "Device removed successfully.\n";
+        commandQueues.erase(deviceID);
+        logInfo("Device removed successfully.");
     } else {
-        cout << "Device not found.\n";
+        logWarning("Device not found.");
     }
 }
 
+// function to add a whole layout under one lock, logging a summary instead of every device
+size_t HomeController::loadLayout(const HomeLayout& layout) {
+    TraceSpan span("HomeController::loadLayout", "home");
+    DeviceLock guard(deviceMutex);
+    std::unordered_map<string, RoomController*> roomByName;
+    for (const auto& room : rooms) {
+        roomByName.emplace(room->getRoomName(), room.get());
+    }
+    vector<RoomController*> layoutRooms;
+    layoutRooms.reserve(layout.rooms.size());
+    for (const auto& roomName : layout.rooms) {
+        auto it = roomByName.find(roomName);
+        if (it == roomByName.end()) {
+            rooms.push_back(make_unique<RoomController>(roomName));
+            automation.addRoom(roomName);
+            it = roomByName.emplace(roomName, rooms.back().get()).first;
+        }
+        layoutRooms.push_back(it->second);
+    }
+
+    // devices grouped by room, the last group holds the ones without a room, with their index slots
+    vector<vector<shared_ptr<Device>>> roomDevices(layout.rooms.size() + 1);
+    vector<vector<uint32_t>> roomSlots(layout.rooms.size());
+    vector<pair<string, double>> readings; // devices the layout turned on, parsed unmetered
+    devices.reserve(devices.size() + layout.devices.size());
+    deviceIndex.reserve(deviceIndex.size() + layout.devices.size());
+    queryIndex.reserve(layout.devices.size());
+    size_t added = 0;
+    for (size_t i = 0; i < layout.devices.size(); ++i) {
+        const auto& device = layout.devices[i];
+        if (!deviceIndex.emplace(device->getDeviceID(), device).second) {
+            continue; // the device already in the home keeps the ID
+        }
+        devices.push_back(device);
+        device->setStringPool(strings);
+        uint32_t slot = queryIndex.add(device);
+        snapshots.deviceChanged(slot);
+        device->setObserver(this);
+        device->setEnergyMonitor(energy);
+        device->setMetered(true);
+        if (device->getIsOn()) {
+            readings.emplace_back(device->getDeviceID(), device->getPowerUsage());
+        }
+        if (auto thermostat = dynamic_pointer_cast<Thermostat>(device)) {
+            thermostatControl.addThermostat(thermostat);
+        }
+        bool inRoom = i < layout.deviceRoom.size() && layout.deviceRoom[i] >= 0;
+        size_t room = inRoom ? static_cast<size_t>(layout.deviceRoom[i]) : layout.rooms.size();
+        roomDevices[room].push_back(device);
+        if (inRoom) {
+            roomSlots[room].push_back(slot);
+        }
+        ++added;
+    }
+    energy->reserveDevices(readings.size());
+    energy->recordUsageBatch(readings);
+    automation.reserveDevices(added);
+    for (size_t r = 0; r < layoutRooms.size(); ++r) {
+        layoutRooms[r]->addDevices(roomDevices[r]);
+        automation.registerDevices(roomDevices[r], layout.rooms[r]);
+        queryIndex.addSlotsToRoom(layout.rooms[r], roomSlots[r]);
+    }
+    automation.registerDevices(roomDevices.back(), "");
+    snapshots.roomsChanged();
+    publishChanges();
+    if (devices.size() >= parallelBatchThreshold) {
+        thermostatControl.setExecutor(&pool()); // large enough for control ticks to be split
+    }
+    if (added < layout.devices.size()) {
+        logWarning(layout.devices.size() - added, " layout devices skipped, their IDs are already in use");
+    }
+    logInfo("Layout loaded: ", added, " devices in ", layout.rooms.size(), " rooms");
+    return added;
+}
+
+// function to list the devices
+vector<shared_ptr<Device>> HomeController::getDevices() const {
+    DeviceLock guard(deviceMutex);
+    return devices;
+}
+
+// function to select devices with a query, through the secondary indexes
+vector<shared_ptr<Device>> HomeController::selectDevices(const string& query) {
+    TraceSpan span("HomeController::selectDevices", "home", query);
+    DeviceQuery parsed = DeviceQuery::parse(query);
+    DeviceLock guard(deviceMutex);
+    return queryIndex.select(parsed);
+}
+
+// function to count the devices a query selects
+size_t HomeController::countDevices(const string& query) {
+    DeviceQuery parsed = DeviceQuery::parse(query);
+    DeviceLock guard(deviceMutex);
+    return queryIndex.count(parsed);
+}
+
 // function to show the devices
 void HomeController::showDevices() const {
-    if (devices.empty()) {
+    showDevices(*readCurrentSnapshot());
+}
+
+// function to show the devices of a version, numbered in the order findNth counts them
+void HomeController::showDevices(const HomeSnapshot& snapshot) const {
+    TraceSpan span("HomeController::showDevices", "console");
+    if (snapshot.getDeviceCount() == 0) {
         cout << "No devices available.\n";
         return;
     }
     cout << "\nDevices Available:\n";
-    for (size_t i = 0; i < devices.size(); i++) {
-        cout << i + 1 << ". " << devices[i]->getDeviceStatus() << "\n";
+    size_t number = 0;
+    snapshot.forEachDevice([&number](const DeviceView& view) {
+        cout << ++number << ". " << view.status() << "\n";
+    });
+}
+
+// function to read the latest snapshot without the device mutex; until the first one is
+// published, the first reader publishes it under the mutex
+PinnedSnapshot HomeController::readSnapshot() const {
+    EpochDomain::ReadGuard guard = EpochDomain::getInstance()->read();
+    const HomeSnapshot* snapshot = snapshots.load(guard);
+    if (!snapshot) {
+        DeviceLock lock(deviceMutex);
+        if (!snapshots.isPublishing()) {
+            snapshots.publish(queryIndex, rooms);
+        }
+        snapshot = snapshots.load(guard);
+    }
+    return PinnedSnapshot(std::move(guard), snapshot);
+}
+
+// function to read a snapshot with every change made so far, for readers like the console that
+// must not show a device as it was before the last command
+PinnedSnapshot HomeController::readCurrentSnapshot() const {
+    {
+        DeviceLock lock(deviceMutex);
+        if (!snapshots.isPublishing() || snapshots.hasChanges()) {
+            snapshots.publish(queryIndex, rooms);
+        }
+    }
+    return readSnapshot(); // the version just published or a later one
+}
+
+// function to publish the changes since the last snapshot
+std::uint64_t HomeController::publishSnapshot() {
+    TraceSpan span("HomeController::publishSnapshot", "home");
+    DeviceLock guard(deviceMutex);
+    if (!snapshots.isPublishing() || snapshots.hasChanges()) {
+        return snapshots.publish(queryIndex, rooms);
+    }
+    return snapshots.getVersion();
+}
+
+// function to publish pending changes at the end of a bulk operation, once anyone reads snapshots
+void HomeController::publishChanges() {
+    if (snapshots.isPublishing() && snapshots.hasChanges()) {
+        TraceSpan span("HomeController::publishSnapshot", "home");
+        snapshots.publish(queryIndex, rooms);
+    }
+}
+
+// function to find a device by ID
+shared_ptr<Device> HomeController::findDevice(const string& deviceId) const {
+    DeviceLock guard(deviceMutex);
+    return findDeviceLocked(deviceId);
+}
+
+shared_ptr<Device> HomeController::findDeviceLocked(const string& deviceId) const {
+    auto it = deviceIndex.find(deviceId);
+    return it != deviceIndex.end() ? it->second : nullptr;
+}
+
+// function to access the device mutex, for callers that batch several calls under it
+std::mutex& HomeController::getDeviceMutex() const {
+    return deviceMutex;
+}
+
+// command metrics: one counter per result, latency timed for 1 in 16 commands
+struct CommandMetrics {
+    vector<Counter> byResult;
+    Histogram duration;
+};
+
+static const CommandMetrics& commandMetrics() {
+    static const CommandMetrics metrics = [] {
+        static const char* const results[] = {"ok", "invalid_brightness", "invalid_color", "invalid_temperature",
+                                              "invalid_mode", "invalid_resolution", "invalid_rotation", "device_off",
+                                              "not_supported", "unknown_device", "timeout"};
+        MetricsRegistry* registry = MetricsRegistry::getInstance();
+        vector<Counter> counters;
+        for (const char* result : results) {
+            counters.push_back(registry->counter("smart_home_commands_total", "Device commands by result",
+                                                 string("result=\"") + result + "\""));
+        }
+        return CommandMetrics{counters, registry->histogram("smart_home_command_duration_seconds",
+                                                            "Device command latency, sampled 1 in 16", "", 16)};
+    }();
+    return metrics;
+}
+
+// Function to apply a command without throwing on invalid input
+DeviceResult HomeController::applyCommand(const string& deviceId, const DeviceCommand& command) {
+    DeviceLock guard(deviceMutex);
+    return applyCommandLocked(deviceId, command);
+}
+
+DeviceResult HomeController::applyCommandLocked(const string& deviceId, const DeviceCommand& command) {
+    TraceSpan span("HomeController::applyCommand", "home", deviceId);
+    const CommandMetrics& metrics = commandMetrics();
+    ScopedLatency timer(metrics.duration);
+    DeviceResult result = DeviceResult::UnknownDevice;
+    if (auto device = findDeviceLocked(deviceId)) {
+        result = device->applyCommand(command);
+    }
+    metrics.byResult[static_cast<size_t>(result)].increment();
+    return result;
+}
+
+// Function to apply a batch of commands, one result per command
+size_t HomeController::applyCommands(const vector<std::pair<string, DeviceCommand>>& commands,
+                                     vector<DeviceResult>& results) {
+    TraceSpan span("HomeController::applyCommands", "home");
+    results.clear();
+    results.reserve(commands.size());
+    size_t succeeded = 0;
+    DeviceLock guard(deviceMutex);
+    if (commands.size() < parallelBatchThreshold || pool().getWorkerCount() == 1) {
+        for (const auto& entry : commands) {
+            results.push_back(applyCommandLocked(entry.first, entry.second));
+            succeeded += results.back() == DeviceResult::Ok ? 1 : 0;
+        }
+        publishChanges();
+        return succeeded;
+    }
+
+    // commands are sharded by device, so each device sees its commands in batch order; automation
+    // rules and telemetry see the changes after the whole batch, in shard order
+    size_t shardCount = pool().getWorkerCount() * shardsPerWorker;
+    vector<vector<size_t>> shards(shardCount);
+    std::hash<string> hashId;
+    for (size_t i = 0; i < commands.size(); ++i) {
+        shards[hashId(commands[i].first) % shardCount].push_back(i);
+    }
+    results.assign(commands.size(), DeviceResult::UnknownDevice);
+    const CommandMetrics& metrics = commandMetrics();
+    runDeviceShards(shardCount, [this, &commands, &shards, &results, &metrics](size_t shard) {
+        for (size_t i : shards[shard]) {
+            auto it = deviceIndex.find(commands[i].first);
+            if (it != deviceIndex.end()) {
+                results[i] = it->second->applyCommand(commands[i].second);
+            }
+            metrics.byResult[static_cast<size_t>(results[i])].increment();
+        }
+    });
+    publishChanges();
+    return static_cast<size_t>(std::count(results.begin(), results.end(), DeviceResult::Ok));
+}
+
+// queued command metrics: commands queued, writes coalesced away and commands applied on flush
+struct QueueMetrics {
+    Counter queued;
+    Counter coalesced;
+    Counter applied;
+};
+
+static const QueueMetrics& queueMetrics() {
+    static const QueueMetrics metrics = [] {
+        MetricsRegistry* registry = MetricsRegistry::getInstance();
+        const char* help = "Queued device commands by outcome";
+        return QueueMetrics{registry->counter("smart_home_command_queue_total", help, "outcome=\"queued\""),
+                            registry->counter("smart_home_command_queue_total", help, "outcome=\"coalesced\""),
+                            registry->counter("smart_home_command_queue_total", help, "outcome=\"applied\"")};
+    }();
+    return metrics;
+}
+
+// Function to queue a command for a device, replacing a pending write it supersedes
+DeviceResult HomeController::queueCommand(const string& deviceId, const DeviceCommand& command) {
+    DeviceLock guard(deviceMutex);
+    auto device = findDeviceLocked(deviceId);
+    if (!device) {
+        commandMetrics().byResult[static_cast<size_t>(DeviceResult::UnknownDevice)].increment();
+        return DeviceResult::UnknownDevice;
+    }
+    const QueueMetrics& metrics = queueMetrics();
+    DeviceCommandQueue& queue = commandQueues[deviceId];
+    if (queue.empty()) {
+        queuedDevices.push_back(deviceId);
+    }
+    metrics.queued.increment();
+    if (queue.push(*device, command)) {
+        metrics.coalesced.increment();
+    }
+    return DeviceResult::Ok;
+}
+
+// Function to apply the queued commands, device by device in the order they were first queued
+size_t HomeController::flushCommandQueues() {
+    DeviceLock guard(deviceMutex);
+    return flushCommandQueuesLocked();
+}
+
+size_t HomeController::flushCommandQueuesLocked() {
+    TraceSpan span("HomeController::flushCommandQueues", "home");
+    const CommandMetrics& metrics = commandMetrics();
+    size_t applied = 0;
+    vector<DeviceResult> results;
+    for (const string& deviceId : queuedDevices) {
+        auto queueIt = commandQueues.find(deviceId);
+        auto device = findDeviceLocked(deviceId);
+        if (queueIt == commandQueues.end() || !device) {
+            continue; // removed since
+        }
+        results.clear();
+        queueIt->second.flush(*device, &results);
+        for (DeviceResult result : results) {
+            metrics.byResult[static_cast<size_t>(result)].increment();
+        }
+        applied += results.size();
     }
+    queuedDevices.clear();
+    queueMetrics().applied.increment(applied);
+    return applied;
+}
+
+// Function to count the commands waiting for the next flush
+size_t HomeController::getPendingCommandCount() const {
+    DeviceLock guard(deviceMutex);
+    size_t pending = 0;
+    for (const string& deviceId : queuedDevices) {
+        auto queueIt = commandQueues.find(deviceId);
+        pending += queueIt != commandQueues.end() ? queueIt->second.size() : 0;
+    }
+    return pending;
+}
+
+// Function to run device work on the executor, shard i queued on worker i % workers so repeated
+// work on the same shard stays on the same core; the caller holds the device mutex
+void HomeController::runDeviceShards(size_t shardCount, const std::function<void(size_t)>& work) {
+    vector<vector<DeferredChange>> changes(shardCount);
+    pool().parallelFor(shardCount, 1, [&work, &changes](size_t begin, size_t end) {
+        for (size_t shard = begin; shard < end; ++shard) {
+            DeferChanges defer(changes[shard]);
+            work(shard);
+        }
+    });
+    for (const auto& shard : changes) {
+        for (const DeferredChange& entry : shard) {
+            onDeviceChanged(*entry.device, entry.change);
+        }
+    }
+}
+
+// Function to send a command to a device and resume once it answers, on a transport worker thread
+Task<DeviceResult> HomeController::applyCommandAsync(DeviceTransport& transport, string deviceId, DeviceCommand command) {
+    shared_ptr<Device> device;
+    {
+        DeviceLock guard(deviceMutex);
+        device = findDeviceLocked(deviceId);
+    }
+    DeviceResult result = co_await ::applyCommandAsync(transport, device, std::move(command), &deviceMutex);
+    commandMetrics().byResult[static_cast<size_t>(result)].increment();
+    co_return result;
+}
+
+// Function to run a batch of commands concurrently; the caller must not hold the device mutex,
+// since the transport workers take it to apply the answered commands
+size_t HomeController::applyCommandsAsync(DeviceTransport& transport, const vector<std::pair<string, DeviceCommand>>& commands,
+                                          vector<DeviceResult>& results) {
+    TraceSpan span("HomeController::applyCommandsAsync", "home");
+    vector<Task<DeviceResult>> tasks;
+    tasks.reserve(commands.size());
+    for (const auto& entry : commands) {
+        tasks.push_back(applyCommandAsync(transport, entry.first, entry.second));
+    }
+    results = syncWait(whenAll(std::move(tasks)));
+    return static_cast<size_t>(std::count(results.begin(), results.end(), DeviceResult::Ok));
+}
+
+// Function to switch a whole room concurrently, 0 if there is no such room; the room's devices are
+// copied under the lock, so removing the room while the commands are in flight is safe
+Task<size_t> HomeController::setRoomPowerAsync(DeviceTransport& transport, string roomName, bool on) {
+    vector<shared_ptr<Device>> roomDevices;
+    {
+        DeviceLock guard(deviceMutex);
+        auto roomIt = find_if(rooms.begin(), rooms.end(),
+            [&roomName](const auto& room) {
+                return room->getRoomName() == roomName;
+            }
+        );
+        if (roomIt == rooms.end()) {
+            logWarning("Room not found.");
+            co_return 0;
+        }
+        roomDevices = (*roomIt)->getDevices();
+    }
+    co_return co_await RoomController::setDevicesPowerAsync(transport, std::move(roomName), std::move(roomDevices), on, &deviceMutex);
+}
+
+// Function to switch a whole room, large rooms in contiguous shards on the executor
+size_t HomeController::setRoomPower(const string& roomName, bool on) {
+    TraceSpan span(on ? "HomeController::setRoomPowerOn" : "HomeController::setRoomPowerOff", "home", roomName);
+    DeviceLock guard(deviceMutex);
+    auto roomIt = find_if(rooms.begin(), rooms.end(),
+        [&roomName](const auto& room) {
+            return room->getRoomName() == roomName;
+        }
+    );
+    if (roomIt == rooms.end()) {
+        logWarning("Room not found.");
+        return 0;
+    }
+    vector<shared_ptr<Device>> roomDevices = (*roomIt)->getDevices();
+    if (roomDevices.size() < parallelBatchThreshold || pool().getWorkerCount() == 1) {
+        on ? (*roomIt)->turnAllDevicesOn() : (*roomIt)->turnAllDevicesOff();
+    } else {
+        size_t shardCount = pool().getWorkerCount() * shardsPerWorker;
+        runDeviceShards(shardCount, [&roomDevices, shardCount, on](size_t shard) {
+            size_t end = roomDevices.size() * (shard + 1) / shardCount;
+            for (size_t i = roomDevices.size() * shard / shardCount; i < end; ++i) {
+                on ? roomDevices[i]->turnOn() : roomDevices[i]->turnOff();
+            }
+        });
+    }
+    publishChanges();
+    return roomDevices.size();
+}
+
+// Function to apply one command to every selected device, large selections in contiguous shards
+// on the executor; the devices' changes reach the indexes once the whole selection is done
+size_t HomeController::applyToSelection(const string& query, const DeviceCommand& command) {
+    TraceSpan span("HomeController::applyToSelection", "home", query);
+    DeviceQuery parsed = DeviceQuery::parse(query);
+    const CommandMetrics& metrics = commandMetrics();
+    DeviceLock guard(deviceMutex);
+    vector<shared_ptr<Device>> selected = queryIndex.select(parsed);
+    vector<DeviceResult> results(selected.size(), DeviceResult::UnknownDevice);
+    auto applyRange = [&selected, &results, &command, &metrics](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            results[i] = selected[i]->applyCommand(command);
+            metrics.byResult[static_cast<size_t>(results[i])].increment();
+        }
+    };
+    if (selected.size() < parallelBatchThreshold || pool().getWorkerCount() == 1) {
+        applyRange(0, selected.size());
+    } else {
+        size_t shardCount = pool().getWorkerCount() * shardsPerWorker;
+        runDeviceShards(shardCount, [&selected, &applyRange, shardCount](size_t shard) {
+            applyRange(selected.size() * shard / shardCount, selected.size() * (shard + 1) / shardCount);
+        });
+    }
+    publishChanges();
+    return static_cast<size_t>(std::count(results.begin(), results.end(), DeviceResult::Ok));
 }
 
 // Function to display the home page
@@ -82,15 +620,22 @@ void HomeController::showMenu() const {
          << "4. Remove Device\n"
          << "5. Room Management\n"
          << "6. Energy Monitoring\n"
-         << "7. Exit\n"
+         << "7. Automation Rules\n"
+         << "8. Diagnostics\n"
+         << "9. Select Devices\n"
+         << "10. Exit\n"
          << "Please select an option: ";
 }
 
 // Function to run the controller
 void HomeController::run() {
     cout << "Welcome to Smart Home System!\n";
+    Tracer::getInstance()->setThreadName("main");
+    thermostatControl.start();
 
     while (true) {
+        Logger::getInstance()->flush(); // queued library messages come before the menu
+        updateScheduler();
         showMenu();
         int choice;
         if (!(cin >> choice)) {
@@ -108,15 +653,24 @@ void HomeController::run() {
                     break;
 
                 case 2: {
-                    if (devices.empty()) {
-                        cout << "No devices available to control.\n";
-                        break;
+                    string deviceId;
+                    {
+                        // one version for the list, the count and the pick, so the number means what was shown
+                        PinnedSnapshot snapshot = readCurrentSnapshot();
+                        if (snapshot->getDeviceCount() == 0) {
+                            cout << "No devices available to control.\n";
+                            break;
+                        }
+                        showDevices(*snapshot);
+                        cout << "Please select a device to control (1-" << snapshot->getDeviceCount() << "): ";
+                        size_t deviceNumber;
+                        const DeviceView* selected = nullptr;
+                        if (cin >> deviceNumber && deviceNumber > 0 && (selected = snapshot->findNth(deviceNumber - 1))) {
+                            deviceId = selected->id; // the view goes with the snapshot
+                        }
                     }
-                    showDevices();
-                    cout << "Please select a device to control (1-" << devices.size() << "): ";
-                    size_t deviceNumber;
-                    if (cin >> deviceNumber && deviceNumber > 0 && deviceNumber <= devices.size()) {
-                        handleDeviceControl(devices[deviceNumber - 1]);
+                    if (auto device = deviceId.empty() ? nullptr : findDevice(deviceId)) {
+                        handleDeviceControl(device);
                     } else {
                         cout << "Invalid device number.\n";
                     }
@@ -151,13 +705,13 @@ void HomeController::run() {
                     try {
                         switch (deviceType) {
                             case 1:
-                                addDevice(make_shared<SmartLight>(id, name, location));
+                                addDevice(make_shared<SmartLight>(id, name, location, strings));
                                 break;
                             case 2:
-                                addDevice(make_shared<Thermostat>(id, name, location));
+                                addDevice(make_shared<Thermostat>(id, name, location, strings));
                                 break;
                             case 3:
-                                addDevice(make_shared<SecurityCamera>(id, name, location));
+                                addDevice(make_shared<SecurityCamera>(id, name, location, strings));
                                 break;
                             default:
                                 cout << "Invalid device type.\n";
@@ -169,7 +723,7 @@ void HomeController::run() {
                 }
 
                 case 4: {
-                    if (devices.empty()) {
+                    if (readCurrentSnapshot()->getDeviceCount() == 0) {
                         cout << "No devices available to remove.\n";
                         break;
                     }
@@ -241,16 +795,33 @@ void HomeController::run() {
                     break;
 
                 case 7:
+                    handleAutomationRules();
+                    break;
+
+                case 8:
+                    handleDiagnostics();
+                    break;
+
+                case 9:
+                    handleDeviceSelection();
+                    break;
+
+                case 10:
+                    thermostatControl.stop();
+                    if (executor) {
+                        executor->shutdown();
+                    }
                     cout << "Thank you for using Smart Home System. Goodbye!\n";
                     return;
 
                 default:
-                    cout << "Invalid choice. Please enter a number between 1 and 5.\n";
+                    cout << "Invalid choice. Please enter a number between 1 and 10.\n";
             }
         } catch (const exception& e) {
             cerr << "Error: " << e.what() << endl;
         }
 
+        Logger::getInstance()->flush();
         cout << "\nPress Enter to continue...";
         cin.get();
     }
@@ -270,13 +841,17 @@ void HomeController::handleDeviceControl(const shared_ptr<Device> device) {
 // Function to handle SmartLight control
 void HomeController::handleSmartLightControl(const shared_ptr<SmartLight> light) {
     while (true) {
+        Logger::getInstance()->flush(); // queued library messages come before the menu
+        updateScheduler();
         cout << "\n=== Smart Light Control ===\n"
              << "1. Turn On/Off\n"
              << "2. Set Brightness\n"
              << "3. Set Color\n"
              << "4. Show Device Status\n"
              << "5. Quick Increase Brightness (+15%)\n"
-             << "6. Back\n"
+             << "6. Fade Brightness\n"
+             << "7. Turn Off After Delay\n"
+             << "8. Back\n"
              << "Please select an option: ";
 
         int choice;
@@ -291,6 +866,7 @@ void HomeController::handleSmartLightControl(const shared_ptr<SmartLight> light)
         try {
             switch (choice) {
                 case 1: {
+                    DeviceLock guard(deviceMutex);
                     if (light->getIsOn()) {
                         light->turnOff();
                         cout << "Light turned off.\n";
@@ -306,6 +882,7 @@ void HomeController::handleSmartLightControl(const shared_ptr<SmartLight> light)
                     cout << "Enter brightness level (0-100): ";
                     int brightness;
                     if (cin >> brightness) {
+                        DeviceLock guard(deviceMutex);
                         light->setBrightness(brightness);
                         cout << *light << "\n";
                     } else {
@@ -317,26 +894,61 @@ void HomeController::handleSmartLightControl(const shared_ptr<SmartLight> light)
                 }
 
                 case 3: {
-                    cout << "Enter color: ";
+                    cout << "Enter color (name, #RRGGBB or temperature e.g. 2700K): ";
                     string color;
                     getline(cin, color);
+                    DeviceLock guard(deviceMutex);
                     light->setColor(color);
                     cout << *light << "\n";
                     break;
                 }
 
-                case 4:
+                case 4: {
+                    DeviceLock guard(deviceMutex);
                     cout << *light << "\n";
                     break;
+                }
 
                 case 5: {
+                    DeviceLock guard(deviceMutex);
                     *light = *light + 15;
                     cout << "Increased brightness by 15%\n";
                     cout << *light << "\n";
                     break;
                 }
 
-                case 6:
+                case 6: {
+                    cout << "Enter target brightness (0-100) and fade time in seconds: ";
+                    int target;
+                    unsigned seconds;
+                    if (cin >> target >> seconds) {
+                        DeviceLock guard(deviceMutex);
+                        scheduler.fadeBrightness(light, target, static_cast<std::uint64_t>(seconds) * 1000);
+                        cout << "Fading to " << target << "% over " << seconds << " seconds\n";
+                    } else {
+                        cout << "Invalid fade values.\n";
+                        cin.clear();
+                    }
+                    cin.ignore(numeric_limits<std::streamsize>::max(), '\n');
+                    break;
+                }
+
+                case 7: {
+                    cout << "Enter delay in minutes: ";
+                    unsigned minutes;
+                    if (cin >> minutes) {
+                        DeviceLock guard(deviceMutex);
+                        scheduler.turnOffAfter(light, static_cast<std::uint64_t>(minutes) * 60 * 1000);
+                        cout << "Light will turn off in " << minutes << " minutes\n";
+                    } else {
+                        cout << "Invalid delay value.\n";
+                        cin.clear();
+                    }
+                    cin.ignore(numeric_limits<std::streamsize>::max(), '\n');
+                    break;
+                }
+
+                case 8:
                     return;
 
                 default:
@@ -351,12 +963,14 @@ void HomeController::handleSmartLightControl(const shared_ptr<SmartLight> light)
 // Function to handle Thermostat control
 void HomeController::handleThermostatControl(const shared_ptr<Thermostat> thermostat) {
     while (true) {
+        Logger::getInstance()->flush(); // queued library messages come before the menu
         cout << "\n=== Thermostat Control ===\n"
              << "1. Turn On/Off\n"
              << "2. Set Temperature\n"
              << "3. Set Mode\n"
-             << "4. Show Device Status\n"
-             << "5. Back\n"
+             << "4. Set Desired Temperature\n"
+             << "5. Show Device Status\n"
+             << "6. Back\n"
              << "Please select an option: ";
 
         int choice;
@@ -371,6 +985,7 @@ void HomeController::handleThermostatControl(const shared_ptr<Thermostat> thermo
         try {
             switch (choice) {
                 case 1: {
+                    DeviceLock guard(deviceMutex);
                     if (thermostat->getIsOn()) {
                         thermostat->turnOff();
                         cout << "Thermostat turned off.\n";
@@ -386,6 +1001,7 @@ void HomeController::handleThermostatControl(const shared_ptr<Thermostat> thermo
                     cout << "Enter temperature: ";
                     float temperature;
                     if (cin >> temperature) {
+                        DeviceLock guard(deviceMutex);
                         thermostat->setTemperature(temperature);
                         cout << thermostat->getDeviceStatus() << "\n";
                     } else {
@@ -400,16 +1016,34 @@ void HomeController::handleThermostatControl(const shared_ptr<Thermostat> thermo
                     cout << "Enter mode (heating/cooling/auto): ";
                     string mode;
                     getline(cin, mode);
+                    DeviceLock guard(deviceMutex);
                     thermostat->setMode(mode);
                     cout << thermostat->getDeviceStatus() << "\n";
                     break;
                 }
 
-                case 4:
+                case 4: {
+                    cout << "Enter desired temperature: ";
+                    float temperature;
+                    if (cin >> temperature) {
+                        DeviceLock guard(deviceMutex);
+                        thermostat->setDesiredTemperature(temperature);
+                        cout << thermostat->getDeviceStatus() << "\n";
+                    } else {
+                        cout << "Invalid temperature value.\n";
+                        cin.clear();
+                    }
+                    cin.ignore(numeric_limits<std::streamsize>::max(), '\n');
+                    break;
+                }
+
+                case 5: {
+                    DeviceLock guard(deviceMutex);
                     cout << thermostat->getDeviceStatus() << "\n";
                     break;
+                }
 
-                case 5:
+                case 6:
                     return;
 
                 default:
@@ -424,6 +1058,7 @@ void HomeController::handleThermostatControl(const shared_ptr<Thermostat> thermo
 // Function to handle SecurityCamera control
 void HomeController::handleSecurityCameraControl(const shared_ptr<SecurityCamera> camera) {
     while (true) {
+        Logger::getInstance()->flush(); // queued library messages come before the menu
         cout << "\n=== Security Camera Control ===\n"
              << "1. Turn On/Off\n"
              << "2. Start/Stop Recording\n"
@@ -446,6 +1081,7 @@ void HomeController::handleSecurityCameraControl(const shared_ptr<SecurityCamera
         try {
             switch (choice) {
                 case 1: {
+                    DeviceLock guard(deviceMutex);
                     if (camera->getIsOn()) {
                         camera->turnOff();
                         cout << "Camera turned off.\n";
@@ -458,6 +1094,7 @@ void HomeController::handleSecurityCameraControl(const shared_ptr<SecurityCamera
                 }
 
                 case 2: {
+                    DeviceLock guard(deviceMutex);
                     if (camera->getIsRecording()) {
                         camera->stopRecording();
                         cout << "Recording stopped.\n";
@@ -473,6 +1110,7 @@ void HomeController::handleSecurityCameraControl(const shared_ptr<SecurityCamera
                     cout << "Enter resolution (720p/1080p/4K): ";
                     string res;
                     getline(cin, res);
+                    DeviceLock guard(deviceMutex);
                     camera->setResolution(res);
                     cout << "Resolution set to " << res << "\n";
                     cout << *camera << "\n";
@@ -483,6 +1121,7 @@ void HomeController::handleSecurityCameraControl(const shared_ptr<SecurityCamera
                     cout << "Enter rotation angle (0-360): ";
                     int angle;
                     if (cin >> angle) {
+                        DeviceLock guard(deviceMutex);
                         camera->setRotation(angle);
                         cout << "Camera rotated to " << angle << " degrees\n";
                     } else {
@@ -490,11 +1129,13 @@ void HomeController::handleSecurityCameraControl(const shared_ptr<SecurityCamera
                         cin.clear();
                     }
                     cin.ignore(numeric_limits<std::streamsize>::max(), '\n');
+                    DeviceLock guard(deviceMutex);
                     cout << *camera << "\n";
                     break;
                 }
 
                 case 5: {
+                    DeviceLock guard(deviceMutex);
                     if (camera->getMotionDetection()) {
                         camera->disableMotionDetection();
                         cout << "Motion detection disabled.\n";
@@ -506,9 +1147,11 @@ void HomeController::handleSecurityCameraControl(const shared_ptr<SecurityCamera
                     break;
                 }
 
-                case 6:
+                case 6: {
+                    DeviceLock guard(deviceMutex);
                     cout << *camera << "\n";
                     break;
+                }
 
                 case 7:
                     return;
@@ -524,15 +1167,12 @@ void HomeController::handleSecurityCameraControl(const shared_ptr<SecurityCamera
 
 // Function to assign device to room
 void HomeController::assignDeviceToRoom(const string& deviceId, const string& roomName) {
-    // Find the device with the given ID
-    auto deviceIt = find_if(devices.begin(), devices.end(),
-        [&deviceId](const auto& device) {
-            return device->getDeviceID() == deviceId;
-        }
-    );
+    DeviceLock guard(deviceMutex);
 
-    if (deviceIt == devices.end()) {
-        cout << "Device not found.\n";
+    // Find the device with the given ID
+    auto device = findDeviceLocked(deviceId);
+    if (!device) {
+        logWarning("Device not found.");
         return;
     }
 
@@ -544,17 +1184,22 @@ void HomeController::assignDeviceToRoom(const string& deviceId, const string& ro
     );
 
     if (roomIt == rooms.end()) {
-        cout << "Room not found.\n";
+        logWarning("Room not found.");
         return;
     }
 
     // Add the device to the room
-    (*roomIt)->addDevice(*deviceIt);
-    cout << "Device " << deviceId << " assigned to room " << roomName << "\n";
+    (*roomIt)->addDevice(device);
+    automation.addDeviceToRoom(roomName, deviceId);
+    queryIndex.addToRoom(roomName, *device);
+    snapshots.roomsChanged();
+    logInfo("Device ", deviceId, " assigned to room ", roomName);
 }
 
 // Function to add a room
 void HomeController::addRoom(const string& roomName) {
+    DeviceLock guard(deviceMutex);
+
     // Check if room already exists
     auto it = find_if(rooms.begin(), rooms.end(),
         [&roomName](const auto& room) {
@@ -563,17 +1208,20 @@ void HomeController::addRoom(const string& roomName) {
     );
 
     if (it != rooms.end()) {
-        cout << "Room already exists.\n";
+        logWarning("Room already exists.");
         return;
     }
 
     // Create a new room and add it to the list
     rooms.push_back(make_unique<RoomController>(roomName));
-    cout << "Room " << roomName << " added successfully.\n";
+    automation.addRoom(roomName);
+    snapshots.roomsChanged();
+    logInfo("Room ", roomName, " added successfully.");
 }
 
 // Function to remove a room
 void HomeController::removeRoom(const string& roomName) {
+    DeviceLock guard(deviceMutex);
     auto initialSize = rooms.size();
     rooms.erase(
         std::remove_if(rooms.begin(), rooms.end(),
@@ -585,32 +1233,43 @@ void HomeController::removeRoom(const string& roomName) {
     );
 
     if (rooms.size() < initialSize) {
-        cout << "Room " << roomName << " removed successfully.\n";
+        automation.removeRoom(roomName);
+        queryIndex.removeRoom(roomName);
+        snapshots.roomsChanged();
+        logInfo("Room ", roomName, " removed successfully.");
     } else {
-        cout << "Room not found.\n";
+        logWarning("Room not found.");
     }
 }
 
 // Function to list all rooms
 void HomeController::listRooms() const {
-    if (rooms.empty()) {
+    PinnedSnapshot snapshot = readCurrentSnapshot();
+    if (snapshot->getRooms().empty()) {
         cout << "No rooms available.\n";
         return;
     }
 
     cout << "\nAvailable Rooms:\n";
-    for (const auto& room : rooms) {
-        cout << "- " << room->getRoomName() << ":\n";
-        room->listDevices();
+    for (const RoomView& room : snapshot->getRooms()) {
+        cout << "- " << room.name << ":\n"
+             << "\nDevices in " << room.name << " (" << room.slots.size() << " devices):\n";
+        if (room.slots.empty()) {
+            cout << "No devices in this room.\n";
+        }
+        for (size_t i = 0; i < room.slots.size(); ++i) {
+            cout << i + 1 << ". " << snapshot->at(room.slots[i]).status() << "\n";
+        }
     }
 }
 // Function to handle Energy Monitoring
 void HomeController::handleEnergyMonitoring() {
-    auto monitor = EnergyMonitor::getInstance();
+    auto monitor = energy;
     int choice; 
 
     // Energy Monitoring Menu
     while (true) {
+        Logger::getInstance()->flush(); // queued library messages come before the menu
         cout << "\n=== Energy Monitoring ===\n"
              << "1. View Current Usage\n"
              << "2. View Total Consumption\n"
@@ -643,14 +1302,491 @@ void HomeController::handleEnergyMonitoring() {
             case 2:
                 monitor->displayTotalUsage();
                 break;
-            case 3:
+            case 3: {
                 monitor->generateReport();
+                EnergySnapshot snapshot = readSnapshot()->measureEnergy(); // as of the last publish, writers go on
+                std::ios::fmtflags flags = cout.flags();
+                std::streamsize precision = cout.precision();
+                cout << "\nLive draw: " << std::fixed << std::setprecision(1) << snapshot.totalWatts << " W from "
+                     << snapshot.devicesOn << " of " << snapshot.deviceCount << " devices on\n";
+                for (const auto& location : snapshot.wattsByLocation) {
+                    cout << "  " << location.first << ": " << location.second << " W\n";
+                }
+                cout.flags(flags);
+                cout.precision(precision);
                 break;
+            }
             case 4:
                 return;
         }
 
+        Logger::getInstance()->flush();
         cout << "\nPress Enter to continue...";
         cin.get(); // Wait for the user to press Enter
     }
 }
+
+// Function to sum every device's current draw, in contiguous shards on the executor
+EnergySnapshot HomeController::measureEnergy() const {
+    TraceSpan span("HomeController::measureEnergy", "energy");
+    DeviceLock guard(deviceMutex);
+    size_t shardCount = devices.size() < parallelBatchThreshold ? 1 : pool().getWorkerCount() * shardsPerWorker;
+    size_t grain = std::max<size_t>(1, (devices.size() + shardCount - 1) / shardCount);
+    vector<EnergySnapshot> partial(shardCount);
+    auto measure = [this, grain, &partial](size_t begin, size_t end) {
+        EnergySnapshot& part = partial[begin / grain];
+        for (size_t i = begin; i < end; ++i) {
+            const Device& device = *devices[i];
+            double watts = device.getPowerUsage();
+            part.totalWatts += watts;
+            part.devicesOn += device.getIsOn() ? 1 : 0;
+            part.wattsByLocation[device.getDeviceLocation()] += watts;
+        }
+        part.deviceCount += end - begin;
+    };
+    if (shardCount == 1) {
+        measure(0, devices.size());
+    } else {
+        pool().parallelFor(devices.size(), grain, measure);
+    }
+
+    EnergySnapshot snapshot;
+    for (const auto& part : partial) {
+        snapshot.totalWatts += part.totalWatts;
+        snapshot.deviceCount += part.deviceCount;
+        snapshot.devicesOn += part.devicesOn;
+        for (const auto& location : part.wattsByLocation) {
+            snapshot.wattsByLocation[location.first] += location.second;
+        }
+    }
+    return snapshot;
+}
+
+// Function to access the home's energy monitor
+EnergyMonitor& HomeController::getEnergyMonitor() const {
+    return *energy;
+}
+
+// Function to access the pool the home's device locations are interned in
+StringPool& HomeController::getStringPool() const {
+    return *strings;
+}
+
+// Function to account the home's memory, devices by type, then every container of the home
+MemoryReport HomeController::measureMemory() const {
+    DeviceLock guard(deviceMutex);
+    MemoryReport report;
+    report.deviceCount = devices.size();
+    MemoryReport::Entry types[] = {{"lights", 0, 0}, {"thermostats", 0, 0}, {"cameras", 0, 0}, {"other devices", 0, 0}};
+    for (const auto& device : devices) {
+        MemoryReport::Entry& type = dynamic_cast<const SmartLight*>(device.get()) ? types[0]
+                                  : dynamic_cast<const Thermostat*>(device.get()) ? types[1]
+                                  : dynamic_cast<const SecurityCamera*>(device.get()) ? types[2] : types[3];
+        ++type.count;
+        type.bytes += device->getMemoryUsage() + sharedControlBlockBytes;
+    }
+    for (const auto& type : types) {
+        if (type.count > 0) {
+            report.deviceTypes.push_back(type);
+        }
+    }
+
+    size_t roomBytes = heapBytes(rooms);
+    for (const auto& room : rooms) {
+        roomBytes += room->getMemoryUsage();
+    }
+    size_t queueBytes = hashTableBytes(commandQueues);
+    for (const auto& queue : commandQueues) {
+        queueBytes += heapBytes(queue.first);
+    }
+    report.subsystems = {
+        {"device list", devices.size(), heapBytes(devices)},
+        {"device lookup", deviceIndex.size(), hashTableBytes(deviceIndex)},
+        {"rooms", rooms.size(), roomBytes},
+        {"query index", queryIndex.size(), queryIndex.getMemoryUsage()},
+        {"automation", automation.getRuleCount(), automation.getMemoryUsage()},
+        {"thermostat control", thermostatControl.getThermostatCount(), thermostatControl.getMemoryUsage()},
+        {"energy monitor", energy->getDeviceCount(), energy->getMemoryUsage()},
+        {"command queues", commandQueues.size(), queueBytes},
+        {"snapshots", snapshots.isPublishing() ? 1u : 0u, snapshots.getMemoryUsage()}, // the latest version
+        {"interned strings", strings->size(), strings->getMemoryUsage()} // the home's pool
+    };
+    return report;
+}
+
+// Function to access the shared executor
+WorkStealingPool& HomeController::getExecutor() {
+    DeviceLock guard(deviceMutex);
+    WorkStealingPool& shared = pool();
+    thermostatControl.setExecutor(&shared);
+    return shared;
+}
+
+// Function to replace the executor, running work finishes on the old one first
+void HomeController::setExecutorThreads(size_t threads) {
+    DeviceLock guard(deviceMutex);
+    std::lock_guard<std::mutex> executorGuard(executorMutex);
+    thermostatControl.setExecutor(nullptr);
+    if (executor) {
+        executor->shutdown();
+    }
+    executor = make_unique<WorkStealingPool>(threads);
+    thermostatControl.setExecutor(executor.get());
+}
+
+// Function to access the scheduler
+Scheduler& HomeController::getScheduler() {
+    return scheduler;
+}
+
+// Function to turn a device on after a delay
+TimerId HomeController::scheduleDeviceOn(const string& deviceId, std::uint64_t delayMillis) {
+    DeviceLock guard(deviceMutex);
+    auto device = findDeviceLocked(deviceId);
+    if (!device) {
+        throw std::invalid_argument("Device not found: " + deviceId);
+    }
+    return scheduler.turnOnAfter(device, delayMillis);
+}
+
+// Function to turn a device off after a delay
+TimerId HomeController::scheduleDeviceOff(const string& deviceId, std::uint64_t delayMillis) {
+    DeviceLock guard(deviceMutex);
+    auto device = findDeviceLocked(deviceId);
+    if (!device) {
+        throw std::invalid_argument("Device not found: " + deviceId);
+    }
+    return scheduler.turnOffAfter(device, delayMillis);
+}
+
+// Function to fade a light to a brightness
+TimerId HomeController::fadeLight(const string& deviceId, int targetBrightness, std::uint64_t durationMillis) {
+    DeviceLock guard(deviceMutex);
+    auto light = dynamic_pointer_cast<SmartLight>(findDeviceLocked(deviceId));
+    if (!light) {
+        throw std::invalid_argument("Smart light not found: " + deviceId);
+    }
+    return scheduler.fadeBrightness(light, targetBrightness, durationMillis);
+}
+
+// Function to run timers that became due since the last update
+void HomeController::updateScheduler() {
+    TraceSpan span("HomeController::updateScheduler", "home");
+    DeviceLock guard(deviceMutex);
+
+    // temperatures moved by the control loop reach the automation rules on this thread
+    thermostatControl.publishTemperatureChanges([this](Thermostat& thermostat) {
+        onDeviceChanged(thermostat, DeviceChange::Temperature);
+    });
+
+    std::int64_t elapsed = static_cast<std::int64_t>(clock->nowMillis()) - clockOffset;
+    if (elapsed > 0) {
+        scheduler.advanceTo(static_cast<std::uint64_t>(elapsed));
+    }
+    flushCommandQueuesLocked();
+
+    // time-of-day rules follow the clock's local time
+    automation.setTimeOfDay(clock->minuteOfDay());
+    publishChanges();
+}
+
+// Function to change the clock, pending timers keep their remaining delay on the new clock
+void HomeController::setClock(HomeClock* newClock) {
+    DeviceLock guard(deviceMutex);
+    clock = newClock ? newClock : &systemClock();
+    clockOffset = static_cast<std::int64_t>(clock->nowMillis()) - static_cast<std::int64_t>(scheduler.now());
+    energy->setClock(clock);
+}
+
+// Function to access the clock
+HomeClock& HomeController::getClock() const {
+    return *clock;
+}
+
+// Function to access the thermostat control loop
+ThermostatControlLoop& HomeController::getThermostatControl() {
+    return thermostatControl;
+}
+
+// Function to access the automation engine
+AutomationEngine& HomeController::getAutomation() {
+    return automation;
+}
+
+// Function to add an automation rule
+std::uint32_t HomeController::addAutomationRule(const string& ruleText) {
+    DeviceLock guard(deviceMutex);
+    return automation.addRule(ruleText);
+}
+
+// Function to list the automation rules, the command server fires them under the same lock
+vector<std::pair<std::uint32_t, string>> HomeController::listAutomationRules() const {
+    DeviceLock guard(deviceMutex);
+    return automation.listRules();
+}
+
+// Function to remove an automation rule
+bool HomeController::removeAutomationRule(std::uint32_t ruleId) {
+    DeviceLock guard(deviceMutex);
+    return automation.removeRule(ruleId);
+}
+
+// Device state changes are passed on to the query indexes and the automation rules; the thread
+// that changed the device holds the device mutex, or is the only one using the home
+void HomeController::onDeviceChanged(Device& device, DeviceChange change) {
+    if (deferredChanges) {
+        deferredChanges->push_back(DeferredChange{&device, change}); // an executor task, its caller holds the lock
+        return;
+    }
+    snapshots.deviceChanged(queryIndex.onDeviceChanged(device, change));
+    automation.onDeviceChanged(device, change);
+    if (telemetry.hasSubscribers()) {
+        publishTelemetry(device, change);
+    }
+}
+
+MessageBroker& HomeController::getTelemetry() {
+    return telemetry;
+}
+
+// Binary state of every device, consistent with the control worker and command server
+std::size_t HomeController::snapshotTelemetry(TelemetryBatchWriter& batch) {
+    DeviceLock guard(deviceMutex);
+    for (const auto& device : devices) {
+        batch.add(*device);
+    }
+    return devices.size();
+}
+
+// topic level for a device change
+static const char* telemetryProperty(DeviceChange change) {
+    switch (change) {
+        case DeviceChange::Power: return "power";
+        case DeviceChange::Brightness: return "brightness";
+        case DeviceChange::Color: return "color";
+        case DeviceChange::Temperature: return "temperature";
+        case DeviceChange::DesiredTemperature: return "setpoint";
+        case DeviceChange::Mode: return "mode";
+        case DeviceChange::Recording: return "recording";
+        case DeviceChange::Resolution: return "resolution";
+        case DeviceChange::Rotation: return "rotation";
+        case DeviceChange::MotionDetection: return "motion_detection";
+        case DeviceChange::Motion: return "motion";
+        case DeviceChange::Name: return "name";
+        case DeviceChange::Location: return "location";
+    }
+    return "unknown";
+}
+
+// topic levels cannot hold the separator or wildcards
+static void appendTopicLevel(string& topic, const string& level) {
+    for (char c : level) {
+        topic.push_back(c == '/' || c == '+' || c == '#' ? '_' : c);
+    }
+}
+
+// the changed property's new value as text
+static string telemetryValue(const Device& device, DeviceChange change) {
+    const auto* light = dynamic_cast<const SmartLight*>(&device);
+    const auto* thermostat = dynamic_cast<const Thermostat*>(&device);
+    const auto* camera = dynamic_cast<const SecurityCamera*>(&device);
+    switch (change) {
+        case DeviceChange::Power: return device.getIsOn() ? "on" : "off";
+        case DeviceChange::Brightness: return light ? std::to_string(light->getBrightness()) : "";
+        case DeviceChange::Color: return light ? light->getColor().toString() : "";
+        case DeviceChange::Temperature: return thermostat ? std::to_string(thermostat->getTemperature()) : "";
+        case DeviceChange::DesiredTemperature: return thermostat ? std::to_string(thermostat->getDesiredTemperature()) : "";
+        case DeviceChange::Mode: return thermostat ? thermostat->getMode() : "";
+        case DeviceChange::Recording: return camera && camera->getIsRecording() ? "on" : "off";
+        case DeviceChange::Resolution: return camera ? camera->getResolution() : "";
+        case DeviceChange::Rotation: return camera ? std::to_string(camera->getRotation()) : "";
+        case DeviceChange::MotionDetection: return camera && camera->getMotionDetection() ? "on" : "off";
+        case DeviceChange::Motion: return camera ? std::to_string(camera->getMotionEventCount()) : "";
+        case DeviceChange::Name: return device.getDeviceName();
+        case DeviceChange::Location: return device.getDeviceLocation();
+    }
+    return "";
+}
+
+void HomeController::publishTelemetry(const Device& device, DeviceChange change) {
+    string topic = "home/";
+    appendTopicLevel(topic, device.getDeviceLocation());
+    topic += '/';
+    appendTopicLevel(topic, device.getDeviceID());
+    topic += '/';
+    topic += telemetryProperty(change);
+    telemetry.publish(topic, telemetryValue(device, change));
+}
+
+// Function to handle the diagnostics menu: metrics in Prometheus text format and Chrome traces
+void HomeController::handleDiagnostics() {
+    while (true) {
+        Logger::getInstance()->flush(); // queued library messages come before the menu
+        Tracer* tracer = Tracer::getInstance();
+        cout << "\n=== Diagnostics ===\n"
+             << "1. Show Metrics\n"
+             << "2. Write Metrics to File\n"
+             << "3. Start Tracing\n"
+             << "4. Stop Tracing and Write Trace File\n"
+             << "5. Back\n"
+             << "Tracing is " << (Tracer::isEnabled() ? "on" : "off") << ", " << tracer->getEventCount() << " events recorded.\n"
+             << "Please select an option: ";
+
+        int choice;
+        if (!(cin >> choice)) {
+            cin.clear();
+            cin.ignore(numeric_limits<std::streamsize>::max(), '\n');
+            cout << "Invalid input.\n";
+            continue;
+        }
+        cin.ignore(numeric_limits<std::streamsize>::max(), '\n');
+
+        switch (choice) {
+            case 1:
+                MetricsRegistry::getInstance()->writePrometheus(cout);
+                break;
+
+            case 2: {
+                cout << "Enter file name: ";
+                string path;
+                getline(cin, path);
+                if (MetricsRegistry::getInstance()->writePrometheusFile(path)) {
+                    cout << "Metrics written to " << path << ".\n";
+                } else {
+                    cout << "Could not write " << path << ".\n";
+                }
+                break;
+            }
+
+            case 3:
+                tracer->start();
+                cout << "Tracing started.\n";
+                break;
+
+            case 4: {
+                tracer->stop();
+                cout << "Enter trace file name (e.g. trace.json): ";
+                string path;
+                getline(cin, path);
+                if (tracer->writeChromeTraceFile(path)) {
+                    cout << "Trace written to " << path << ", open it in chrome://tracing or ui.perfetto.dev.\n";
+                } else {
+                    cout << "Could not write " << path << ".\n";
+                }
+                break;
+            }
+
+            case 5:
+                return;
+
+            default:
+                cout << "Invalid choice. Please try again.\n";
+        }
+    }
+}
+
+// Function to handle the automation rules menu
+void HomeController::handleAutomationRules() {
+    while (true) {
+        Logger::getInstance()->flush(); // queued library messages come before the menu
+        cout << "\n=== Automation Rules ===\n"
+             << "1. Add Rule\n"
+             << "2. List Rules\n"
+             << "3. Remove Rule\n"
+             << "4. Back\n"
+             << "Please select an option: ";
+
+        int choice;
+        if (!(cin >> choice)) {
+            cin.clear();
+            cin.ignore(numeric_limits<std::streamsize>::max(), '\n');
+            cout << "Invalid input.\n";
+            continue;
+        }
+        cin.ignore(numeric_limits<std::streamsize>::max(), '\n');
+
+        try {
+            switch (choice) {
+                case 1: {
+                    cout << "Enter rule (e.g. when motion on CAM1 and after sunset, set Hallway lights to 40%): ";
+                    string rule;
+                    getline(cin, rule);
+                    std::uint32_t id = addAutomationRule(rule);
+                    cout << "Rule " << id << " added.\n";
+                    break;
+                }
+
+                case 2: {
+                    auto rules = listAutomationRules();
+                    if (rules.empty()) {
+                        cout << "No automation rules.\n";
+                    }
+                    for (const auto& rule : rules) {
+                        cout << rule.first << ". " << rule.second << "\n";
+                    }
+                    break;
+                }
+
+                case 3: {
+                    cout << "Enter rule number to remove: ";
+                    std::uint32_t id;
+                    if (cin >> id && removeAutomationRule(id)) {
+                        cout << "Rule removed.\n";
+                    } else {
+                        cout << "Rule not found.\n";
+                        cin.clear();
+                    }
+                    cin.ignore(numeric_limits<std::streamsize>::max(), '\n');
+                    break;
+                }
+
+                case 4:
+                    return;
+
+                default:
+                    cout << "Invalid choice. Please try again.\n";
+            }
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+        }
+    }
+}
+
+// Function to handle the device selection menu: a query, its devices, then a command for all of them
+void HomeController::handleDeviceSelection() {
+    cout << "Enter query (e.g. lights and on and in Living Room, cameras and not recording, power above 5): ";
+    string query;
+    getline(cin, query);
+    vector<shared_ptr<Device>> selected = selectDevices(query);
+    const size_t shown = 20;
+    {
+        DeviceLock guard(deviceMutex); // the command server may be changing them
+        for (size_t i = 0; i < selected.size() && i < shown; ++i) {
+            cout << i + 1 << ". " << selected[i]->getDeviceStatus() << "\n";
+        }
+    }
+    if (selected.size() > shown) {
+        cout << "... and " << selected.size() - shown << " more\n";
+    }
+    cout << selected.size() << " devices selected.\n";
+    if (selected.empty()) {
+        return;
+    }
+
+    cout << "Enter a command for every selected device (e.g. off, brightness 40), or nothing to go back: ";
+    string line;
+    getline(cin, line);
+    std::istringstream words(line);
+    string verb, argument;
+    words >> verb;
+    getline(words >> std::ws, argument);
+    if (verb.empty()) {
+        return;
+    }
+    DeviceCommand command;
+    if (!parseDeviceCommand(verb, argument, command)) {
+        cout << "Unknown command.\n";
+        return;
+    }
+    cout << applyToSelection(query, command) << " devices accepted the command.\n";
+}
@@ -0,0 +1,143 @@
+// includes
+#include "controllers/home_generator.hpp"
+#include "controllers/home_controller.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// picks indices 0..count-1 with Zipf-like weights, the busy indices are shuffled
+class SkewedPicker {
+    private:
+        std::vector<double> cumulative; // running weight by rank
+        std::vector<std::size_t> rankToIndex; // which device holds each rank
+
+    public:
+        SkewedPicker(std::size_t count, double skew, std::mt19937& rng)
+            : cumulative(count)
+            , rankToIndex(count)
+        {
+            double total = 0.0;
+            for (std::size_t rank = 0; rank < count; ++rank) {
+                total += skew > 0.0 ? 1.0 / std::pow(static_cast<double>(rank + 1), skew) : 1.0;
+                cumulative[rank] = total;
+                rankToIndex[rank] = rank;
+            }
+            std::shuffle(rankToIndex.begin(), rankToIndex.end(), rng);
+        }
+
+        std::size_t pick(std::mt19937& rng) const {
+            std::uniform_real_distribution<double> draw(0.0, cumulative.back());
+            auto it = std::upper_bound(cumulative.begin(), cumulative.end(), draw(rng));
+            std::size_t rank = std::min(static_cast<std::size_t>(it - cumulative.begin()), cumulative.size() - 1);
+            return rankToIndex[rank];
+        }
+};
+
+// build the devices and rooms for a spec
+GeneratedHome generateHome(const HomeSpec& spec) {
+    GeneratedHome home;
+    std::size_t zones = std::max<std::size_t>(1, spec.zones);
+    std::size_t rooms = std::max<std::size_t>(1, spec.rooms);
+    for (std::size_t r = 0; r < rooms; ++r) {
+        home.rooms.push_back("Zone " + std::to_string(r % zones + 1) + " Room " + std::to_string(r / zones + 1));
+    }
+
+    home.lights = spec.lights;
+    home.thermostats = spec.thermostats;
+    home.cameras = spec.cameras;
+    home.devices.reserve(spec.lights + spec.thermostats + spec.cameras);
+    home.deviceRoom.reserve(home.devices.capacity());
+    auto place = [&home, rooms](std::size_t index) {
+        std::size_t room = index % rooms;
+        home.deviceRoom.push_back(room);
+        return home.rooms[room];
+    };
+    for (std::size_t i = 0; i < spec.lights; ++i) {
+        std::string id = std::to_string(i);
+        home.devices.push_back(std::make_shared<SmartLight>("L" + id, "Light " + id, place(i), spec.strings));
+    }
+    for (std::size_t i = 0; i < spec.thermostats; ++i) {
+        std::string id = std::to_string(i);
+        home.devices.push_back(std::make_shared<Thermostat>("T" + id, "Thermostat " + id, place(i), spec.strings));
+    }
+    for (std::size_t i = 0; i < spec.cameras; ++i) {
+        std::string id = std::to_string(i);
+        home.devices.push_back(std::make_shared<SecurityCamera>("C" + id, "Camera " + id, place(i), spec.strings));
+    }
+    return home;
+}
+
+// add the rooms and devices to a controller and turn every device on
+void populateHome(HomeController& controller, const GeneratedHome& home) {
+    for (const auto& room : home.rooms) {
+        controller.addRoom(room);
+    }
+    for (std::size_t i = 0; i < home.devices.size(); ++i) {
+        const auto& device = home.devices[i];
+        controller.addDevice(device);
+        controller.assignDeviceToRoom(device->getDeviceID(), home.rooms[home.deviceRoom[i]]);
+        (void)controller.applyCommand(device->getDeviceID(), DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+    }
+}
+
+// a reproducible stream of commands with the given mix
+CommandStream generateCommands(const GeneratedHome& home, const CommandMix& mix, std::size_t count, std::uint32_t seed) {
+    CommandStream commands;
+    if (home.devices.empty()) {
+        return commands;
+    }
+    std::mt19937 rng(seed);
+    SkewedPicker anyDevice(home.devices.size(), mix.skew, rng);
+    SkewedPicker light(std::max<std::size_t>(1, home.lights), mix.skew, rng);
+    SkewedPicker thermostat(std::max<std::size_t>(1, home.thermostats), mix.skew, rng);
+    SkewedPicker camera(std::max<std::size_t>(1, home.cameras), mix.skew, rng);
+
+    // kinds without devices to act on get no share, an empty mix falls back to toggles
+    std::vector<double> weights{
+        std::max(0.0, mix.toggles),
+        home.lights > 0 ? std::max(0.0, mix.brightness) : 0.0,
+        home.thermostats > 0 ? std::max(0.0, mix.setpoints) : 0.0,
+        home.cameras > 0 ? std::max(0.0, mix.recording) : 0.0
+    };
+    if (weights[0] + weights[1] + weights[2] + weights[3] <= 0.0) {
+        weights[0] = 1.0;
+    }
+    std::discrete_distribution<int> kind(weights.begin(), weights.end());
+    std::uniform_int_distribution<int> coin(0, 1);
+    std::uniform_int_distribution<int> brightnessStep(0, 20); // 0-100 in steps of 5
+    std::uniform_int_distribution<int> setpointStep(0, 20); // 16-26C in half degrees
+
+    commands.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        switch (kind(rng)) {
+            case 0: {
+                const auto& device = home.devices[anyDevice.pick(rng)];
+                CommandType type = coin(rng) ? CommandType::TurnOn : CommandType::TurnOff;
+                commands.emplace_back(device->getDeviceID(), DeviceCommand{type, 0.0f, ""});
+                break;
+            }
+            case 1: {
+                const auto& device = home.devices[light.pick(rng)];
+                float value = static_cast<float>(brightnessStep(rng) * 5);
+                commands.emplace_back(device->getDeviceID(), DeviceCommand{CommandType::SetBrightness, value, ""});
+                break;
+            }
+            case 2: {
+                const auto& device = home.devices[home.lights + thermostat.pick(rng)];
+                float value = 16.0f + static_cast<float>(setpointStep(rng)) * 0.5f;
+                commands.emplace_back(device->getDeviceID(), DeviceCommand{CommandType::SetDesiredTemperature, value, ""});
+                break;
+            }
+            default: {
+                const auto& device = home.devices[home.lights + home.thermostats + camera.pick(rng)];
+                CommandType type = coin(rng) ? CommandType::StartRecording : CommandType::StopRecording;
+                commands.emplace_back(device->getDeviceID(), DeviceCommand{type, 0.0f, ""});
+                break;
+            }
+        }
+    }
+    return commands;
+}
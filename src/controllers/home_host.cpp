@@ -0,0 +1,119 @@
+// includes
+#include "controllers/home_host.hpp"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "core/logger.hpp"
+#include "core/tracing.hpp"
+
+HomeHost::HomeHost(std::size_t shardCount)
+    : executedCount(0)
+    , failedCount(0)
+{
+    if (shardCount == 0) {
+        shardCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::size_t i = 0; i < shardCount; ++i) {
+        shards.push_back(std::make_unique<Shard>());
+    }
+    for (std::size_t i = 0; i < shardCount; ++i) {
+        shards[i]->thread = std::thread(&HomeHost::run, this, i);
+    }
+}
+
+// queued work still runs, the homes go once no shard can reach them
+HomeHost::~HomeHost() {
+    for (auto& shard : shards) {
+        {
+            std::lock_guard<std::mutex> guard(shard->lock);
+            shard->stopping = true;
+        }
+        shard->workAvailable.notify_one();
+    }
+    for (auto& shard : shards) {
+        shard->thread.join();
+    }
+}
+
+std::size_t HomeHost::addHome() {
+    auto created = std::make_unique<HomeController>();
+    std::lock_guard<std::mutex> guard(homesMutex);
+    homes.push_back(std::move(created));
+    return homes.size() - 1;
+}
+
+HomeController& HomeHost::home(std::size_t id) const {
+    std::lock_guard<std::mutex> guard(homesMutex);
+    if (id >= homes.size()) {
+        throw std::out_of_range("No home with ID " + std::to_string(id));
+    }
+    return *homes[id];
+}
+
+HomeController& HomeHost::getHome(std::size_t id) {
+    return home(id);
+}
+
+std::size_t HomeHost::getHomeCount() const {
+    std::lock_guard<std::mutex> guard(homesMutex);
+    return homes.size();
+}
+
+void HomeHost::post(std::size_t id, HomeTask task) {
+    HomeController* target = &home(id);
+    Shard& shard = *shards[getShardOf(id)];
+    bool wake;
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        wake = shard.tasks.empty() && !shard.running;
+        shard.tasks.emplace_back(target, std::move(task));
+    }
+    // a busy shard picks the task up with its next batch
+    if (wake) {
+        shard.workAvailable.notify_one();
+    }
+}
+
+void HomeHost::wait() {
+    for (auto& shard : shards) {
+        std::unique_lock<std::mutex> guard(shard->lock);
+        shard->drained.wait(guard, [&shard] { return shard->tasks.empty() && !shard->running; });
+    }
+}
+
+// take the whole queue at once, so posting and running contend once per batch instead of per task
+void HomeHost::run(std::size_t index) {
+    Tracer::getInstance()->setThreadName("home shard " + std::to_string(index));
+    Shard& shard = *shards[index];
+    std::deque<std::pair<HomeController*, HomeTask>> batch;
+    std::unique_lock<std::mutex> guard(shard.lock);
+    while (true) {
+        shard.workAvailable.wait(guard, [&shard] { return shard.stopping || !shard.tasks.empty(); });
+        if (shard.tasks.empty()) {
+            return; // stopping and drained
+        }
+        batch.swap(shard.tasks);
+        shard.running = true;
+        guard.unlock();
+        for (auto& task : batch) {
+            try {
+                task.second(*task.first);
+            } catch (const std::exception& e) {
+                failedCount.fetch_add(1, std::memory_order_relaxed);
+                logError("Home task failed on shard ", index, ": ", e.what());
+            } catch (...) {
+                failedCount.fetch_add(1, std::memory_order_relaxed);
+                logError("Home task failed on shard ", index);
+            }
+        }
+        executedCount.fetch_add(batch.size(), std::memory_order_relaxed);
+        batch.clear();
+        guard.lock();
+        shard.running = false;
+        if (shard.tasks.empty()) {
+            shard.drained.notify_all();
+        }
+    }
+}
@@ -0,0 +1,297 @@
+// includes
+#include "controllers/home_layout.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+// bytes read from the input at a time
+static const std::size_t layoutBlockSize = 1 << 20;
+
+// splits a line at spaces outside double quotes, up to a # that starts a field; false for an open quote
+static bool tokenizeLayoutLine(std::string_view line, std::vector<std::string_view>& fields) {
+    fields.clear();
+    std::size_t i = 0;
+    while (true) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) {
+            ++i;
+        }
+        if (i == line.size() || line[i] == '#') {
+            return true;
+        }
+        std::size_t start = i;
+        bool quoted = false;
+        while (i < line.size() && (quoted || (line[i] != ' ' && line[i] != '\t' && line[i] != '\r'))) {
+            quoted = line[i] == '"' ? !quoted : quoted;
+            ++i;
+        }
+        if (quoted) {
+            return false;
+        }
+        fields.push_back(line.substr(start, i - start));
+    }
+}
+
+static std::string_view unquote(std::string_view field) {
+    if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+        return field.substr(1, field.size() - 2);
+    }
+    return field;
+}
+
+// builds the layout one line at a time, remembering what earlier lines declared
+class LayoutParser {
+    private:
+        HomeLayout layout;
+        StringPool* pool; // the device locations are interned here, null for the process default
+        std::unordered_map<std::string, std::int32_t> roomIndex; // room name to index in layout.rooms
+        std::vector<std::pair<std::size_t, std::uint32_t>> idHashes; // ID hash and index of each device, sorted at the end
+        std::vector<std::uint32_t> deviceLines; // line of each device, for a duplicate found at the end
+        std::vector<std::string_view> fields; // reused for every line
+        std::string id, name, location, roomName; // reused for every device, the device copies what it keeps
+        std::size_t lineNumber = 0;
+
+        [[noreturn]] void fail(const std::string& message) const {
+            throw std::invalid_argument("layout line " + std::to_string(lineNumber) + ": " + message);
+        }
+
+        void parseRoom() {
+            if (fields.size() != 2) {
+                fail("expected room <name>");
+            }
+            std::string room(unquote(fields[1]));
+            if (room.empty() || !roomIndex.emplace(room, static_cast<std::int32_t>(layout.rooms.size())).second) {
+                fail("room \"" + room + "\" is empty or declared twice");
+            }
+            layout.rooms.push_back(std::move(room));
+        }
+
+        void parseDevice(std::string_view type) {
+            if (fields.size() < 4) {
+                fail("expected " + std::string(type) + " <id> <name> <location> [room=<room>] [state...]");
+            }
+            id.assign(unquote(fields[1]));
+            name.assign(unquote(fields[2]));
+            location.assign(unquote(fields[3]));
+            std::shared_ptr<Device> device;
+            try {
+                if (type == "light") {
+                    device = std::make_shared<SmartLight>(id, name, location, pool);
+                } else if (type == "thermostat") {
+                    device = std::make_shared<Thermostat>(id, name, location, pool);
+                } else {
+                    device = std::make_shared<SecurityCamera>(id, name, location, pool);
+                }
+            } catch (const std::exception& e) {
+                fail(e.what());
+            }
+            idHashes.emplace_back(std::hash<std::string_view>()(device->getDeviceID()),
+                                  static_cast<std::uint32_t>(layout.devices.size()));
+            deviceLines.push_back(static_cast<std::uint32_t>(lineNumber));
+
+            // the device has no observer yet and is unmetered, so its initial state is set without
+            // notifications or power readings; the home it is loaded into takes the readings at once
+            device->setMetered(false);
+            std::int32_t room = -1;
+            DeviceCommand command;
+            for (std::size_t i = 4; i < fields.size(); ++i) {
+                std::string_view field = fields[i];
+                std::size_t equals = field.find('=');
+                std::string_view verb = field.substr(0, equals);
+                std::string_view argument = equals == std::string_view::npos ? std::string_view() : unquote(field.substr(equals + 1));
+                if (verb == "room") {
+                    roomName.assign(argument);
+                    auto it = roomIndex.find(roomName);
+                    if (it == roomIndex.end()) {
+                        fail("unknown room \"" + std::string(argument) + "\"");
+                    }
+                    room = it->second;
+                    continue;
+                }
+                if (!parseDeviceCommand(verb, argument, command)) {
+                    fail("bad state \"" + std::string(field) + "\"");
+                }
+                DeviceResult result = device->applyCommand(command);
+                if (result != DeviceResult::Ok) {
+                    fail(std::string(field) + ": " + describeResult(result));
+                }
+            }
+            layout.devices.push_back(std::move(device));
+            layout.deviceRoom.push_back(room);
+        }
+
+    public:
+        explicit LayoutParser(StringPool* strings) : pool(strings) {}
+
+        void parseLine(std::string_view line) {
+            ++lineNumber;
+            if (!tokenizeLayoutLine(line, fields)) {
+                fail("unterminated quote");
+            }
+            if (fields.empty()) {
+                return;
+            }
+            std::string_view type = fields[0];
+            if (type == "room") {
+                parseRoom();
+            } else if (type == "light" || type == "thermostat" || type == "camera") {
+                parseDevice(type);
+            } else {
+                fail("unknown declaration \"" + std::string(type) + "\"");
+            }
+        }
+
+        // duplicate IDs are found by sorting their hashes once, a million-entry hash set costs several
+        // times as much; the first device whose ID an earlier line declared is reported
+        HomeLayout take() {
+            std::sort(idHashes.begin(), idHashes.end());
+            std::uint32_t duplicate = std::numeric_limits<std::uint32_t>::max();
+            for (std::size_t i = 1; i < idHashes.size(); ++i) {
+                for (std::size_t j = i; j-- > 0 && idHashes[j].first == idHashes[i].first;) {
+                    const std::string& id = layout.devices[idHashes[i].second]->getDeviceID();
+                    if (layout.devices[idHashes[j].second]->getDeviceID() == id) {
+                        duplicate = std::min(duplicate, idHashes[i].second); // the later of the two
+                    }
+                }
+            }
+            if (duplicate != std::numeric_limits<std::uint32_t>::max()) {
+                lineNumber = deviceLines[duplicate];
+                fail("device " + layout.devices[duplicate]->getDeviceID() + " declared twice");
+            }
+            return std::move(layout);
+        }
+};
+
+// lines are cut out of large blocks in place, only a line split across two blocks is copied
+HomeLayout parseHomeLayout(std::istream& in, StringPool* pool) {
+    LayoutParser parser(pool);
+    std::vector<char> block(layoutBlockSize);
+    std::string partial; // start of a line whose end is in the next block
+    while (in) {
+        in.read(block.data(), static_cast<std::streamsize>(block.size()));
+        std::string_view text(block.data(), static_cast<std::size_t>(in.gcount()));
+        if (text.empty()) {
+            break;
+        }
+        std::size_t start = 0;
+        if (!partial.empty()) {
+            std::size_t newline = text.find('\n');
+            if (newline == std::string_view::npos) {
+                partial.append(text);
+                continue;
+            }
+            partial.append(text.substr(0, newline));
+            parser.parseLine(partial);
+            partial.clear();
+            start = newline + 1;
+        }
+        for (std::size_t newline; (newline = text.find('\n', start)) != std::string_view::npos; start = newline + 1) {
+            parser.parseLine(text.substr(start, newline - start));
+        }
+        partial.append(text.substr(start));
+    }
+    if (!partial.empty()) {
+        parser.parseLine(partial);
+    }
+    return parser.take();
+}
+
+HomeLayout loadHomeLayout(const std::string& path, StringPool* pool) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open layout file: " + path);
+    }
+    return parseHomeLayout(file, pool);
+}
+
+// a field, quoted when it holds spaces or would start a comment
+static void writeField(std::ostream& out, const std::string& field) {
+    if (field.find_first_of("\"\n") != std::string::npos) {
+        throw std::invalid_argument("Layout fields cannot hold quotes or line breaks: " + field);
+    }
+    if (field.empty() || field.front() == '#' || field.find_first_of(" \t\r") != std::string::npos) {
+        out << '"' << field << '"';
+    } else {
+        out << field;
+    }
+}
+
+// shortest text that reads back as the same float
+static void writeNumber(std::ostream& out, float value) {
+    char text[32];
+    auto written = std::to_chars(text, text + sizeof(text), value);
+    out.write(text, written.ptr - text);
+}
+
+void writeHomeLayout(std::ostream& out, const HomeLayout& layout) {
+    for (const auto& room : layout.rooms) {
+        out << "room ";
+        writeField(out, room);
+        out << '\n';
+    }
+    for (std::size_t i = 0; i < layout.devices.size(); ++i) {
+        const Device& device = *layout.devices[i];
+        const auto* light = dynamic_cast<const SmartLight*>(&device);
+        const auto* thermostat = dynamic_cast<const Thermostat*>(&device);
+        const auto* camera = dynamic_cast<const SecurityCamera*>(&device);
+        if (!light && !thermostat && !camera) {
+            throw std::invalid_argument("Layouts hold lights, thermostats and cameras only: " + device.getDeviceID());
+        }
+        out << (light ? "light " : thermostat ? "thermostat " : "camera ");
+        writeField(out, device.getDeviceID());
+        out << ' ';
+        writeField(out, device.getDeviceName());
+        out << ' ';
+        writeField(out, device.getDeviceLocation());
+        if (i < layout.deviceRoom.size() && layout.deviceRoom[i] >= 0) {
+            out << " room=";
+            writeField(out, layout.rooms.at(static_cast<std::size_t>(layout.deviceRoom[i])));
+        }
+        if (device.getIsOn()) {
+            out << " on";
+        }
+        // only what differs from a new device, in an order the device accepts
+        if (light) {
+            if (light->getBrightness() != 0) {
+                out << " brightness=" << light->getBrightness();
+            }
+            if (!(light->getColor() == LightColor())) {
+                out << " color=";
+                writeField(out, light->getColor().toString());
+            }
+        } else if (thermostat) {
+            out << " temperature=";
+            writeNumber(out, thermostat->getTemperature());
+            out << " setpoint=";
+            writeNumber(out, thermostat->getDesiredTemperature());
+            out << " mode=" << thermostat->getMode();
+        } else {
+            out << " resolution=" << camera->getResolution();
+            if (camera->getRotation() != 0) {
+                out << " rotation=" << camera->getRotation();
+            }
+            if (device.getIsOn() && camera->getMotionDetection()) {
+                out << " motion=on";
+            }
+            if (device.getIsOn() && camera->getIsRecording()) {
+                out << " record";
+            }
+        }
+        out << '\n';
+    }
+}
+
+bool saveHomeLayout(const std::string& path, const HomeLayout& layout) {
+    std::ofstream file(path, std::ios::binary);
+    writeHomeLayout(file, layout);
+    return static_cast<bool>(file);
+}
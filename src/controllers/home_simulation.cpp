@@ -0,0 +1,215 @@
+// includes
+#include "controllers/home_simulation.hpp"
+#include "controllers/energy_monitor.hpp"
+#include "core/tracing.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+static const std::uint64_t millisPerMinute = 60 * 1000;
+static const std::uint64_t millisPerDay = 24 * 60 * millisPerMinute;
+static const double pi = 3.14159265358979323846;
+
+namespace {
+
+// puts the home back as run() found it, also when a timer or device command throws: the
+// simulation's timers cancelled, the control loop's config and worker and the home's clock restored
+class RunRestore {
+    private:
+        HomeController& home;
+        std::vector<TimerId>& timers;
+        ControlLoopConfig savedControl;
+        HomeClock* savedClock;
+        bool workerWasRunning;
+
+    public:
+        RunRestore(HomeController& home, std::vector<TimerId>& timers)
+            : home(home)
+            , timers(timers)
+            , savedControl(home.getThermostatControl().getConfig())
+            , savedClock(&home.getClock())
+            , workerWasRunning(home.getThermostatControl().isRunning()) {}
+        RunRestore(const RunRestore&) = delete;
+        RunRestore& operator=(const RunRestore&) = delete;
+
+        ~RunRestore() {
+            for (TimerId timer : timers) {
+                home.getScheduler().cancel(timer);
+            }
+            timers.clear();
+            ThermostatControlLoop& loop = home.getThermostatControl();
+            loop.setConfig(savedControl);
+            home.setClock(savedClock);
+            if (workerWasRunning) {
+                loop.start();
+            }
+        }
+
+        const ControlLoopConfig& getSavedControl() const { return savedControl; }
+};
+
+} // namespace
+
+HomeSimulation::HomeSimulation(HomeController& simulatedHome, const SimulationConfig& simulationConfig)
+    : home(simulatedHome)
+    , config(simulationConfig)
+    , clock(0, static_cast<int>(simulationConfig.startMinute % (24 * 60)))
+    , random(simulationConfig.seed)
+    , clockOffset(0)
+{
+    if (config.controlPeriodSeconds == 0 || config.updatePeriodSeconds == 0) {
+        throw std::invalid_argument("Simulation periods must be positive");
+    }
+}
+
+// 53 random bits, so the sequence does not depend on the standard library's distributions
+double HomeSimulation::uniform() {
+    std::uint64_t bits = (static_cast<std::uint64_t>(random()) << 32) | random();
+    return static_cast<double>(bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Poisson arrivals, at least a millisecond apart
+std::uint64_t HomeSimulation::exponentialDelay(double perDay) {
+    double mean = static_cast<double>(millisPerDay) / perDay;
+    return std::max<std::uint64_t>(1, static_cast<std::uint64_t>(-std::log(1.0 - uniform()) * mean));
+}
+
+// a device command through the home, as if someone had sent it; timers run under the device mutex
+void HomeSimulation::apply(const std::shared_ptr<Device>& device, CommandType type, float value) {
+    if (home.applyCommandLocked(device->getDeviceID(), DeviceCommand{type, value, ""}) == DeviceResult::Ok) {
+        ++result.deviceEvents;
+    }
+}
+
+// switch the light, with a fresh brightness when it comes on; like every simulation timer it first
+// moves the clock to its own time, so energy readings are taken when the event happens
+void HomeSimulation::scheduleLight(std::size_t slot, std::shared_ptr<Device> light, double perDay) {
+    timers[slot] = home.getScheduler().runAfter(exponentialDelay(perDay), [this, slot, light, perDay]() {
+        clock.advanceTo(home.getScheduler().now() + static_cast<std::uint64_t>(clockOffset));
+        if (light->getIsOn()) {
+            apply(light, CommandType::TurnOff);
+        } else {
+            apply(light, CommandType::TurnOn);
+            apply(light, CommandType::SetBrightness, static_cast<float>(20 + random() % 81));
+        }
+        scheduleLight(slot, light, perDay);
+    });
+}
+
+// a recording starts at random and stops a fixed time later, then the next one is drawn
+void HomeSimulation::scheduleCamera(std::size_t slot, std::shared_ptr<Device> camera, double perDay) {
+    timers[slot] = home.getScheduler().runAfter(exponentialDelay(perDay), [this, slot, camera, perDay]() {
+        clock.advanceTo(home.getScheduler().now() + static_cast<std::uint64_t>(clockOffset));
+        apply(camera, CommandType::StartRecording);
+        timers[slot] = home.getScheduler().runAfter(config.recordingMinutes * millisPerMinute, [this, slot, camera, perDay]() {
+            clock.advanceTo(home.getScheduler().now() + static_cast<std::uint64_t>(clockOffset));
+            apply(camera, CommandType::StopRecording);
+            scheduleCamera(slot, camera, perDay);
+        });
+    });
+}
+
+// a cosine over the year, coldest on day 15
+float HomeSimulation::ambientAt(std::uint64_t millis) const {
+    double day = static_cast<double>(millis) / static_cast<double>(millisPerDay);
+    double winter = std::cos(2.0 * pi * (day - 15.0) / 365.0);
+    double middle = (config.winterAmbient + config.summerAmbient) / 2.0;
+    double swing = (config.summerAmbient - config.winterAmbient) / 2.0;
+    return static_cast<float>(middle - swing * winter);
+}
+
+SimulationResult HomeSimulation::run() {
+    TraceSpan span("HomeSimulation::run", "simulation");
+    result = SimulationResult();
+    ThermostatControlLoop& loop = home.getThermostatControl();
+    Scheduler& scheduler = home.getScheduler();
+    timers.clear();
+    RunRestore restore(home, timers);
+    loop.stop();
+    home.setClock(&clock);
+    std::uint64_t start = clock.nowMillis();
+    std::uint64_t end = start + config.durationMillis;
+    clockOffset = static_cast<std::int64_t>(start) - static_cast<std::int64_t>(scheduler.now());
+    EnergyMonitor* monitor = &home.getEnergyMonitor();
+    double energyAtStart = monitor->getTotalEnergyWattHours();
+
+    // gains for the longer step: proportional control alone halves the error every step on the
+    // plant model, the integral removes the remaining offset over about ten steps
+    float dt = static_cast<float>(config.controlPeriodSeconds);
+    ControlLoopConfig control = restore.getSavedControl();
+    control.periodMillis = config.controlPeriodSeconds * 1000;
+    control.strategy = ControlStrategy::Pid;
+    control.simulatePlant = true;
+    control.energyReportTicks = std::max(1u, config.updatePeriodSeconds / config.controlPeriodSeconds);
+    control.ambientTemperature = ambientAt(start);
+    float decay = control.lossRate > 0.0f ? std::exp(-control.lossRate * dt) : 1.0f;
+    float gain = control.lossRate > 0.0f ? control.heatingRate / control.lossRate * (1.0f - decay) : control.heatingRate * dt;
+    control.kp = 0.5f * decay / gain;
+    control.ki = 0.1f * control.kp / dt;
+    control.kd = 0.0f;
+    loop.setConfig(control);
+
+    // one recurring timer per device plus the control and season timers
+    std::vector<std::shared_ptr<Device>> devices = home.getDevices();
+    std::vector<std::shared_ptr<Thermostat>> thermostats;
+    for (const auto& device : devices) {
+        if (auto thermostat = std::dynamic_pointer_cast<Thermostat>(device)) {
+            thermostats.push_back(thermostat);
+            // every thermostat keeps its own wake and sleep time within half an hour of the schedule
+            int minuteNow = clock.minuteOfDay();
+            for (int target : {config.wakeMinute, config.sleepMinute}) {
+                int minute = target - 30 + static_cast<int>(random() % 61);
+                std::uint64_t first = static_cast<std::uint64_t>(((minute - minuteNow) % 1440 + 1440) % 1440) * millisPerMinute;
+                float setpoint = target == config.wakeMinute ? config.daySetpoint : config.nightSetpoint;
+                timers.push_back(scheduler.runEvery(millisPerDay, [this, thermostat, setpoint]() {
+                    clock.advanceTo(home.getScheduler().now() + static_cast<std::uint64_t>(clockOffset));
+                    apply(thermostat, CommandType::SetDesiredTemperature, setpoint);
+                }, std::max<std::uint64_t>(1, first)));
+            }
+        } else if (std::dynamic_pointer_cast<SmartLight>(device) && config.lightTogglesPerDay > 0.0) {
+            timers.push_back(0);
+            scheduleLight(timers.size() - 1, device, config.lightTogglesPerDay);
+        } else if (std::dynamic_pointer_cast<SecurityCamera>(device) && config.recordingsPerDay > 0.0) {
+            timers.push_back(0);
+            scheduleCamera(timers.size() - 1, device, config.recordingsPerDay);
+        }
+    }
+    std::uint64_t controlMillis = config.controlPeriodSeconds * 1000ull;
+    timers.push_back(scheduler.runEvery(controlMillis, [this, &loop, dt]() {
+        clock.advanceTo(home.getScheduler().now() + static_cast<std::uint64_t>(clockOffset));
+        loop.runTick(dt);
+        ++result.controlTicks;
+    }, controlMillis));
+    timers.push_back(scheduler.runEvery(millisPerDay, [this, &loop]() {
+        ControlLoopConfig seasonal = loop.getConfig();
+        seasonal.ambientTemperature = ambientAt(home.getScheduler().now() + static_cast<std::uint64_t>(clockOffset));
+        loop.setConfig(seasonal);
+    }, millisPerDay));
+
+    // the home catches up once per update period, the timers in between run at their own times
+    double temperatureSum = 0.0;
+    std::uint64_t temperatureSamples = 0;
+    std::uint64_t updateMillis = config.updatePeriodSeconds * 1000ull;
+    for (std::uint64_t now = start; now < end;) {
+        now = std::min(end, now + updateMillis);
+        {
+            std::lock_guard<std::mutex> guard(home.getDeviceMutex());
+            scheduler.advanceTo(now - static_cast<std::uint64_t>(clockOffset));
+        }
+        clock.advanceTo(now);
+        home.updateScheduler();
+        ++result.updates;
+        for (const auto& thermostat : thermostats) {
+            temperatureSum += thermostat->getTemperature();
+        }
+        temperatureSamples += thermostats.size();
+    }
+
+    result.simulatedMillis = end - start;
+    result.energyWattHours = monitor->getTotalEnergyWattHours() - energyAtStart;
+    result.meanIndoorTemperature = temperatureSamples > 0 ? temperatureSum / static_cast<double>(temperatureSamples) : 0.0;
+    return result; // restore puts the home back
+}
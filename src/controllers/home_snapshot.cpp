@@ -0,0 +1,260 @@
+// includes
+#include "controllers/home_snapshot.hpp"
+#include <stdexcept>
+#include "core/memory_usage.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+
+// a chunk's dirty bits lie within one word of the slot bitset
+static_assert(64 % HomeSnapshot::chunkSize == 0, "chunks must not straddle dirty slot words");
+
+namespace {
+
+// the state a view keeps, read while the caller holds the device mutex
+DeviceView capture(const std::shared_ptr<Device>& device, DeviceKind kind) {
+    DeviceView view;
+    if (!device) {
+        return view;
+    }
+    view.id = device->getDeviceID();
+    view.live = true;
+    view.name = device->getDeviceName();
+    view.location = device->getDeviceLocation();
+    view.kind = kind;
+    view.on = device->getIsOn();
+    view.power = static_cast<float>(device->getPowerUsage());
+    switch (kind) {
+        case DeviceKind::Light: {
+            const auto& light = static_cast<const SmartLight&>(*device);
+            view.brightness = static_cast<std::uint8_t>(light.getBrightness());
+            view.color = light.getColor();
+            break;
+        }
+        case DeviceKind::Thermostat: {
+            const auto& thermostat = static_cast<const Thermostat&>(*device);
+            view.temperature = thermostat.getTemperature();
+            view.desiredTemperature = thermostat.getDesiredTemperature();
+            view.mode = thermostat.getThermostatMode();
+            view.closedLoop = thermostat.isClosedLoop();
+            view.controlOutput = thermostat.getControlOutput();
+            break;
+        }
+        case DeviceKind::Camera: {
+            const auto& camera = static_cast<const SecurityCamera&>(*device);
+            view.recording = camera.getIsRecording();
+            view.resolution = camera.getCameraResolution();
+            view.rotation = static_cast<std::int16_t>(camera.getRotation());
+            view.motionDetection = camera.getMotionDetection();
+            break;
+        }
+        default:
+            view.otherStatus = std::make_shared<const std::string>(device->getDeviceStatus());
+            break;
+    }
+    return view;
+}
+
+} // namespace
+
+// formatted by the device classes from the captured fields, so the formats live only in the devices
+std::string DeviceView::status() const {
+    switch (kind) {
+        case DeviceKind::Light:
+            return SmartLight::formatStatus(id, on, brightness, color);
+        case DeviceKind::Thermostat:
+            return Thermostat::formatStatus(id, on, temperature, desiredTemperature, mode, closedLoop, controlOutput);
+        case DeviceKind::Camera:
+            return SecurityCamera::formatStatus(id, on, recording, resolution, rotation, motionDetection);
+        default:
+            return otherStatus ? *otherStatus : std::string();
+    }
+}
+
+HomeSnapshot::HomeSnapshot()
+    : version(0), rooms(std::make_shared<const std::vector<RoomView>>()), slotCount(0), deviceCount(0) {}
+
+std::uint64_t HomeSnapshot::getVersion() const {
+    return version;
+}
+
+std::size_t HomeSnapshot::getSlotCount() const {
+    return slotCount;
+}
+
+std::size_t HomeSnapshot::getDeviceCount() const {
+    return deviceCount;
+}
+
+const DeviceView& HomeSnapshot::at(std::size_t slot) const {
+    if (slot >= slotCount) {
+        throw std::out_of_range("snapshot slot " + std::to_string(slot) + " past " + std::to_string(slotCount));
+    }
+    return (*chunks[slot / chunkSize])[slot % chunkSize];
+}
+
+const DeviceView* HomeSnapshot::findNth(std::size_t n) const {
+    for (const auto& chunk : chunks) {
+        for (const DeviceView& view : *chunk) {
+            if (view.live && n-- == 0) {
+                return &view;
+            }
+        }
+    }
+    return nullptr;
+}
+
+const std::vector<RoomView>& HomeSnapshot::getRooms() const {
+    return *rooms;
+}
+
+EnergySnapshot HomeSnapshot::measureEnergy() const {
+    EnergySnapshot energy;
+    forEachDevice([&energy](const DeviceView& view) {
+        energy.totalWatts += view.power;
+        energy.devicesOn += view.on ? 1 : 0;
+        energy.wattsByLocation[view.location] += view.power;
+        ++energy.deviceCount;
+    });
+    return energy;
+}
+
+std::size_t HomeSnapshot::getMemoryUsage() const {
+    std::size_t bytes = sizeof(HomeSnapshot) + heapBytes(chunks) + heapBytes(*rooms);
+    for (const auto& chunk : chunks) {
+        bytes += sizeof(HomeSnapshot::Chunk) + heapBytes(*chunk);
+        for (const DeviceView& view : *chunk) {
+            bytes += heapBytes(view.id) + heapBytes(view.name) + heapBytes(view.location)
+                   + (view.otherStatus ? sharedControlBlockBytes + sizeof(std::string) + heapBytes(*view.otherStatus) : 0);
+        }
+    }
+    for (const RoomView& room : *rooms) {
+        bytes += heapBytes(room.name) + heapBytes(room.slots);
+    }
+    return bytes;
+}
+
+PinnedSnapshot::PinnedSnapshot(EpochDomain::ReadGuard guard, const HomeSnapshot* snapshot)
+    : guard(std::move(guard)), snapshot(snapshot) {}
+
+const HomeSnapshot& PinnedSnapshot::operator*() const {
+    return *snapshot;
+}
+
+const HomeSnapshot* PinnedSnapshot::operator->() const {
+    return snapshot;
+}
+
+SnapshotPublisher::SnapshotPublisher() : published(nullptr), devicesDirty(false), roomsDirty(false) {}
+
+SnapshotPublisher::~SnapshotPublisher() {
+    if (published) {
+        std::vector<const HomeSnapshot::Chunk*> chunks = published->chunks;
+        latest.publish(nullptr);
+        retireChunks(std::move(chunks));
+    }
+}
+
+void SnapshotPublisher::retireChunks(std::vector<const HomeSnapshot::Chunk*> chunks) {
+    if (chunks.empty()) {
+        return;
+    }
+    auto garbage = std::make_shared<std::vector<const HomeSnapshot::Chunk*>>(std::move(chunks));
+    EpochDomain::getInstance()->retire([garbage] {
+        for (const HomeSnapshot::Chunk* chunk : *garbage) {
+            delete chunk;
+        }
+    });
+}
+
+bool SnapshotPublisher::isPublishing() const {
+    return published != nullptr;
+}
+
+bool SnapshotPublisher::hasChanges() const {
+    return devicesDirty || roomsDirty;
+}
+
+void SnapshotPublisher::deviceChanged(std::uint32_t slot) {
+    if (!published || slot == DeviceIndex::noSlot) {
+        return;
+    }
+    if (slot / 64 >= dirtySlots.size()) {
+        dirtySlots.resize(slot / 64 + 1, 0);
+    }
+    dirtySlots[slot / 64] |= std::uint64_t(1) << (slot % 64);
+    devicesDirty = true;
+}
+
+void SnapshotPublisher::roomsChanged() {
+    roomsDirty = published != nullptr;
+}
+
+// chunks that changed, or grew with new slots, are copied from the devices; the rest are shared
+// with the previous version, and the ones replaced are retired once it is
+std::uint64_t SnapshotPublisher::publish(const DeviceIndex& index, const std::vector<std::unique_ptr<RoomController>>& rooms) {
+    auto next = std::make_unique<HomeSnapshot>();
+    next->version = published ? published->version + 1 : 1;
+    next->slotCount = index.getSlotCount();
+    next->deviceCount = index.size();
+    std::size_t chunkCount = (next->slotCount + HomeSnapshot::chunkSize - 1) / HomeSnapshot::chunkSize;
+    next->chunks.reserve(chunkCount);
+    std::vector<const HomeSnapshot::Chunk*> replaced;
+    for (std::size_t c = 0; c < chunkCount; ++c) {
+        std::size_t begin = c * HomeSnapshot::chunkSize;
+        std::size_t end = std::min(begin + HomeSnapshot::chunkSize, next->slotCount);
+        const HomeSnapshot::Chunk* previous = published && c < published->chunks.size() ? published->chunks[c] : nullptr;
+        std::uint64_t word = begin / 64 < dirtySlots.size() ? dirtySlots[begin / 64] : 0;
+        std::uint64_t dirty = (word >> (begin % 64)) & (~std::uint64_t(0) >> (64 - HomeSnapshot::chunkSize)); // a bit per slot
+        bool grown = previous && c + 1 == published->chunks.size() && previous->size() != end - begin; // only the last can grow
+        if (previous && dirty == 0 && !grown) {
+            next->chunks.push_back(previous);
+            continue;
+        }
+        auto chunk = std::make_unique<HomeSnapshot::Chunk>();
+        chunk->reserve(end - begin);
+        for (std::size_t slot = begin; slot < end; ++slot) {
+            std::size_t offset = slot - begin;
+            if (previous && offset < previous->size() && !((dirty >> offset) & 1u)) {
+                chunk->push_back((*previous)[offset]);
+            } else {
+                auto slotIndex = static_cast<std::uint32_t>(slot);
+                chunk->push_back(capture(index.deviceAt(slotIndex), index.kindAt(slotIndex)));
+            }
+        }
+        next->chunks.push_back(chunk.release());
+        if (previous) {
+            replaced.push_back(previous);
+        }
+    }
+
+    if (published && !roomsDirty) {
+        next->rooms = published->rooms;
+    } else {
+        auto roomViews = std::make_shared<std::vector<RoomView>>();
+        roomViews->reserve(rooms.size());
+        for (const auto& room : rooms) {
+            roomViews->push_back(RoomView{room->getRoomName(), index.roomSlots(room->getRoomName())});
+        }
+        next->rooms = std::move(roomViews);
+    }
+
+    std::fill(dirtySlots.begin(), dirtySlots.end(), 0);
+    devicesDirty = false;
+    roomsDirty = false;
+    published = next.get();
+    latest.publish(std::move(next));
+    retireChunks(std::move(replaced)); // after the version that held them is unpublished
+    return published->version;
+}
+
+std::uint64_t SnapshotPublisher::getVersion() const {
+    return published ? published->version : 0;
+}
+
+const HomeSnapshot* SnapshotPublisher::load(const EpochDomain::ReadGuard& guard) const {
+    return latest.load(guard);
+}
+
+std::size_t SnapshotPublisher::getMemoryUsage() const {
+    return published ? published->getMemoryUsage() : 0;
+}
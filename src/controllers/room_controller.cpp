@@ -1,65 +1,126 @@
 #include "controllers/room_controller.hpp"
+#include "devices/async_device.hpp"
+#include "core/logger.hpp"
+#include "core/memory_usage.hpp"
+#include "core/metrics.hpp"
+#include "core/tracing.hpp"
 #include <iostream>
 #include <algorithm>
 
 // using statements
 using std::cout;
-using std::endl;
 using std::string;
 using std::vector;
 using std::shared_ptr;
-using std::remove_if;
 using std::any_of;
+using std::remove_if;
 
 RoomController::RoomController(const string& name) : roomName(name) {}
 
+// bulk operation metrics, every call is timed since each one switches a whole room
+struct BulkMetrics {
+    Counter operations;
+    Counter devicesSwitched;
+    Histogram duration;
+};
+
+static const BulkMetrics& bulkMetrics(bool on) {
+    static auto make = [](const char* operation) {
+        MetricsRegistry* registry = MetricsRegistry::getInstance();
+        string label = string("operation=\"") + operation + "\"";
+        return BulkMetrics{
+            registry->counter("smart_home_room_bulk_operations_total", "Room-wide turn on and turn off calls", label),
+            registry->counter("smart_home_room_bulk_devices_total", "Devices switched by room-wide calls", label),
+            registry->histogram("smart_home_room_bulk_duration_seconds", "Time to switch every device in a room", label)
+        };
+    };
+    static const BulkMetrics turnOn = make("on");
+    static const BulkMetrics turnOff = make("off");
+    return on ? turnOn : turnOff;
+}
+
+// small rooms are scanned, the ID set is built once a room outgrows that and kept from then on
+bool RoomController::claimId(const Device& device) {
+    if (deviceIds.empty()) {
+        if (roomDevices.size() < scannedRoomSize) {
+            return !hasDevice(device.getDeviceID());
+        }
+        for (const auto& member : roomDevices) {
+            deviceIds.insert(member->getDeviceID());
+        }
+    }
+    return deviceIds.insert(device.getDeviceID()).second;
+}
+
 // add device to room
 void RoomController::addDevice(shared_ptr<Device> device) {
-    if (!hasDevice(device->getDeviceID())) {
+    if (claimId(*device)) {
         roomDevices.push_back(device);
-        cout << "Device " << device->getDeviceID() << " added to " << roomName << endl;
+        logInfo("Device ", device->getDeviceID(), " added to ", roomName);
     } else {
-        cout << "Device already exists in this room." << endl;
+        logWarning("Device already exists in this room.");
+    }
+}
+
+// add many devices to room, e.g. from a layout file
+size_t RoomController::addDevices(const vector<shared_ptr<Device>>& devices) {
+    roomDevices.reserve(roomDevices.size() + devices.size());
+    if (roomDevices.size() + devices.size() >= scannedRoomSize) {
+        deviceIds.reserve(roomDevices.size() + devices.size()); // the room ends up too large to scan
+    }
+    size_t added = 0;
+    for (const auto& device : devices) {
+        if (claimId(*device)) {
+            roomDevices.push_back(device);
+            ++added;
+        }
     }
+    logDebug(added, " devices added to ", roomName);
+    return added;
 }
 
 // remove device from room
 void RoomController::removeDevice(const string& deviceID) {
-    auto initialSize = roomDevices.size();
+    if (!hasDevice(deviceID)) {
+        logWarning("Device not found in this room.");
+        return;
+    }
+    deviceIds.erase(deviceID); // before the device, whose ID the key views, can go
     roomDevices.erase(
         remove_if(roomDevices.begin(), roomDevices.end(),
                   [&deviceID](const auto& device) {
                       return device->getDeviceID() == deviceID;
                   }),
         roomDevices.end());
-
-    if (roomDevices.size() < initialSize) {
-        cout << "Device " << deviceID << " removed from " << roomName << endl;
-    } else {
-        cout << "Device not found in this room." << endl;
-    }
+    logInfo("Device ", deviceID, " removed from ", roomName);
 }
 
 // list all devices in room
 void RoomController::listDevices() const {
-    cout << "\nDevices in " << roomName << " (" << roomDevices.size() << " devices):" << endl;
+    TraceSpan span("RoomController::listDevices", "console", roomName);
+    cout << "\nDevices in " << roomName << " (" << roomDevices.size() << " devices):\n";
     if (roomDevices.empty()) {
-        cout << "No devices in this room." << endl;
+        cout << "No devices in this room.\n";
         return;
     }
     for (size_t i = 0; i < roomDevices.size(); ++i) {
-        cout << i + 1 << ". " << roomDevices[i]->getDeviceStatus() << endl;
+        cout << i + 1 << ". " << roomDevices[i]->getDeviceStatus() << "\n";
     }
 }
 
 // turn all devices on
 void RoomController::turnAllDevicesOn() {
-    cout << "Turning on all devices in " << roomName << "..." << endl;
+    TraceSpan span("RoomController::turnAllDevicesOn", "room", roomName);
+    const BulkMetrics& metrics = bulkMetrics(true);
+    ScopedLatency timer(metrics.duration);
+    metrics.operations.increment();
+    metrics.devicesSwitched.increment(roomDevices.size());
+    logInfo("Turning on all devices in ", roomName, "...");
     for (auto& device : roomDevices) {
         try {
             device->turnOn();
         } catch (const std::exception& e) {
-            std::cerr << "Error turning on device " << device->getDeviceID() << ": " << e.what() << endl;
+            logError("Error turning on device ", device->getDeviceID(), ": ", e.what());
             throw std::runtime_error("Failed to turn on device");
         }
     }
@@ -67,17 +128,53 @@ void RoomController::turnAllDevicesOn() {
 
 // turn all devices off
 void RoomController::turnAllDevicesOff() {
-    cout << "Turning off all devices in " << roomName << "..." << endl;
+    TraceSpan span("RoomController::turnAllDevicesOff", "room", roomName);
+    const BulkMetrics& metrics = bulkMetrics(false);
+    ScopedLatency timer(metrics.duration);
+    metrics.operations.increment();
+    metrics.devicesSwitched.increment(roomDevices.size());
+    logInfo("Turning off all devices in ", roomName, "...");
     for (auto& device : roomDevices) {
         try {
             device->turnOff();
         } catch (const std::exception& e) {
-            std::cerr << "Error turning off device " << device->getDeviceID() << ": " << e.what() << endl;
+            logError("Error turning off device ", device->getDeviceID(), ": ", e.what());
             throw std::runtime_error("Failed to turn off device");
         }
     }
 }
 
+// turn all devices on or off concurrently, the arguments are copied into the task before it starts
+Task<size_t> RoomController::setAllDevicesPowerAsync(DeviceTransport& transport, bool on, std::mutex* deviceMutex) {
+    return setDevicesPowerAsync(transport, roomName, roomDevices, on, deviceMutex);
+}
+
+// each command waits for its device's answer; parameters are taken by value, they live in the
+// coroutine frame while it is suspended
+Task<size_t> RoomController::setDevicesPowerAsync(DeviceTransport& transport, string roomName, vector<shared_ptr<Device>> devices,
+                                                  bool on, std::mutex* deviceMutex) {
+    TraceSpan span(on ? "RoomController::turnAllDevicesOnAsync" : "RoomController::turnAllDevicesOffAsync", "room", roomName);
+    const BulkMetrics& metrics = bulkMetrics(on);
+    ScopedLatency timer(metrics.duration);
+    metrics.operations.increment();
+    DeviceCommand command{on ? CommandType::TurnOn : CommandType::TurnOff, 0.0f, ""};
+    vector<Task<DeviceResult>> commands;
+    commands.reserve(devices.size());
+    for (const auto& device : devices) {
+        commands.push_back(applyCommandAsync(transport, device, command, deviceMutex));
+    }
+    vector<DeviceResult> results = co_await whenAll(std::move(commands));
+    size_t answered = 0;
+    for (DeviceResult result : results) {
+        answered += result == DeviceResult::Timeout ? 0 : 1;
+    }
+    metrics.devicesSwitched.increment(answered);
+    if (answered < results.size()) {
+        logWarning(results.size() - answered, " devices in ", roomName, " did not respond");
+    }
+    co_return answered;
+}
+
 // get room name
 string RoomController::getRoomName() const {
     return roomName;
@@ -90,13 +187,19 @@ size_t RoomController::getDeviceCount() const {
 
 // check if room has device by ID
 bool RoomController::hasDevice(const string& deviceID) const {
+    if (!deviceIds.empty()) {
+        return deviceIds.count(deviceID) > 0;
+    }
     return any_of(roomDevices.begin(), roomDevices.end(),
-                  [&deviceID](const auto& device) {
-                      return device->getDeviceID() == deviceID;
-                  });
+                  [&deviceID](const auto& device) { return device->getDeviceID() == deviceID; });
 }
 
 // vector of devices in room
 vector<shared_ptr<Device>> RoomController::getDevices() const {
     return roomDevices;
 }
+
+// get the bytes of the room and its lists
+size_t RoomController::getMemoryUsage() const {
+    return sizeof(RoomController) + heapBytes(roomName) + heapBytes(roomDevices) + hashTableBytes(deviceIds);
+}
@@ -0,0 +1,166 @@
+// includes
+#include "controllers/scheduler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// progress of a running fade, shared with its timer callback
+struct FadeState {
+    std::weak_ptr<SmartLight> light; // light being faded, the fade stops if it is removed
+    int startBrightness; // brightness when the fade began
+    int targetBrightness; // brightness at the end of the fade
+    std::uint64_t durationMillis; // total fade time
+    std::uint64_t elapsedMillis; // fade time covered so far
+    std::uint64_t stepMillis; // time between brightness updates
+    TimerId timer; // periodic timer driving the fade
+};
+
+// progress of a running color transition, shared with its timer callback
+struct ColorFadeState {
+    std::weak_ptr<SmartLight> light; // light being faded, the transition stops if it is removed
+    LightColor startColor; // color when the transition began
+    LightColor targetColor; // color at the end of the transition
+    std::uint64_t durationMillis; // total transition time
+    std::uint64_t elapsedMillis; // transition time covered so far
+    std::uint64_t stepMillis; // time between color updates
+    TimerId timer; // periodic timer driving the transition
+};
+
+// constructor
+Scheduler::Scheduler(std::uint64_t startMillis)
+    : wheel(startMillis)
+{}
+
+TimerId Scheduler::runAfter(std::uint64_t delayMillis, std::function<void()> action) {
+    return wheel.schedule(delayMillis, std::move(action));
+}
+
+TimerId Scheduler::runAt(std::uint64_t atMillis, std::function<void()> action) {
+    return wheel.schedule(atMillis > now() ? atMillis - now() : 0, std::move(action));
+}
+
+// first run after firstDelayMillis, or after one period when no delay is given
+TimerId Scheduler::runEvery(std::uint64_t periodMillis, std::function<void()> action, std::uint64_t firstDelayMillis) {
+    if (periodMillis == 0) {
+        throw std::invalid_argument("Schedule period must be positive");
+    }
+    return wheel.schedule(firstDelayMillis == 0 ? periodMillis : firstDelayMillis, std::move(action), periodMillis);
+}
+
+bool Scheduler::cancel(TimerId id) {
+    return wheel.cancel(id);
+}
+
+bool Scheduler::isPending(TimerId id) const {
+    return wheel.isPending(id);
+}
+
+// turn a device on later, skipped if the device has been removed by then
+TimerId Scheduler::turnOnAfter(const std::shared_ptr<Device>& device, std::uint64_t delayMillis) {
+    std::weak_ptr<Device> target = device;
+    return runAfter(delayMillis, [target] {
+        if (auto d = target.lock()) {
+            d->turnOn();
+        }
+    });
+}
+
+// turn a device off later, skipped if the device has been removed by then
+TimerId Scheduler::turnOffAfter(const std::shared_ptr<Device>& device, std::uint64_t delayMillis) {
+    std::weak_ptr<Device> target = device;
+    return runAfter(delayMillis, [target] {
+        if (auto d = target.lock()) {
+            d->turnOff();
+        }
+    });
+}
+
+// each step sets the brightness for its point on the line, so late steps do not accumulate error
+TimerId Scheduler::fadeBrightness(const std::shared_ptr<SmartLight>& light, int targetBrightness,
+                                  std::uint64_t durationMillis, std::uint64_t stepMillis) {
+    if (!light) {
+        throw std::invalid_argument("Cannot fade a missing light");
+    }
+    if (targetBrightness < 0 || targetBrightness > 100) {
+        throw std::invalid_argument("Brightness must be between 0 and 100");
+    }
+    if (stepMillis == 0) {
+        throw std::invalid_argument("Fade step must be positive");
+    }
+
+    auto state = std::make_shared<FadeState>();
+    state->light = light;
+    state->startBrightness = light->getBrightness();
+    state->targetBrightness = targetBrightness;
+    state->durationMillis = durationMillis;
+    state->elapsedMillis = 0;
+    state->stepMillis = std::min(stepMillis, std::max<std::uint64_t>(durationMillis, 1));
+
+    state->timer = wheel.schedule(state->stepMillis, [this, state] {
+        auto target = state->light.lock();
+        if (!target) {
+            wheel.cancel(state->timer);
+            return;
+        }
+        state->elapsedMillis = std::min(state->elapsedMillis + state->stepMillis, state->durationMillis);
+        double progress = state->durationMillis == 0 ? 1.0
+            : static_cast<double>(state->elapsedMillis) / static_cast<double>(state->durationMillis);
+        int level = static_cast<int>(std::lround(state->startBrightness + (state->targetBrightness - state->startBrightness) * progress));
+        (void)target->trySetBrightness(level); // always in range, both ends were validated
+        if (state->elapsedMillis >= state->durationMillis) {
+            wheel.cancel(state->timer);
+        }
+    }, state->stepMillis);
+    return state->timer;
+}
+
+// same stepping as brightness fades, the blend itself is done by LightColor
+TimerId Scheduler::fadeColor(const std::shared_ptr<SmartLight>& light, LightColor targetColor,
+                             std::uint64_t durationMillis, std::uint64_t stepMillis) {
+    if (!light) {
+        throw std::invalid_argument("Cannot fade a missing light");
+    }
+    if (stepMillis == 0) {
+        throw std::invalid_argument("Fade step must be positive");
+    }
+
+    auto state = std::make_shared<ColorFadeState>();
+    state->light = light;
+    state->startColor = light->getColor();
+    state->targetColor = targetColor;
+    state->durationMillis = durationMillis;
+    state->elapsedMillis = 0;
+    state->stepMillis = std::min(stepMillis, std::max<std::uint64_t>(durationMillis, 1));
+
+    state->timer = wheel.schedule(state->stepMillis, [this, state] {
+        auto target = state->light.lock();
+        if (!target) {
+            wheel.cancel(state->timer);
+            return;
+        }
+        state->elapsedMillis = std::min(state->elapsedMillis + state->stepMillis, state->durationMillis);
+        double progress = state->durationMillis == 0 ? 1.0
+            : static_cast<double>(state->elapsedMillis) / static_cast<double>(state->durationMillis);
+        target->setColor(LightColor::interpolate(state->startColor, state->targetColor, progress));
+        if (state->elapsedMillis >= state->durationMillis) {
+            wheel.cancel(state->timer);
+        }
+    }, state->stepMillis);
+    return state->timer;
+}
+
+std::size_t Scheduler::advanceTo(std::uint64_t nowMillis) {
+    return wheel.advanceTo(nowMillis);
+}
+
+std::size_t Scheduler::advanceBy(std::uint64_t millis) {
+    return wheel.advanceTo(now() + millis);
+}
+
+std::uint64_t Scheduler::now() const {
+    return wheel.now();
+}
+
+std::size_t Scheduler::getPendingCount() const {
+    return wheel.getPendingCount();
+}
@@ -0,0 +1,354 @@
+// includes
+#include "controllers/thermostat_control.hpp"
+#include "core/tracing.hpp"
+#include "controllers/energy_monitor.hpp"
+#include "core/memory_usage.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using SteadyClock = std::chrono::steady_clock;
+
+// output limits for a thermostat mode, heating cannot cool and cooling cannot heat
+static void outputLimits(ThermostatMode mode, float& low, float& high) {
+    low = mode == ThermostatMode::Heating ? 0.0f : -1.0f;
+    high = mode == ThermostatMode::Cooling ? 0.0f : 1.0f;
+}
+
+// below this many thermostats a tick is cheaper than handing it to the pool
+static const std::size_t parallelChannelThreshold = 1024;
+
+// constructor
+ThermostatControlLoop::ThermostatControlLoop(const ControlLoopConfig& initialConfig)
+    : ticksSinceReport(0)
+    , plantDecay(1.0f)
+    , deviceMutex(nullptr)
+    , executor(nullptr)
+    , energyMonitor(nullptr)
+    , stopRequested(false)
+    , running(false)
+    , jitterNext(0)
+    , tickCount(0)
+    , workerTicks(0)
+    , missedTicks(0)
+    , maxJitterMicros(0.0)
+    , totalTickMicros(0.0)
+    , maxTickMicros(0.0)
+{
+    setConfig(initialConfig);
+    jitterSamples.reserve(jitterSampleCount);
+}
+
+// destructor
+ThermostatControlLoop::~ThermostatControlLoop() {
+    stop();
+}
+
+// the current temperature seeds the derivative so the first step does not kick
+void ThermostatControlLoop::addThermostat(const std::shared_ptr<Thermostat>& thermostat) {
+    if (!thermostat) {
+        throw std::invalid_argument("Cannot control a missing thermostat");
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (channelById.count(thermostat->getDeviceID())) {
+        return;
+    }
+    Channel channel;
+    channel.thermostat = thermostat;
+    channel.integral = 0.0f;
+    channel.lastTemperature = thermostat->getTemperature();
+    channel.relay = 0;
+    channel.temperatureMoved = false;
+    channel.energyAccumulator = 0.0;
+    channelById.emplace(thermostat->getDeviceID(), channels.size());
+    channels.push_back(std::move(channel));
+}
+
+// swap with the last channel so removal stays constant time
+bool ThermostatControlLoop::removeThermostat(const std::string& deviceId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = channelById.find(deviceId);
+    if (it == channelById.end()) {
+        return false;
+    }
+    std::size_t index = it->second;
+    channels[index].thermostat->releaseControl();
+    channelById.erase(it);
+    if (index + 1 != channels.size()) {
+        channels[index] = std::move(channels.back());
+        channelById[channels[index].thermostat->getDeviceID()] = index;
+    }
+    channels.pop_back();
+    return true;
+}
+
+std::size_t ThermostatControlLoop::getThermostatCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return channels.size();
+}
+
+void ThermostatControlLoop::setConfig(const ControlLoopConfig& newConfig) {
+    if (newConfig.periodMillis == 0) {
+        throw std::invalid_argument("Control period must be positive");
+    }
+    if (newConfig.energyReportTicks == 0) {
+        throw std::invalid_argument("Energy report interval must be positive");
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    config = newConfig;
+}
+
+ControlLoopConfig ThermostatControlLoop::getConfig() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return config;
+}
+
+void ThermostatControlLoop::start() {
+    if (running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopRequested = false;
+    }
+    running = true;
+    worker = std::thread(&ThermostatControlLoop::workerLoop, this);
+}
+
+void ThermostatControlLoop::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopRequested = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    running = false;
+}
+
+bool ThermostatControlLoop::isRunning() const {
+    return running;
+}
+
+void ThermostatControlLoop::setDeviceMutex(std::mutex* mutex) {
+    deviceMutex = mutex;
+}
+
+void ThermostatControlLoop::setExecutor(WorkStealingPool* pool) {
+    std::lock_guard<std::mutex> lock(mutex);
+    executor = pool;
+}
+
+void ThermostatControlLoop::setEnergyMonitor(EnergyMonitor* monitor) {
+    std::lock_guard<std::mutex> lock(mutex);
+    energyMonitor = monitor;
+}
+
+// deadlines are absolute so compute time and wake-up delay do not accumulate into drift
+void ThermostatControlLoop::workerLoop() {
+    Tracer::getInstance()->setThreadName("thermostat control");
+    std::chrono::microseconds period(static_cast<std::int64_t>(getConfig().periodMillis) * 1000);
+    auto deadline = SteadyClock::now() + period;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            if (wake.wait_until(lock, deadline, [this] { return stopRequested; })) {
+                return;
+            }
+        }
+        auto woke = SteadyClock::now();
+        {
+            std::unique_lock<std::mutex> devices;
+            if (deviceMutex) {
+                devices = std::unique_lock<std::mutex>(*deviceMutex);
+            }
+            runTick(static_cast<float>(period.count()) / 1e6f);
+        }
+        auto finished = SteadyClock::now();
+
+        double jitter = std::chrono::duration<double, std::micro>(woke - deadline).count();
+        double tickMicros = std::chrono::duration<double, std::micro>(finished - woke).count();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jitterSamples.size() < jitterSampleCount) {
+                jitterSamples.push_back(static_cast<float>(jitter));
+            } else {
+                jitterSamples[jitterNext] = static_cast<float>(jitter);
+            }
+            jitterNext = (jitterNext + 1) % jitterSampleCount;
+            maxJitterMicros = std::max(maxJitterMicros, jitter);
+            ++workerTicks;
+            totalTickMicros += tickMicros;
+            maxTickMicros = std::max(maxTickMicros, tickMicros);
+
+            // a period changed by setConfig applies from the next deadline on
+            period = std::chrono::microseconds(static_cast<std::int64_t>(config.periodMillis) * 1000);
+
+            // a tick that overran skips the deadlines it missed rather than running them back to back
+            deadline += period;
+            while (deadline <= finished) {
+                deadline += period;
+                ++missedTicks;
+            }
+        }
+    }
+}
+
+// PID with derivative on measurement and no integration while saturated, or a relay with a dead band
+float ThermostatControlLoop::computeOutput(Channel& channel, const Thermostat& thermostat, float dtSeconds) {
+    float temperature = thermostat.getTemperature();
+    float setpoint = thermostat.getDesiredTemperature();
+    float low, high;
+    outputLimits(thermostat.getThermostatMode(), low, high);
+    float error = setpoint - temperature;
+
+    if (config.strategy == ControlStrategy::Hysteresis) {
+        float band = config.hysteresisBand;
+        if (temperature < setpoint - band && high > 0.0f) {
+            channel.relay = 1;
+        } else if (temperature > setpoint + band && low < 0.0f) {
+            channel.relay = -1;
+        } else if ((channel.relay > 0 && temperature >= setpoint + (low < 0.0f ? 0.0f : band))
+                   || (channel.relay < 0 && temperature <= setpoint - (high > 0.0f ? 0.0f : band))) {
+            channel.relay = 0;
+        }
+        return static_cast<float>(channel.relay);
+    }
+
+    float derivative = dtSeconds > 0.0f ? (temperature - channel.lastTemperature) / dtSeconds : 0.0f;
+    float integral = channel.integral + error * dtSeconds;
+    float output = config.kp * error + config.ki * integral - config.kd * derivative;
+    bool windingUp = (output > high && error > 0.0f) || (output < low && error < 0.0f);
+    if (!windingUp) {
+        channel.integral = integral;
+    }
+    output = config.kp * error + config.ki * channel.integral - config.kd * derivative;
+    return std::min(high, std::max(low, output));
+}
+
+// one pass over all channels under the lock
+void ThermostatControlLoop::runTick(float dtSeconds) {
+    TraceSpan span("ThermostatControlLoop::runTick", "control");
+    std::lock_guard<std::mutex> lock(mutex);
+    plantDecay = std::exp(-config.lossRate * dtSeconds);
+    // channels are independent, so a large tick is split into contiguous runs, a few per worker;
+    // the pool tasks run while this thread holds the lock for them
+    if (executor && executor->getWorkerCount() > 1 && channels.size() >= parallelChannelThreshold) {
+        std::size_t chunks = executor->getWorkerCount() * 4;
+        executor->parallelFor(channels.size(), (channels.size() + chunks - 1) / chunks,
+            [this, dtSeconds](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; ++i) {
+                    stepChannel(channels[i], dtSeconds);
+                }
+            });
+    } else {
+        for (auto& channel : channels) {
+            stepChannel(channel, dtSeconds);
+        }
+    }
+
+    ++tickCount;
+    if (++ticksSinceReport >= config.energyReportTicks) {
+        reportEnergy();
+    }
+}
+
+// one thermostat's control output and simulated temperature, no notifications or shared state
+void ThermostatControlLoop::stepChannel(Channel& channel, float dtSeconds) {
+    Thermostat& thermostat = *channel.thermostat;
+    if (!thermostat.getIsOn()) {
+        channel.integral = 0.0f;
+        channel.relay = 0;
+        thermostat.applyControlOutput(0.0f);
+    } else {
+        thermostat.applyControlOutput(computeOutput(channel, thermostat, dtSeconds));
+    }
+    channel.lastTemperature = thermostat.getTemperature();
+
+    // the first-order model solved exactly over the step, so long simulated steps cannot overshoot
+    if (config.simulatePlant) {
+        float temperature = thermostat.getTemperature();
+        float heating = thermostat.getControlOutput() * config.heatingRate;
+        float next = temperature + heating * dtSeconds;
+        if (config.lossRate > 0.0f) {
+            float settled = config.ambientTemperature + heating / config.lossRate;
+            next = settled + (temperature - settled) * plantDecay;
+        }
+        thermostat.updateTemperatureReading(next);
+        channel.temperatureMoved = channel.temperatureMoved || thermostat.getTemperature() != temperature;
+    }
+    channel.energyAccumulator += thermostat.getPowerUsage();
+}
+
+// averaged over the report interval, one monitor lock per report instead of one per thermostat
+void ThermostatControlLoop::reportEnergy() {
+    TraceSpan span("ThermostatControlLoop::reportEnergy", "control");
+    energyBatch.clear();
+    energyBatch.reserve(channels.size());
+    for (auto& channel : channels) {
+        energyBatch.emplace_back(channel.thermostat->getDeviceID(), channel.energyAccumulator / ticksSinceReport);
+        channel.energyAccumulator = 0.0;
+    }
+    ticksSinceReport = 0;
+    (energyMonitor ? energyMonitor : EnergyMonitor::getInstance())->recordUsageBatch(energyBatch);
+}
+
+// called on the thread that owns the observers, e.g. the home controller's main loop; the
+// callback runs outside the loop's lock, so it may add or remove thermostats
+std::size_t ThermostatControlLoop::publishTemperatureChanges(const std::function<void(Thermostat&)>& publish) {
+    std::vector<std::shared_ptr<Thermostat>> moved;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& channel : channels) {
+            if (channel.temperatureMoved) {
+                channel.temperatureMoved = false;
+                moved.push_back(channel.thermostat);
+            }
+        }
+    }
+    for (const auto& thermostat : moved) {
+        publish(*thermostat);
+    }
+    return moved.size();
+}
+
+ControlLoopStats ThermostatControlLoop::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ControlLoopStats stats;
+    stats.ticks = tickCount;
+    stats.missedTicks = missedTicks;
+    stats.maxJitterMicros = maxJitterMicros;
+    stats.maxTickMicros = maxTickMicros;
+    if (!jitterSamples.empty()) {
+        std::vector<float> sorted(jitterSamples);
+        std::sort(sorted.begin(), sorted.end());
+        stats.p50JitterMicros = sorted[(sorted.size() - 1) / 2];
+        stats.p99JitterMicros = sorted[(sorted.size() - 1) * 99 / 100];
+    }
+    if (workerTicks > 0) {
+        stats.meanTickMicros = totalTickMicros / static_cast<double>(workerTicks);
+    }
+    return stats;
+}
+
+void ThermostatControlLoop::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    jitterSamples.clear();
+    jitterNext = 0;
+    tickCount = 0;
+    workerTicks = 0;
+    missedTicks = 0;
+    maxJitterMicros = 0.0;
+    totalTickMicros = 0.0;
+    maxTickMicros = 0.0;
+}
+
+std::size_t ThermostatControlLoop::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t bytes = heapBytes(channels) + hashTableBytes(channelById) + heapBytes(energyBatch) + heapBytes(jitterSamples);
+    for (const auto& reading : energyBatch) {
+        bytes += heapBytes(reading.first);
+    }
+    return bytes;
+}
@@ -0,0 +1,56 @@
+// includes
+#include "core/clock.hpp"
+#include <ctime>
+#include <stdexcept>
+
+static const std::uint64_t millisPerMinute = 60 * 1000;
+static const int minutesPerDay = 24 * 60;
+
+SystemClock::SystemClock() : epoch(std::chrono::steady_clock::now()) {}
+
+std::uint64_t SystemClock::nowMillis() const {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+// local time, localtime_r so readers on other threads do not share its buffer
+int SystemClock::minuteOfDay() const {
+    std::time_t now = std::time(nullptr);
+    std::tm local;
+    if (localtime_r(&now, &local) == nullptr) {
+        return 0;
+    }
+    return local.tm_hour * 60 + local.tm_min;
+}
+
+VirtualClock::VirtualClock(std::uint64_t startMillis, int startMinuteOfDay)
+    : millis(startMillis)
+    , startMinute(startMinuteOfDay)
+{
+    if (startMinuteOfDay < 0 || startMinuteOfDay >= minutesPerDay) {
+        throw std::invalid_argument("Start minute must be between 0 and 1439");
+    }
+}
+
+std::uint64_t VirtualClock::nowMillis() const {
+    return millis.load(std::memory_order_acquire);
+}
+
+int VirtualClock::minuteOfDay() const {
+    return static_cast<int>((startMinute + nowMillis() / millisPerMinute) % minutesPerDay);
+}
+
+void VirtualClock::advanceTo(std::uint64_t nowMillis) {
+    std::uint64_t current = millis.load(std::memory_order_relaxed);
+    while (nowMillis > current && !millis.compare_exchange_weak(current, nowMillis, std::memory_order_release)) {
+    }
+}
+
+void VirtualClock::advanceBy(std::uint64_t deltaMillis) {
+    millis.fetch_add(deltaMillis, std::memory_order_release);
+}
+
+HomeClock& systemClock() {
+    static SystemClock clock;
+    return clock;
+}
@@ -0,0 +1,126 @@
+// includes
+#include "core/epoch.hpp"
+#include <algorithm>
+
+// the calling thread's slot, handed back when the thread exits, and how deep its reads nest
+struct EpochThreadState {
+    EpochDomain::ReaderSlot* slot = nullptr;
+    unsigned depth = 0;
+    ~EpochThreadState() {
+        if (slot) {
+            EpochDomain::getInstance()->release(slot);
+        }
+    }
+};
+
+static thread_local EpochThreadState threadState;
+
+EpochDomain::EpochDomain() : globalEpoch(1), slots(nullptr), reclaimedCount(0) {}
+
+EpochDomain* EpochDomain::getInstance() {
+    static EpochDomain* const instance = new EpochDomain(); // never destroyed, thread exits still release slots
+    return instance;
+}
+
+EpochDomain::ReaderSlot* EpochDomain::claimSlot() {
+    for (ReaderSlot* slot = slots.load(); slot; slot = slot->next) {
+        bool expected = false;
+        if (!slot->claimed.load(std::memory_order_relaxed) && slot->claimed.compare_exchange_strong(expected, true)) {
+            return slot;
+        }
+    }
+    ReaderSlot* slot = new ReaderSlot;
+    slot->epoch.store(idle);
+    slot->claimed.store(true);
+    slot->next = slots.load();
+    while (!slots.compare_exchange_weak(slot->next, slot)) {
+    }
+    return slot;
+}
+
+void EpochDomain::release(ReaderSlot* slot) {
+    slot->epoch.store(idle);
+    slot->claimed.store(false);
+}
+
+// the epoch is stored before the caller loads any pointer, so a writer that sees the slot idle
+// has unpublished its object before this reader can load it
+void EpochDomain::enter() {
+    if (threadState.depth++ > 0) {
+        return;
+    }
+    if (!threadState.slot) {
+        threadState.slot = claimSlot();
+    }
+    threadState.slot->epoch.store(globalEpoch.load());
+}
+
+void EpochDomain::leave() {
+    if (--threadState.depth == 0) {
+        threadState.slot->epoch.store(idle, std::memory_order_release);
+    }
+}
+
+EpochDomain::ReadGuard::ReadGuard(EpochDomain& domain) : domain(&domain) {
+    domain.enter();
+}
+
+EpochDomain::ReadGuard::ReadGuard(ReadGuard&& other) noexcept : domain(other.domain) {
+    other.domain = nullptr;
+}
+
+EpochDomain::ReadGuard::~ReadGuard() {
+    if (domain) {
+        domain->leave();
+    }
+}
+
+EpochDomain::ReadGuard EpochDomain::read() {
+    return ReadGuard(*this);
+}
+
+// retired at the current epoch: a reader pinned at it or earlier may have loaded the object
+void EpochDomain::retire(std::function<void()> reclaim) {
+    {
+        std::lock_guard<std::mutex> guard(retiredMutex);
+        retired.push_back(Retired{globalEpoch.load(), std::move(reclaim)});
+    }
+    this->reclaim();
+}
+
+// objects retired before the oldest pinned epoch are unreachable; they are freed outside the
+// lock, since freeing one may retire others
+std::size_t EpochDomain::reclaim() {
+    std::uint64_t oldest = globalEpoch.fetch_add(1) + 1;
+    for (ReaderSlot* slot = slots.load(); slot; slot = slot->next) {
+        oldest = std::min(oldest, slot->epoch.load());
+    }
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> guard(retiredMutex);
+        auto unreachable = std::stable_partition(retired.begin(), retired.end(),
+            [oldest](const Retired& entry) { return entry.epoch < oldest; });
+        for (auto it = retired.begin(); it != unreachable; ++it) {
+            ready.push_back(std::move(it->reclaim));
+        }
+        retired.erase(retired.begin(), unreachable);
+    }
+    for (auto& reclaim : ready) {
+        reclaim();
+    }
+    reclaimedCount.fetch_add(ready.size());
+    return ready.size();
+}
+
+std::uint64_t EpochDomain::getEpoch() const {
+    return globalEpoch.load();
+}
+
+std::size_t EpochDomain::getRetiredCount() const {
+    std::lock_guard<std::mutex> guard(retiredMutex);
+    return retired.size();
+}
+
+std::uint64_t EpochDomain::getReclaimedCount() const {
+    return reclaimedCount.load();
+}
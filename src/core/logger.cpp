@@ -0,0 +1,205 @@
+// includes
+#include "core/logger.hpp"
+#include "core/tracing.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+// bounded multi-producer ring after Dmitry Vyukov's queue, one consumer
+Logger::Logger()
+    : slots(new Slot[slotCount])
+    , enqueuePosition(0)
+    , dequeuePosition(0)
+    , writtenCount(0)
+    , droppedCount(0)
+    , level(LogLevel::Info)
+    , infoSink(stdout)
+    , errorSink(stderr)
+    , writerSleeping(false)
+    , stopRequested(false)
+{
+    static_assert((slotCount & (slotCount - 1)) == 0, "ring size must be a power of two");
+    for (std::size_t i = 0; i < slotCount; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// a function-local static so the destructor drains the ring at exit
+Logger* Logger::getInstance() {
+    static Logger instance;
+    return &instance;
+}
+
+Logger::~Logger() {
+    stopRequested.store(true);
+    wake.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+void Logger::setLevel(LogLevel newLevel) {
+    level.store(newLevel, std::memory_order_relaxed);
+}
+
+LogLevel Logger::getLevel() const {
+    return level.load(std::memory_order_relaxed);
+}
+
+bool Logger::isEnabled(LogLevel messageLevel) const {
+    return messageLevel != LogLevel::Off && messageLevel >= level.load(std::memory_order_relaxed);
+}
+
+void Logger::setSinks(std::FILE* info, std::FILE* error) {
+    flush();
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    infoSink = info;
+    errorSink = error;
+}
+
+// claim a slot, copy the line in and publish it; full rings drop routine messages only
+void Logger::enqueue(LogLevel messageLevel, const char* text, std::size_t length) {
+    std::call_once(writerStarted, [this] { writer = std::thread(&Logger::writerLoop, this); });
+
+    std::uint64_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots[position & (slotCount - 1)];
+        std::uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        std::int64_t difference = static_cast<std::int64_t>(sequence) - static_cast<std::int64_t>(position);
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            if (messageLevel <= LogLevel::Info) {
+                droppedCount.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            wake.notify_one();
+            std::this_thread::yield();
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = messageLevel;
+    slot->length = static_cast<std::uint16_t>(length);
+    std::memcpy(slot->text, text, length);
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    // routine lines wait for the writer's next poll, waking it per line would cost a context switch each
+    bool halfFull = position - writtenCount.load(std::memory_order_relaxed) >= slotCount / 2;
+    if (messageLevel >= LogLevel::Warning || (halfFull && writerSleeping.load(std::memory_order_relaxed))) {
+        wake.notify_one();
+    }
+}
+
+// lines are gathered per sink and written in large chunks
+std::size_t Logger::drain() {
+    std::vector<char>& infoLines = infoBuffer;
+    std::vector<char>& errorLines = errorBuffer;
+    std::size_t lines = 0;
+    while (true) {
+        Slot& slot = slots[dequeuePosition & (slotCount - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+            break;
+        }
+        std::vector<char>& target = slot.level >= LogLevel::Warning ? errorLines : infoLines;
+        target.insert(target.end(), slot.text, slot.text + slot.length);
+        target.push_back('\n');
+        slot.sequence.store(dequeuePosition + slotCount, std::memory_order_release);
+        ++dequeuePosition;
+        ++lines;
+    }
+    if (lines > 0) {
+        TraceSpan span("Logger::write", "console");
+        std::lock_guard<std::mutex> lock(sinkMutex);
+        if (!infoLines.empty()) {
+            std::fwrite(infoLines.data(), 1, infoLines.size(), infoSink);
+            std::fflush(infoSink);
+        }
+        if (!errorLines.empty()) {
+            std::fwrite(errorLines.data(), 1, errorLines.size(), errorSink);
+            std::fflush(errorSink);
+        }
+        infoLines.clear();
+        errorLines.clear();
+        writtenCount.store(dequeuePosition, std::memory_order_release);
+    }
+    return lines;
+}
+
+// sleeps briefly when idle, producers wake it early
+void Logger::writerLoop() {
+    Tracer::getInstance()->setThreadName("logger");
+    while (true) {
+        if (drain() > 0) {
+            continue;
+        }
+        if (stopRequested.load()) {
+            drain();
+            return;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        writerSleeping.store(true);
+        wake.wait_for(lock, std::chrono::milliseconds(5));
+        writerSleeping.store(false);
+    }
+}
+
+// everything enqueued before the call is written when it returns
+void Logger::flush() {
+    std::uint64_t target = enqueuePosition.load(std::memory_order_acquire);
+    while (writtenCount.load(std::memory_order_acquire) < target) {
+        wake.notify_one();
+        std::this_thread::yield();
+    }
+}
+
+std::uint64_t Logger::getDroppedCount() const {
+    return droppedCount.load(std::memory_order_relaxed);
+}
+
+void Logger::append(char*& out, char* end, const char* text, std::size_t length) {
+    std::size_t room = static_cast<std::size_t>(end - out);
+    std::size_t count = std::min(length, room);
+    std::memcpy(out, text, count);
+    out += count;
+}
+
+void Logger::appendArg(char*& out, char* end, const std::string& value) {
+    append(out, end, value.data(), value.size());
+}
+
+void Logger::appendArg(char*& out, char* end, const char* value) {
+    append(out, end, value, std::strlen(value));
+}
+
+void Logger::appendArg(char*& out, char* end, char value) {
+    append(out, end, &value, 1);
+}
+
+void Logger::appendArg(char*& out, char* end, bool value) {
+    appendArg(out, end, value ? "true" : "false");
+}
+
+void Logger::appendArg(char*& out, char* end, long long value) {
+    char digits[24];
+    int length = std::snprintf(digits, sizeof(digits), "%lld", value);
+    append(out, end, digits, static_cast<std::size_t>(length));
+}
+
+void Logger::appendArg(char*& out, char* end, unsigned long long value) {
+    char digits[24];
+    int length = std::snprintf(digits, sizeof(digits), "%llu", value);
+    append(out, end, digits, static_cast<std::size_t>(length));
+}
+
+void Logger::appendArg(char*& out, char* end, double value) {
+    char digits[32];
+    int length = std::snprintf(digits, sizeof(digits), "%g", value);
+    append(out, end, digits, static_cast<std::size_t>(length));
+}
@@ -0,0 +1,53 @@
+// includes
+#include "core/memory_usage.hpp"
+#include <iomanip>
+
+std::size_t MemoryReport::deviceBytes() const {
+    std::size_t bytes = 0;
+    for (const auto& entry : deviceTypes) {
+        bytes += entry.bytes;
+    }
+    return bytes;
+}
+
+std::size_t MemoryReport::subsystemBytes() const {
+    std::size_t bytes = 0;
+    for (const auto& entry : subsystems) {
+        bytes += entry.bytes;
+    }
+    return bytes;
+}
+
+std::size_t MemoryReport::totalBytes() const {
+    return deviceBytes() + subsystemBytes();
+}
+
+double MemoryReport::bytesPerDevice() const {
+    return deviceCount ? static_cast<double>(totalBytes()) / static_cast<double>(deviceCount) : 0.0;
+}
+
+// per device is over that type's devices for device types, over every device for subsystems
+// the caller's stream gets its formatting back, the table sets alignment and a fixed precision
+void MemoryReport::print(std::ostream& out) const {
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    auto row = [&out](const std::string& name, std::size_t count, std::size_t bytes, std::size_t perCount) {
+        out << std::left << std::setw(24) << name << std::right << std::setw(12) << count << std::setw(16) << bytes
+            << std::setw(14) << std::fixed << std::setprecision(1)
+            << (perCount ? static_cast<double>(bytes) / static_cast<double>(perCount) : 0.0) << "\n";
+    };
+    out << std::left << std::setw(24) << "device type" << std::right << std::setw(12) << "devices" << std::setw(16) << "bytes"
+        << std::setw(14) << "per device" << "\n";
+    for (const auto& entry : deviceTypes) {
+        row(entry.name, entry.count, entry.bytes, entry.count);
+    }
+    out << "\n" << std::left << std::setw(24) << "subsystem" << std::right << std::setw(12) << "elements" << std::setw(16)
+        << "bytes" << std::setw(14) << "per device" << "\n";
+    for (const auto& entry : subsystems) {
+        row(entry.name, entry.count, entry.bytes, deviceCount);
+    }
+    out << "\n";
+    row("total", deviceCount, totalBytes(), deviceCount);
+    out.flags(flags);
+    out.precision(precision);
+}
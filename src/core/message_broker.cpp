@@ -0,0 +1,300 @@
+// includes
+#include "core/message_broker.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+// topic or filter levels, reusing the strings of an earlier split
+static void splitLevels(const std::string& text, std::vector<std::string>& levels) {
+    std::size_t count = 0;
+    std::size_t begin = 0;
+    while (true) {
+        std::size_t end = text.find('/', begin);
+        if (count == levels.size()) {
+            levels.emplace_back();
+        }
+        levels[count++].assign(text, begin, end == std::string::npos ? std::string::npos : end - begin);
+        if (end == std::string::npos) {
+            break;
+        }
+        begin = end + 1;
+    }
+    levels.resize(count);
+}
+
+Subscription::Subscription(std::size_t capacity, OverflowPolicy overflow)
+    : ring(std::max<std::size_t>(capacity, 1))
+    , head(0)
+    , count(0)
+    , policy(overflow)
+    , delivered(0)
+    , dropped(0)
+{}
+
+// queue a message under the subscriber's policy, false if it was dropped
+bool Subscription::offer(const std::shared_ptr<const BrokerMessage>& message, std::chrono::milliseconds blockTimeout) {
+    std::unique_lock<std::mutex> guard(lock);
+    if (count == ring.size()) {
+        if (policy == OverflowPolicy::DropOldest) {
+            ring[head].reset();
+            head = (head + 1) % ring.size();
+            --count;
+            ++dropped;
+        } else if (policy == OverflowPolicy::DropNewest ||
+                   !notFull.wait_for(guard, blockTimeout, [this] { return count < ring.size(); })) {
+            ++dropped;
+            return false;
+        }
+    }
+    ring[(head + count) % ring.size()] = message;
+    ++count;
+    ++delivered;
+    guard.unlock();
+    notEmpty.notify_one();
+    return true;
+}
+
+std::shared_ptr<const BrokerMessage> Subscription::poll() {
+    std::shared_ptr<const BrokerMessage> message;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (count == 0) {
+            return message;
+        }
+        message = std::move(ring[head]);
+        head = (head + 1) % ring.size();
+        --count;
+    }
+    if (policy == OverflowPolicy::Block) {
+        notFull.notify_one();
+    }
+    return message;
+}
+
+std::shared_ptr<const BrokerMessage> Subscription::waitFor(std::chrono::milliseconds timeout) {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if (!notEmpty.wait_for(guard, timeout, [this] { return count > 0; })) {
+            return nullptr;
+        }
+    }
+    return poll();
+}
+
+std::size_t Subscription::drain(std::vector<std::shared_ptr<const BrokerMessage>>& out) {
+    std::size_t taken;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        taken = count;
+        for (; count > 0; --count) {
+            out.push_back(std::move(ring[head]));
+            head = (head + 1) % ring.size();
+        }
+    }
+    if (taken > 0 && policy == OverflowPolicy::Block) {
+        notFull.notify_all();
+    }
+    return taken;
+}
+
+std::size_t Subscription::size() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return count;
+}
+
+std::size_t Subscription::capacity() const {
+    return ring.size();
+}
+
+std::uint64_t Subscription::getDelivered() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return delivered;
+}
+
+std::uint64_t Subscription::getDropped() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return dropped;
+}
+
+std::vector<std::string> Subscription::getFilters() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return filters;
+}
+
+MessageBroker::MessageBroker(std::chrono::milliseconds publisherBlockTimeout)
+    : subscriptionCount(0)
+    , nextSequence(1)
+    , publishedCount(0)
+    , blockTimeout(publisherBlockTimeout)
+{}
+
+// '+' and '#' only as whole levels, '#' only last
+bool MessageBroker::validFilter(const std::string& filter) {
+    if (filter.empty()) {
+        return false;
+    }
+    std::vector<std::string> levels;
+    splitLevels(filter, levels);
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+        const std::string& level = levels[i];
+        bool wildcard = level == "+" || level == "#";
+        if (!wildcard && level.find_first_of("+#") != std::string::npos) {
+            return false;
+        }
+        if (level == "#" && i + 1 != levels.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<Subscription> MessageBroker::subscribe(const std::string& filter, std::size_t capacity,
+                                                       OverflowPolicy policy) {
+    auto subscription = std::make_shared<Subscription>(capacity, policy);
+    addFilter(subscription, filter);
+    return subscription;
+}
+
+void MessageBroker::addFilter(const std::shared_ptr<Subscription>& subscription, const std::string& filter) {
+    if (!validFilter(filter)) {
+        throw std::invalid_argument("Invalid topic filter: " + filter);
+    }
+    std::vector<std::string> levels;
+    splitLevels(filter, levels);
+    std::unique_lock<std::shared_mutex> guard(trieMutex);
+    Node* node = &root;
+    for (const std::string& level : levels) {
+        if (level == "#") {
+            break;
+        }
+        std::unique_ptr<Node>& child = level == "+" ? node->anyLevel : node->children[level];
+        if (!child) {
+            child.reset(new Node());
+        }
+        node = child.get();
+    }
+    (levels.back() == "#" ? node->anyTail : node->exact).push_back(subscription.get());
+    {
+        std::lock_guard<std::mutex> subscriptionGuard(subscription->lock);
+        subscription->filters.push_back(filter);
+    }
+    if (std::find(subscriptions.begin(), subscriptions.end(), subscription) == subscriptions.end()) {
+        subscriptions.push_back(subscription);
+        subscriptionCount.store(subscriptions.size(), std::memory_order_relaxed);
+    }
+}
+
+// drop the subscriber from the filter's node and prune nodes left empty, true if this node is now empty
+bool MessageBroker::removeFilter(Node& node, const std::vector<std::string>& levels, std::size_t depth,
+                                 Subscription* subscriber) {
+    if (depth == levels.size() || levels[depth] == "#") {
+        auto& list = depth < levels.size() ? node.anyTail : node.exact;
+        list.erase(std::remove(list.begin(), list.end(), subscriber), list.end());
+    } else if (levels[depth] == "+") {
+        if (node.anyLevel && removeFilter(*node.anyLevel, levels, depth + 1, subscriber)) {
+            node.anyLevel.reset();
+        }
+    } else {
+        auto child = node.children.find(levels[depth]);
+        if (child != node.children.end() && removeFilter(*child->second, levels, depth + 1, subscriber)) {
+            node.children.erase(child);
+        }
+    }
+    return node.children.empty() && !node.anyLevel && node.exact.empty() && node.anyTail.empty();
+}
+
+void MessageBroker::unsubscribe(const std::shared_ptr<Subscription>& subscription) {
+    std::vector<std::string> filters = subscription->getFilters();
+    std::unique_lock<std::shared_mutex> guard(trieMutex);
+    std::vector<std::string> levels;
+    for (const std::string& filter : filters) {
+        splitLevels(filter, levels);
+        removeFilter(root, levels, 0, subscription.get());
+    }
+    {
+        std::lock_guard<std::mutex> subscriptionGuard(subscription->lock);
+        subscription->filters.clear();
+    }
+    subscriptions.erase(std::remove(subscriptions.begin(), subscriptions.end(), subscription), subscriptions.end());
+    subscriptionCount.store(subscriptions.size(), std::memory_order_relaxed);
+}
+
+void MessageBroker::collect(const Node& node, const std::vector<std::string>& levels, std::size_t depth,
+                            std::vector<Subscription*>& matches) const {
+    matches.insert(matches.end(), node.anyTail.begin(), node.anyTail.end());
+    if (depth == levels.size()) {
+        matches.insert(matches.end(), node.exact.begin(), node.exact.end());
+        return;
+    }
+    auto child = node.children.find(levels[depth]);
+    if (child != node.children.end()) {
+        collect(*child->second, levels, depth + 1, matches);
+    }
+    if (node.anyLevel) {
+        collect(*node.anyLevel, levels, depth + 1, matches);
+    }
+}
+
+std::size_t MessageBroker::publish(const std::string& topic, const std::string& payload) {
+    if (topic.empty() || topic.find_first_of("+#") != std::string::npos) {
+        throw std::invalid_argument("Invalid topic: " + topic);
+    }
+    publishedCount.fetch_add(1, std::memory_order_relaxed);
+    if (!hasSubscribers()) {
+        return 0;
+    }
+    static thread_local std::vector<std::string> levels; // reused, so publishing does not allocate per level
+    static thread_local std::vector<Subscription*> matches;
+    static thread_local std::vector<std::shared_ptr<Subscription>> blocking; // offered once the trie is unlocked
+    splitLevels(topic, levels);
+    matches.clear();
+    std::shared_lock<std::shared_mutex> guard(trieMutex);
+    collect(root, levels, 0, matches);
+    if (matches.empty()) {
+        return 0;
+    }
+    if (matches.size() > 1) {
+        // a subscriber whose filters overlap gets the message once
+        std::sort(matches.begin(), matches.end());
+        matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+    }
+    auto message = std::make_shared<const BrokerMessage>(
+        BrokerMessage{topic, payload, nextSequence.fetch_add(1, std::memory_order_relaxed)});
+    std::size_t deliveredTo = 0;
+    for (Subscription* subscriber : matches) {
+        if (subscriber->policy == OverflowPolicy::Block) {
+            blocking.push_back(subscriber->shared_from_this()); // kept alive should it unsubscribe meanwhile
+        } else {
+            deliveredTo += subscriber->offer(message, blockTimeout) ? 1 : 0; // never waits
+        }
+    }
+    guard.unlock();
+    for (const auto& subscriber : blocking) {
+        deliveredTo += subscriber->offer(message, blockTimeout) ? 1 : 0;
+    }
+    blocking.clear();
+    return deliveredTo;
+}
+
+std::size_t MessageBroker::getSubscriptionCount() const {
+    return subscriptionCount.load(std::memory_order_relaxed);
+}
+
+std::uint64_t MessageBroker::getPublishedCount() const {
+    return publishedCount.load(std::memory_order_relaxed);
+}
+
+// the same rules as the trie, one filter at a time
+bool MessageBroker::matches(const std::string& filter, const std::string& topic) {
+    std::vector<std::string> filterLevels, topicLevels;
+    splitLevels(filter, filterLevels);
+    splitLevels(topic, topicLevels);
+    for (std::size_t i = 0; i < filterLevels.size(); ++i) {
+        if (filterLevels[i] == "#") {
+            return true;
+        }
+        if (i == topicLevels.size() || (filterLevels[i] != "+" && filterLevels[i] != topicLevels[i])) {
+            return false;
+        }
+    }
+    return filterLevels.size() == topicLevels.size();
+}
@@ -0,0 +1,262 @@
+// includes
+#include "core/metrics.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+// bucket index: values below 16 get their own bucket, above that 16 buckets per power of two
+std::size_t HistogramCells::bucketFor(std::uint64_t value) {
+    const std::uint64_t largest = (std::uint64_t(1) << maxValueBits) - 1;
+    value = std::min(value, largest);
+    if (value < (std::uint64_t(1) << subBucketBits)) {
+        return static_cast<std::size_t>(value);
+    }
+    int highBit = 63 - __builtin_clzll(value);
+    std::size_t group = static_cast<std::size_t>(highBit - subBucketBits + 1);
+    std::size_t subBucket = static_cast<std::size_t>((value >> (highBit - subBucketBits)) & ((1u << subBucketBits) - 1));
+    return (group << subBucketBits) + subBucket;
+}
+
+std::uint64_t HistogramCells::bucketLowerBound(std::size_t bucket) {
+    std::size_t group = bucket >> subBucketBits;
+    std::uint64_t subBucket = bucket & ((1u << subBucketBits) - 1);
+    if (group == 0) {
+        return subBucket;
+    }
+    return ((std::uint64_t(1) << subBucketBits) + subBucket) << (group - 1);
+}
+
+std::uint64_t HistogramCells::bucketUpperBound(std::size_t bucket) {
+    return bucketLowerBound(bucket) + (bucket >> subBucketBits == 0 ? 1 : std::uint64_t(1) << ((bucket >> subBucketBits) - 1));
+}
+
+// midpoint of the bucket that holds the requested rank
+double HistogramSnapshot::percentile(double fraction) const {
+    if (count == 0) {
+        return 0.0;
+    }
+    std::uint64_t rank = static_cast<std::uint64_t>(fraction * static_cast<double>(count) + 0.5);
+    rank = std::max<std::uint64_t>(1, std::min(rank, count));
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return (HistogramCells::bucketLowerBound(bucket) + HistogramCells::bucketUpperBound(bucket)) / 2.0;
+        }
+    }
+    return static_cast<double>(HistogramCells::bucketLowerBound(buckets.size() - 1));
+}
+
+void Gauge::add(double amount) const {
+    double current = value->load(std::memory_order_relaxed);
+    while (!value->compare_exchange_weak(current, current + amount, std::memory_order_relaxed)) {
+    }
+}
+
+// hands the calling thread's block back when the thread exits
+struct ThreadBlockOwner {
+    MetricsThreadBlock* block = nullptr;
+    ~ThreadBlockOwner() {
+        if (block) {
+            MetricsRegistry::getInstance()->releaseThreadBlock(block);
+        }
+    }
+};
+static thread_local ThreadBlockOwner threadBlockOwner;
+
+// static members
+std::atomic<bool> MetricsRegistry::enabled(true);
+
+MetricsRegistry::MetricsRegistry()
+    : counterCount(0)
+    , histogramCount(0)
+{}
+
+// never destroyed, threads may record while the process exits
+MetricsRegistry* MetricsRegistry::getInstance() {
+    static MetricsRegistry* instance = new MetricsRegistry();
+    return instance;
+}
+
+// find or add a series, throws if the name is taken by another kind or the slots run out
+const MetricsRegistry::Series& MetricsRegistry::registerSeries(const std::string& name, const std::string& help,
+                                                               const std::string& labels, Kind kind,
+                                                               std::uint32_t sampleEvery) {
+    auto it = families.find(name);
+    if (it == families.end()) {
+        it = families.emplace(name, Family{kind, help, {}}).first;
+    } else if (it->second.kind != kind) {
+        throw std::invalid_argument("Metric " + name + " is already registered as another kind");
+    }
+    for (const auto& series : it->second.series) {
+        if (series.labels == labels) {
+            return series;
+        }
+    }
+
+    std::uint32_t slot = 0;
+    switch (kind) {
+        case Kind::Counter:
+            if (counterCount == MetricsThreadBlock::maxCounters) {
+                throw std::length_error("Too many counters");
+            }
+            slot = counterCount++;
+            break;
+        case Kind::Histogram:
+            if (histogramCount == MetricsThreadBlock::maxHistograms) {
+                throw std::length_error("Too many histograms");
+            }
+            slot = histogramCount++;
+            break;
+        case Kind::Gauge:
+            slot = static_cast<std::uint32_t>(gauges.size());
+            gauges.emplace_back(0.0);
+            break;
+    }
+    it->second.series.push_back(Series{labels, slot, sampleEvery});
+    return it->second.series.back();
+}
+
+Counter MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return Counter(registerSeries(name, help, labels, Kind::Counter, 1).slot);
+}
+
+Gauge MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return Gauge(&gauges[registerSeries(name, help, labels, Kind::Gauge, 1).slot]);
+}
+
+Histogram MetricsRegistry::histogram(const std::string& name, const std::string& help, const std::string& labels,
+                                     std::uint32_t sampleEvery) {
+    std::uint32_t rounded = 1;
+    while (rounded < sampleEvery) {
+        rounded <<= 1;
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    const Series& series = registerSeries(name, help, labels, Kind::Histogram, rounded);
+    return Histogram(series.slot, series.sampleEvery - 1);
+}
+
+// a recycled block keeps the counts of the thread that used it before
+MetricsThreadBlock* MetricsRegistry::acquireThreadBlock() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    MetricsThreadBlock* block;
+    if (!freeBlocks.empty()) {
+        block = freeBlocks.back();
+        freeBlocks.pop_back();
+    } else {
+        blocks.emplace_back(new MetricsThreadBlock()); // value-initialised, every cell starts at zero
+        block = blocks.back().get();
+    }
+    threadBlockOwner.block = block;
+    return block;
+}
+
+void MetricsRegistry::releaseThreadBlock(MetricsThreadBlock* block) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    freeBlocks.push_back(block);
+}
+
+HistogramCells* MetricsRegistry::allocateCells(MetricsThreadBlock& block, std::uint32_t slot) {
+    HistogramCells* cells = new HistogramCells(); // owned by the block from here on, like the block itself
+    block.histograms[slot].store(cells, std::memory_order_release);
+    return cells;
+}
+
+std::uint64_t MetricsRegistry::sumCounter(std::uint32_t slot) const {
+    std::uint64_t total = 0;
+    for (const auto& block : blocks) {
+        total += block->counters[slot].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+HistogramSnapshot MetricsRegistry::mergeHistogram(std::uint32_t slot) const {
+    HistogramSnapshot snapshot;
+    snapshot.buckets.assign(HistogramCells::bucketCount, 0);
+    for (const auto& block : blocks) {
+        const HistogramCells* cells = block->histograms[slot].load(std::memory_order_acquire);
+        if (!cells) {
+            continue;
+        }
+        for (std::size_t bucket = 0; bucket < HistogramCells::bucketCount; ++bucket) {
+            std::uint64_t hits = cells->buckets[bucket].load(std::memory_order_relaxed);
+            snapshot.buckets[bucket] += hits;
+            snapshot.count += hits;
+        }
+        snapshot.sum += cells->sum.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+std::uint64_t MetricsRegistry::read(const Counter& counter) const {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return sumCounter(counter.getIndex());
+}
+
+HistogramSnapshot MetricsRegistry::read(const Histogram& histogram) const {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return mergeHistogram(histogram.getIndex());
+}
+
+// name{labels} or name{labels,extra}
+static std::string seriesName(const std::string& name, const std::string& labels, const std::string& extra = "") {
+    std::string joined = labels.empty() ? extra : (extra.empty() ? labels : labels + "," + extra);
+    return joined.empty() ? name : name + "{" + joined + "}";
+}
+
+// histograms are written in seconds with one bucket boundary per power of two
+void MetricsRegistry::writePrometheus(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    char number[32];
+    for (const auto& entry : families) {
+        const std::string& name = entry.first;
+        const Family& family = entry.second;
+        const char* type = family.kind == Kind::Counter ? "counter" : family.kind == Kind::Gauge ? "gauge" : "histogram";
+        out << "# HELP " << name << " " << family.help << "\n# TYPE " << name << " " << type << "\n";
+        for (const auto& series : family.series) {
+            if (family.kind == Kind::Counter) {
+                out << seriesName(name, series.labels) << " " << sumCounter(series.slot) << "\n";
+                continue;
+            }
+            if (family.kind == Kind::Gauge) {
+                std::snprintf(number, sizeof(number), "%.17g", gauges[series.slot].load(std::memory_order_relaxed));
+                out << seriesName(name, series.labels) << " " << number << "\n";
+                continue;
+            }
+            HistogramSnapshot snapshot = mergeHistogram(series.slot);
+            std::uint64_t cumulative = 0;
+            const std::size_t perGroup = std::size_t(1) << HistogramCells::subBucketBits;
+            for (std::size_t group = 0; group * perGroup < HistogramCells::bucketCount; ++group) {
+                for (std::size_t bucket = group * perGroup; bucket < (group + 1) * perGroup; ++bucket) {
+                    cumulative += snapshot.buckets[bucket];
+                }
+                double upperSeconds = static_cast<double>(HistogramCells::bucketUpperBound((group + 1) * perGroup - 1)) * 1e-9;
+                std::snprintf(number, sizeof(number), "le=\"%g\"", upperSeconds);
+                out << seriesName(name + "_bucket", series.labels, number) << " " << cumulative << "\n";
+            }
+            out << seriesName(name + "_bucket", series.labels, "le=\"+Inf\"") << " " << snapshot.count << "\n";
+            std::snprintf(number, sizeof(number), "%.9g", static_cast<double>(snapshot.sum) * 1e-9);
+            out << seriesName(name + "_sum", series.labels) << " " << number << "\n"
+                << seriesName(name + "_count", series.labels) << " " << snapshot.count << "\n";
+        }
+    }
+}
+
+// written to a temporary file and renamed so a scraper never sees half a dump
+bool MetricsRegistry::writePrometheusFile(const std::string& path) const {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary);
+        if (!file) {
+            return false;
+        }
+        writePrometheus(file);
+        if (!file) {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,27 @@
+// includes
+#include "core/string_pool.hpp"
+#include "core/memory_usage.hpp"
+
+StringPool* StringPool::getInstance() {
+    static StringPool* const instance = new StringPool();
+    return instance;
+}
+
+const std::string& StringPool::intern(const std::string& text) {
+    std::lock_guard<std::mutex> guard(mutex);
+    return *strings.insert(text).first;
+}
+
+std::size_t StringPool::size() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return strings.size();
+}
+
+std::size_t StringPool::getMemoryUsage() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    std::size_t bytes = hashTableBytes(strings);
+    for (const auto& text : strings) {
+        bytes += heapBytes(text);
+    }
+    return bytes;
+}
@@ -0,0 +1,189 @@
+// includes
+#include "core/thread_pool.hpp"
+#include <algorithm>
+#include <string>
+#include "core/tracing.hpp"
+
+static thread_local int workerIndex = -1;
+
+WorkStealingPool::WorkStealingPool(std::size_t threads)
+    : queued(0)
+    , sleepers(0)
+    , nextWorker(0)
+    , stopping(false)
+    , executedCount(0)
+    , stolenCount(0)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // every deque exists before any worker looks for something to steal
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers[i]->thread = std::thread(&WorkStealingPool::run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    shutdown();
+}
+
+int WorkStealingPool::currentWorker() {
+    return workerIndex;
+}
+
+void WorkStealingPool::push(std::size_t index, std::function<void()> task) {
+    if (stopping.load()) {
+        throw std::runtime_error("Thread pool is shut down");
+    }
+    {
+        std::lock_guard<std::mutex> guard(workers[index]->lock);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1);
+    // a worker registers as a sleeper before it checks queued, so one of the two sides sees the other
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> guard(sleepMutex);
+        workAvailable.notify_one();
+    }
+}
+
+bool WorkStealingPool::takeTask(std::size_t index, std::function<void()>& task) {
+    {
+        Worker& own = *workers[index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    for (std::size_t offset = 1; offset < workers.size(); ++offset) {
+        Worker& victim = *workers[(index + offset) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            stolenCount.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(std::size_t index) {
+    workerIndex = static_cast<int>(index);
+    Tracer::getInstance()->setThreadName("pool " + std::to_string(index));
+    std::function<void()> task;
+    while (true) {
+        if (takeTask(index, task)) {
+            task(); // futures and parallelFor carry exceptions, so none arrive here
+            task = nullptr;
+            executedCount.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(sleepMutex);
+        sleepers.fetch_add(1);
+        workAvailable.wait(guard, [this] { return queued.load() > 0 || stopping.load(); });
+        sleepers.fetch_sub(1);
+        if (stopping.load() && queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+void WorkStealingPool::parallelFor(std::size_t count, std::size_t grain,
+                                   const std::function<void(std::size_t, std::size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<std::size_t>(1, grain);
+    std::size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || workers.size() == 1 || stopping.load()) {
+        body(0, count);
+        return;
+    }
+
+    // queued chunks may still be found by a worker after this call returns, so they share the
+    // state; a chunk runs on whoever claims it first, and the body is only used before that
+    struct State {
+        const std::function<void(std::size_t, std::size_t)>* body;
+        std::size_t count;
+        std::size_t grain;
+        std::unique_ptr<std::atomic<bool>[]> claimed;
+        std::atomic<std::size_t> remaining;
+        std::mutex lock;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    state->body = &body;
+    state->count = count;
+    state->grain = grain;
+    state->claimed = std::make_unique<std::atomic<bool>[]>(chunks);
+    state->remaining.store(chunks);
+    auto runChunk = [](State& shared, std::size_t chunk) {
+        if (shared.claimed[chunk].exchange(true)) {
+            return;
+        }
+        std::size_t begin = chunk * shared.grain;
+        try {
+            (*shared.body)(begin, std::min(shared.count, begin + shared.grain));
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(shared.lock);
+            if (!shared.error) {
+                shared.error = std::current_exception();
+            }
+        }
+        if (shared.remaining.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> guard(shared.lock);
+            shared.done.notify_all();
+        }
+    };
+
+    // the caller takes the first chunk itself, the rest go round the workers
+    std::size_t queuedChunks = 1;
+    try {
+        for (; queuedChunks < chunks; ++queuedChunks) {
+            push(queuedChunks % workers.size(), [state, runChunk, queuedChunks] { runChunk(*state, queuedChunks); });
+        }
+    } catch (const std::runtime_error&) {
+        // shut down meanwhile: the chunks that were not queued are run below
+    }
+
+    // work through whatever no worker has claimed yet, then wait for the rest
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        runChunk(*state, chunk);
+    }
+    std::unique_lock<std::mutex> guard(state->lock);
+    state->done.wait(guard, [&state] { return state->remaining.load() == 0; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+void WorkStealingPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> guard(sleepMutex);
+        if (stopping.exchange(true)) {
+            return;
+        }
+        workAvailable.notify_all();
+    }
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    // a task pushed while the flag was being set can arrive after the workers left
+    std::function<void()> task;
+    while (takeTask(0, task)) {
+        task();
+        task = nullptr;
+        executedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
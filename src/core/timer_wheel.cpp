@@ -0,0 +1,274 @@
+// includes
+#include "core/timer_wheel.hpp"
+#include <stdexcept>
+
+const std::uint32_t TimerWheel::none; // bound to references, e.g. by fill()
+
+// constructor, the start tick counts as already processed
+TimerWheel::TimerWheel(std::uint64_t startTick)
+    : freeHead(none)
+    , current(startTick + 1)
+    , pending(0)
+{
+    heads.fill(none);
+    levelZeroOccupied.fill(0);
+}
+
+// take a node from the free list or grow the pool
+std::uint32_t TimerWheel::allocateNode() {
+    if (freeHead != none) {
+        std::uint32_t index = freeHead;
+        freeHead = nodes[index].next;
+        return index;
+    }
+    if (nodes.size() >= none - 3) {
+        throw std::length_error("Too many pending timers");
+    }
+    nodes.push_back(Node{0, 0, none, none, freeNode, 1, nullptr});
+    return static_cast<std::uint32_t>(nodes.size() - 1);
+}
+
+// return a node to the free list, invalidating its id
+void TimerWheel::releaseNode(std::uint32_t index) {
+    Node& node = nodes[index];
+    node.callback = nullptr;
+    node.list = freeNode;
+    ++node.generation;
+    node.next = freeHead;
+    freeHead = index;
+}
+
+// add a node at the front of a list
+void TimerWheel::pushFront(std::uint32_t list, std::uint32_t index) {
+    Node& node = nodes[index];
+    node.list = list;
+    node.prev = none;
+    node.next = heads[list];
+    if (node.next != none) {
+        nodes[node.next].prev = index;
+    }
+    heads[list] = index;
+    if (list < slotsPerLevel) {
+        levelZeroOccupied[list / 64] |= std::uint64_t(1) << (list % 64);
+    }
+}
+
+// remove a node from whichever list it is in
+void TimerWheel::unlink(std::uint32_t index) {
+    Node& node = nodes[index];
+    if (node.prev != none) {
+        nodes[node.prev].next = node.next;
+    } else {
+        heads[node.list] = node.next;
+        if (node.list < slotsPerLevel && node.next == none) {
+            levelZeroOccupied[node.list / 64] &= ~(std::uint64_t(1) << (node.list % 64));
+        }
+    }
+    if (node.next != none) {
+        nodes[node.next].prev = node.prev;
+    }
+    node.prev = node.next = none;
+}
+
+// the level is chosen by distance to the current tick, the slot by the expiry bits of that level
+void TimerWheel::link(std::uint32_t index) {
+    std::uint64_t expiry = nodes[index].expiry;
+    std::uint64_t distance = expiry - current;
+    for (int level = 0; level < levelCount; ++level) {
+        if (distance < (std::uint64_t(1) << (levelBits * (level + 1)))) {
+            std::uint32_t slot = static_cast<std::uint32_t>((expiry >> (levelBits * level)) & (slotsPerLevel - 1));
+            pushFront(static_cast<std::uint32_t>(level * slotsPerLevel) + slot, index);
+            return;
+        }
+    }
+    pushFront(overflowList, index);
+}
+
+// re-file every timer in the level's current slot, they are now close enough for a lower level
+void TimerWheel::cascade(int level) {
+    std::uint32_t list = level < levelCount
+        ? static_cast<std::uint32_t>(level * slotsPerLevel) + static_cast<std::uint32_t>((current >> (levelBits * level)) & (slotsPerLevel - 1))
+        : overflowList;
+    std::uint32_t index = heads[list];
+    heads[list] = none;
+    while (index != none) {
+        std::uint32_t next = nodes[index].next;
+        link(index);
+        index = next;
+    }
+}
+
+// cascade on block boundaries, then fire the level-0 slot for this tick
+std::size_t TimerWheel::runTick(std::uint64_t tick) {
+    current = tick;
+    if ((tick & (slotsPerLevel - 1)) == 0) {
+        int top = 1;
+        while (top < levelCount && ((tick >> (levelBits * top)) & (slotsPerLevel - 1)) == 0) {
+            ++top;
+        }
+        // higher levels first so their timers can land in the slots cascaded next
+        for (int level = top; level >= 1; --level) {
+            cascade(level);
+        }
+    }
+
+    // move the due timers aside so callbacks can schedule into this slot without firing early
+    std::uint32_t slot = static_cast<std::uint32_t>(tick & (slotsPerLevel - 1));
+    std::uint32_t index = heads[slot];
+    heads[slot] = none;
+    levelZeroOccupied[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+    while (index != none) {
+        std::uint32_t next = nodes[index].next;
+        pushFront(firingList, index);
+        index = next;
+    }
+    current = tick + 1;
+
+    std::size_t fired = 0;
+    while (heads[firingList] != none) {
+        std::uint32_t firing = heads[firingList];
+        unlink(firing);
+        Node& node = nodes[firing];
+        node.list = runningNode;
+        --pending;
+        ++fired;
+        node.callback();
+
+        // the callback may have cancelled the timer, otherwise periodic timers go round again
+        if (node.list == runningNode && node.period > 0) {
+            node.expiry += node.period;
+            if (node.expiry < current) {
+                node.expiry = current;
+            }
+            ++pending;
+            link(firing);
+        } else {
+            releaseNode(firing);
+        }
+    }
+    return fired;
+}
+
+// first tick from current on that needs work: a busy level-0 slot or the next block boundary
+std::uint64_t TimerWheel::nextBusyTick(std::uint64_t limit) const {
+    if ((current & (slotsPerLevel - 1)) == 0) {
+        return current;
+    }
+    std::uint64_t blockStart = current & ~std::uint64_t(slotsPerLevel - 1);
+    for (std::uint32_t slot = static_cast<std::uint32_t>(current - blockStart); slot < slotsPerLevel; ) {
+        std::uint64_t word = levelZeroOccupied[slot / 64] >> (slot % 64);
+        if (word != 0) {
+            int skip = 0;
+            while ((word & 1) == 0) {
+                word >>= 1;
+                ++skip;
+            }
+            return blockStart + slot + static_cast<std::uint32_t>(skip);
+        }
+        slot = (slot / 64 + 1) * 64;
+        if (blockStart + slot > limit) {
+            break;
+        }
+    }
+    return blockStart + slotsPerLevel;
+}
+
+bool TimerWheel::levelZeroEmpty() const {
+    for (std::uint64_t word : levelZeroOccupied) {
+        if (word != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// with level 0 empty the only work left is cascading, and a block boundary whose level-1 slot is
+// empty cascades nothing unless it also starts a level-2 block, so whole idle blocks are skipped
+std::uint64_t TimerWheel::nextCascadeTick(std::uint64_t limit) const {
+    std::uint64_t next = (current + slotsPerLevel - 1) & ~std::uint64_t(slotsPerLevel - 1);
+    while (next <= limit) {
+        std::uint32_t slot = static_cast<std::uint32_t>((next >> levelBits) & (slotsPerLevel - 1));
+        if (slot == 0 || heads[slotsPerLevel + slot] != none) {
+            return next;
+        }
+        next += slotsPerLevel;
+    }
+    return next;
+}
+
+// schedule a callback, delay 0 fires on the next advance
+TimerId TimerWheel::schedule(std::uint64_t delayTicks, std::function<void()> callback, std::uint64_t periodTicks) {
+    if (!callback) {
+        throw std::invalid_argument("Timer callback cannot be empty");
+    }
+    std::uint32_t index = allocateNode();
+    Node& node = nodes[index];
+    node.expiry = delayTicks == 0 ? current : now() + delayTicks;
+    node.period = periodTicks;
+    node.callback = std::move(callback);
+    link(index);
+    ++pending;
+    return (static_cast<TimerId>(node.generation) << 32) | index;
+}
+
+// unlink a pending timer
+bool TimerWheel::cancel(TimerId id) {
+    std::uint32_t index = static_cast<std::uint32_t>(id & 0xFFFFFFFFu);
+    std::uint32_t generation = static_cast<std::uint32_t>(id >> 32);
+    if (index >= nodes.size() || nodes[index].generation != generation) {
+        return false;
+    }
+
+    Node& node = nodes[index];
+    if (node.list == freeNode || node.list == cancelledNode) {
+        return false;
+    }
+    if (node.list == runningNode) {
+        // released once the callback returns, only periodic timers had more firings to stop
+        node.list = cancelledNode;
+        return node.period > 0;
+    }
+    unlink(index);
+    releaseNode(index);
+    --pending;
+    return true;
+}
+
+bool TimerWheel::isPending(TimerId id) const {
+    std::uint32_t index = static_cast<std::uint32_t>(id & 0xFFFFFFFFu);
+    std::uint32_t generation = static_cast<std::uint32_t>(id >> 32);
+    if (index >= nodes.size() || nodes[index].generation != generation) {
+        return false;
+    }
+    const Node& node = nodes[index];
+    if (node.list == freeNode || node.list == cancelledNode) {
+        return false;
+    }
+    return node.list != runningNode || node.period > 0;
+}
+
+// process ticks up to and including the target, skipping empty stretches
+std::size_t TimerWheel::advanceTo(std::uint64_t tick) {
+    std::size_t fired = 0;
+    while (current <= tick) {
+        if (pending == 0) {
+            current = tick + 1;
+            break;
+        }
+        std::uint64_t next = levelZeroEmpty() ? nextCascadeTick(tick) : nextBusyTick(tick);
+        if (next > tick) {
+            current = tick + 1; // nothing due and no block boundary before the target
+            break;
+        }
+        fired += runTick(next);
+    }
+    return fired;
+}
+
+std::uint64_t TimerWheel::now() const {
+    return current - 1;
+}
+
+std::size_t TimerWheel::getPendingCount() const {
+    return pending;
+}
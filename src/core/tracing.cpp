@@ -0,0 +1,148 @@
+// includes
+#include "core/tracing.hpp"
+#include <cstdio>
+#include <fstream>
+
+// static members
+std::atomic<bool> Tracer::enabled(false);
+
+Tracer::Tracer()
+    : epoch(std::chrono::steady_clock::now())
+{}
+
+// never destroyed, threads may finish spans while the process exits
+Tracer* Tracer::getInstance() {
+    static Tracer* instance = new Tracer();
+    return instance;
+}
+
+// created on the thread's first span and kept for the dump after it exits
+TraceThreadBuffer& Tracer::localBuffer() {
+    static thread_local TraceThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> guard(registryMutex);
+        buffers.emplace_back(new TraceThreadBuffer());
+        buffer = buffers.back().get();
+        buffer->threadIndex = static_cast<std::uint32_t>(buffers.size());
+        buffer->threadName = "thread " + std::to_string(buffer->threadIndex);
+        buffer->dropped = 0;
+    }
+    return *buffer;
+}
+
+void Tracer::start() {
+    clear();
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::stop() {
+    enabled.store(false, std::memory_order_relaxed);
+}
+
+void Tracer::record(const char* name, const char* category, std::string detail,
+                    std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+    TraceThreadBuffer& buffer = localBuffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    if (buffer.events.size() >= maxEventsPerThread) {
+        ++buffer.dropped;
+        return;
+    }
+    auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - epoch).count();
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    buffer.events.push_back(TraceEvent{name, category, std::move(detail),
+                                       static_cast<std::uint64_t>(sinceEpoch > 0 ? sinceEpoch : 0),
+                                       static_cast<std::uint64_t>(duration)});
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    TraceThreadBuffer& buffer = localBuffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    buffer.threadName = name;
+}
+
+std::size_t Tracer::getEventCount() const {
+    std::lock_guard<std::mutex> guard(registryMutex);
+    std::size_t count = 0;
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> bufferGuard(buffer->lock);
+        count += buffer->events.size();
+    }
+    return count;
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> guard(registryMutex);
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> bufferGuard(buffer->lock);
+        buffer->events.clear();
+        buffer->dropped = 0;
+    }
+}
+
+// quotes, backslashes and control characters in a JSON string
+static void writeJsonString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+// timestamps are microseconds with nanosecond decimals, one thread_name record per thread
+void Tracer::writeChromeTrace(std::ostream& out) const {
+    std::lock_guard<std::mutex> guard(registryMutex);
+    char number[64];
+    bool first = true;
+    auto separator = [&out, &first] {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> bufferGuard(buffer->lock);
+        separator();
+        out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->threadIndex
+            << ", \"args\": {\"name\": ";
+        writeJsonString(out, buffer->threadName);
+        out << "}}";
+        for (const auto& event : buffer->events) {
+            separator();
+            out << "{\"name\": ";
+            writeJsonString(out, event.name);
+            out << ", \"cat\": ";
+            writeJsonString(out, event.category);
+            std::snprintf(number, sizeof(number), ", \"ts\": %.3f, \"dur\": %.3f",
+                          event.startNanos / 1000.0, event.durationNanos / 1000.0);
+            out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->threadIndex << number;
+            if (!event.detail.empty()) {
+                out << ", \"args\": {\"detail\": ";
+                writeJsonString(out, event.detail);
+                out << "}";
+            }
+            out << "}";
+        }
+        if (buffer->dropped > 0) {
+            separator();
+            out << "{\"name\": \"dropped events\", \"ph\": \"C\", \"pid\": 1, \"tid\": " << buffer->threadIndex
+                << ", \"ts\": 0, \"args\": {\"dropped\": " << buffer->dropped << "}}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+bool Tracer::writeChromeTraceFile(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+    writeChromeTrace(file);
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,58 @@
+// includes
+#include "devices/async_device.hpp"
+#include <utility>
+
+// the arguments are taken by value: they live in the coroutine frame while it is suspended
+Task<DeviceResult> applyCommandAsync(DeviceTransport& transport, std::shared_ptr<Device> device, DeviceCommand command,
+                                     std::mutex* deviceMutex) {
+    if (!device) {
+        co_return DeviceResult::UnknownDevice;
+    }
+    for (std::uint32_t attempt = 0; attempt <= transport.getConfig().retries; ++attempt) {
+        if (co_await transport.exchange()) {
+            if (!deviceMutex) {
+                co_return device->applyCommand(command);
+            }
+            std::lock_guard<std::mutex> guard(*deviceMutex);
+            co_return device->applyCommand(command);
+        }
+    }
+    co_return DeviceResult::Timeout;
+}
+
+// the wrappers only build the command, so they are plain functions returning the task
+Task<DeviceResult> turnOnAsync(DeviceTransport& transport, std::shared_ptr<Device> device) {
+    return applyCommandAsync(transport, std::move(device), DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+}
+
+Task<DeviceResult> turnOffAsync(DeviceTransport& transport, std::shared_ptr<Device> device) {
+    return applyCommandAsync(transport, std::move(device), DeviceCommand{CommandType::TurnOff, 0.0f, ""});
+}
+
+Task<DeviceResult> setBrightnessAsync(DeviceTransport& transport, std::shared_ptr<Device> device, int level) {
+    return applyCommandAsync(transport, std::move(device), DeviceCommand{CommandType::SetBrightness, static_cast<float>(level), ""});
+}
+
+Task<DeviceResult> setColorAsync(DeviceTransport& transport, std::shared_ptr<Device> device, const std::string& color) {
+    return applyCommandAsync(transport, std::move(device), DeviceCommand{CommandType::SetColor, 0.0f, color});
+}
+
+Task<DeviceResult> setTemperatureAsync(DeviceTransport& transport, std::shared_ptr<Device> device, float temperature) {
+    return applyCommandAsync(transport, std::move(device), DeviceCommand{CommandType::SetTemperature, temperature, ""});
+}
+
+Task<DeviceResult> setDesiredTemperatureAsync(DeviceTransport& transport, std::shared_ptr<Device> device, float temperature) {
+    return applyCommandAsync(transport, std::move(device), DeviceCommand{CommandType::SetDesiredTemperature, temperature, ""});
+}
+
+Task<DeviceResult> setModeAsync(DeviceTransport& transport, std::shared_ptr<Device> device, const std::string& mode) {
+    return applyCommandAsync(transport, std::move(device), DeviceCommand{CommandType::SetMode, 0.0f, mode});
+}
+
+Task<DeviceResult> startRecordingAsync(DeviceTransport& transport, std::shared_ptr<Device> device) {
+    return applyCommandAsync(transport, std::move(device), DeviceCommand{CommandType::StartRecording, 0.0f, ""});
+}
+
+Task<DeviceResult> stopRecordingAsync(DeviceTransport& transport, std::shared_ptr<Device> device) {
+    return applyCommandAsync(transport, std::move(device), DeviceCommand{CommandType::StopRecording, 0.0f, ""});
+}
@@ -0,0 +1,62 @@
+// includes
+#include "devices/command_queue.hpp"
+
+DeviceCommandQueue::DeviceCommandQueue()
+    : segmentStart(0)
+    , queuedCount(0)
+    , coalescedCount(0)
+    , appliedCount(0)
+{}
+
+bool DeviceCommandQueue::isCoalescable(CommandType type) {
+    switch (type) {
+        case CommandType::SetBrightness:
+        case CommandType::SetColor:
+        case CommandType::SetTemperature:
+        case CommandType::SetDesiredTemperature:
+        case CommandType::SetRotation:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool DeviceCommandQueue::push(const Device& device, const DeviceCommand& command) {
+    ++queuedCount;
+    if (!isCoalescable(command.type)) {
+        pending.push_back(command);
+        segmentStart = pending.size();
+        return false;
+    }
+    // a rejected write changes nothing, so it cannot stand in for the write before it
+    if (device.checkCommand(command) == DeviceResult::Ok) {
+        for (std::size_t i = segmentStart; i < pending.size(); ++i) {
+            if (pending[i].type == command.type && device.checkCommand(pending[i]) == DeviceResult::Ok) {
+                pending[i] = command;
+                ++coalescedCount;
+                return true;
+            }
+        }
+    }
+    pending.push_back(command);
+    return false;
+}
+
+std::size_t DeviceCommandQueue::flush(Device& device, std::vector<DeviceResult>* results) {
+    std::size_t succeeded = 0;
+    for (const DeviceCommand& command : pending) {
+        DeviceResult result = device.applyCommand(command);
+        succeeded += result == DeviceResult::Ok ? 1 : 0;
+        if (results) {
+            results->push_back(result);
+        }
+    }
+    appliedCount += pending.size();
+    clear();
+    return succeeded;
+}
+
+void DeviceCommandQueue::clear() {
+    pending.clear();
+    segmentStart = 0;
+}
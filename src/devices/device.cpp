@@ -1,40 +1,63 @@
 #include "devices/device.hpp"
 #include "controllers/energy_monitor.hpp"
+#include "core/memory_usage.hpp"
+#include "core/string_pool.hpp"
+
+// one counter per kind of change, in DeviceChange order
+static Counter changeCounter(const char* kind) {
+    return MetricsRegistry::getInstance()->counter("smart_home_device_changes_total", "Device state changes by kind",
+                                                   string("change=\"") + kind + "\"");
+}
+
+const Counter deviceChangeCounters[] = {
+    changeCounter("power"), changeCounter("brightness"), changeCounter("color"), changeCounter("temperature"),
+    changeCounter("desired_temperature"), changeCounter("mode"), changeCounter("recording"),
+    changeCounter("resolution"), changeCounter("rotation"), changeCounter("motion_detection"), changeCounter("motion"),
+    changeCounter("name"), changeCounter("location")
+};
 
 // default constructor
 Device::Device() 
     : deviceID("") // default device id
     , deviceName("") // default name
-    , deviceLocation("") // default location
+    , deviceLocation(&StringPool::getInstance()->intern("")) // default location
+    , locationPool(nullptr) // the default pool until a home takes the device
     , isOn(false) // default value for isOn is false
+    , metered(true) // readings are reported from the start
     , powerConsumption(0.0) // default value for power consumption
+    , observer(nullptr) // no observer until the device is registered
+    , energyMonitor(nullptr) // the default monitor until a home takes the device
 
 {} // end constructor
 
 
 // parameterized constructor
-Device::Device(const string& id, const string& name, const string& location)
+Device::Device(const string& id, const string& name, const string& location, StringPool* pool)
     : deviceID(id) // set device id
     , deviceName(name) // set device name
-    , deviceLocation(location) // set device location
+    , deviceLocation(&(pool ? *pool : *StringPool::getInstance()).intern(location)) // set device location
+    , locationPool(pool) // the home's pool when built for one
     , isOn(false) // default value for isOn is false
+    , metered(true) // readings are reported from the start
     , powerConsumption(0.0) // default value for power consumption
+    , observer(nullptr) // no observer until the device is registered
+    , energyMonitor(nullptr) // the default monitor until a home takes the device
 {} // end constructor
 
 
 // getter for device ID
-string Device::getDeviceID() const {
+const string& Device::getDeviceID() const {
     return deviceID;
 }
 
 // getter for device name
-string Device::getDeviceName() const {
+const string& Device::getDeviceName() const {
     return deviceName;
 }
 
 // getter for device location
-string Device::getDeviceLocation() const {
-    return deviceLocation;
+const string& Device::getDeviceLocation() const {
+    return *deviceLocation;
 }
 
 // getter for isOn status
@@ -45,17 +68,83 @@ bool Device::getIsOn() const {
 
 // setter for device location
 void Device::setDeviceLocation(const string& newLocation) {
-    deviceLocation = newLocation;
+    deviceLocation = &(locationPool ? *locationPool : *StringPool::getInstance()).intern(newLocation);
+    notifyChange(DeviceChange::Location);
 }
 
 // setter for device name
 void Device::setDeviceName(const string& newName) {
     deviceName = newName;
+    notifyChange(DeviceChange::Name);
+}
+
+// setter for state change observer
+void Device::setObserver(DeviceObserver* newObserver) {
+    observer = newObserver;
+}
+
+// setter for the energy monitor power readings go to
+void Device::setEnergyMonitor(EnergyMonitor* monitor) {
+    energyMonitor = monitor;
+}
+
+// setter for the pool holding the location, which is interned there
+void Device::setStringPool(StringPool* pool) {
+    if (pool != locationPool) {
+        deviceLocation = &(pool ? *pool : *StringPool::getInstance()).intern(*deviceLocation);
+        locationPool = pool;
+    }
+}
+
+// setter for whether power readings are reported
+void Device::setMetered(bool report) {
+    metered = report;
+}
+
+// the home's energy monitor, or the process default outside a home
+EnergyMonitor& Device::energy() const {
+    return energyMonitor ? *energyMonitor : *EnergyMonitor::getInstance();
+}
+
+// a power reading, dropped while the device is unmetered
+void Device::reportUsage(double watts) {
+    if (metered) {
+        energy().recordUsage(deviceID, watts);
+    }
+}
+
+// heap bytes of the strings the device owns, the location is pooled
+size_t Device::stringMemoryUsage() const {
+    return heapBytes(deviceID) + heapBytes(deviceName);
+}
+
+// power commands are common to all devices
+DeviceResult Device::applyCommand(const DeviceCommand& command) {
+    switch (command.type) {
+        case CommandType::TurnOn:
+            turnOn();
+            return DeviceResult::Ok;
+        case CommandType::TurnOff:
+            turnOff();
+            return DeviceResult::Ok;
+        default:
+            return DeviceResult::NotSupported;
+    }
+}
+
+// power commands take no argument
+DeviceResult Device::checkCommand(const DeviceCommand& command) const {
+    return command.type == CommandType::TurnOn || command.type == CommandType::TurnOff ? DeviceResult::Ok
+                                                                                        : DeviceResult::NotSupported;
 }
 
 // setter for device status
 void Device::setIsOn(bool status) {
+    bool changed = isOn != status;
     isOn = status;
+    if (changed) {
+        notifyChange(DeviceChange::Power);
+    }
 }
 
 // setter for power consumption
@@ -63,20 +152,20 @@ void Device::setPowerConsumption(double consumption) {
     powerConsumption = consumption;
 
     // record usage in energy monitor
-    EnergyMonitor::getInstance()->recordUsage(deviceID, consumption);
+    reportUsage(consumption);
 }
 
 // turn on energy monitoring for device
 void Device::turnOn() {
     setIsOn(true);
     // when device is on, record power consumption
-    EnergyMonitor::getInstance()->recordUsage(deviceID, powerConsumption);
+    reportUsage(powerConsumption);
 }
 
 // turn off energy monitoring for device
 void Device::turnOff() {
     setIsOn(false);
     // when device is off, record power consumption as 0
-    EnergyMonitor::getInstance()->recordUsage(deviceID, 0.0);
+    reportUsage(0.0);
 }
 
@@ -0,0 +1,92 @@
+// includes
+#include "devices/device_command.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+// message for a result
+const char* describeResult(DeviceResult result) {
+    switch (result) {
+        case DeviceResult::Ok: return "OK";
+        case DeviceResult::InvalidBrightness: return "Brightness must be between 0 and 100";
+        case DeviceResult::InvalidColor: return "Unknown color";
+        case DeviceResult::InvalidTemperature: return "Temperature must be between 0 and 50 degrees";
+        case DeviceResult::InvalidMode: return "Mode must be heating, cooling or auto";
+        case DeviceResult::InvalidResolution: return "Invalid resolution. Use 720p, 1080p, or 4K";
+        case DeviceResult::InvalidRotation: return "Rotation angle must be between 0 and 360 degrees";
+        case DeviceResult::DeviceOff: return "Device must be on";
+        case DeviceResult::NotSupported: return "Command not supported by this device";
+        case DeviceResult::UnknownDevice: return "Device not found";
+        case DeviceResult::Timeout: return "Device did not respond";
+    }
+    return "Unknown result";
+}
+
+// whole argument as a float, copied out since strtof needs the terminator
+static bool parseNumber(std::string_view text, float& value) {
+    char digits[64];
+    if (text.empty() || text.size() >= sizeof(digits)) {
+        return false;
+    }
+    text.copy(digits, text.size());
+    digits[text.size()] = '\0';
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtof(digits, &end);
+    return errno == 0 && end == digits + text.size();
+}
+
+// command from a verb and its argument
+bool parseDeviceCommand(std::string_view verb, std::string_view argument, DeviceCommand& command) {
+    command = DeviceCommand{CommandType::TurnOn, 0.0f, ""};
+    if (verb == "on" || verb == "off" || verb == "record" || verb == "stop") {
+        command.type = verb == "on" ? CommandType::TurnOn
+                     : verb == "off" ? CommandType::TurnOff
+                     : verb == "record" ? CommandType::StartRecording : CommandType::StopRecording;
+        return argument.empty();
+    }
+    if (verb == "color" || verb == "mode" || verb == "resolution") {
+        command.type = verb == "color" ? CommandType::SetColor
+                     : verb == "mode" ? CommandType::SetMode : CommandType::SetResolution;
+        command.text = std::string(argument);
+        return !argument.empty();
+    }
+    if (verb == "motion") {
+        command.type = argument == "on" ? CommandType::EnableMotionDetection : CommandType::DisableMotionDetection;
+        return argument == "on" || argument == "off";
+    }
+    if (verb == "brightness") {
+        command.type = CommandType::SetBrightness;
+    } else if (verb == "temperature") {
+        command.type = CommandType::SetTemperature;
+    } else if (verb == "setpoint") {
+        command.type = CommandType::SetDesiredTemperature;
+    } else if (verb == "rotation") {
+        command.type = CommandType::SetRotation;
+    } else {
+        return false;
+    }
+    return parseNumber(argument, command.value);
+}
+
+// verb and argument for a command
+std::string formatDeviceCommand(const DeviceCommand& command) {
+    char number[32];
+    std::snprintf(number, sizeof(number), "%g", command.value);
+    switch (command.type) {
+        case CommandType::TurnOn: return "on";
+        case CommandType::TurnOff: return "off";
+        case CommandType::SetBrightness: return std::string("brightness ") + number;
+        case CommandType::SetColor: return "color " + command.text;
+        case CommandType::SetTemperature: return std::string("temperature ") + number;
+        case CommandType::SetDesiredTemperature: return std::string("setpoint ") + number;
+        case CommandType::SetMode: return "mode " + command.text;
+        case CommandType::StartRecording: return "record";
+        case CommandType::StopRecording: return "stop";
+        case CommandType::SetResolution: return "resolution " + command.text;
+        case CommandType::SetRotation: return std::string("rotation ") + number;
+        case CommandType::EnableMotionDetection: return "motion on";
+        case CommandType::DisableMotionDetection: return "motion off";
+    }
+    return "";
+}
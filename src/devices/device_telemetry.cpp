@@ -0,0 +1,239 @@
+// includes
+#include "devices/device_telemetry.hpp"
+#include <cstring>
+#include <stdexcept>
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+
+// layout, see device_telemetry.hpp
+static const std::size_t recordHeaderSize = 12; // up to and including the power usage
+static const std::size_t batchHeaderSize = 16;
+static const char batchMagic[4] = {'S', 'H', 'T', 'B'};
+
+// bytes of type fields after the device ID
+static std::size_t fieldSize(TelemetryDeviceType type) {
+    switch (type) {
+        case TelemetryDeviceType::Light: return 8;
+        case TelemetryDeviceType::Thermostat: return 16;
+        case TelemetryDeviceType::Camera: return 12;
+        case TelemetryDeviceType::Unknown: return 0;
+    }
+    return 0;
+}
+
+// little-endian stores and loads
+static void put16(std::uint8_t* at, std::uint16_t value) {
+    at[0] = static_cast<std::uint8_t>(value);
+    at[1] = static_cast<std::uint8_t>(value >> 8);
+}
+
+static void put32(std::uint8_t* at, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) at[i] = static_cast<std::uint8_t>(value >> (8 * i));
+}
+
+static void put64(std::uint8_t* at, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) at[i] = static_cast<std::uint8_t>(value >> (8 * i));
+}
+
+static void putFloat(std::uint8_t* at, float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put32(at, bits);
+}
+
+static std::uint16_t get16(const std::uint8_t* at) {
+    return static_cast<std::uint16_t>(at[0] | (at[1] << 8));
+}
+
+static std::uint32_t get32(const std::uint8_t* at) {
+    return std::uint32_t(at[0]) | (std::uint32_t(at[1]) << 8) | (std::uint32_t(at[2]) << 16) | (std::uint32_t(at[3]) << 24);
+}
+
+static std::uint64_t get64(const std::uint8_t* at) {
+    return std::uint64_t(get32(at)) | (std::uint64_t(get32(at + 4)) << 32);
+}
+
+static float getFloat(const std::uint8_t* at) {
+    std::uint32_t bits = get32(at);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::size_t encodeTelemetry(const Device& device, std::vector<std::uint8_t>& out) {
+    const auto* light = dynamic_cast<const SmartLight*>(&device);
+    const auto* thermostat = light ? nullptr : dynamic_cast<const Thermostat*>(&device);
+    const auto* camera = light || thermostat ? nullptr : dynamic_cast<const SecurityCamera*>(&device);
+    TelemetryDeviceType type = light ? TelemetryDeviceType::Light
+                             : thermostat ? TelemetryDeviceType::Thermostat
+                             : camera ? TelemetryDeviceType::Camera
+                             : TelemetryDeviceType::Unknown;
+    const std::string& id = device.getDeviceID();
+    if (id.size() > 255) {
+        throw std::invalid_argument("Device ID too long for telemetry: " + id);
+    }
+    std::size_t fields = fieldSize(type);
+    std::size_t size = recordHeaderSize + fields + id.size();
+    std::size_t start = out.size();
+    out.resize(start + size);
+    std::uint8_t* record = out.data() + start;
+    std::uint8_t* field = record + recordHeaderSize + id.size();
+    std::memset(field, 0, fields);
+
+    std::uint8_t flags = device.getIsOn() ? TelemetryOn : 0;
+    if (light) {
+        LightColor color = light->getColor();
+        field[0] = static_cast<std::uint8_t>(light->getBrightness());
+        field[1] = color.getRed();
+        field[2] = color.getGreen();
+        field[3] = color.getBlue();
+        field[4] = static_cast<std::uint8_t>(color.getKelvin() / 100);
+    } else if (thermostat) {
+        putFloat(field, thermostat->getTemperature());
+        putFloat(field + 4, thermostat->getDesiredTemperature());
+        putFloat(field + 8, thermostat->getControlOutput());
+        field[12] = static_cast<std::uint8_t>(thermostat->getThermostatMode()); // enum order is the code order
+        flags |= thermostat->isClosedLoop() ? TelemetryClosedLoop : 0;
+    } else if (camera) {
+        put64(field, camera->getMotionEventCount());
+        put16(field + 8, static_cast<std::uint16_t>(camera->getRotation()));
+        field[10] = static_cast<std::uint8_t>(camera->getCameraResolution());
+        flags |= camera->getIsRecording() ? TelemetryRecording : 0;
+        flags |= camera->getMotionDetection() ? TelemetryMotionDetection : 0;
+    }
+    record[0] = telemetryVersion;
+    record[1] = static_cast<std::uint8_t>(type);
+    record[2] = flags;
+    record[3] = static_cast<std::uint8_t>(id.size());
+    put16(record + 4, static_cast<std::uint16_t>(size));
+    put16(record + 6, 0);
+    putFloat(record + 8, static_cast<float>(device.getPowerUsage()));
+    std::memcpy(record + recordHeaderSize, id.data(), id.size());
+    return size;
+}
+
+bool TelemetryRecord::tryDecode(const std::uint8_t* bytes, std::size_t length, TelemetryRecord& record) {
+    if (length < recordHeaderSize || bytes[0] != telemetryVersion) {
+        return false;
+    }
+    std::size_t size = get16(bytes + 4);
+    record.data = bytes;
+    if (size > length || size < recordHeaderSize + fieldSize(record.getType()) + bytes[3]) {
+        record.data = nullptr;
+        return false;
+    }
+    return true;
+}
+
+TelemetryRecord TelemetryRecord::decode(const std::uint8_t* bytes, std::size_t length) {
+    TelemetryRecord record;
+    if (!tryDecode(bytes, length, record)) {
+        throw std::invalid_argument("Malformed telemetry record");
+    }
+    return record;
+}
+
+TelemetryDeviceType TelemetryRecord::getType() const {
+    return data[1] <= static_cast<std::uint8_t>(TelemetryDeviceType::Camera) ? static_cast<TelemetryDeviceType>(data[1])
+                                                                             : TelemetryDeviceType::Unknown;
+}
+
+std::size_t TelemetryRecord::getSize() const {
+    return get16(data + 4);
+}
+
+std::string_view TelemetryRecord::getDeviceID() const {
+    return std::string_view(reinterpret_cast<const char*>(data + recordHeaderSize), data[3]);
+}
+
+float TelemetryRecord::getPowerUsage() const {
+    return getFloat(data + 8);
+}
+
+float TelemetryRecord::getTemperature() const {
+    return getFloat(fields());
+}
+
+float TelemetryRecord::getDesiredTemperature() const {
+    return getFloat(fields() + 4);
+}
+
+float TelemetryRecord::getControlOutput() const {
+    return getFloat(fields() + 8);
+}
+
+const char* TelemetryRecord::getMode() const {
+    return thermostatModeName(fields()[12] < 3 ? static_cast<ThermostatMode>(fields()[12]) : ThermostatMode::Auto);
+}
+
+std::uint64_t TelemetryRecord::getMotionEventCount() const {
+    return get64(fields());
+}
+
+int TelemetryRecord::getRotation() const {
+    return get16(fields() + 8);
+}
+
+const char* TelemetryRecord::getResolution() const {
+    return cameraResolutionName(fields()[10] < 3 ? static_cast<CameraResolution>(fields()[10]) : CameraResolution::Hd720);
+}
+
+TelemetryBatchWriter::TelemetryBatchWriter(std::size_t reserveBytes)
+    : recordCount(0)
+{
+    buffer.reserve(batchHeaderSize + reserveBytes);
+    buffer.resize(batchHeaderSize);
+}
+
+void TelemetryBatchWriter::add(const Device& device) {
+    encodeTelemetry(device, buffer);
+    ++recordCount;
+}
+
+void TelemetryBatchWriter::clear() {
+    buffer.resize(batchHeaderSize);
+    recordCount = 0;
+}
+
+const std::vector<std::uint8_t>& TelemetryBatchWriter::finish() {
+    std::memset(buffer.data(), 0, batchHeaderSize);
+    std::memcpy(buffer.data(), batchMagic, sizeof(batchMagic));
+    buffer[4] = telemetryVersion;
+    put32(buffer.data() + 8, recordCount);
+    put32(buffer.data() + 12, static_cast<std::uint32_t>(buffer.size() - batchHeaderSize));
+    return buffer;
+}
+
+TelemetryBatchReader::TelemetryBatchReader(const std::uint8_t* bytes, std::size_t length)
+    : data(bytes)
+    , end(0)
+    , offset(batchHeaderSize)
+    , recordCount(0)
+    , recordsRead(0)
+{
+    if (length < batchHeaderSize || std::memcmp(bytes, batchMagic, sizeof(batchMagic)) != 0) {
+        throw std::invalid_argument("Not a telemetry batch");
+    }
+    if (bytes[4] != telemetryVersion) {
+        throw std::invalid_argument("Unsupported telemetry version " + std::to_string(bytes[4]));
+    }
+    recordCount = get32(bytes + 8);
+    std::size_t recordBytes = get32(bytes + 12);
+    if (recordBytes > length - batchHeaderSize) {
+        throw std::invalid_argument("Truncated telemetry batch");
+    }
+    end = batchHeaderSize + recordBytes;
+}
+
+bool TelemetryBatchReader::next(TelemetryRecord& record) {
+    if (recordsRead == recordCount) {
+        return false;
+    }
+    if (!TelemetryRecord::tryDecode(data + offset, end - offset, record)) {
+        throw std::invalid_argument("Malformed telemetry record " + std::to_string(recordsRead));
+    }
+    offset += record.getSize();
+    ++recordsRead;
+    return true;
+}
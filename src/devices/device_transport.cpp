@@ -0,0 +1,121 @@
+// includes
+#include "devices/device_transport.hpp"
+#include <algorithm>
+#include "core/metrics.hpp"
+
+// transport metrics: round trips by outcome
+struct TransportMetrics {
+    Counter answered;
+    Counter lost;
+};
+
+static const TransportMetrics& transportMetrics() {
+    static const TransportMetrics metrics = [] {
+        MetricsRegistry* registry = MetricsRegistry::getInstance();
+        return TransportMetrics{
+            registry->counter("smart_home_transport_requests_total", "Device round trips by outcome", "result=\"answered\""),
+            registry->counter("smart_home_transport_requests_total", "Device round trips by outcome", "result=\"lost\"")};
+    }();
+    return metrics;
+}
+
+void DeviceTransport::Exchange::await_suspend(std::coroutine_handle<> sender) {
+    transport.send(answered, sender);
+}
+
+DeviceTransport::DeviceTransport(const TransportConfig& transportConfig)
+    : config(transportConfig)
+    , random(transportConfig.seed)
+    , start(std::chrono::steady_clock::now())
+    , running(true)
+    , requestCount(0)
+    , lostCount(0)
+    , inFlight(0)
+{
+    timerThread = std::thread(&DeviceTransport::runTimers, this);
+    for (std::size_t i = 0; i < std::max<std::size_t>(1, config.workers); ++i) {
+        workers.emplace_back(&DeviceTransport::runWorker, this);
+    }
+}
+
+DeviceTransport::~DeviceTransport() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        running = false;
+    }
+    timersChanged.notify_all();
+    readyChanged.notify_all();
+    timerThread.join();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+std::uint64_t DeviceTransport::nowMillis() const {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+// decide whether the round trip succeeds and when the sender hears back
+void DeviceTransport::send(bool& answered, std::coroutine_handle<> sender) {
+    requestCount.fetch_add(1, std::memory_order_relaxed);
+    inFlight.fetch_add(1, std::memory_order_relaxed);
+    bool lost;
+    bool wake;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        lost = config.lossRate > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(random) < config.lossRate;
+        std::uint64_t delay = lost ? config.timeoutMillis : config.latencyMillis;
+        if (!lost && config.jitterMillis > 0) {
+            delay += std::uniform_int_distribution<std::uint32_t>(0, config.jitterMillis)(random);
+        }
+        answered = !lost; // the sender may be resumed as soon as the lock is released, so not read after it
+        wake = wheel.getPendingCount() == 0; // the timer thread sleeps until the first timer
+        // the wheel is only advanced while timers are pending, so count from the real time
+        delay += nowMillis() - wheel.now();
+        wheel.schedule(delay, [this, sender] { ready.push_back(sender); });
+    }
+    (lost ? transportMetrics().lost : transportMetrics().answered).increment();
+    if (lost) {
+        lostCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (wake) {
+        timersChanged.notify_one();
+    }
+}
+
+// fire due replies once a millisecond while any are pending
+void DeviceTransport::runTimers() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (running) {
+        if (wheel.getPendingCount() == 0) {
+            timersChanged.wait(guard);
+            continue;
+        }
+        if (wheel.advanceTo(nowMillis()) > 0) {
+            readyChanged.notify_all();
+        }
+        timersChanged.wait_until(guard, start + std::chrono::milliseconds(wheel.now() + 1));
+    }
+}
+
+// resume senders in small batches, outside the lock since they go on to send more
+void DeviceTransport::runWorker() {
+    std::vector<std::coroutine_handle<>> batch;
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        readyChanged.wait(guard, [this] { return !running || !ready.empty(); });
+        if (ready.empty()) {
+            return; // stopping
+        }
+        std::size_t take = std::min<std::size_t>(ready.size(), 64);
+        batch.assign(ready.begin(), ready.begin() + take);
+        ready.erase(ready.begin(), ready.begin() + take);
+        guard.unlock();
+        inFlight.fetch_sub(take, std::memory_order_relaxed);
+        for (auto sender : batch) {
+            sender.resume();
+        }
+        guard.lock();
+    }
+}
@@ -0,0 +1,267 @@
+// includes
+#include "devices/light_color.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+
+// named color in the lookup table
+struct NamedColor {
+    const char* name; // display name
+    LightColor color; // packed value
+};
+
+// display names double as the parse keys, matched ignoring case, spaces, '-' and '_'
+constexpr NamedColor namedColors[] = {
+    {"White", LightColor(255, 255, 255)},
+    {"Warm White", LightColor(255, 167, 87, 27)},
+    {"Soft White", LightColor(255, 177, 110, 30)},
+    {"Cool White", LightColor(255, 206, 166, 40)},
+    {"Daylight", LightColor(255, 254, 250, 65)},
+    {"Red", LightColor(255, 0, 0)},
+    {"Green", LightColor(0, 255, 0)},
+    {"Blue", LightColor(0, 0, 255)},
+    {"Yellow", LightColor(255, 255, 0)},
+    {"Orange", LightColor(255, 165, 0)},
+    {"Amber", LightColor(255, 191, 0)},
+    {"Gold", LightColor(255, 215, 0)},
+    {"Purple", LightColor(128, 0, 128)},
+    {"Violet", LightColor(238, 130, 238)},
+    {"Indigo", LightColor(75, 0, 130)},
+    {"Pink", LightColor(255, 192, 203)},
+    {"Magenta", LightColor(255, 0, 255)},
+    {"Crimson", LightColor(220, 20, 60)},
+    {"Cyan", LightColor(0, 255, 255)},
+    {"Teal", LightColor(0, 128, 128)},
+    {"Turquoise", LightColor(64, 224, 208)},
+    {"Lime", LightColor(50, 205, 50)},
+    {"Lavender", LightColor(230, 230, 250)},
+};
+constexpr std::size_t namedColorCount = sizeof(namedColors) / sizeof(namedColors[0]);
+
+// characters that do not take part in name matching
+constexpr bool isNameSeparator(char c) {
+    return c == ' ' || c == '-' || c == '_' || c == '\t';
+}
+
+constexpr char toLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// FNV-1a over the normalised name
+constexpr std::uint32_t nameHash(const char* text, std::size_t length) {
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < length; ++i) {
+        if (isNameSeparator(text[i])) continue;
+        hash = (hash ^ static_cast<std::uint8_t>(toLower(text[i]))) * 16777619u;
+    }
+    return hash;
+}
+
+constexpr std::size_t nameLength(const char* text) {
+    std::size_t length = 0;
+    while (text[length] != '\0') ++length;
+    return length;
+}
+
+// open-addressed hash index from name to table position, built at compile time
+constexpr std::size_t indexSize = 64;
+constexpr std::uint8_t emptySlot = 0xFF;
+
+constexpr std::array<std::uint8_t, indexSize> buildNameIndex() {
+    std::array<std::uint8_t, indexSize> slots{};
+    for (std::size_t i = 0; i < indexSize; ++i) {
+        slots[i] = emptySlot;
+    }
+    for (std::size_t i = 0; i < namedColorCount; ++i) {
+        std::size_t slot = nameHash(namedColors[i].name, nameLength(namedColors[i].name)) % indexSize;
+        while (slots[slot] != emptySlot) {
+            slot = (slot + 1) % indexSize;
+        }
+        slots[slot] = static_cast<std::uint8_t>(i);
+    }
+    return slots;
+}
+
+constexpr std::array<std::uint8_t, indexSize> nameIndex = buildNameIndex();
+static_assert(namedColorCount < indexSize / 2, "color name index should stay at most half full");
+
+// compare a query with a table name, ignoring case and separators
+bool namesMatch(const std::string& query, const char* name) {
+    std::size_t q = 0;
+    const char* n = name;
+    while (true) {
+        while (q < query.size() && isNameSeparator(query[q])) ++q;
+        while (*n != '\0' && isNameSeparator(*n)) ++n;
+        if (q == query.size() || *n == '\0') {
+            return q == query.size() && *n == '\0';
+        }
+        if (toLower(query[q]) != toLower(*n)) {
+            return false;
+        }
+        ++q;
+        ++n;
+    }
+}
+
+// look a name up in the compile-time index
+const NamedColor* findNamedColor(const std::string& text) {
+    std::size_t slot = nameHash(text.data(), text.size()) % indexSize;
+    while (nameIndex[slot] != emptySlot) {
+        const NamedColor& entry = namedColors[nameIndex[slot]];
+        if (namesMatch(text, entry.name)) {
+            return &entry;
+        }
+        slot = (slot + 1) % indexSize;
+    }
+    return nullptr;
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::uint8_t clampChannel(double value) {
+    return static_cast<std::uint8_t>(std::lround(std::min(255.0, std::max(0.0, value))));
+}
+
+} // namespace
+
+// Tanner Helland's curve fit of the black-body locus
+LightColor LightColor::fromKelvin(int kelvin) {
+    if (kelvin < 1000 || kelvin > 25500) {
+        throw std::invalid_argument("Color temperature must be between 1000K and 25500K");
+    }
+    double t = kelvin / 100.0;
+    double r = t <= 66 ? 255.0 : 329.698727446 * std::pow(t - 60, -0.1332047592);
+    double g = t <= 66 ? 99.4708025861 * std::log(t) - 161.1195681661
+                       : 288.1221695283 * std::pow(t - 60, -0.0755148492);
+    double b = t >= 66 ? 255.0 : (t <= 19 ? 0.0 : 138.5177312231 * std::log(t - 10) - 305.0447927307);
+    return LightColor(clampChannel(r), clampChannel(g), clampChannel(b),
+                      static_cast<std::uint8_t>((kelvin + 50) / 100));
+}
+
+// standard sector conversion
+LightColor LightColor::fromHsv(const HsvColor& hsv) {
+    double h = std::fmod(std::fmod(static_cast<double>(hsv.hue), 360.0) + 360.0, 360.0) / 60.0;
+    double s = std::min(1.0, std::max(0.0, static_cast<double>(hsv.saturation)));
+    double v = std::min(1.0, std::max(0.0, static_cast<double>(hsv.value)));
+    double c = v * s;
+    double x = c * (1 - std::fabs(std::fmod(h, 2.0) - 1));
+    double m = v - c;
+    double r = 0, g = 0, b = 0;
+    switch (static_cast<int>(h)) {
+        case 0: r = c; g = x; break;
+        case 1: r = x; g = c; break;
+        case 2: g = c; b = x; break;
+        case 3: g = x; b = c; break;
+        case 4: r = x; b = c; break;
+        default: r = c; b = x; break;
+    }
+    return LightColor(clampChannel((r + m) * 255), clampChannel((g + m) * 255), clampChannel((b + m) * 255));
+}
+
+// accepts a table name, #RRGGBB or a temperature such as 2700K
+bool LightColor::tryParse(const std::string& text, LightColor& result) {
+    if (text.empty()) {
+        return false;
+    }
+    if (const NamedColor* entry = findNamedColor(text)) {
+        result = entry->color;
+        return true;
+    }
+    if (text.size() == 7 && text[0] == '#') {
+        int digits[6];
+        for (int i = 0; i < 6; ++i) {
+            digits[i] = hexDigit(text[static_cast<std::size_t>(i) + 1]);
+            if (digits[i] < 0) return false;
+        }
+        result = LightColor(static_cast<std::uint8_t>(digits[0] * 16 + digits[1]),
+                            static_cast<std::uint8_t>(digits[2] * 16 + digits[3]),
+                            static_cast<std::uint8_t>(digits[4] * 16 + digits[5]));
+        return true;
+    }
+    if (text.size() >= 5 && text.size() <= 6 && (text.back() == 'K' || text.back() == 'k')) {
+        int kelvin = 0;
+        for (std::size_t i = 0; i + 1 < text.size(); ++i) {
+            if (text[i] < '0' || text[i] > '9') return false;
+            kelvin = kelvin * 10 + (text[i] - '0');
+        }
+        if (kelvin < 1000 || kelvin > 25500) return false;
+        result = fromKelvin(kelvin);
+        return true;
+    }
+    return false;
+}
+
+LightColor LightColor::parse(const std::string& text) {
+    LightColor result;
+    if (!tryParse(text, result)) {
+        throw std::invalid_argument("Unknown color: " + text);
+    }
+    return result;
+}
+
+// hue, saturation and value of the RGB channels
+HsvColor LightColor::toHsv() const {
+    float r = red / 255.0f, g = green / 255.0f, b = blue / 255.0f;
+    float maxC = std::max(r, std::max(g, b));
+    float minC = std::min(r, std::min(g, b));
+    float delta = maxC - minC;
+    float hue = 0.0f;
+    if (delta > 0.0f) {
+        if (maxC == r) hue = 60.0f * std::fmod((g - b) / delta, 6.0f);
+        else if (maxC == g) hue = 60.0f * ((b - r) / delta + 2.0f);
+        else hue = 60.0f * ((r - g) / delta + 4.0f);
+        if (hue < 0.0f) hue += 360.0f;
+    }
+    return HsvColor{hue, maxC > 0.0f ? delta / maxC : 0.0f, maxC};
+}
+
+// linear scan is fine here, names are only needed for display
+const char* LightColor::name() const {
+    for (const auto& entry : namedColors) {
+        if (entry.color == *this) {
+            return entry.name;
+        }
+    }
+    return nullptr;
+}
+
+std::string LightColor::toString() const {
+    if (const char* tableName = name()) {
+        return tableName;
+    }
+    if (kelvinCode != 0) {
+        return std::to_string(getKelvin()) + "K";
+    }
+    char buffer[8];
+    std::snprintf(buffer, sizeof(buffer), "#%02X%02X%02X", red, green, blue);
+    return buffer;
+}
+
+// whites blend along the temperature scale, everything else channel by channel
+LightColor LightColor::interpolate(const LightColor& from, const LightColor& to, double progress) {
+    double t = std::min(1.0, std::max(0.0, progress));
+    if (t <= 0.0) return from;
+    if (t >= 1.0) return to;
+    if (from.kelvinCode != 0 && to.kelvinCode != 0) {
+        double kelvin = from.getKelvin() + (to.getKelvin() - from.getKelvin()) * t;
+        return fromKelvin(static_cast<int>(std::lround(kelvin)));
+    }
+    return LightColor(clampChannel(from.red + (to.red - from.red) * t),
+                      clampChannel(from.green + (to.green - from.green) * t),
+                      clampChannel(from.blue + (to.blue - from.blue) * t));
+}
+
+std::ostream& operator<<(std::ostream& os, const LightColor& color) {
+    return os << color.toString();
+}
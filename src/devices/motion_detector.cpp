@@ -0,0 +1,117 @@
+// includes
+#include "devices/motion_detector.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MOTION_DETECTOR_SSE2 1
+#endif
+
+// constructor
+MotionDetector::MotionDetector(FrameSize frameSize, std::uint8_t threshold, double ratio)
+    : size(frameSize)
+    , background(frameSize.pixelCount())
+    , hasBackground(false)
+    , pixelThreshold(threshold)
+    , triggerRatio(ratio)
+    , lastChangedPixels(0)
+{
+    if (frameSize.width <= 0 || frameSize.height <= 0) {
+        throw std::invalid_argument("Frame dimensions must be positive");
+    }
+    if (ratio <= 0.0 || ratio > 1.0) {
+        throw std::invalid_argument("Motion trigger ratio must be between 0 and 1");
+    }
+}
+
+// difference the frame against the background model
+bool MotionDetector::processFrame(const GrayFrame& frame) {
+    if (frame.getSize() != size) {
+        throw std::invalid_argument("Frame size does not match camera resolution");
+    }
+
+    // the first frame seeds the background, nothing to compare against yet
+    if (!hasBackground) {
+        std::memcpy(background.data(), frame.data(), background.size());
+        hasBackground = true;
+        lastChangedPixels = 0;
+        return false;
+    }
+
+    lastChangedPixels = diffAndUpdateBackground(frame.data(), background.data(), background.size(), pixelThreshold);
+    return getLastChangedRatio() >= triggerRatio;
+}
+
+// forget the background so the next frame seeds it again
+void MotionDetector::reset() {
+    hasBackground = false;
+    lastChangedPixels = 0;
+}
+
+FrameSize MotionDetector::getFrameSize() const {
+    return size;
+}
+
+std::size_t MotionDetector::getMemoryUsage() const {
+    return sizeof(MotionDetector) + background.capacity();
+}
+
+std::size_t MotionDetector::getLastChangedPixels() const {
+    return lastChangedPixels;
+}
+
+double MotionDetector::getLastChangedRatio() const {
+    return static_cast<double>(lastChangedPixels) / static_cast<double>(background.size());
+}
+
+// rounding average, identical to what _mm_avg_epu8 computes
+static inline std::uint8_t averageRounded(std::uint8_t a, std::uint8_t b) {
+    return static_cast<std::uint8_t>((a + b + 1) >> 1);
+}
+
+// difference and background update for a run of pixels
+std::size_t diffAndUpdateBackground(const std::uint8_t* frame, std::uint8_t* background,
+                                    std::size_t count, std::uint8_t threshold) {
+    std::size_t changed = 0;
+    std::size_t i = 0;
+
+#ifdef MOTION_DETECTOR_SSE2
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold));
+    const __m128i zero = _mm_setzero_si128();
+
+    // per-lane byte counters are flushed before they can overflow
+    while (i + 16 <= count) {
+        __m128i counters = _mm_setzero_si128();
+        std::size_t blockEnd = std::min(count - (count - i) % 16, i + 255 * 16);
+        for (; i < blockEnd; i += 16) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + i));
+            __m128i model = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + i));
+
+            // |pixels - model| > threshold
+            __m128i diff = _mm_or_si128(_mm_subs_epu8(pixels, model), _mm_subs_epu8(model, pixels));
+            __m128i over = _mm_subs_epu8(diff, limit);
+            __m128i isChanged = _mm_andnot_si128(_mm_cmpeq_epi8(over, zero), _mm_set1_epi8(1));
+            counters = _mm_add_epi8(counters, isChanged);
+
+            // model += (pixels - model) / 4
+            __m128i half = _mm_avg_epu8(model, pixels);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(background + i), _mm_avg_epu8(model, half));
+        }
+        __m128i sums = _mm_sad_epu8(counters, zero);
+        changed += static_cast<std::size_t>(_mm_cvtsi128_si32(sums)) +
+                   static_cast<std::size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+    }
+#endif
+
+    // scalar tail, or the whole frame without SSE2
+    for (; i < count; ++i) {
+        std::uint8_t pixel = frame[i];
+        std::uint8_t model = background[i];
+        std::uint8_t diff = pixel > model ? static_cast<std::uint8_t>(pixel - model) : static_cast<std::uint8_t>(model - pixel);
+        changed += diff > threshold ? 1 : 0;
+        background[i] = averageRounded(model, averageRounded(model, pixel));
+    }
+    return changed;
+}
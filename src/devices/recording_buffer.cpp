@@ -0,0 +1,283 @@
+// includes
+#include "devices/recording_buffer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// constructor
+RecordingBuffer::RecordingBuffer(const RecordingBufferConfig& bufferConfig)
+    : config(bufferConfig)
+    , ringBytes(0)
+    , firstChunkSequence(0)
+    , firstFrameSequence(0)
+    , evictedFrames(0)
+{
+    if (config.chunkBytes == 0 || config.capacityBytes < config.chunkBytes) {
+        throw std::invalid_argument("Recording buffer capacity must hold at least one chunk");
+    }
+}
+
+// drop the oldest chunk together with every frame stored in it
+void RecordingBuffer::evictOldestChunk() {
+    std::shared_ptr<RecordingChunk> oldest = std::move(chunks.front());
+    chunks.pop_front();
+    ringBytes -= oldest->capacity;
+
+    while (!frames.empty() && frames.front().chunkSequence == firstChunkSequence) {
+        frames.pop_front();
+        ++firstFrameSequence;
+        ++evictedFrames;
+    }
+    ++firstChunkSequence;
+
+    // recycle the chunk unless a clip is still being written from it
+    if (oldest.use_count() == 1 && oldest->capacity == config.chunkBytes) {
+        oldest->used = 0;
+        freeChunks.push_back(std::move(oldest));
+    }
+}
+
+// make room for and append a fresh chunk at the head of the ring
+void RecordingBuffer::startChunk(std::size_t minimumBytes) {
+    std::size_t capacity = std::max(minimumBytes, config.chunkBytes);
+    while (!chunks.empty() && ringBytes + capacity > config.capacityBytes) {
+        evictOldestChunk();
+    }
+
+    std::shared_ptr<RecordingChunk> chunk;
+    if (capacity == config.chunkBytes && !freeChunks.empty()) {
+        chunk = std::move(freeChunks.back());
+        freeChunks.pop_back();
+    } else {
+        // free list and ring share the capacity, so give up spare chunks before allocating
+        while (!freeChunks.empty() && ringBytes + capacity + freeChunks.size() * config.chunkBytes > config.capacityBytes) {
+            freeChunks.pop_back();
+        }
+        chunk = std::make_shared<RecordingChunk>();
+        chunk->bytes.reset(new std::uint8_t[capacity]);
+        chunk->capacity = capacity;
+        chunk->used = 0;
+    }
+    ringBytes += chunk->capacity;
+    chunks.push_back(std::move(chunk));
+}
+
+// copy an encoded frame into the newest chunk
+void RecordingBuffer::appendFrame(const std::uint8_t* data, std::size_t size,
+                                  std::uint64_t timestampMicros, bool keyFrame) {
+    if (size > config.capacityBytes) {
+        throw std::invalid_argument("Encoded frame is larger than the recording buffer");
+    }
+    if (chunks.empty() || chunks.back()->capacity - chunks.back()->used < size) {
+        startChunk(size);
+    }
+
+    RecordingChunk& chunk = *chunks.back();
+    std::memcpy(chunk.bytes.get() + chunk.used, data, size);
+    frames.push_back(FrameRecord{firstChunkSequence + chunks.size() - 1, chunk.used, size, timestampMicros, keyFrame});
+    chunk.used += size;
+}
+
+// last key frame at or before the pre-roll cutoff, so a clip starting there decodes
+std::uint64_t RecordingBuffer::getPreRollStart() const {
+    if (frames.empty()) {
+        return getNextSequence();
+    }
+
+    std::uint64_t newest = frames.back().timestampMicros;
+    std::uint64_t cutoff = newest > config.preRollMicros ? newest - config.preRollMicros : 0;
+
+    std::size_t start = frames.size();
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        if (!frames[i].keyFrame) continue;
+        if (frames[i].timestampMicros <= cutoff || start == frames.size()) {
+            start = i;
+        }
+        if (frames[i].timestampMicros >= cutoff) break;
+    }
+    if (start == frames.size()) {
+        start = 0; // no key frame buffered yet
+    }
+    return firstFrameSequence + start;
+}
+
+// frames from the pre-roll start up to the newest frame
+RecordingClip RecordingBuffer::extractPreRoll() const {
+    return extractRange(getPreRollStart(), getNextSequence());
+}
+
+// collect frames into segments, merging neighbours that sit back to back in a chunk
+RecordingClip RecordingBuffer::extractRange(std::uint64_t fromSequence, std::uint64_t toSequence) const {
+    RecordingClip clip;
+    std::uint64_t first = std::max(fromSequence, firstFrameSequence);
+    std::uint64_t last = std::min(toSequence, getNextSequence());
+    if (first >= last) {
+        return clip;
+    }
+    clip.firstSequence = first;
+
+    for (std::uint64_t seq = first; seq < last; ++seq) {
+        const FrameRecord& frame = frames[static_cast<std::size_t>(seq - firstFrameSequence)];
+        const auto& chunk = chunks[static_cast<std::size_t>(frame.chunkSequence - firstChunkSequence)];
+        if (!clip.segments.empty()) {
+            ClipSegment& tail = clip.segments.back();
+            if (tail.chunk == chunk && tail.offset + tail.length == frame.offset) {
+                tail.length += frame.size;
+                clip.byteCount += frame.size;
+                ++clip.frameCount;
+                continue;
+            }
+        }
+        clip.segments.push_back(ClipSegment{chunk, frame.offset, frame.size});
+        clip.byteCount += frame.size;
+        ++clip.frameCount;
+    }
+    return clip;
+}
+
+std::uint64_t RecordingBuffer::getNextSequence() const {
+    return firstFrameSequence + frames.size();
+}
+
+std::uint64_t RecordingBuffer::getOldestSequence() const {
+    return firstFrameSequence;
+}
+
+std::size_t RecordingBuffer::getFrameCount() const {
+    return frames.size();
+}
+
+std::size_t RecordingBuffer::getMemoryUsage() const {
+    return ringBytes + freeChunks.size() * config.chunkBytes;
+}
+
+std::uint64_t RecordingBuffer::getEvictedFrames() const {
+    return evictedFrames;
+}
+
+const RecordingBufferConfig& RecordingBuffer::getConfig() const {
+    return config;
+}
+
+// key frames compress to about an eighth of a raw frame, delta frames to a sixty-fourth
+SyntheticVideoEncoder::SyntheticVideoEncoder(FrameSize frameSize, int fps, int gop)
+    : keyFrameBytes(frameSize.pixelCount() / 8)
+    , deltaFrameBytes(frameSize.pixelCount() / 64)
+    , framesPerSecond(fps)
+    , gopLength(gop)
+    , frameCount(0)
+{
+    if (fps <= 0 || gop <= 0) {
+        throw std::invalid_argument("Frame rate and GOP length must be positive");
+    }
+    payload.resize(keyFrameBytes);
+    for (std::size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<std::uint8_t>(i * 31 + 7);
+    }
+}
+
+// stamp the frame number into the reused payload
+std::size_t SyntheticVideoEncoder::encodeNext() {
+    ++frameCount;
+    std::memcpy(payload.data(), &frameCount, sizeof(frameCount));
+    return isKeyFrame() ? keyFrameBytes : deltaFrameBytes;
+}
+
+const std::uint8_t* SyntheticVideoEncoder::data() const {
+    return payload.data();
+}
+
+bool SyntheticVideoEncoder::isKeyFrame() const {
+    return (frameCount - 1) % static_cast<std::uint64_t>(gopLength) == 0;
+}
+
+std::uint64_t SyntheticVideoEncoder::getTimestampMicros() const {
+    return (frameCount - 1) * 1000000u / static_cast<std::uint64_t>(framesPerSecond);
+}
+
+// open the output file
+ClipWriter::ClipWriter(const std::string& filePath)
+    : fd(-1)
+    , path(filePath)
+    , bytesWritten(0)
+{
+#ifdef _WIN32
+    fd = _open(filePath.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+    fd = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create clip file: " + filePath);
+    }
+}
+
+ClipWriter::~ClipWriter() {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+// hand the chunk memory to the kernel directly, no staging buffer
+void ClipWriter::write(const RecordingClip& clip) {
+#ifdef _WIN32
+    for (const auto& segment : clip.segments) {
+        const std::uint8_t* data = segment.data();
+        std::size_t remaining = segment.length;
+        while (remaining > 0) {
+            unsigned request = static_cast<unsigned>(std::min<std::size_t>(remaining, 1u << 30));
+            int written = _write(fd, data, request);
+            if (written <= 0) {
+                throw std::runtime_error("Failed to write clip file: " + path);
+            }
+            data += written;
+            remaining -= static_cast<std::size_t>(written);
+        }
+    }
+#else
+    std::vector<iovec> vectors;
+    vectors.reserve(clip.segments.size());
+    for (const auto& segment : clip.segments) {
+        vectors.push_back(iovec{const_cast<std::uint8_t*>(segment.data()), segment.length});
+    }
+
+    // writev may stop short, so resume from wherever it got to
+    std::size_t index = 0;
+    while (index < vectors.size()) {
+        int batch = static_cast<int>(std::min<std::size_t>(vectors.size() - index, IOV_MAX));
+        ssize_t written = ::writev(fd, vectors.data() + index, batch);
+        if (written < 0) {
+            throw std::runtime_error("Failed to write clip file: " + path);
+        }
+        std::size_t consumed = static_cast<std::size_t>(written);
+        while (index < vectors.size() && consumed >= vectors[index].iov_len) {
+            consumed -= vectors[index].iov_len;
+            ++index;
+        }
+        if (consumed > 0) {
+            vectors[index].iov_base = static_cast<std::uint8_t*>(vectors[index].iov_base) + consumed;
+            vectors[index].iov_len -= consumed;
+        }
+    }
+#endif
+    bytesWritten += clip.byteCount;
+}
+
+std::uint64_t ClipWriter::getBytesWritten() const {
+    return bytesWritten;
+}
+
+const std::string& ClipWriter::getPath() const {
+    return path;
+}
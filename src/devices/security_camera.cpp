@@ -1,46 +1,72 @@
 #include "devices/security_camera.hpp"
+#include "core/logger.hpp"
+#include "core/tracing.hpp"
 #include "controllers/home_controller.hpp"
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 
+// accepted resolutions and angles, shared by the setters and checkCommand
+static bool validResolution(const std::string& res) {
+    CameraResolution parsed;
+    return parseCameraResolution(res, parsed);
+}
+
+static bool validRotation(int angle) {
+    return angle >= 0 && angle <= 360;
+}
+
+// a command's angle, checked before it is cast: whole degrees only, false for NaN and infinity
+static bool validRotationArgument(float angle) {
+    return std::isfinite(angle) && angle >= 0 && angle <= 360 && std::trunc(angle) == angle;
+}
+
 // constructor
 SecurityCamera::SecurityCamera(
     const std::string& id,
     const std::string& name,
-    const std::string& location)
-    : Device(id, name, location)
+    const std::string& location,
+    StringPool* pool)
+    : Device(id, name, location, pool)
     , isRecording(false)
-    , resolution("1080p")
+    , resolution(CameraResolution::Hd1080)
     , angleRotation(0)
     , motionDetection(false)
+    , motionEventCount(0)
+    , recordingCursor(0)
+    , recordingEnd(0)
+    , recordOnMotion(false)
 {
     try {
         if (id.empty() || name.empty() || location.empty()) {
             throw std::invalid_argument("ID, name, and location cannot be empty");
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error creating SecurityCamera: " << e.what() << std::endl;
+        logError("Error creating SecurityCamera: ", e.what());
         throw;
     }
 }
 
 // Override functions
 void SecurityCamera::turnOn() {
+    TraceSpan span("SecurityCamera::turnOn", "device", deviceID);
     try {
-        setIsOn(true);
         setPowerConsumption(0.5);  // 0.5W when running
+        setIsOn(true);
     } catch (const std::exception& e) {
-        std::cerr << "Error turning on camera: " << e.what() << std::endl;
+        logError("Error turning on camera: ", e.what());
         throw std::runtime_error("Failed to turn on camera");
     }
 }
 
 void SecurityCamera::turnOff() {
+    TraceSpan span("SecurityCamera::turnOff", "device", deviceID);
     try {
-        setIsOn(false);
-        isRecording = false;
+        endRecording(); // the clip so far can still be taken
         setPowerConsumption(0.0);
+        setIsOn(false); // last so observers see the recording stopped too
     } catch (const std::exception& e) {
-        std::cerr << "Error turning off camera: " << e.what() << std::endl;
+        logError("Error turning off camera: ", e.what());
         throw std::runtime_error("Failed to turn off camera");
     }
 }
@@ -50,89 +76,292 @@ double SecurityCamera::getPowerUsage() const {
         if (!getIsOn()) return 0.0;
         return isRecording ? 1.0 : 0.5;  // 1.0W when recording, 0.5W when just on
     } catch (const std::exception& e) {
-        std::cerr << "Error getting power usage: " << e.what() << std::endl;
+        logError("Error getting power usage: ", e.what());
         throw std::runtime_error("Failed to get power usage");
     }
 }
 
 std::string SecurityCamera::getDeviceStatus() const {
     try {
-        return "Security Camera " + getDeviceID() +
-               " is " + (getIsOn() ? "on" : "off") +
-               " [Recording: " + (isRecording ? "Yes" : "No") +
-               ", Resolution: " + resolution +
-               ", Rotation: " + std::to_string(angleRotation) +
-               " degrees, Motion Detection: " + (motionDetection ? "On" : "Off") + "]";
+        return formatStatus(getDeviceID(), getIsOn(), isRecording, resolution, angleRotation, motionDetection);
     } catch (const std::exception& e) {
-        std::cerr << "Error getting device status: " << e.what() << std::endl;
+        logError("Error getting device status: ", e.what());
         throw std::runtime_error("Failed to get device status");
     }
 }
 
+// the status text of a camera in the given state, also used for snapshot views
+std::string SecurityCamera::formatStatus(const std::string& id, bool on, bool recording, CameraResolution resolution,
+                                         int rotation, bool motionDetection) {
+    return "Security Camera " + id +
+           " is " + (on ? "on" : "off") +
+           " [Recording: " + (recording ? "Yes" : "No") +
+           ", Resolution: " + cameraResolutionName(resolution) +
+           ", Rotation: " + std::to_string(rotation) +
+           " degrees, Motion Detection: " + (motionDetection ? "On" : "Off") + "]";
+}
+
 // Camera specific functions
+void SecurityCamera::endRecording() {
+    if (isRecording && recordingBuffer) {
+        recordingEnd = recordingBuffer->getNextSequence();
+    }
+    isRecording = false;
+}
+
 void SecurityCamera::startRecording() {
     try {
-        if (!getIsOn()) {
+        if (tryStartRecording() != DeviceResult::Ok) {
             throw std::runtime_error("Camera must be on to start recording");
         }
-        isRecording = true;
-        setPowerConsumption(1.0);  // Increase power consumption when recording
     } catch (const std::exception& e) {
-        std::cerr << "Error starting recording: " << e.what() << std::endl;
+        logError("Error starting recording: ", e.what());
         throw;
     }
 }
 
 void SecurityCamera::stopRecording() {
+    TraceSpan span("SecurityCamera::stopRecording", "device", deviceID);
     try {
-        isRecording = false;
+        endRecording();
         if (getIsOn()) {
             setPowerConsumption(0.5);  // Return to standard power consumption
         }
+        notifyChange(DeviceChange::Recording);
     } catch (const std::exception& e) {
-        std::cerr << "Error stopping recording: " << e.what() << std::endl;
+        logError("Error stopping recording: ", e.what());
         throw;
     }
 }
 
 void SecurityCamera::setResolution(const std::string& res) {
     try {
-        if (res != "720p" && res != "1080p" && res != "4K") {
-            throw std::invalid_argument("Invalid resolution. Use 720p, 1080p, or 4K");
+        DeviceResult result = trySetResolution(res);
+        if (result != DeviceResult::Ok) {
+            throw std::invalid_argument(describeResult(result));
         }
-        resolution = res;
     } catch (const std::exception& e) {
-        std::cerr << "Error setting resolution: " << e.what() << std::endl;
+        logError("Error setting resolution: ", e.what());
         throw;
     }
 }
 
 void SecurityCamera::setRotation(int angle) {
     try {
-        if (angle < 0 || angle > 360) {
-            throw std::invalid_argument("Rotation angle must be between 0 and 360 degrees");
+        DeviceResult result = trySetRotation(angle);
+        if (result != DeviceResult::Ok) {
+            throw std::invalid_argument(describeResult(result));
         }
-        angleRotation = angle;
     } catch (const std::exception& e) {
-        std::cerr << "Error setting rotation: " << e.what() << std::endl;
+        logError("Error setting rotation: ", e.what());
         throw;
     }
 }
 
 void SecurityCamera::enableMotionDetection() {
     try {
-        if (!getIsOn()) {
+        if (tryEnableMotionDetection() != DeviceResult::Ok) {
             throw std::runtime_error("Camera must be on to enable motion detection");
         }
-        motionDetection = true;
     } catch (const std::exception& e) {
-        std::cerr << "Error enabling motion detection: " << e.what() << std::endl;
+        logError("Error enabling motion detection: ", e.what());
         throw;
     }
 }
 
 void SecurityCamera::disableMotionDetection() {
     motionDetection = false;
+    motionDetector.reset();
+    notifyChange(DeviceChange::MotionDetection);
+}
+
+// Non-throwing versions
+DeviceResult SecurityCamera::tryStartRecording() {
+    TraceSpan span("SecurityCamera::startRecording", "device", deviceID);
+    if (!getIsOn()) {
+        return DeviceResult::DeviceOff;
+    }
+    isRecording = true;
+
+    // include the pre-roll unless frames from an earlier recording are still pending; frames
+    // already handed off are never handed off again
+    if (recordingBuffer && recordingCursor >= recordingEnd) {
+        recordingCursor = std::max(recordingCursor, recordingBuffer->getPreRollStart());
+    }
+    setPowerConsumption(1.0);  // Increase power consumption when recording
+    notifyChange(DeviceChange::Recording);
+    return DeviceResult::Ok;
+}
+
+DeviceResult SecurityCamera::trySetResolution(const std::string& res) {
+    TraceSpan span("SecurityCamera::setResolution", "device", deviceID);
+    CameraResolution parsed;
+    if (!parseCameraResolution(res, parsed)) {
+        return DeviceResult::InvalidResolution;
+    }
+    setResolution(parsed);
+    return DeviceResult::Ok;
+}
+
+void SecurityCamera::setResolution(CameraResolution res) {
+    resolution = res;
+
+    // frame size changed, rebuild the background model
+    if (motionDetector) {
+        motionDetector = std::make_unique<MotionDetector>(frameSizeForResolution(resolution));
+    }
+    notifyChange(DeviceChange::Resolution);
+}
+
+DeviceResult SecurityCamera::trySetRotation(int angle) {
+    TraceSpan span("SecurityCamera::setRotation", "device", deviceID);
+    if (!validRotation(angle)) {
+        return DeviceResult::InvalidRotation;
+    }
+    angleRotation = angle;
+    notifyChange(DeviceChange::Rotation);
+    return DeviceResult::Ok;
+}
+
+DeviceResult SecurityCamera::tryEnableMotionDetection() {
+    TraceSpan span("SecurityCamera::enableMotionDetection", "device", deviceID);
+    if (!getIsOn()) {
+        return DeviceResult::DeviceOff;
+    }
+    motionDetection = true;
+    if (!motionDetector) {
+        motionDetector = std::make_unique<MotionDetector>(frameSizeForResolution(resolution));
+    }
+    notifyChange(DeviceChange::MotionDetection);
+    return DeviceResult::Ok;
+}
+
+// camera commands, power is handled by Device
+DeviceResult SecurityCamera::applyCommand(const DeviceCommand& command) {
+    switch (command.type) {
+        case CommandType::StartRecording:
+            return tryStartRecording();
+        case CommandType::StopRecording:
+            stopRecording();
+            return DeviceResult::Ok;
+        case CommandType::SetResolution:
+            return trySetResolution(command.text);
+        case CommandType::SetRotation:
+            if (!validRotationArgument(command.value)) {
+                return DeviceResult::InvalidRotation;
+            }
+            return trySetRotation(static_cast<int>(command.value));
+        case CommandType::EnableMotionDetection:
+            return tryEnableMotionDetection();
+        case CommandType::DisableMotionDetection:
+            disableMotionDetection();
+            return DeviceResult::Ok;
+        default:
+            return Device::applyCommand(command);
+    }
+}
+
+// argument checks of the camera commands; whether the camera is on is state, so not checked here
+DeviceResult SecurityCamera::checkCommand(const DeviceCommand& command) const {
+    switch (command.type) {
+        case CommandType::StartRecording:
+        case CommandType::StopRecording:
+        case CommandType::EnableMotionDetection:
+        case CommandType::DisableMotionDetection:
+            return DeviceResult::Ok;
+        case CommandType::SetResolution:
+            return validResolution(command.text) ? DeviceResult::Ok : DeviceResult::InvalidResolution;
+        case CommandType::SetRotation:
+            return validRotationArgument(command.value) ? DeviceResult::Ok : DeviceResult::InvalidRotation;
+        default:
+            return Device::checkCommand(command);
+    }
+}
+
+// Motion pipeline
+bool SecurityCamera::processFrame(const GrayFrame& frame) {
+    if (!motionDetection || !getIsOn()) {
+        return false;
+    }
+    try {
+        if (!motionDetector->processFrame(frame)) {
+            return false;
+        }
+        ++motionEventCount;
+        notifyChange(DeviceChange::Motion);
+        if (recordOnMotion && !isRecording) {
+            startRecording();
+        }
+        if (motionCallback) {
+            motionCallback(MotionEvent{getDeviceID(), frame.getFrameNumber(),
+                                       motionDetector->getLastChangedPixels(),
+                                       motionDetector->getLastChangedRatio()});
+        }
+        return true;
+    } catch (const std::exception& e) {
+        logError("Error processing frame: ", e.what());
+        throw;
+    }
+}
+
+void SecurityCamera::setMotionCallback(std::function<void(const MotionEvent&)> callback) {
+    motionCallback = std::move(callback);
+}
+
+FrameSize SecurityCamera::getFrameSize() const {
+    return frameSizeForResolution(resolution);
+}
+
+uint64_t SecurityCamera::getMotionEventCount() const {
+    return motionEventCount;
+}
+
+void SecurityCamera::setRecordOnMotion(bool enabled) {
+    recordOnMotion = enabled;
+}
+
+// Pre-roll recording
+void SecurityCamera::configureRecordingBuffer(const RecordingBufferConfig& config) {
+    try {
+        recordingBuffer = std::make_unique<RecordingBuffer>(config);
+        recordingConfig = config;
+        recordingCursor = 0;
+        recordingEnd = 0;
+    } catch (const std::exception& e) {
+        logError("Error configuring recording buffer: ", e.what());
+        throw;
+    }
+}
+
+// frames are buffered whenever the camera is on so a recording can reach back
+void SecurityCamera::ingestEncodedFrame(const uint8_t* data, size_t size, uint64_t timestampMicros, bool keyFrame) {
+    if (!getIsOn()) {
+        return;
+    }
+    if (!recordingBuffer) {
+        recordingBuffer = std::make_unique<RecordingBuffer>(recordingConfig);
+    }
+    recordingBuffer->appendFrame(data, size, timestampMicros, keyFrame);
+}
+
+// hand off recorded frames as references into the buffer, the caller writes them out
+RecordingClip SecurityCamera::takeRecordedClip() {
+    if (!recordingBuffer) {
+        return RecordingClip();
+    }
+    uint64_t end = isRecording ? recordingBuffer->getNextSequence() : recordingEnd;
+    RecordingClip clip = recordingBuffer->extractRange(recordingCursor, end);
+    recordingCursor = std::max(recordingCursor, end);
+    return clip;
+}
+
+size_t SecurityCamera::getRecordingMemoryUsage() const {
+    return recordingBuffer ? recordingBuffer->getMemoryUsage() : 0;
+}
+
+size_t SecurityCamera::getMemoryUsage() const {
+    return sizeof(SecurityCamera) + stringMemoryUsage() + (motionDetector ? motionDetector->getMemoryUsage() : 0)
+         + getRecordingMemoryUsage();
 }
 
 // Getters
@@ -141,6 +370,10 @@ bool SecurityCamera::getIsRecording() const {
 }
 
 std::string SecurityCamera::getResolution() const {
+    return cameraResolutionName(resolution);
+}
+
+CameraResolution SecurityCamera::getCameraResolution() const {
     return resolution;
 }
 
@@ -158,7 +391,7 @@ SecurityCamera& SecurityCamera::operator+(int angle) {
         setRotation((angleRotation + angle) % 360);
         return *this;
     } catch (const std::exception& e) {
-        std::cerr << "Error rotating camera: " << e.what() << std::endl;
+        logError("Error rotating camera: ", e.what());
         return *this;
     }
 }
@@ -168,7 +401,7 @@ std::ostream& operator<<(std::ostream& os, const SecurityCamera& camera) {
         os << camera.getDeviceStatus();
         return os;
     } catch (const std::exception& e) {
-        std::cerr << "Error in stream output: " << e.what() << std::endl;
+        logError("Error in stream output: ", e.what());
         return os;
     }
 }
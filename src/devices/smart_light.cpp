@@ -1,44 +1,68 @@
 // includes
 #include "devices/smart_light.hpp"
+#include "core/logger.hpp"
+#include "core/tracing.hpp"
+#include <cmath>
 #include <stdexcept> // exception handling
 
+// brightness range shared by the setter and checkCommand
+static bool validBrightness(int level) {
+    return level >= 0 && level <= 100;
+}
+
+// a command's brightness, checked before it is cast: whole numbers only, false for NaN and infinity
+static bool validBrightnessArgument(float level) {
+    return std::isfinite(level) && level >= 0 && level <= 100 && std::trunc(level) == level;
+}
+
 // constructor
 SmartLight::SmartLight(
     const string& id, // unique identifier
     const string& name, // name of the device
-    const string& location) // location of the device
-try : Device(id, name, location), // call the Device constructor
+    const string& location, // location of the device
+    StringPool* pool) // interns the location
+try : Device(id, name, location, pool), // call the Device constructor
     brightness(0), // initialize brightness to 0
-    color("White") // initialize color to white
+    color() // initialize color to white
 {
     if (id.empty() || name.empty() || location.empty()) {
         throw invalid_argument("ID, name, and location cannot be empty");
     }
 } catch (const exception& e) {
-    cerr << "Error creating SmartLight: " << e.what() << endl;
+    logError("Error creating SmartLight: ", e.what());
     throw; // Re-throw the exception
 }
 
 // methods for controlling the light
 // turn the light on
 void SmartLight::turnOn() {
+    TraceSpan span("SmartLight::turnOn", "device", deviceID);
     try {
-        setIsOn(true); // set the status to on (true)
+        bool redrawn = getIsOn() && powerConsumption != 0.1; // already lit, only the draw changes
         setPowerConsumption(0.1); // set the power consumption to 0.1 W
+        setIsOn(true); // set the status to on (true), after the draw so observers see both
+        if (redrawn) {
+            notifyChange(DeviceChange::Brightness);
+        }
     } catch (const exception& e) {
-        cerr << "Error turning on light: " << e.what() << endl;
+        logError("Error turning on light: ", e.what());
         throw runtime_error("Failed to turn on light");
     }
 }
 
 // turn the light off
 void SmartLight::turnOff() { 
+    TraceSpan span("SmartLight::turnOff", "device", deviceID);
     try {
-        setIsOn(false); // set the status to off (false)
+        bool dimmed = !getIsOn() && brightness != 0; // brightness set while off, observers hear it reset
         brightness = 0; // set the brightness to 0
         setPowerConsumption(0.0); // set the power consumption to 0 W
+        setIsOn(false); // set the status to off (false), last so observers see the whole change
+        if (dimmed) {
+            notifyChange(DeviceChange::Brightness);
+        }
     } catch (const exception& e) {
-        cerr << "Error turning off light: " << e.what() << endl;
+        logError("Error turning off light: ", e.what());
         throw runtime_error("Failed to turn off light");
     }
 }
@@ -48,40 +72,46 @@ double SmartLight::getPowerUsage() const {
     try {
         return powerConsumption;
     } catch (const exception& e) {
-        cerr << "Error getting power usage: " << e.what() << endl;
+        logError("Error getting power usage: ", e.what());
         throw runtime_error("Failed to get power usage");
     }
 }
 
+// bytes of the light and its strings, the color is packed in place
+size_t SmartLight::getMemoryUsage() const {
+    return sizeof(SmartLight) + stringMemoryUsage();
+}
+
 // get the device status
 string SmartLight::getDeviceStatus() const {
     try {
-        return "Smart Light " + getDeviceID() + // get the device ID
-        " is " + (getIsOn() ? "on" : "off") + // check if the light is on or off
-        " with brightness " + to_string(brightness) + // get the brightness value
-        "%, " + "and color " + getColor(); // get the color
+        return formatStatus(getDeviceID(), getIsOn(), brightness, color);
     } catch (const exception& e) {
-        cerr << "Error getting device status: " << e.what() << endl;
+        logError("Error getting device status: ", e.what());
         throw runtime_error("Failed to get device status");
     }
 }
 
+// the status text of a light in the given state, also used for snapshot views
+string SmartLight::formatStatus(const string& id, bool on, int brightness, LightColor color) {
+    return "Smart Light " + id + // get the device ID
+    " is " + (on ? "on" : "off") + // check if the light is on or off
+    " with brightness " + to_string(brightness) + // get the brightness value
+    "%, " + "and color " + color.toString(); // get the color name
+}
+
 // set the brightness of the light device
 void SmartLight::setBrightness(int level) {
     try {
-        if (level < 0 || level > 100) {
-            throw invalid_argument("Brightness must be between 0 and 100");
+        DeviceResult result = trySetBrightness(level);
+        if (result != DeviceResult::Ok) {
+            throw invalid_argument(describeResult(result));
         }
-        brightness = level; // set the brightness to the given level
-        
-        // power consumption increases with brightness
-        double power = level * 0.001; 
-        setPowerConsumption(power);
     } catch (const invalid_argument& e) {
-        cerr << "Invalid brightness value: " << e.what() << endl;
+        logWarning("Invalid brightness value: ", e.what());
         throw;
     } catch (const exception& e) {
-        cerr << "Error setting brightness: " << e.what() << endl;
+        logError("Error setting brightness: ", e.what());
         throw runtime_error("Failed to set brightness");
     }
 }
@@ -92,32 +122,95 @@ void SmartLight::setColor(const string& newColor) {
         if (newColor.empty()) {
             throw invalid_argument("Color cannot be empty");
         }
-        color = newColor; // set the color to the given color
+        if (trySetColor(newColor) != DeviceResult::Ok) {
+            throw invalid_argument("Unknown color: " + newColor);
+        }
     } catch (const invalid_argument& e) {
-        cerr << "Invalid color value: " << e.what() << endl;
+        logWarning("Invalid color value: ", e.what());
         throw;
     } catch (const exception& e) {
-        cerr << "Error setting color: " << e.what() << endl;
+        logError("Error setting color: ", e.what());
         throw runtime_error("Failed to set color");
     }
 }
 
+// set the color of the light device from a packed value
+void SmartLight::setColor(LightColor newColor) {
+    color = newColor;
+    notifyChange(DeviceChange::Color);
+}
+
+// set the brightness without throwing
+DeviceResult SmartLight::trySetBrightness(int level) {
+    TraceSpan span("SmartLight::setBrightness", "device", deviceID);
+    if (!validBrightness(level)) {
+        return DeviceResult::InvalidBrightness;
+    }
+    brightness = level; // set the brightness to the given level
+
+    // power consumption increases with brightness
+    double power = level * 0.001;
+    setPowerConsumption(power);
+    notifyChange(DeviceChange::Brightness);
+    return DeviceResult::Ok;
+}
+
+// set the color without throwing
+DeviceResult SmartLight::trySetColor(const string& newColor) {
+    TraceSpan span("SmartLight::setColor", "device", deviceID);
+    LightColor parsed;
+    if (!LightColor::tryParse(newColor, parsed)) {
+        return DeviceResult::InvalidColor;
+    }
+    color = parsed; // packed color
+    notifyChange(DeviceChange::Color);
+    return DeviceResult::Ok;
+}
+
+// light commands, power is handled by Device
+DeviceResult SmartLight::applyCommand(const DeviceCommand& command) {
+    switch (command.type) {
+        case CommandType::SetBrightness:
+            if (!validBrightnessArgument(command.value)) {
+                return DeviceResult::InvalidBrightness;
+            }
+            return trySetBrightness(static_cast<int>(command.value));
+        case CommandType::SetColor:
+            return trySetColor(command.text);
+        default:
+            return Device::applyCommand(command);
+    }
+}
+
+// argument checks of the light commands
+DeviceResult SmartLight::checkCommand(const DeviceCommand& command) const {
+    LightColor parsed;
+    switch (command.type) {
+        case CommandType::SetBrightness:
+            return validBrightnessArgument(command.value) ? DeviceResult::Ok : DeviceResult::InvalidBrightness;
+        case CommandType::SetColor:
+            return LightColor::tryParse(command.text, parsed) ? DeviceResult::Ok : DeviceResult::InvalidColor;
+        default:
+            return Device::checkCommand(command);
+    }
+}
+
 // get the brightness of the light device
 int SmartLight::getBrightness() const {
     try {
         return brightness; // return the brightness value
     } catch (const exception& e) {
-        cerr << "Error getting brightness: " << e.what() << endl;
+        logError("Error getting brightness: ", e.what());
         throw runtime_error("Failed to get brightness");
     }
 }
 
 // get the color of the light device
-string SmartLight::getColor() const {
+LightColor SmartLight::getColor() const {
     try {
         return color; // return the color value
     } catch (const exception& e) {
-        cerr << "Error getting color: " << e.what() << endl;
+        logError("Error getting color: ", e.what());
         throw runtime_error("Failed to get color");
     }
 }
@@ -131,10 +224,10 @@ SmartLight& SmartLight::operator+(int brightnessIncrement) {
         setBrightness(brightness + brightnessIncrement);
         return *this;
     } catch (const invalid_argument& e) {
-        cerr << "Invalid brightness increment: " << e.what() << endl;
+        logWarning("Invalid brightness increment: ", e.what());
         throw;
     } catch (const exception& e) {
-        cerr << "Error in brightness increment: " << e.what() << endl;
+        logError("Error in brightness increment: ", e.what());
         throw runtime_error("Failed to increment brightness");
     }
 }
@@ -145,7 +238,7 @@ ostream& operator<<(ostream& os, const SmartLight& light) {
         os << light.getDeviceStatus();
         return os;
     } catch (const exception& e) {
-        cerr << "Error in stream output: " << e.what() << endl;
+        logError("Error in stream output: ", e.what());
         throw runtime_error("Failed to output device status");
     }
 }
@@ -1,34 +1,75 @@
 //includes
 #include "devices/thermostat.hpp"
 #include "controllers/energy_monitor.hpp"
+#include "core/tracing.hpp"
+#include <algorithm>
 #include <cmath>
 
+// power drawn by the heating/cooling plant at full output
+static const double actuatorPower = 50.0;
+
+// accepted temperatures and modes, shared by the setters and checkCommand
+static bool validTemperature(float temp) {
+    return temp >= 0 && temp <= 50; // between 0 and 50 degrees celsius, false for NaN
+}
+
+static bool validMode(const string& mode) {
+    ThermostatMode parsed;
+    return parseThermostatMode(mode, parsed);
+}
+
+static const char* const modeNames[] = {"auto", "heating", "cooling"};
+
+const char* thermostatModeName(ThermostatMode mode) {
+    return modeNames[static_cast<size_t>(mode)];
+}
+
+bool parseThermostatMode(const string& text, ThermostatMode& mode) {
+    for (size_t i = 0; i < sizeof(modeNames) / sizeof(modeNames[0]); ++i) {
+        if (text == modeNames[i]) {
+            mode = static_cast<ThermostatMode>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
 // constructor for thermostat class
-Thermostat::Thermostat(const string& id, const string& name, const string& location)
-: Device(id, name, location)
+Thermostat::Thermostat(const string& id, const string& name, const string& location, StringPool* pool)
+: Device(id, name, location, pool)
 , temperature(20.0) // default temperature is 20.0 degrees celsius
-, mode("auto") // default mode is auto
-, desiredTemperature(20.0){
+, mode(ThermostatMode::Auto) // default mode is auto
+, desiredTemperature(20.0)
+, controlOutput(0.0f) // nothing running until a control loop drives it
+, closedLoop(false){
     setIsOn(false); // default is off
 }
 
 // turn on the thermostat
 void Thermostat::turnOn() {
+    TraceSpan span("Thermostat::turnOn", "device", deviceID);
     setIsOn(true);
 
     // when device is on, record power consumption
-    EnergyMonitor::getInstance()->recordUsage(deviceID, getPowerUsage());
+    reportUsage(getPowerUsage());
 }
 
 // turn off the thermostat
 void Thermostat::turnOff() {
+    TraceSpan span("Thermostat::turnOff", "device", deviceID);
+    controlOutput = 0.0f;
     setIsOn(false);
 }
 
 // set the temperature of the thermostat
 double Thermostat::getPowerUsage() const {
     if (!getIsOn()) return 0.0;
-    
+
+    // under closed-loop control the draw follows the actual output
+    if (closedLoop) {
+        return 1.0 + fabs(controlOutput) * actuatorPower;
+    }
+
     // Base power consumption when on + additional usage based on temperature difference
     double basePower = 1.0; // Base power consumption when running
     double tempDiffPower = fabs(desiredTemperature - temperature) * 10.0;
@@ -39,25 +80,61 @@ double Thermostat::getPowerUsage() const {
 
 // get the status of the thermostat
 string Thermostat::getDeviceStatus() const {
-    return "Thermostat " + getDeviceID() + // get the device ID
-    " is " + (getIsOn() ? "on" : "off") + // check if the thermostat is on or off ?
+    return formatStatus(getDeviceID(), getIsOn(), temperature, desiredTemperature, mode, closedLoop, controlOutput);
+}
+
+// the status text of a thermostat in the given state, also used for snapshot views
+string Thermostat::formatStatus(const string& id, bool on, float temperature, float desiredTemperature,
+                                ThermostatMode mode, bool closedLoop, float controlOutput) {
+    return "Thermostat " + id + // get the device ID
+    " is " + (on ? "on" : "off") + // check if the thermostat is on or off ?
     " Current Temperature: " + to_string(temperature) + "C, " + // get the temperature value and convert it to string
     " Desired Temperature: " + to_string(desiredTemperature) + "C, " + // get the desired temperature value and
-    " Mode: " + mode + ")"; // get the mode of the thermostat
+    " Mode: " + thermostatModeName(mode) + // get the mode of the thermostat
+    (closedLoop ? ", Output: " + to_string(static_cast<int>(lround(controlOutput * 100))) + "%" : "") + ")"; // control output when closed loop
+}
+
+// bytes of the thermostat and its strings
+size_t Thermostat::getMemoryUsage() const {
+    return sizeof(Thermostat) + stringMemoryUsage();
 }
 
 // set the temperature of the thermostat
 void Thermostat::setTemperature(float temp) {
-    if (temp >= 0 && temp <= 50) { // check if the temperature is between 0 and 50 degrees celsius
-        temperature = temp; // set the temperature to the given value
+    (void)trySetTemperature(temp); // out of range values are ignored
+}
+
+// set the temperature, reporting out of range values
+DeviceResult Thermostat::trySetTemperature(float temp) {
+    TraceSpan span("Thermostat::setTemperature", "device", deviceID);
+    if (!validTemperature(temp)) {
+        return DeviceResult::InvalidTemperature;
     }
+    temperature = temp; // set the temperature to the given value
+    notifyChange(DeviceChange::Temperature);
+    return DeviceResult::Ok;
 }
 
 // set the mode of the thermostat
 void Thermostat::setMode(const string& newMode) {
-    if (newMode == "heating" || newMode == "cooling" || newMode == "auto") {
-        mode = newMode; // set the mode to the given value
+    (void)trySetMode(newMode); // unknown modes are ignored
+}
+
+// set the mode, reporting unknown modes
+DeviceResult Thermostat::trySetMode(const string& newMode) {
+    TraceSpan span("Thermostat::setMode", "device", deviceID);
+    ThermostatMode parsed;
+    if (!parseThermostatMode(newMode, parsed)) {
+        return DeviceResult::InvalidMode;
     }
+    setMode(parsed);
+    return DeviceResult::Ok;
+}
+
+// set the mode from its enum
+void Thermostat::setMode(ThermostatMode newMode) {
+    mode = newMode; // set the mode to the given value
+    notifyChange(DeviceChange::Mode);
 }
 
 // get the temperature of the thermostat
@@ -67,7 +144,12 @@ float Thermostat::getTemperature() const {
 
 // get mode of the thermostat
 string Thermostat::getMode() const {
-    return mode; // return the mode value
+    return thermostatModeName(mode); // return the mode name
+}
+
+// get mode of the thermostat as its enum
+ThermostatMode Thermostat::getThermostatMode() const {
+    return mode;
 }
 
 // get the desired temperature of the thermostat
@@ -77,7 +159,72 @@ float Thermostat::getDesiredTemperature() const {
 
 // set the desired temperature of the thermostat
 void Thermostat::setDesiredTemperature(float temp) {
-    if (temp >= 0 && temp <= 50) { // check if the temperature is between 0 and 50 degrees celsius
-        desiredTemperature = temp; // set the desired temperature to the given value
+    (void)trySetDesiredTemperature(temp); // out of range values are ignored
+}
+
+// set the desired temperature, reporting out of range values
+DeviceResult Thermostat::trySetDesiredTemperature(float temp) {
+    TraceSpan span("Thermostat::setDesiredTemperature", "device", deviceID);
+    if (!validTemperature(temp)) {
+        return DeviceResult::InvalidTemperature;
+    }
+    desiredTemperature = temp; // set the desired temperature to the given value
+    notifyChange(DeviceChange::DesiredTemperature);
+    return DeviceResult::Ok;
+}
+
+// thermostat commands, power is handled by Device
+DeviceResult Thermostat::applyCommand(const DeviceCommand& command) {
+    switch (command.type) {
+        case CommandType::SetTemperature:
+            return trySetTemperature(command.value);
+        case CommandType::SetDesiredTemperature:
+            return trySetDesiredTemperature(command.value);
+        case CommandType::SetMode:
+            return trySetMode(command.text);
+        default:
+            return Device::applyCommand(command);
+    }
+}
+
+// argument checks of the thermostat commands
+DeviceResult Thermostat::checkCommand(const DeviceCommand& command) const {
+    switch (command.type) {
+        case CommandType::SetTemperature:
+        case CommandType::SetDesiredTemperature:
+            return validTemperature(command.value) ? DeviceResult::Ok : DeviceResult::InvalidTemperature;
+        case CommandType::SetMode:
+            return validMode(command.text) ? DeviceResult::Ok : DeviceResult::InvalidMode;
+        default:
+            return Device::checkCommand(command);
     }
-}
\ No newline at end of file
+}
+
+// drive the output, heating mode cannot cool and cooling mode cannot heat
+void Thermostat::applyControlOutput(float output) {
+    float low = mode == ThermostatMode::Heating ? 0.0f : -1.0f;
+    float high = mode == ThermostatMode::Cooling ? 0.0f : 1.0f;
+    controlOutput = getIsOn() ? std::min(high, std::max(low, output)) : 0.0f;
+    closedLoop = true;
+}
+
+// stop closed-loop control
+void Thermostat::releaseControl() {
+    controlOutput = 0.0f;
+    closedLoop = false;
+}
+
+// measured temperature from the control loop, without notifying observers
+void Thermostat::updateTemperatureReading(float temp) {
+    temperature = std::min(50.0f, std::max(0.0f, temp));
+}
+
+// get the heating/cooling output
+float Thermostat::getControlOutput() const {
+    return controlOutput;
+}
+
+// is a control loop driving the output?
+bool Thermostat::isClosedLoop() const {
+    return closedLoop;
+}
@@ -0,0 +1,231 @@
+// includes
+#include "devices/video_frame.hpp"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+static const char* const resolutionNames[] = {"720p", "1080p", "4K"};
+static const FrameSize resolutionSizes[] = {FrameSize{1280, 720}, FrameSize{1920, 1080}, FrameSize{3840, 2160}};
+
+const char* cameraResolutionName(CameraResolution resolution) {
+    return resolutionNames[static_cast<std::size_t>(resolution)];
+}
+
+bool parseCameraResolution(const std::string& text, CameraResolution& resolution) {
+    for (std::size_t i = 0; i < sizeof(resolutionNames) / sizeof(resolutionNames[0]); ++i) {
+        if (text == resolutionNames[i]) {
+            resolution = static_cast<CameraResolution>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// frame size for each supported camera resolution
+FrameSize frameSizeForResolution(const std::string& resolution) {
+    CameraResolution parsed;
+    if (!parseCameraResolution(resolution, parsed)) {
+        throw std::invalid_argument("Invalid resolution. Use 720p, 1080p, or 4K");
+    }
+    return frameSizeForResolution(parsed);
+}
+
+FrameSize frameSizeForResolution(CameraResolution resolution) {
+    return resolutionSizes[static_cast<std::size_t>(resolution)];
+}
+
+// empty frame
+GrayFrame::GrayFrame()
+    : size{0, 0}
+    , frameNumber(0)
+{}
+
+// frame filled with a constant value
+GrayFrame::GrayFrame(FrameSize frameSize, std::uint8_t fill)
+    : size(frameSize)
+    , pixels(frameSize.pixelCount(), fill)
+    , frameNumber(0)
+{
+    if (frameSize.width <= 0 || frameSize.height <= 0) {
+        throw std::invalid_argument("Frame dimensions must be positive");
+    }
+}
+
+FrameSize GrayFrame::getSize() const {
+    return size;
+}
+
+std::uint64_t GrayFrame::getFrameNumber() const {
+    return frameNumber;
+}
+
+const std::uint8_t* GrayFrame::data() const {
+    return pixels.data();
+}
+
+std::uint8_t* GrayFrame::data() {
+    return pixels.data();
+}
+
+std::size_t GrayFrame::pixelCount() const {
+    return pixels.size();
+}
+
+void GrayFrame::setFrameNumber(std::uint64_t number) {
+    frameNumber = number;
+}
+
+// noise table is longer than a frame so each frame can start at a different offset
+static const std::size_t noiseWindow = 4096;
+
+// build the static scene and the noise table
+SyntheticFrameSource::SyntheticFrameSource(FrameSize frameSize, std::uint32_t seed)
+    : frame(frameSize)
+    , scene(frameSize.pixelCount())
+    , noise(frameSize.pixelCount() + noiseWindow)
+    , framesProduced(0)
+    , motion(false)
+{
+    // diagonal gradient between 16 and 223
+    for (int y = 0; y < frameSize.height; ++y) {
+        for (int x = 0; x < frameSize.width; ++x) {
+            int value = 16 + ((x + y) * 207) / (frameSize.width + frameSize.height);
+            scene[static_cast<std::size_t>(y) * static_cast<std::size_t>(frameSize.width) + static_cast<std::size_t>(x)] =
+                static_cast<std::uint8_t>(value);
+        }
+    }
+
+    // sensor noise in the range 0-7 from a linear congruential generator
+    std::uint32_t state = seed ? seed : 1;
+    for (auto& n : noise) {
+        state = state * 1664525u + 1013904223u;
+        n = static_cast<std::uint8_t>(state >> 29);
+    }
+}
+
+// render the next frame into the reused buffer
+const GrayFrame& SyntheticFrameSource::nextFrame() {
+    const std::size_t count = scene.size();
+    const std::size_t offset = (framesProduced * 977) % noiseWindow;
+    const std::uint8_t* src = scene.data();
+    const std::uint8_t* jitter = noise.data() + offset;
+    std::uint8_t* out = frame.data();
+    for (std::size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<std::uint8_t>(src[i] + jitter[i]);
+    }
+
+    // bright block sweeping left to right
+    if (motion) {
+        FrameSize size = frame.getSize();
+        int side = std::max(1, size.height / 4);
+        int travel = std::max(1, size.width - side);
+        int left = static_cast<int>((framesProduced * static_cast<std::uint64_t>(std::max(1, size.width / 32))) % static_cast<std::uint64_t>(travel));
+        int top = (size.height - side) / 2;
+        for (int y = top; y < top + side; ++y) {
+            std::uint8_t* row = out + static_cast<std::size_t>(y) * static_cast<std::size_t>(size.width);
+            std::fill(row + left, row + left + side, static_cast<std::uint8_t>(250));
+        }
+    }
+
+    frame.setFrameNumber(framesProduced++);
+    return frame;
+}
+
+FrameSize SyntheticFrameSource::getFrameSize() const {
+    return frame.getSize();
+}
+
+void SyntheticFrameSource::setMotion(bool enabled) {
+    motion = enabled;
+}
+
+bool SyntheticFrameSource::getMotion() const {
+    return motion;
+}
+
+// load every image so playback never touches the disk
+ImageFileFrameSource::ImageFileFrameSource(const std::vector<std::string>& paths)
+    : nextIndex(0)
+    , framesProduced(0)
+{
+    if (paths.empty()) {
+        throw std::invalid_argument("At least one image file is required");
+    }
+    frames.reserve(paths.size());
+    for (const auto& path : paths) {
+        frames.push_back(loadPgmFrame(path));
+        if (frames.back().getSize() != frames.front().getSize()) {
+            throw std::invalid_argument("All images must have the same dimensions: " + path);
+        }
+    }
+}
+
+// return the next image, wrapping around at the end of the list
+const GrayFrame& ImageFileFrameSource::nextFrame() {
+    GrayFrame& frame = frames[nextIndex];
+    frame.setFrameNumber(framesProduced++);
+    nextIndex = (nextIndex + 1) % frames.size();
+    return frame;
+}
+
+FrameSize ImageFileFrameSource::getFrameSize() const {
+    return frames.front().getSize();
+}
+
+// skip whitespace and comment lines in a PGM header
+static void skipPgmSeparators(std::istream& in) {
+    while (true) {
+        int c = in.peek();
+        if (c == '#') {
+            in.ignore(1 << 20, '\n');
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            in.get();
+        } else {
+            return;
+        }
+    }
+}
+
+// read a binary 8-bit PGM image
+GrayFrame loadPgmFrame(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open image file: " + path);
+    }
+
+    std::string magic;
+    in >> magic;
+    if (magic != "P5") {
+        throw std::runtime_error("Unsupported image format (expected binary PGM): " + path);
+    }
+
+    int width = 0, height = 0, maxValue = 0;
+    skipPgmSeparators(in);
+    in >> width;
+    skipPgmSeparators(in);
+    in >> height;
+    skipPgmSeparators(in);
+    in >> maxValue;
+    in.get(); // single whitespace before pixel data
+    if (!in || width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 255) {
+        throw std::runtime_error("Invalid PGM header: " + path);
+    }
+
+    GrayFrame frame(FrameSize{width, height});
+    in.read(reinterpret_cast<char*>(frame.data()), static_cast<std::streamsize>(frame.pixelCount()));
+    if (in.gcount() != static_cast<std::streamsize>(frame.pixelCount())) {
+        throw std::runtime_error("Truncated PGM pixel data: " + path);
+    }
+    return frame;
+}
+
+// write a binary 8-bit PGM image
+void savePgmFrame(const GrayFrame& frame, const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Cannot create image file: " + path);
+    }
+    FrameSize size = frame.getSize();
+    out << "P5\n" << size.width << " " << size.height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(frame.data()), static_cast<std::streamsize>(frame.pixelCount()));
+}
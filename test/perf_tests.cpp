@@ -0,0 +1,199 @@
+// performance regression tier: key operations on a home of a million devices, checked against
+// recorded throughput baselines
+//
+// usage: perf_tests [--devices n] [--baselines file] [--record file]
+//
+// Each case reports operations per second, the best of three runs except the one-off population.
+// A case fails when it is slower than its baseline times SMART_HOME_PERF_SCALE (default 1), so a
+// slower machine can scale every baseline down instead of editing the file. --record writes half
+// of the measured throughput as the new baselines, leaving room for noisy runs.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "controllers/energy_monitor.hpp"
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "controllers/room_controller.hpp"
+#include "core/logger.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// one measured case
+struct PerfResult {
+    std::string name;
+    double opsPerSecond;
+};
+
+// operations per second of one run of body, which performs operations operations
+static double throughput(std::size_t operations, const std::function<void()>& body) {
+    auto start = Clock::now();
+    body();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return operations / std::max(seconds, 1e-9);
+}
+
+// best of several runs, noise only ever makes a run slower
+static double bestThroughput(std::size_t operations, const std::function<void()>& body, int runs = 3) {
+    double best = 0.0;
+    for (int run = 0; run < runs; ++run) {
+        best = std::max(best, throughput(operations, body));
+    }
+    return best;
+}
+
+// "name ops_per_second" lines, # starts a comment
+static std::map<std::string, double> loadBaselines(const std::string& path) {
+    std::map<std::string, double> baselines;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string name;
+        double opsPerSecond = 0.0;
+        if (fields >> name >> opsPerSecond) {
+            baselines[name] = opsPerSecond;
+        }
+    }
+    return baselines;
+}
+
+static bool recordBaselines(const std::string& path, const std::vector<PerfResult>& results, std::size_t deviceCount) {
+    std::ofstream file(path);
+    file << "# minimum operations per second for perf_tests, " << deviceCount << " devices\n"
+         << "# half of a measured Release run, regenerate with: perf_tests --record <this file>\n";
+    for (const auto& result : results) {
+        file << result.name << " " << static_cast<long long>(result.opsPerSecond / 2.0) << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t deviceCount = 1000000;
+    std::string baselinePath;
+    std::string recordPath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--devices") {
+            deviceCount = static_cast<std::size_t>(std::atoll(argv[i + 1]));
+        } else if (flag == "--baselines") {
+            baselinePath = argv[i + 1];
+        } else if (flag == "--record") {
+            recordPath = argv[i + 1];
+        }
+    }
+    double scale = 1.0;
+    if (const char* scaleText = std::getenv("SMART_HOME_PERF_SCALE")) {
+        scale = std::atof(scaleText);
+    }
+    Logger::getInstance()->setLevel(LogLevel::Warning);
+    std::vector<PerfResult> results;
+
+    // the home: 80% lights, 10% thermostats, 10% cameras in a thousand rooms
+    HomeSpec spec;
+    spec.lights = deviceCount * 8 / 10;
+    spec.thermostats = deviceCount / 10;
+    spec.cameras = deviceCount - spec.lights - spec.thermostats;
+    spec.rooms = std::max<std::size_t>(1, deviceCount / 1000);
+    spec.zones = 10;
+    GeneratedHome home;
+    HomeController* controller = HomeController::getInstance();
+    results.push_back({"home.populate", throughput(deviceCount, [&] {
+        home = generateHome(spec);
+        populateHome(*controller, home);
+    })});
+
+    std::vector<std::string> ids;
+    for (std::size_t i = 0; i < deviceCount; ++i) {
+        ids.push_back(home.devices[(i * 7919) % deviceCount]->getDeviceID());
+    }
+    results.push_back({"home.findDevice", bestThroughput(deviceCount, [&] {
+        std::size_t found = 0;
+        for (const auto& id : ids) found += controller->findDevice(id) ? 1 : 0;
+        if (found != deviceCount) std::abort();
+    })});
+
+    CommandStream commands = generateCommands(home, CommandMix(), deviceCount, 42);
+    results.push_back({"home.applyCommand", bestThroughput(commands.size(), [&] {
+        for (const auto& command : commands) (void)controller->applyCommand(command.first, command.second);
+    })});
+    std::vector<DeviceResult> commandResults;
+    results.push_back({"home.applyCommands", bestThroughput(commands.size(), [&] {
+        controller->applyCommands(commands, commandResults);
+    })});
+
+    results.push_back({"device.getDeviceStatus", bestThroughput(deviceCount, [&] {
+        std::size_t length = 0;
+        for (const auto& device : home.devices) length += device->getDeviceStatus().size();
+        if (length == 0) std::abort();
+    })});
+
+    // the generated rooms, switched off and on as a whole
+    std::vector<std::unique_ptr<RoomController>> rooms;
+    for (const auto& name : home.rooms) {
+        rooms.push_back(std::make_unique<RoomController>(name));
+    }
+    for (std::size_t i = 0; i < deviceCount; ++i) {
+        rooms[home.deviceRoom[i]]->addDevice(home.devices[i]);
+    }
+    results.push_back({"room.turnAllDevicesOnOff", bestThroughput(deviceCount * 2, [&] {
+        for (auto& room : rooms) room->turnAllDevicesOff();
+        for (auto& room : rooms) room->turnAllDevicesOn();
+    })});
+
+    EnergyMonitor* monitor = EnergyMonitor::getInstance();
+    std::vector<std::pair<std::string, double>> readings;
+    for (const auto& device : home.devices) {
+        readings.emplace_back(device->getDeviceID(), device->getPowerUsage());
+    }
+    results.push_back({"energy.recordUsageBatch", bestThroughput(deviceCount, [&] {
+        monitor->recordUsageBatch(readings);
+    })});
+    results.push_back({"energy.getTotalSystemUsage", bestThroughput(deviceCount, [&] {
+        if (monitor->getTotalSystemUsage() < 0.0) std::abort();
+    })});
+
+    // report and compare
+    std::map<std::string, double> baselines;
+    if (!baselinePath.empty()) {
+        baselines = loadBaselines(baselinePath);
+    }
+    int failures = 0;
+    std::cout << "=== perf tier, " << deviceCount << " devices, ops/s ===\n"
+              << std::left << std::setw(30) << "case" << std::right << std::setw(14) << "measured" << std::setw(14)
+              << "baseline" << "\n";
+    for (const auto& result : results) {
+        auto baseline = baselines.find(result.name);
+        std::cout << std::left << std::setw(30) << result.name << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(14) << result.opsPerSecond;
+        if (baseline == baselines.end()) {
+            std::cout << std::setw(14) << "-" << "\n";
+            continue;
+        }
+        double minimum = baseline->second * scale;
+        bool passed = result.opsPerSecond >= minimum;
+        failures += passed ? 0 : 1;
+        std::cout << std::setw(14) << minimum << (passed ? "  ok" : "  REGRESSION") << "\n";
+    }
+    if (!recordPath.empty()) {
+        if (!recordBaselines(recordPath, results, deviceCount)) {
+            std::cerr << "Cannot write " << recordPath << "\n";
+            return 1;
+        }
+        std::cout << "baselines written to " << recordPath << "\n";
+    }
+    std::cout << failures << " regressions\n";
+    return failures == 0 ? 0 : 1;
+}
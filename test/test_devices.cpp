@@ -3,6 +3,18 @@
 #include "devices/device.hpp"
 #include "devices/smart_light.hpp"
 #include "devices/thermostat.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/video_frame.hpp"
+#include "devices/recording_buffer.hpp"
+#include "controllers/scheduler.hpp"
+#include "controllers/automation_engine.hpp"
+#include "controllers/thermostat_control.hpp"
+#include "controllers/home_generator.hpp"
+#include "core/metrics.hpp"
+#include "core/tracing.hpp"
+#include <sstream>
+#include <chrono>
+#include <thread>
 
 // define a function for separating output
 void printSeparator() { 
@@ -65,6 +77,304 @@ void testThermostat() {
 }
 
 
+// test the SecurityCamera motion pipeline
+void testMotionDetection() {
+    SecurityCamera frontCamera("C01", "Front Door Camera", "Front Door");
+
+    // print camera header
+    printSectionHeader("SECURITY CAMERA MOTION DETECTION TEST");
+    frontCamera.setResolution("720p");
+    frontCamera.turnOn();
+    frontCamera.enableMotionDetection();
+
+    // count motion events reported through the callback
+    int events = 0;
+    frontCamera.setMotionCallback([&events](const MotionEvent&) { ++events; });
+
+    // still scene should not trigger motion
+    SyntheticFrameSource source(frontCamera.getFrameSize());
+    for (int i = 0; i < 10; ++i) {
+        frontCamera.processFrame(source.nextFrame());
+    }
+    cout << "\n[MOTION] Events on still scene: " << events << " (expected 0)\n";
+
+    // moving block should trigger motion
+    source.setMotion(true);
+    for (int i = 0; i < 10; ++i) {
+        frontCamera.processFrame(source.nextFrame());
+    }
+    cout << "[MOTION] Events with moving object: " << events << " (expected > 0)\n"
+    << "  Status: " << frontCamera.getDeviceStatus() << "\n";
+}
+// test the SecurityCamera pre-roll recording buffer
+void testPreRollRecording() {
+    SecurityCamera garageCamera("C02", "Garage Camera", "Garage");
+
+    // print recording header
+    printSectionHeader("SECURITY CAMERA PRE-ROLL RECORDING TEST");
+    RecordingBufferConfig config;
+    config.capacityBytes = 4u << 20; // 4 MiB ring
+    config.preRollMicros = 2000000; // 2 second pre-roll
+    garageCamera.setResolution("720p");
+    garageCamera.configureRecordingBuffer(config);
+    garageCamera.turnOn();
+
+    // buffer ten seconds of video before recording starts
+    SyntheticVideoEncoder encoder(garageCamera.getFrameSize());
+    for (int i = 0; i < 300; ++i) {
+        size_t size = encoder.encodeNext();
+        garageCamera.ingestEncodedFrame(encoder.data(), size, encoder.getTimestampMicros(), encoder.isKeyFrame());
+    }
+    garageCamera.startRecording();
+    RecordingClip clip = garageCamera.takeRecordedClip();
+    cout << "\n[RECORD] Pre-roll frames: " << clip.frameCount << " (expected 90, from the key frame before the 2s cutoff)\n"
+    << "  Segments: " << clip.segments.size() << ", Bytes: " << clip.byteCount << "\n"
+    << "  Buffer memory: " << garageCamera.getRecordingMemoryUsage() << " bytes (limit " << config.capacityBytes << ")\n";
+
+    // frames after the recording started are handed off next
+    for (int i = 0; i < 30; ++i) {
+        size_t size = encoder.encodeNext();
+        garageCamera.ingestEncodedFrame(encoder.data(), size, encoder.getTimestampMicros(), encoder.isKeyFrame());
+    }
+    garageCamera.stopRecording();
+    cout << "[RECORD] Frames after start: " << garageCamera.takeRecordedClip().frameCount << " (expected 30)\n";
+}
+// test scheduled fades and delayed commands
+void testScheduler() {
+    auto hallLight = make_shared<SmartLight>("003", "Hall Light", "Hall");
+    Scheduler scheduler;
+
+    // print scheduler header
+    printSectionHeader("SCHEDULER TEST");
+    hallLight->turnOn();
+
+    // fade from 0% to 80% over 2 seconds
+    scheduler.fadeBrightness(hallLight, 80, 2000);
+    scheduler.advanceBy(1000);
+    cout << "\n[FADE] Brightness after 1s: " << hallLight->getBrightness() << "% (expected 40%)\n";
+    scheduler.advanceBy(1000);
+    cout << "[FADE] Brightness after 2s: " << hallLight->getBrightness() << "% (expected 80%)\n";
+
+    // turn off after 10 minutes
+    scheduler.turnOffAfter(hallLight, 10 * 60 * 1000);
+    scheduler.advanceBy(10 * 60 * 1000 - 1);
+    cout << "[DELAY] On just before 10 minutes: " << (hallLight->getIsOn() ? "yes" : "no") << " (expected yes)\n";
+    scheduler.advanceBy(1);
+    cout << "[DELAY] On at 10 minutes: " << (hallLight->getIsOn() ? "yes" : "no") << " (expected no)\n"
+    << "  Pending timers: " << scheduler.getPendingCount() << "\n";
+}
+
+// test closed-loop thermostat control against the simulated room
+void testThermostatControl() {
+    auto study = make_shared<Thermostat>("W04", "Study Thermostat", "Study");
+    auto den = make_shared<Thermostat>("W05", "Den Thermostat", "Den");
+    ControlLoopConfig config;
+    config.energyReportTicks = 60;
+    ThermostatControlLoop pid(config);
+    config.strategy = ControlStrategy::Hysteresis;
+    ThermostatControlLoop relay(config);
+
+    // print control loop header
+    printSectionHeader("THERMOSTAT CONTROL TEST");
+    for (auto& thermostat : {study, den}) {
+        thermostat->turnOn();
+        thermostat->setMode("heating");
+        thermostat->setDesiredTemperature(22);
+    }
+    pid.addThermostat(study);
+    relay.addThermostat(den);
+
+    // an hour of one-second control steps
+    for (int second = 0; second < 3600; ++second) {
+        pid.runTick(1.0f);
+        relay.runTick(1.0f);
+    }
+    cout << "\n[PID] Temperature after 1h: " << fixed << setprecision(1) << study->getTemperature()
+    << "C (expected 22.0C)\n"
+    << "  Holding output: " << study->getControlOutput() * 100 << "%, power " << study->getPowerUsage() << " W\n";
+    cout << "[RELAY] Temperature after 1h: " << den->getTemperature() << "C (expected within 21.5-22.5C)\n";
+
+    // heating mode never cools
+    study->setDesiredTemperature(18);
+    pid.runTick(1.0f);
+    cout << "[MODE] Output above setpoint in heating mode: " << study->getControlOutput() * 100 << "% (expected 0.0%)\n";
+
+    // the worker runs ticks on its own
+    config.periodMillis = 5;
+    pid.setConfig(config);
+    pid.resetStats();
+    pid.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    pid.stop();
+    cout << "[WORKER] Ticks in 100ms at 5ms: " << (pid.getStats().ticks > 0 ? "some" : "none") << " (expected some)\n";
+}
+
+// test the status-code command API
+void testCommandResults() {
+    SmartLight deskLight("005", "Desk Light", "Study");
+    SecurityCamera yardCamera("CAM3", "Yard Camera", "Yard");
+
+    // print command header
+    printSectionHeader("COMMAND RESULT TEST");
+    DeviceResult result = deskLight.trySetBrightness(150);
+    cout << "\n[RESULT] Brightness 150: " << describeResult(result) << " (expected range error)\n"
+    << "  Brightness unchanged: " << deskLight.getBrightness() << "% (expected 0%)\n";
+    result = deskLight.applyCommand(DeviceCommand{CommandType::SetColor, 0.0f, "Teal"});
+    cout << "[RESULT] Set color Teal: " << describeResult(result) << ", color " << deskLight.getColor() << " (expected OK, Teal)\n";
+    result = deskLight.applyCommand(DeviceCommand{CommandType::SetRotation, 90.0f, ""});
+    cout << "[RESULT] Rotate a light: " << describeResult(result) << " (expected not supported)\n";
+    result = yardCamera.tryStartRecording();
+    cout << "[RESULT] Record while off: " << describeResult(result) << " (expected device must be on)\n";
+}
+
+// test synthetic homes and command streams
+void testHomeGenerator() {
+    HomeSpec spec;
+    spec.lights = 12;
+    spec.thermostats = 3;
+    spec.cameras = 3;
+    spec.rooms = 6;
+    spec.zones = 2;
+    GeneratedHome home = generateHome(spec);
+
+    // print generator header
+    printSectionHeader("HOME GENERATOR TEST");
+    cout << "\n[HOME] Devices: " << home.devices.size() << " in " << home.rooms.size() << " rooms (expected 18 in 6)\n"
+    << "  Last room: " << home.rooms.back() << " (expected Zone 2 Room 3)\n";
+
+    CommandMix lightsOnly;
+    lightsOnly.toggles = 0.0;
+    lightsOnly.setpoints = 0.0;
+    lightsOnly.recording = 0.0;
+    CommandStream first = generateCommands(home, lightsOnly, 200, 7);
+    CommandStream again = generateCommands(home, lightsOnly, 200, 7);
+    size_t brightness = 0;
+    bool same = first.size() == again.size();
+    for (size_t i = 0; i < first.size(); ++i) {
+        brightness += first[i].second.type == CommandType::SetBrightness && first[i].first[0] == 'L' ? 1 : 0;
+        same = same && first[i].first == again[i].first && first[i].second.value == again[i].second.value;
+    }
+    cout << "[COMMANDS] Brightness commands on lights: " << brightness << " of " << first.size() << " (expected 200 of 200)\n"
+    << "  Same seed, same stream: " << (same ? "yes" : "no") << " (expected yes)\n";
+}
+
+// test counters, histograms and the Prometheus dump
+void testMetrics() {
+    MetricsRegistry* registry = MetricsRegistry::getInstance();
+    Counter changes = registry->counter("smart_home_device_changes_total", "", "change=\"brightness\"");
+    uint64_t before = registry->read(changes);
+    SmartLight hallLight("006", "Hall Light", "Hall");
+    hallLight.turnOn();
+    hallLight.setBrightness(30);
+    hallLight.setBrightness(60);
+
+    // print metrics header
+    printSectionHeader("METRICS TEST");
+    cout << "\n[COUNTER] Brightness changes: " << registry->read(changes) - before << " (expected 2)\n";
+
+    Histogram latency = registry->histogram("test_latency_seconds", "Test latencies");
+    for (uint64_t nanos = 1; nanos <= 1000; ++nanos) {
+        latency.record(nanos * 1000);
+    }
+    HistogramSnapshot snapshot = registry->read(latency);
+    cout << "[HISTOGRAM] Samples: " << snapshot.count << " (expected 1000)\n"
+    << "  p50: " << static_cast<int>(snapshot.percentile(0.5) / 1000) << " us (expected about 500)\n"
+    << "  p99: " << static_cast<int>(snapshot.percentile(0.99) / 1000) << " us (expected about 990)\n";
+
+    std::ostringstream dump;
+    registry->writePrometheus(dump);
+    string text = dump.str();
+    cout << "[PROMETHEUS] Has change counter: "
+    << (text.find("smart_home_device_changes_total{change=\"brightness\"}") != string::npos ? "yes" : "no") << " (expected yes)\n"
+    << "  Has histogram count: " << (text.find("test_latency_seconds_count 1000") != string::npos ? "yes" : "no") << " (expected yes)\n";
+}
+
+// test tracing spans and the Chrome trace output
+void testTracing() {
+    SmartLight stairLight("007", "Stair Light", "Stairs");
+    Tracer* tracer = Tracer::getInstance();
+
+    // print tracing header
+    printSectionHeader("TRACING TEST");
+    stairLight.turnOn();
+    cout << "\n[TRACE] Events while off: " << tracer->getEventCount() << " (expected 0)\n";
+    tracer->start();
+    stairLight.setBrightness(70);
+    tracer->stop();
+    stairLight.setBrightness(20);
+    cout << "[TRACE] Events recorded: " << (tracer->getEventCount() >= 2 ? "2 or more" : "fewer than 2")
+    << " (expected 2 or more, the setter and its energy reading)\n";
+
+    std::ostringstream json;
+    tracer->writeChromeTrace(json);
+    string text = json.str();
+    cout << "[TRACE] Has setter span: " << (text.find("\"name\": \"SmartLight::setBrightness\"") != string::npos ? "yes" : "no")
+    << " (expected yes)\n"
+    << "  Device ID recorded: " << (text.find("\"detail\": \"007\"") != string::npos ? "yes" : "no") << " (expected yes)\n";
+    tracer->clear();
+}
+
+// passes device changes straight to an automation engine
+struct AutomationFeed : DeviceObserver {
+    AutomationEngine& engine;
+    explicit AutomationFeed(AutomationEngine& e) : engine(e) {}
+    void onDeviceChanged(Device& device, DeviceChange change) override {
+        engine.onDeviceChanged(device, change);
+    }
+};
+
+// test rules triggered by motion, temperature and time
+void testAutomation() {
+    auto porchCamera = make_shared<SecurityCamera>("CAM2", "Porch Camera", "Porch");
+    auto porchLight = make_shared<SmartLight>("004", "Porch Light", "Porch");
+    auto lounge = make_shared<Thermostat>("W03", "Lounge Thermostat", "Lounge");
+    AutomationEngine engine;
+    AutomationFeed feed(engine);
+
+    // print automation header
+    printSectionHeader("AUTOMATION TEST");
+    for (const shared_ptr<Device>& device : {shared_ptr<Device>(porchCamera), shared_ptr<Device>(porchLight), shared_ptr<Device>(lounge)}) {
+        engine.registerDevice(device);
+        device->setObserver(&feed);
+    }
+    engine.addDeviceToRoom("Porch", "004");
+    engine.addRule("when motion on CAM2 and after sunset, set Porch lights to 40% and start recording on CAM2");
+    engine.addRule("when temperature on W03 above 24 then set W03 temperature to 20");
+    engine.addRule("when at 23:00, turn off Porch");
+    cout << "\n[RULES] Loaded: " << engine.getRuleCount() << " (expected 3)\n";
+
+    // motion in daylight does nothing, after sunset the porch lights come on
+    FrameSize size = porchCamera->getFrameSize();
+    SyntheticFrameSource source(size, 11);
+    porchCamera->turnOn();
+    porchCamera->enableMotionDetection();
+    engine.setTimeOfDay(12 * 60);
+    porchCamera->processFrame(source.nextFrame());
+    source.setMotion(true);
+    porchCamera->processFrame(source.nextFrame());
+    cout << "[MOTION] Light at noon: " << (porchLight->getIsOn() ? "on" : "off") << " (expected off)\n";
+    engine.setTimeOfDay(21 * 60);
+    porchCamera->processFrame(source.nextFrame());
+    cout << "[MOTION] Light after sunset: " << porchLight->getBrightness() << "% (expected 40%)\n"
+    << "  Recording: " << (porchCamera->getIsRecording() ? "yes" : "no") << " (expected yes)\n";
+
+    // only crossing the threshold fires the rule
+    lounge->setTemperature(22);
+    lounge->setTemperature(26);
+    cout << "[TEMP] Setpoint after crossing 24C: " << lounge->getDesiredTemperature() << "C (expected 20C)\n";
+
+    // the 23:00 rule turns the porch off
+    engine.setTimeOfDay(23 * 60 + 5);
+    cout << "[TIME] Light after 23:00: " << (porchLight->getIsOn() ? "on" : "off") << " (expected off)\n"
+    << "  Rules fired: " << engine.getRulesFired() << " (expected 3)\n";
+
+    // bad rules are rejected with a reason
+    try {
+        engine.addRule("when motion on CAM2, dim the lights");
+    } catch (const invalid_argument& e) {
+        cout << "[PARSE] " << e.what() << "\n";
+    }
+}
 
 int main() {
     // create a smart light device
@@ -115,6 +425,42 @@ int main() {
     testThermostat();
     printSeparator();
 
+    // test camera motion detection
+    testMotionDetection();
+    printSeparator();
+
+    // test camera pre-roll recording
+    testPreRollRecording();
+    printSeparator();
+
+    // test scheduler
+    testScheduler();
+    printSeparator();
+
+    // test automation rules
+    testAutomation();
+    printSeparator();
+
+    // test status-code commands
+    testCommandResults();
+    printSeparator();
+
+    // test closed-loop thermostat control
+    testThermostatControl();
+    printSeparator();
+
+    // test synthetic home generation
+    testHomeGenerator();
+    printSeparator();
+
+    // test metrics
+    testMetrics();
+    printSeparator();
+
+    // test tracing
+    testTracing();
+    printSeparator();
+
     // complete
     printSectionHeader("TEST COMPLETE");
     printSeparator();
@@ -0,0 +1,124 @@
+#ifndef test_harness_hpp
+#define test_harness_hpp
+
+// includes
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// a minimal assertion harness: TEST_CASE registers a function, CHECK records a failure and goes on,
+// REQUIRE stops the test case. runTests() returns non-zero when anything failed, for CTest.
+
+// one registered test
+struct TestCase {
+    const char* name;
+    void (*body)();
+};
+
+// thrown by REQUIRE to leave the current test case
+struct TestAbort {};
+
+inline std::vector<TestCase>& testRegistry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+inline int& testFailures() {
+    static int failures = 0; // in the running test case
+    return failures;
+}
+
+// adds a test at static initialisation
+struct TestRegistrar {
+    TestRegistrar(const char* name, void (*body)()) { testRegistry().push_back(TestCase{name, body}); }
+};
+
+inline void reportFailure(const char* file, int line, const std::string& message) {
+    ++testFailures();
+    std::cout << "  " << file << ":" << line << ": " << message << "\n";
+}
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static TestRegistrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(expression) \
+    do { \
+        if (!(expression)) reportFailure(__FILE__, __LINE__, "CHECK(" #expression ") failed"); \
+    } while (0)
+
+#define REQUIRE(expression) \
+    do { \
+        if (!(expression)) { \
+            reportFailure(__FILE__, __LINE__, "REQUIRE(" #expression ") failed"); \
+            throw TestAbort(); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        auto actualValue = (actual); \
+        auto expectedValue = (expected); \
+        if (!(actualValue == expectedValue)) { \
+            std::ostringstream message; \
+            message << "CHECK_EQ(" #actual ", " #expected ") failed: " << actualValue << " != " << expectedValue; \
+            reportFailure(__FILE__, __LINE__, message.str()); \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        double actualValue = static_cast<double>(actual); \
+        double expectedValue = static_cast<double>(expected); \
+        if (!(std::fabs(actualValue - expectedValue) <= (tolerance))) { \
+            std::ostringstream message; \
+            message << "CHECK_NEAR(" #actual ", " #expected ") failed: " << actualValue << " vs " << expectedValue; \
+            reportFailure(__FILE__, __LINE__, message.str()); \
+        } \
+    } while (0)
+
+#define CHECK_THROWS(expression, ExceptionType) \
+    do { \
+        bool thrown = false; \
+        try { \
+            (void)(expression); \
+        } catch (const ExceptionType&) { \
+            thrown = true; \
+        } catch (...) { \
+        } \
+        if (!thrown) reportFailure(__FILE__, __LINE__, "CHECK_THROWS(" #expression ", " #ExceptionType ") failed"); \
+    } while (0)
+
+// runs every test whose name starts with one of the arguments, or all of them without arguments
+inline int runTests(int argc, char* argv[]) {
+    int failedTests = 0;
+    int ranTests = 0;
+    for (const TestCase& test : testRegistry()) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; ++i) {
+            selected = std::strncmp(test.name, argv[i], std::strlen(argv[i])) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        ++ranTests;
+        testFailures() = 0;
+        try {
+            test.body();
+        } catch (const TestAbort&) {
+        } catch (const std::exception& e) {
+            reportFailure(__FILE__, __LINE__, std::string("unexpected exception: ") + e.what());
+        }
+        std::cout << (testFailures() == 0 ? "[PASS] " : "[FAIL] ") << test.name << "\n";
+        failedTests += testFailures() == 0 ? 0 : 1;
+    }
+    std::cout << ranTests - failedTests << " of " << ranTests << " tests passed\n";
+    return failedTests == 0 && ranTests > 0 ? 0 : 1;
+}
+
+#endif // test_harness_hpp
@@ -0,0 +1,2268 @@
+// assertion tests for the devices, controllers and core services
+//
+// usage: unit_tests [prefix...]   runs the tests whose names start with a prefix, e.g. "light_"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "test_harness.hpp"
+#include "controllers/automation_engine.hpp"
+#include "controllers/command_server.hpp"
+#include "controllers/device_query.hpp"
+#include "controllers/energy_monitor.hpp"
+#include "controllers/home_controller.hpp"
+#include "controllers/home_generator.hpp"
+#include "controllers/home_host.hpp"
+#include "controllers/home_layout.hpp"
+#include "controllers/home_simulation.hpp"
+#include "controllers/room_controller.hpp"
+#include "controllers/scheduler.hpp"
+#include "controllers/thermostat_control.hpp"
+#include "core/clock.hpp"
+#include "core/epoch.hpp"
+#include "core/logger.hpp"
+#include "core/message_broker.hpp"
+#include "core/metrics.hpp"
+#include "core/task.hpp"
+#include "core/thread_pool.hpp"
+#include "core/tracing.hpp"
+#include "devices/async_device.hpp"
+#include "devices/command_queue.hpp"
+#include "devices/device_telemetry.hpp"
+#include "devices/light_color.hpp"
+#include "devices/motion_detector.hpp"
+#include "devices/recording_buffer.hpp"
+#include "devices/security_camera.hpp"
+#include "devices/smart_light.hpp"
+#include "devices/thermostat.hpp"
+
+// forwards device changes to an automation engine, as the home controller does
+class EngineFeed : public DeviceObserver {
+    private:
+        AutomationEngine& engine;
+
+    public:
+        explicit EngineFeed(AutomationEngine& target) : engine(target) {}
+        void onDeviceChanged(Device& device, DeviceChange change) override { engine.onDeviceChanged(device, change); }
+};
+
+// forwards device changes to a query index, as the home controller does
+class IndexFeed : public DeviceObserver {
+    private:
+        DeviceIndex& index;
+
+    public:
+        explicit IndexFeed(DeviceIndex& target) : index(target) {}
+        void onDeviceChanged(Device& device, DeviceChange change) override { index.onDeviceChanged(device, change); }
+};
+
+// counts the changes a device reports
+class ChangeCounter : public DeviceObserver {
+    public:
+        std::vector<DeviceChange> changes;
+        void onDeviceChanged(Device&, DeviceChange change) override { changes.push_back(change); }
+};
+
+// smart light
+
+TEST_CASE(light_power_follows_state) {
+    SmartLight light("UL1", "Desk Light", "Study");
+    CHECK(!light.getIsOn());
+    CHECK_EQ(light.getBrightness(), 0);
+    light.turnOn();
+    CHECK(light.getIsOn());
+    CHECK_NEAR(light.getPowerUsage(), 0.1, 1e-9);
+    light.setBrightness(80);
+    CHECK_NEAR(light.getPowerUsage(), 0.08, 1e-9);
+    light.turnOff();
+    CHECK(!light.getIsOn());
+    CHECK_EQ(light.getBrightness(), 0);
+    CHECK_NEAR(light.getPowerUsage(), 0.0, 1e-9);
+}
+
+TEST_CASE(light_rejects_bad_brightness) {
+    SmartLight light("UL2", "Desk Light", "Study");
+    light.setBrightness(40);
+    CHECK_THROWS(light.setBrightness(101), std::invalid_argument);
+    CHECK_THROWS(light.setBrightness(-1), std::invalid_argument);
+    CHECK(light.trySetBrightness(150) == DeviceResult::InvalidBrightness);
+    CHECK_EQ(light.getBrightness(), 40);
+    light + 30;
+    CHECK_EQ(light.getBrightness(), 70);
+}
+
+TEST_CASE(light_colors) {
+    SmartLight light("UL3", "Desk Light", "Study");
+    CHECK(light.getColor() == LightColor());
+    light.setColor("red");
+    CHECK(light.getColor() == LightColor(255, 0, 0));
+    CHECK(light.trySetColor("#00ff00") == DeviceResult::Ok);
+    CHECK_EQ(light.getColor().toRgb(), 0x00ff00u);
+    CHECK(light.trySetColor("plaid") == DeviceResult::InvalidColor);
+    CHECK_THROWS(light.setColor(""), std::invalid_argument);
+    CHECK_THROWS(light.setColor("plaid"), std::invalid_argument); // any string was accepted before packed colors
+    CHECK_EQ(light.getColor().toRgb(), 0x00ff00u);
+}
+
+TEST_CASE(light_rejects_empty_fields) {
+    CHECK_THROWS(SmartLight("", "Desk Light", "Study"), std::invalid_argument);
+    CHECK_THROWS(SmartLight("UL4", "", "Study"), std::invalid_argument);
+}
+
+TEST_CASE(light_notifies_observer) {
+    SmartLight light("UL5", "Desk Light", "Study");
+    ChangeCounter counter;
+    light.setObserver(&counter);
+    light.turnOn();
+    light.setBrightness(10);
+    light.setColor("blue");
+    REQUIRE(counter.changes.size() == 3);
+    CHECK(counter.changes[0] == DeviceChange::Power);
+    CHECK(counter.changes[1] == DeviceChange::Brightness);
+    CHECK(counter.changes[2] == DeviceChange::Color);
+    light.setObserver(nullptr);
+    light.turnOff();
+    CHECK_EQ(counter.changes.size(), 3u);
+}
+
+// light color
+
+TEST_CASE(color_parse_and_format) {
+    LightColor color;
+    CHECK(LightColor::tryParse("#102030", color));
+    CHECK_EQ(static_cast<int>(color.getRed()), 0x10);
+    CHECK_EQ(static_cast<int>(color.getGreen()), 0x20);
+    CHECK_EQ(static_cast<int>(color.getBlue()), 0x30);
+    CHECK(LightColor::tryParse("2700K", color));
+    CHECK_EQ(color.getKelvin(), 2700);
+    CHECK(!LightColor::tryParse("#12345", color));
+    CHECK_THROWS(LightColor::parse("nope"), std::invalid_argument);
+    CHECK_EQ(LightColor(255, 0, 0).toString(), std::string("Red"));
+}
+
+TEST_CASE(color_interpolate_and_hsv) {
+    LightColor black(0, 0, 0), white(255, 255, 255);
+    CHECK(LightColor::interpolate(black, white, 0.0) == black);
+    CHECK(LightColor::interpolate(black, white, 1.0) == white);
+    LightColor middle = LightColor::interpolate(black, white, 0.5);
+    CHECK_NEAR(middle.getRed(), 128, 1);
+    HsvColor hsv = LightColor(0, 0, 255).toHsv();
+    CHECK_NEAR(hsv.hue, 240.0, 0.5);
+    CHECK_NEAR(hsv.saturation, 1.0, 1e-3);
+    CHECK(LightColor::fromHsv(hsv) == LightColor(0, 0, 255));
+}
+
+// thermostat
+
+TEST_CASE(thermostat_defaults_and_power) {
+    Thermostat thermostat("UT1", "Hall Thermostat", "Hall");
+    CHECK(!thermostat.getIsOn());
+    CHECK_NEAR(thermostat.getTemperature(), 20.0, 1e-6);
+    CHECK_EQ(thermostat.getMode(), std::string("auto"));
+    CHECK_NEAR(thermostat.getPowerUsage(), 0.0, 1e-9);
+    thermostat.turnOn();
+    CHECK_NEAR(thermostat.getPowerUsage(), 1.0, 1e-9);
+    thermostat.setDesiredTemperature(22.5f);
+    CHECK_NEAR(thermostat.getPowerUsage(), 1.0 + 2.5 * 10.0, 1e-6);
+}
+
+TEST_CASE(thermostat_validates_input) {
+    Thermostat thermostat("UT2", "Hall Thermostat", "Hall");
+    CHECK(thermostat.trySetTemperature(51.0f) == DeviceResult::InvalidTemperature);
+    CHECK(thermostat.trySetDesiredTemperature(-1.0f) == DeviceResult::InvalidTemperature);
+    CHECK(thermostat.trySetMode("blast") == DeviceResult::InvalidMode);
+    thermostat.setTemperature(60.0f); // ignored
+    CHECK_NEAR(thermostat.getTemperature(), 20.0, 1e-6);
+    CHECK(thermostat.trySetMode("cooling") == DeviceResult::Ok);
+    CHECK_EQ(thermostat.getMode(), std::string("cooling"));
+}
+
+TEST_CASE(thermostat_control_output_clamped_by_mode) {
+    Thermostat thermostat("UT3", "Hall Thermostat", "Hall");
+    thermostat.turnOn();
+    thermostat.setMode("heating");
+    thermostat.applyControlOutput(-0.7f);
+    CHECK(thermostat.isClosedLoop());
+    CHECK_NEAR(thermostat.getControlOutput(), 0.0, 1e-6);
+    thermostat.applyControlOutput(2.0f);
+    CHECK_NEAR(thermostat.getControlOutput(), 1.0, 1e-6);
+    CHECK_NEAR(thermostat.getPowerUsage(), 51.0, 1e-6);
+    thermostat.releaseControl();
+    CHECK(!thermostat.isClosedLoop());
+    thermostat.updateTemperatureReading(80.0f);
+    CHECK_NEAR(thermostat.getTemperature(), 50.0, 1e-6);
+}
+
+// security camera
+
+TEST_CASE(camera_recording_needs_power) {
+    SecurityCamera camera("UC1", "Door Camera", "Door");
+    CHECK_THROWS(camera.startRecording(), std::runtime_error);
+    CHECK(camera.tryStartRecording() == DeviceResult::DeviceOff);
+    camera.turnOn();
+    CHECK_NEAR(camera.getPowerUsage(), 0.5, 1e-9);
+    camera.startRecording();
+    CHECK(camera.getIsRecording());
+    CHECK_NEAR(camera.getPowerUsage(), 1.0, 1e-9);
+    camera.stopRecording();
+    CHECK_NEAR(camera.getPowerUsage(), 0.5, 1e-9);
+    camera.startRecording();
+    camera.turnOff();
+    CHECK(!camera.getIsRecording());
+    CHECK_NEAR(camera.getPowerUsage(), 0.0, 1e-9);
+}
+
+TEST_CASE(camera_restart_skips_frames_already_handed_off) {
+    SecurityCamera camera("UC3", "Door Camera", "Door");
+    RecordingBufferConfig config;
+    config.preRollMicros = 2000000;
+    camera.setResolution("720p");
+    camera.configureRecordingBuffer(config);
+    camera.turnOn();
+    SyntheticVideoEncoder encoder(camera.getFrameSize());
+    auto ingest = [&camera, &encoder](int frames) {
+        for (int i = 0; i < frames; ++i) {
+            std::size_t size = encoder.encodeNext();
+            camera.ingestEncodedFrame(encoder.data(), size, encoder.getTimestampMicros(), encoder.isKeyFrame());
+        }
+    };
+    ingest(300);
+    camera.startRecording();
+    CHECK_EQ(camera.takeRecordedClip().frameCount, std::size_t(90));
+    ingest(10);
+    camera.stopRecording();
+    CHECK_EQ(camera.takeRecordedClip().frameCount, std::size_t(10));
+
+    // restarted within the pre-roll: only frames after the last clip
+    ingest(5);
+    camera.startRecording();
+    CHECK_EQ(camera.takeRecordedClip().frameCount, std::size_t(5));
+
+    // turned off mid-recording, the clip still ends where the camera stopped
+    ingest(20);
+    camera.turnOff();
+    CHECK(!camera.getIsRecording());
+    ingest(10);
+    CHECK_EQ(camera.takeRecordedClip().frameCount, std::size_t(20));
+}
+
+TEST_CASE(camera_settings) {
+    SecurityCamera camera("UC2", "Door Camera", "Door");
+    CHECK_EQ(camera.getResolution(), std::string("1080p"));
+    camera.setResolution("4K");
+    CHECK_EQ(camera.getResolution(), std::string("4K"));
+    CHECK_THROWS(camera.setResolution("8K"), std::invalid_argument);
+    CHECK(camera.trySetRotation(361) == DeviceResult::InvalidRotation);
+    camera.setRotation(300);
+    camera + 90;
+    CHECK_EQ(camera.getRotation(), 30);
+    CHECK(camera.tryEnableMotionDetection() == DeviceResult::DeviceOff);
+    camera.turnOn();
+    camera.enableMotionDetection();
+    CHECK(camera.getMotionDetection());
+    camera.disableMotionDetection();
+    CHECK(!camera.getMotionDetection());
+}
+
+// motion detection
+
+// diffAndUpdateBackground one pixel at a time, as the scalar tail does
+static std::size_t diffAndUpdateScalar(const std::uint8_t* frame, std::uint8_t* background, std::size_t count,
+                                       std::uint8_t threshold) {
+    std::size_t changed = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        int diff = std::abs(frame[i] - background[i]);
+        changed += diff > threshold ? 1 : 0;
+        int half = (background[i] + frame[i] + 1) >> 1;
+        background[i] = static_cast<std::uint8_t>((background[i] + half + 1) >> 1);
+    }
+    return changed;
+}
+
+// a frame of value with a bright side-by-side square at column x
+static GrayFrame frameWithSquare(FrameSize size, int x, int side, std::uint8_t value) {
+    GrayFrame frame(size, value);
+    for (int row = 10; row < 10 + side; ++row) {
+        for (int column = x; column < x + side; ++column) {
+            frame.data()[static_cast<std::size_t>(row) * size.width + column] = 220;
+        }
+    }
+    return frame;
+}
+
+TEST_CASE(motion_vector_path_matches_scalar) {
+    // odd counts leave a scalar tail, over 255 blocks of 16 flushes the lane counters
+    std::mt19937 rng(7);
+    for (std::size_t count : {std::size_t(1), std::size_t(15), std::size_t(16), std::size_t(100), std::size_t(4081), std::size_t(9999)}) {
+        for (std::uint8_t threshold : {std::uint8_t(0), std::uint8_t(25), std::uint8_t(254)}) {
+            std::vector<std::uint8_t> frame(count), background(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                frame[i] = static_cast<std::uint8_t>(rng());
+                background[i] = static_cast<std::uint8_t>(rng());
+            }
+            std::vector<std::uint8_t> expected = background;
+            std::size_t expectedChanged = diffAndUpdateScalar(frame.data(), expected.data(), count, threshold);
+            CHECK_EQ(diffAndUpdateBackground(frame.data(), background.data(), count, threshold), expectedChanged);
+            CHECK(background == expected);
+        }
+    }
+}
+
+TEST_CASE(motion_still_scene_and_moving_square) {
+    FrameSize size{100, 37}; // rows are not a multiple of 16 pixels
+    MotionDetector detector(size);
+    CHECK(!detector.processFrame(frameWithSquare(size, 10, 20, 40))); // seeds the background
+    CHECK(!detector.processFrame(frameWithSquare(size, 10, 20, 40)));
+    CHECK_EQ(detector.getLastChangedPixels(), std::size_t(0));
+    CHECK(detector.processFrame(frameWithSquare(size, 60, 20, 40)));
+    CHECK_EQ(detector.getLastChangedPixels(), std::size_t(800)); // the square left one place and arrived in another
+    CHECK_THROWS(detector.processFrame(GrayFrame(FrameSize{64, 37})), std::invalid_argument);
+}
+
+TEST_CASE(motion_camera_reports_events) {
+    SecurityCamera camera("UC4", "Yard Camera", "Yard");
+    camera.setResolution("720p");
+    camera.turnOn();
+    camera.enableMotionDetection();
+    std::vector<MotionEvent> events;
+    camera.setMotionCallback([&events](const MotionEvent& event) { events.push_back(event); });
+    FrameSize size = camera.getFrameSize();
+    for (int i = 0; i < 3; ++i) {
+        CHECK(!camera.processFrame(frameWithSquare(size, 100, 60, 40)));
+    }
+    GrayFrame moved = frameWithSquare(size, 1000, 60, 40);
+    moved.setFrameNumber(4);
+    CHECK(camera.processFrame(moved));
+    REQUIRE(events.size() == 1);
+    CHECK_EQ(events[0].cameraID, std::string("UC4"));
+    CHECK_EQ(events[0].frameNumber, std::uint64_t(4));
+    CHECK_EQ(events[0].changedPixels, std::size_t(7200));
+    CHECK_EQ(camera.getMotionEventCount(), std::uint64_t(1));
+}
+
+// device commands
+
+TEST_CASE(command_dispatch_by_device_type) {
+    SmartLight light("UD1", "Lamp", "Den");
+    Thermostat thermostat("UD2", "Den Thermostat", "Den");
+    SecurityCamera camera("UD3", "Den Camera", "Den");
+    CHECK(light.applyCommand(DeviceCommand{CommandType::TurnOn, 0.0f, ""}) == DeviceResult::Ok);
+    CHECK(light.getIsOn());
+    CHECK(light.applyCommand(DeviceCommand{CommandType::SetBrightness, 55.0f, ""}) == DeviceResult::Ok);
+    CHECK_EQ(light.getBrightness(), 55);
+    CHECK(light.applyCommand(DeviceCommand{CommandType::SetMode, 0.0f, "heating"}) == DeviceResult::NotSupported);
+    CHECK(thermostat.applyCommand(DeviceCommand{CommandType::SetDesiredTemperature, 18.0f, ""}) == DeviceResult::Ok);
+    CHECK_NEAR(thermostat.getDesiredTemperature(), 18.0, 1e-6);
+    CHECK(thermostat.applyCommand(DeviceCommand{CommandType::SetBrightness, 5.0f, ""}) == DeviceResult::NotSupported);
+    CHECK(camera.applyCommand(DeviceCommand{CommandType::StartRecording, 0.0f, ""}) == DeviceResult::DeviceOff);
+    CHECK(camera.applyCommand(DeviceCommand{CommandType::SetResolution, 0.0f, "720p"}) == DeviceResult::Ok);
+    CHECK_EQ(camera.getResolution(), std::string("720p"));
+}
+
+TEST_CASE(command_text_round_trip) {
+    DeviceCommand command;
+    CHECK(parseDeviceCommand("brightness", "40", command));
+    CHECK(command.type == CommandType::SetBrightness);
+    CHECK_NEAR(command.value, 40.0, 1e-6);
+    CHECK(parseDeviceCommand("color", "Warm White", command));
+    CHECK_EQ(command.text, std::string("Warm White"));
+    CHECK(parseDeviceCommand("motion", "on", command));
+    CHECK(command.type == CommandType::EnableMotionDetection);
+    CHECK(!parseDeviceCommand("brightness", "40%", command));
+    CHECK(!parseDeviceCommand("on", "now", command));
+    CHECK(!parseDeviceCommand("fly", "", command));
+    std::vector<DeviceCommand> commands = {{CommandType::TurnOff, 0.0f, ""}, {CommandType::SetDesiredTemperature, 21.5f, ""},
+                                           {CommandType::SetMode, 0.0f, "cooling"}, {CommandType::SetRotation, 90.0f, ""},
+                                           {CommandType::StartRecording, 0.0f, ""}};
+    for (const auto& original : commands) {
+        std::string text = formatDeviceCommand(original);
+        std::size_t space = text.find(' ');
+        DeviceCommand parsed;
+        CHECK(parseDeviceCommand(text.substr(0, space), space == std::string::npos ? "" : text.substr(space + 1), parsed));
+        CHECK(parsed.type == original.type);
+        CHECK_NEAR(parsed.value, original.value, 1e-6);
+        CHECK_EQ(parsed.text, original.text);
+    }
+}
+
+TEST_CASE(command_results_have_messages) {
+    for (int result = 0; result <= static_cast<int>(DeviceResult::UnknownDevice); ++result) {
+        const char* text = describeResult(static_cast<DeviceResult>(result));
+        REQUIRE(text != nullptr);
+        CHECK(std::string(text).size() > 0);
+    }
+}
+
+TEST_CASE(command_checks_match_apply) {
+    SmartLight light("UD4", "Lamp", "Den");
+    Thermostat thermostat("UD5", "Den Thermostat", "Den");
+    SecurityCamera camera("UD6", "Den Camera", "Den");
+    CHECK(light.checkCommand(DeviceCommand{CommandType::SetBrightness, 101.0f, ""}) == DeviceResult::InvalidBrightness);
+    CHECK(light.checkCommand(DeviceCommand{CommandType::SetColor, 0.0f, "plaid"}) == DeviceResult::InvalidColor);
+    CHECK(light.checkCommand(DeviceCommand{CommandType::SetMode, 0.0f, "auto"}) == DeviceResult::NotSupported);
+    CHECK(thermostat.checkCommand(DeviceCommand{CommandType::SetDesiredTemperature, 60.0f, ""}) == DeviceResult::InvalidTemperature);
+    CHECK(thermostat.checkCommand(DeviceCommand{CommandType::TurnOn, 0.0f, ""}) == DeviceResult::Ok);
+    CHECK(camera.checkCommand(DeviceCommand{CommandType::SetRotation, 400.0f, ""}) == DeviceResult::InvalidRotation);
+    CHECK(camera.checkCommand(DeviceCommand{CommandType::StartRecording, 0.0f, ""}) == DeviceResult::Ok); // power is state
+    CHECK_EQ(light.getBrightness(), 0); // nothing applied
+}
+
+TEST_CASE(command_numbers_checked_before_cast) {
+    SmartLight light("UD8", "Lamp", "Den");
+    SecurityCamera camera("UD9", "Den Camera", "Den");
+    camera.turnOn();
+    DeviceCommand command;
+    REQUIRE(parseDeviceCommand("brightness", "nan", command));
+    CHECK(light.checkCommand(command) == DeviceResult::InvalidBrightness);
+    CHECK(light.applyCommand(command) == DeviceResult::InvalidBrightness);
+    REQUIRE(parseDeviceCommand("brightness", "inf", command));
+    CHECK(light.applyCommand(command) == DeviceResult::InvalidBrightness);
+    REQUIRE(parseDeviceCommand("brightness", "50.7", command));
+    CHECK(light.applyCommand(command) == DeviceResult::InvalidBrightness); // not truncated to 50
+    REQUIRE(parseDeviceCommand("rotation", "1e30", command));
+    CHECK(camera.checkCommand(command) == DeviceResult::InvalidRotation);
+    CHECK(camera.applyCommand(command) == DeviceResult::InvalidRotation);
+    CHECK_EQ(light.getBrightness(), 0);
+    CHECK_EQ(camera.getRotation(), 0);
+    REQUIRE(parseDeviceCommand("brightness", "50.0", command));
+    CHECK(light.applyCommand(command) == DeviceResult::Ok);
+    CHECK_EQ(light.getBrightness(), 50);
+}
+
+TEST_CASE(command_queue_coalesces_writes) {
+    SmartLight light("UD7", "Lamp", "Den");
+    DeviceCommandQueue queue;
+    for (int level = 10; level <= 50; level += 10) {
+        (void)queue.push(light, DeviceCommand{CommandType::SetBrightness, static_cast<float>(level), ""});
+    }
+    CHECK(!queue.push(light, DeviceCommand{CommandType::SetColor, 0.0f, "red"}));
+    CHECK(queue.push(light, DeviceCommand{CommandType::SetColor, 0.0f, "blue"}));
+    CHECK(!queue.push(light, DeviceCommand{CommandType::SetBrightness, 300.0f, ""})); // rejected, keeps 50
+    CHECK_EQ(queue.size(), 3u);
+    CHECK_EQ(queue.getCoalescedCount(), 5u);
+
+    // toggles keep their place: writes before and after them stay apart
+    CHECK(!queue.push(light, DeviceCommand{CommandType::TurnOff, 0.0f, ""}));
+    (void)queue.push(light, DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+    CHECK(!queue.push(light, DeviceCommand{CommandType::SetBrightness, 70.0f, ""}));
+    CHECK(queue.push(light, DeviceCommand{CommandType::SetBrightness, 80.0f, ""}));
+    REQUIRE(queue.size() == 6);
+    CHECK(queue.getPending()[0].type == CommandType::SetBrightness);
+    CHECK_NEAR(queue.getPending()[0].value, 50.0, 1e-6);
+    std::vector<DeviceResult> results;
+    CHECK_EQ(queue.flush(light, &results), 5u);
+    REQUIRE(results.size() == 6);
+    CHECK(results[2] == DeviceResult::InvalidBrightness);
+    CHECK(queue.empty());
+    CHECK_EQ(queue.getAppliedCount(), 6u);
+    CHECK(light.getIsOn());
+    CHECK_EQ(light.getBrightness(), 80);
+    CHECK(light.getColor() == LightColor(0, 0, 255));
+}
+
+// room controller
+
+TEST_CASE(room_membership) {
+    RoomController room("Kitchen");
+    auto light = std::make_shared<SmartLight>("UR1", "Kitchen Light", "Kitchen");
+    auto camera = std::make_shared<SecurityCamera>("UR2", "Kitchen Camera", "Kitchen");
+    CHECK_EQ(room.getRoomName(), std::string("Kitchen"));
+    room.addDevice(light);
+    room.addDevice(camera);
+    room.addDevice(light); // duplicate is ignored
+    CHECK_EQ(room.getDeviceCount(), 2u);
+    CHECK(room.hasDevice("UR2"));
+    room.removeDevice("UR2");
+    room.removeDevice("UR9"); // unknown is ignored
+    CHECK(!room.hasDevice("UR2"));
+    CHECK_EQ(room.getDevices().size(), 1u);
+}
+
+// small rooms are scanned, larger ones switch to an ID set on the way up
+TEST_CASE(room_membership_past_a_scan) {
+    RoomController room("Hall");
+    std::vector<std::shared_ptr<Device>> lights;
+    for (int i = 0; i < 80; ++i) {
+        lights.push_back(std::make_shared<SmartLight>("URS" + std::to_string(i), "Hall Light", "Hall"));
+    }
+    CHECK_EQ(room.addDevices(std::vector<std::shared_ptr<Device>>(lights.begin(), lights.begin() + 20)), 20u);
+    CHECK_EQ(room.addDevices(lights), 60u); // the first twenty are already in
+    room.addDevice(lights[50]);
+    CHECK_EQ(room.getDeviceCount(), 80u);
+    CHECK(room.hasDevice("URS5") && room.hasDevice("URS79"));
+    room.removeDevice("URS79");
+    CHECK(!room.hasDevice("URS79"));
+    lights.pop_back(); // the device is freed, the room no longer views its ID
+    CHECK(!room.hasDevice("URS79"));
+    CHECK_EQ(room.getDeviceCount(), 79u);
+}
+
+TEST_CASE(room_turns_every_device_on_and_off) {
+    RoomController room("Garage");
+    std::vector<std::shared_ptr<Device>> devices = {
+        std::make_shared<SmartLight>("UR3", "Garage Light", "Garage"),
+        std::make_shared<Thermostat>("UR4", "Garage Thermostat", "Garage"),
+        std::make_shared<SecurityCamera>("UR5", "Garage Camera", "Garage")};
+    for (const auto& device : devices) room.addDevice(device);
+    room.turnAllDevicesOn();
+    for (const auto& device : devices) CHECK(device->getIsOn());
+    room.turnAllDevicesOff();
+    for (const auto& device : devices) CHECK(!device->getIsOn());
+}
+
+// energy monitor
+
+TEST_CASE(energy_current_and_total) {
+    EnergyMonitor* monitor = EnergyMonitor::getInstance();
+    double systemBefore = monitor->getTotalSystemUsage();
+    monitor->recordUsage("UE1", 2.0);
+    monitor->recordUsage("UE1", 3.0);
+    monitor->recordUsageBatch({{"UE2", 1.5}, {"UE1", 1.0}});
+    CHECK_NEAR(monitor->getCurrentUsage("UE1"), 1.0, 1e-9);
+    CHECK_NEAR(monitor->getTotalUsage("UE1"), 6.0, 1e-9);
+    CHECK_NEAR(monitor->getTotalUsage("UE2"), 1.5, 1e-9);
+    CHECK_NEAR(monitor->getTotalSystemUsage() - systemBefore, 7.5, 1e-9);
+    CHECK_NEAR(monitor->getCurrentUsage("UE-missing"), 0.0, 1e-9);
+}
+
+TEST_CASE(energy_integrates_readings_over_the_clock) {
+    EnergyMonitor* monitor = EnergyMonitor::getInstance();
+    VirtualClock clock;
+    monitor->setClock(&clock);
+    monitor->recordUsage("UE3", 100.0);
+    clock.advanceBy(3600 * 1000);
+    CHECK_NEAR(monitor->getEnergyWattHours("UE3"), 100.0, 1e-9); // an hour at 100 W
+    monitor->recordUsageBatch({{"UE3", 40.0}});
+    clock.advanceBy(1800 * 1000);
+    CHECK_NEAR(monitor->getEnergyWattHours("UE3"), 120.0, 1e-9);
+    monitor->recordUsage("UE3", 0.0);
+    clock.advanceBy(3600 * 1000);
+    CHECK_NEAR(monitor->getEnergyWattHours("UE3"), 120.0, 1e-9);
+    CHECK_NEAR(monitor->getEnergyWattHours("UE-missing"), 0.0, 1e-9);
+    monitor->setClock(nullptr);
+    CHECK(&monitor->getClock() == &systemClock());
+    CHECK_NEAR(monitor->getEnergyWattHours("UE3"), 120.0, 1e-9); // a zero reading adds nothing on the new clock
+}
+
+// home controller, a singleton, so every test uses its own device IDs
+
+TEST_CASE(home_add_find_remove) {
+    HomeController* home = HomeController::getInstance();
+    auto light = std::make_shared<SmartLight>("UH1", "Hall Light", "Hall");
+    home->addDevice(light);
+    CHECK(home->findDevice("UH1") == light);
+    CHECK(home->findDevice("UH-missing") == nullptr);
+    home->removeDevice("UH1");
+    CHECK(home->findDevice("UH1") == nullptr);
+    light->setBrightness(10); // no longer observed
+}
+
+TEST_CASE(home_apply_commands) {
+    HomeController* home = HomeController::getInstance();
+    auto light = std::make_shared<SmartLight>("UH2", "Hall Light", "Hall");
+    auto thermostat = std::make_shared<Thermostat>("UH3", "Hall Thermostat", "Hall");
+    home->addDevice(light);
+    home->addDevice(thermostat);
+    CHECK(home->applyCommand("UH2", DeviceCommand{CommandType::TurnOn, 0.0f, ""}) == DeviceResult::Ok);
+    CHECK(home->applyCommand("UH-missing", DeviceCommand{CommandType::TurnOn, 0.0f, ""}) == DeviceResult::UnknownDevice);
+    std::vector<DeviceResult> results;
+    size_t succeeded = home->applyCommands({{"UH2", DeviceCommand{CommandType::SetBrightness, 70.0f, ""}},
+                                            {"UH3", DeviceCommand{CommandType::SetMode, 0.0f, "heating"}},
+                                            {"UH3", DeviceCommand{CommandType::SetMode, 0.0f, "warp"}}},
+                                           results);
+    CHECK_EQ(succeeded, 2u);
+    REQUIRE(results.size() == 3);
+    CHECK(results[2] == DeviceResult::InvalidMode);
+    CHECK_EQ(light->getBrightness(), 70);
+    CHECK_EQ(thermostat->getMode(), std::string("heating"));
+    home->removeDevice("UH2");
+    home->removeDevice("UH3");
+}
+
+TEST_CASE(home_queued_commands_coalesce) {
+    HomeController* home = HomeController::getInstance();
+    auto light = std::make_shared<SmartLight>("UH6", "Hall Light", "Hall");
+    auto thermostat = std::make_shared<Thermostat>("UH7", "Hall Thermostat", "Hall");
+    home->addDevice(light);
+    home->addDevice(thermostat);
+    auto subscriber = home->getTelemetry().subscribe("home/Hall/+/+");
+    for (int level = 1; level <= 100; ++level) {
+        CHECK(home->queueCommand("UH6", DeviceCommand{CommandType::SetBrightness, static_cast<float>(level), ""}) == DeviceResult::Ok);
+        CHECK(home->queueCommand("UH7", DeviceCommand{CommandType::SetDesiredTemperature, 15.0f + level / 10.0f, ""}) == DeviceResult::Ok);
+    }
+    CHECK(home->queueCommand("UH-missing", DeviceCommand{CommandType::TurnOn, 0.0f, ""}) == DeviceResult::UnknownDevice);
+    CHECK_EQ(light->getBrightness(), 0); // nothing applied until the flush
+    CHECK_EQ(home->getPendingCommandCount(), 2u);
+    CHECK_EQ(home->flushCommandQueues(), 2u);
+    CHECK_EQ(light->getBrightness(), 100);
+    CHECK_NEAR(thermostat->getDesiredTemperature(), 25.0, 1e-4);
+    std::vector<std::shared_ptr<const BrokerMessage>> messages;
+    subscriber->drain(messages);
+    CHECK_EQ(messages.size(), 2u); // one change each instead of a hundred
+    CHECK_EQ(home->flushCommandQueues(), 0u);
+    (void)home->queueCommand("UH6", DeviceCommand{CommandType::TurnOff, 0.0f, ""});
+    home->removeDevice("UH6"); // its queue goes with it
+    CHECK_EQ(home->getPendingCommandCount(), 0u);
+    CHECK_EQ(home->flushCommandQueues(), 0u);
+    home->getTelemetry().unsubscribe(subscriber);
+    home->removeDevice("UH7");
+}
+
+TEST_CASE(home_rooms_and_rules) {
+    HomeController* home = HomeController::getInstance();
+    auto sensor = std::make_shared<SmartLight>("UH4", "Porch Switch", "Porch");
+    auto lamp = std::make_shared<SmartLight>("UH5", "Porch Lamp", "Porch");
+    home->addDevice(sensor);
+    home->addDevice(lamp);
+    home->addRoom("Unit Porch");
+    home->assignDeviceToRoom("UH5", "Unit Porch");
+    std::uint32_t rule = home->addAutomationRule("when UH4 turns on, set Unit Porch lights to 30%");
+    sensor->turnOn();
+    CHECK_EQ(lamp->getBrightness(), 30);
+    CHECK_EQ(home->listAutomationRules().size(), 1u);
+    CHECK(home->removeAutomationRule(rule));
+    CHECK(!home->removeAutomationRule(rule));
+    CHECK(home->listAutomationRules().empty());
+    home->removeRoom("Unit Porch");
+    home->removeDevice("UH4");
+    home->removeDevice("UH5");
+}
+
+TEST_CASE(home_device_mutex_is_shared_with_the_control_worker) {
+    HomeController home;
+    auto thermostat = std::make_shared<Thermostat>("UH6", "Hall Thermostat", "Hall");
+    home.addDevice(thermostat);
+    ControlLoopConfig control;
+    control.periodMillis = 1;
+    home.getThermostatControl().setConfig(control);
+    home.getThermostatControl().start();
+    std::thread rooms([&home] {
+        for (int i = 0; i < 200; ++i) {
+            home.addRoom("Hall " + std::to_string(i % 10)); // duplicates are checked under the lock
+        }
+    });
+    for (int i = 0; i < 200; ++i) {
+        CHECK(home.applyCommand("UH6", DeviceCommand{CommandType::SetDesiredTemperature, 18.0f + static_cast<float>(i % 8), ""}) == DeviceResult::Ok);
+        home.updateScheduler();
+    }
+    rooms.join();
+    while (home.getThermostatControl().getStats().ticks == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    home.getThermostatControl().stop();
+    CHECK_EQ(home.readSnapshot()->getRooms().size(), std::size_t(10));
+    CHECK(home.findDevice("UH6") == thermostat);
+}
+
+TEST_CASE(home_layout_installs_rooms) {
+    HomeController* home = HomeController::getInstance();
+    auto existing = std::make_shared<SmartLight>("UH8", "Study Light", "Study");
+    home->addDevice(existing);
+    std::istringstream text("room \"Unit Study\"\n"
+                            "light UH8 Duplicate Study room=\"Unit Study\"\n"
+                            "light UH9 \"Study Switch\" Study\n"
+                            "light UH10 \"Study Lamp\" Study room=\"Unit Study\"\n");
+    CHECK_EQ(home->loadLayout(parseHomeLayout(text)), 2u); // UH8 is already in the home
+    CHECK(home->findDevice("UH8") == existing);
+    REQUIRE(home->findDevice("UH10") != nullptr);
+    std::uint32_t rule = home->addAutomationRule("when UH9 turns on, set Unit Study lights to 30%");
+    home->findDevice("UH9")->turnOn();
+    CHECK_EQ(std::dynamic_pointer_cast<SmartLight>(home->findDevice("UH10"))->getBrightness(), 30);
+    CHECK_EQ(existing->getBrightness(), 0); // the skipped line did not put UH8 in the room
+    CHECK(home->getAutomation().removeRule(rule));
+    home->removeRoom("Unit Study");
+    for (const char* id : {"UH8", "UH9", "UH10"}) {
+        home->removeDevice(id);
+    }
+}
+
+TEST_CASE(home_layout_readings_go_to_the_home) {
+    HomeController home;
+    std::istringstream text("light UH12 \"Den Lamp\" Den on brightness=50\n"
+                            "light UH13 \"Den Light\" Den\n");
+    HomeLayout layout = parseHomeLayout(text);
+    CHECK_EQ(EnergyMonitor::getInstance()->getCurrentUsage("UH12"), 0.0); // state is restored unmetered
+    CHECK_EQ(home.loadLayout(layout), 2u);
+    CHECK(home.getEnergyMonitor().getCurrentUsage("UH12") > 0.0);
+    CHECK_EQ(home.getEnergyMonitor().getCurrentUsage("UH12"), layout.devices[0]->getPowerUsage());
+    CHECK_EQ(home.getEnergyMonitor().getDeviceCount(), 1u); // only devices the layout turned on
+    layout.devices[1]->turnOn();
+    CHECK_EQ(home.getEnergyMonitor().getDeviceCount(), 2u);
+}
+
+TEST_CASE(home_clock_drives_scheduler_and_energy) {
+    HomeController* home = HomeController::getInstance();
+    auto light = std::make_shared<SmartLight>("UH11", "Clock Light", "Hall");
+    home->addDevice(light);
+    VirtualClock clock(0, 8 * 60);
+    home->setClock(&clock);
+    CHECK(&EnergyMonitor::getInstance()->getClock() == &clock);
+    home->scheduleDeviceOn("UH11", 5000);
+    clock.advanceBy(4999);
+    home->updateScheduler();
+    CHECK(!light->getIsOn());
+    clock.advanceBy(1);
+    home->updateScheduler();
+    CHECK(light->getIsOn());
+    double before = EnergyMonitor::getInstance()->getEnergyWattHours("UH11");
+    clock.advanceBy(3600 * 1000);
+    CHECK_NEAR(EnergyMonitor::getInstance()->getEnergyWattHours("UH11") - before, light->getPowerUsage(), 1e-9);
+    CHECK_EQ(clock.minuteOfDay(), 9 * 60);
+    home->setClock(nullptr);
+    CHECK(&home->getClock() == &systemClock());
+    home->removeDevice("UH11");
+}
+
+TEST_CASE(home_simulation_is_deterministic) {
+    HomeController* home = HomeController::getInstance();
+    SimulationConfig config;
+    config.durationMillis = 3ull * 24 * 3600 * 1000;
+    config.seed = 7;
+    config.lightTogglesPerDay = 6.0;
+    // a fresh copy of the same small home for every run
+    auto simulate = [&](std::vector<std::string>& statuses) {
+        const char* ids[] = {"UZ1", "UZ2", "UZ3", "UZ4", "UZ5"};
+        home->addDevice(std::make_shared<SmartLight>(ids[0], "Sim Light", "Sim"));
+        home->addDevice(std::make_shared<SmartLight>(ids[1], "Sim Light", "Sim"));
+        home->addDevice(std::make_shared<Thermostat>(ids[2], "Sim Thermostat", "Sim"));
+        home->addDevice(std::make_shared<Thermostat>(ids[3], "Sim Thermostat", "Sim"));
+        home->addDevice(std::make_shared<SecurityCamera>(ids[4], "Sim Camera", "Sim"));
+        for (const char* id : ids) {
+            (void)home->applyCommand(id, DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+        }
+        HomeSimulation simulation(*home, config);
+        SimulationResult result = simulation.run();
+        statuses.clear();
+        for (const char* id : ids) {
+            statuses.push_back(home->findDevice(id)->getDeviceStatus());
+            home->removeDevice(id);
+        }
+        return result;
+    };
+    std::vector<std::string> firstStatuses, secondStatuses;
+    std::size_t pendingBefore = home->getScheduler().getPendingCount();
+    SimulationResult first = simulate(firstStatuses);
+    SimulationResult second = simulate(secondStatuses);
+    CHECK_EQ(home->getScheduler().getPendingCount(), pendingBefore); // every simulation timer is gone
+    CHECK_EQ(first.simulatedMillis, config.durationMillis);
+    CHECK_EQ(first.controlTicks, 3u * 24 * 12); // every five minutes
+    CHECK(first.deviceEvents > 30);
+    CHECK_EQ(first.deviceEvents, second.deviceEvents);
+    CHECK_NEAR(first.energyWattHours, second.energyWattHours, 1e-6 * first.energyWattHours);
+    CHECK_NEAR(first.meanIndoorTemperature, second.meanIndoorTemperature, 1e-9);
+    CHECK(firstStatuses == secondStatuses);
+    CHECK(first.meanIndoorTemperature > 15.0 && first.meanIndoorTemperature < 23.0);
+    CHECK(&home->getClock() == &systemClock());
+    CHECK_THROWS(HomeSimulation(*home, SimulationConfig{0, 1, 0, 0}), std::invalid_argument);
+}
+
+// a light whose every command fails by throwing
+class ThrowingLight : public SmartLight {
+    public:
+        using SmartLight::SmartLight;
+        DeviceResult applyCommand(const DeviceCommand&) override {
+            throw std::runtime_error("transport lost");
+        }
+};
+
+TEST_CASE(home_simulation_restores_home_on_throw) {
+    HomeController home;
+    home.addDevice(std::make_shared<ThrowingLight>("UZ9", "Faulty Light", "Sim"));
+    ThermostatControlLoop& loop = home.getThermostatControl();
+    std::uint64_t period = loop.getConfig().periodMillis;
+    std::size_t pendingBefore = home.getScheduler().getPendingCount();
+    loop.start();
+    SimulationConfig config;
+    config.durationMillis = 24ull * 3600 * 1000;
+    config.lightTogglesPerDay = 24.0;
+    HomeSimulation simulation(home, config);
+    CHECK_THROWS(simulation.run(), std::runtime_error);
+    CHECK(&home.getClock() == &systemClock()); // not the simulation's clock
+    CHECK(loop.isRunning());
+    CHECK_EQ(loop.getConfig().periodMillis, period);
+    CHECK_EQ(home.getScheduler().getPendingCount(), pendingBefore);
+    loop.stop();
+}
+
+TEST_CASE(home_scheduled_commands) {
+    HomeController* home = HomeController::getInstance();
+    auto light = std::make_shared<SmartLight>("UH6", "Hall Light", "Hall");
+    home->addDevice(light);
+    home->scheduleDeviceOn("UH6", 50);
+    CHECK_THROWS(home->scheduleDeviceOn("UH-missing", 50), std::invalid_argument);
+    CHECK(!light->getIsOn());
+    home->getScheduler().advanceBy(home->getScheduler().now() + 60);
+    CHECK(light->getIsOn());
+    home->removeDevice("UH6");
+}
+
+// scheduler
+
+TEST_CASE(scheduler_one_shot_and_repeating) {
+    Scheduler scheduler;
+    int once = 0, repeated = 0;
+    scheduler.runAfter(10, [&once] { ++once; });
+    TimerId every = scheduler.runEvery(5, [&repeated] { ++repeated; }, 5);
+    CHECK_EQ(scheduler.advanceTo(9), 1u);
+    CHECK_EQ(once, 0);
+    scheduler.advanceTo(10);
+    CHECK_EQ(once, 1);
+    CHECK_EQ(repeated, 2);
+    CHECK(scheduler.cancel(every));
+    CHECK(!scheduler.isPending(every));
+    scheduler.advanceBy(100);
+    CHECK_EQ(repeated, 2);
+    CHECK_EQ(scheduler.getPendingCount(), 0u);
+}
+
+TEST_CASE(scheduler_skips_long_idle_stretches) {
+    Scheduler scheduler;
+    std::vector<std::uint64_t> firedAt;
+    for (std::uint64_t delay : {3600000ull, 864000000ull, 8640000000ull}) { // an hour, ten days, a hundred days
+        scheduler.runAfter(delay, [&scheduler, &firedAt] { firedAt.push_back(scheduler.now()); });
+    }
+    CHECK_EQ(scheduler.advanceTo(864000000ull - 1), 1u);
+    CHECK_EQ(scheduler.advanceTo(20000000000ull), 2u);
+    REQUIRE(firedAt.size() == 3);
+    CHECK_EQ(firedAt[0], 3600000u);
+    CHECK_EQ(firedAt[1], 864000000u);
+    CHECK_EQ(firedAt[2], 8640000000u);
+}
+
+TEST_CASE(scheduler_device_timers_and_fades) {
+    Scheduler scheduler;
+    auto light = std::make_shared<SmartLight>("US1", "Fade Light", "Lounge");
+    scheduler.turnOnAfter(light, 100);
+    scheduler.advanceTo(99);
+    CHECK(!light->getIsOn());
+    scheduler.advanceTo(100);
+    CHECK(light->getIsOn());
+    TimerId fade = scheduler.fadeBrightness(light, 100, 1000, 100);
+    scheduler.advanceBy(500);
+    CHECK(light->getBrightness() > 0);
+    CHECK(light->getBrightness() < 100);
+    scheduler.advanceBy(600);
+    CHECK_EQ(light->getBrightness(), 100);
+    CHECK(!scheduler.isPending(fade));
+    scheduler.turnOffAfter(light, 10);
+    scheduler.advanceBy(10);
+    CHECK(!light->getIsOn());
+}
+
+// automation engine
+
+TEST_CASE(automation_device_triggers_and_rooms) {
+    AutomationEngine engine;
+    EngineFeed feed(engine);
+    auto switchLight = std::make_shared<SmartLight>("UA1", "Switch", "Hall");
+    auto hallLight = std::make_shared<SmartLight>("UA2", "Hall Light", "Hall");
+    auto hallThermostat = std::make_shared<Thermostat>("UA3", "Hall Thermostat", "Hall");
+    for (const std::shared_ptr<Device>& device : {std::shared_ptr<Device>(switchLight), std::shared_ptr<Device>(hallLight),
+                                                  std::shared_ptr<Device>(hallThermostat)}) {
+        engine.registerDevice(device);
+        device->setObserver(&feed);
+    }
+    engine.addDeviceToRoom("Hall", "UA2");
+    engine.addDeviceToRoom("Hall", "UA3");
+    engine.addRule("when UA1 turns on, set Hall lights to 60% and set Hall lights color to red");
+    engine.addRule("when UA1 turns off then turn off Hall");
+    CHECK_EQ(engine.getRuleCount(), 2u);
+    switchLight->turnOn();
+    CHECK_EQ(hallLight->getBrightness(), 60);
+    CHECK(hallLight->getColor() == LightColor(255, 0, 0));
+    CHECK(!hallThermostat->getIsOn()); // lights only
+    hallThermostat->turnOn();
+    switchLight->turnOff();
+    CHECK(!hallLight->getIsOn());
+    CHECK(!hallThermostat->getIsOn());
+    CHECK_EQ(engine.getRulesFired(), 2u);
+}
+
+TEST_CASE(automation_conditions_and_time) {
+    AutomationEngine engine;
+    EngineFeed feed(engine);
+    auto thermostat = std::make_shared<Thermostat>("UA4", "Attic Thermostat", "Attic");
+    auto fan = std::make_shared<SmartLight>("UA5", "Attic Fan", "Attic");
+    engine.registerDevice(thermostat);
+    engine.registerDevice(fan);
+    thermostat->setObserver(&feed);
+    engine.addRule("when temperature on UA4 above 28 and UA5 is off, turn on UA5");
+    engine.addRule("when at 22:30, turn off UA5");
+    thermostat->setTemperature(30.0f);
+    CHECK(fan->getIsOn());
+    fan->turnOff();
+    thermostat->setTemperature(31.0f); // still above, no new crossing
+    CHECK(!fan->getIsOn());
+    fan->turnOn();
+    engine.setTimeOfDay(22 * 60);
+    CHECK(fan->getIsOn());
+    engine.setTimeOfDay(23 * 60);
+    CHECK(!fan->getIsOn());
+}
+
+TEST_CASE(automation_clock_jumps_fire_nothing) {
+    AutomationEngine engine;
+    auto lamp = std::make_shared<SmartLight>("UA6", "Desk Lamp", "Study");
+    engine.registerDevice(lamp);
+    engine.addRule("when at 18:00, turn on UA6");
+    engine.setTimeOfDay(11 * 60 + 59); // back a minute, not a day ahead
+    CHECK(!lamp->getIsOn());
+    CHECK_EQ(engine.getRulesFired(), std::uint64_t(0));
+    engine.setTimeOfDay(18 * 60);
+    CHECK(lamp->getIsOn());
+    lamp->turnOff();
+    engine.setReplayLimit(60);
+    engine.setTimeOfDay(17 * 60); // past the limit
+    engine.setTimeOfDay(18 * 60);
+    CHECK(lamp->getIsOn());
+    CHECK_THROWS(engine.setReplayLimit(24 * 60), std::invalid_argument);
+}
+
+TEST_CASE(automation_rejects_bad_rules) {
+    AutomationEngine engine;
+    CHECK_THROWS(engine.addRule("when motion on CAM1, dim the lights"), std::invalid_argument);
+    CHECK_THROWS(engine.addRule("set Hall lights to 50%"), std::invalid_argument);
+    CHECK_THROWS(engine.addRule("when at 25:00, turn off Hall"), std::invalid_argument);
+    std::uint32_t rule = engine.addRule("when UA9 turns on, turn off UA9");
+    CHECK(engine.removeRule(rule));
+    CHECK(!engine.removeRule(rule));
+    CHECK_EQ(engine.getRuleCount(), 0u);
+}
+
+// device queries
+
+TEST_CASE(query_parses_clauses) {
+    DeviceQuery query = DeviceQuery::parse("Lights AND on and in Living Room and power from 0.02 to 0.08W and named Desk");
+    CHECK(query.kind == DeviceKind::Light);
+    CHECK_EQ(query.on, 1);
+    CHECK_EQ(query.recording, -1);
+    CHECK(query.room == "Living Room");
+    CHECK(query.namePrefix == "Desk");
+    CHECK_NEAR(query.minPower, 0.02, 1e-6);
+    CHECK(query.powerMatches(0.08f));
+    CHECK(!query.powerMatches(0.09f));
+    CHECK(!query.contradictory);
+    query = DeviceQuery::parse("cameras and not recording and power above 0.5 and power below 2 and power above 0.75");
+    CHECK_EQ(query.recording, 0);
+    CHECK(!query.powerMatches(0.75f));
+    CHECK(query.powerMatches(1.0f));
+    CHECK(!query.powerMatches(2.0f));
+    CHECK(DeviceQuery::parse("lights and cameras").contradictory);
+    CHECK(DeviceQuery::parse("at Hall and at Study").contradictory);
+    CHECK(DeviceQuery::parse("power above 3 and power below 2").contradictory);
+    CHECK(!DeviceQuery::parse("named Desk and named Desk L").contradictory);
+    CHECK(DeviceQuery::parse("all").kind == DeviceKind::Unknown);
+    CHECK_THROWS(DeviceQuery::parse(""), std::invalid_argument);
+    CHECK_THROWS(DeviceQuery::parse("lights and blue"), std::invalid_argument);
+    CHECK_THROWS(DeviceQuery::parse("power above many"), std::invalid_argument);
+    CHECK_THROWS(DeviceQuery::parse("at "), std::invalid_argument);
+    CHECK_THROWS(DeviceQuery::parse("in Hall and in Study"), std::invalid_argument);
+
+    // an " and " inside a quoted name does not split the clause
+    query = DeviceQuery::parse("lights and in \"Bed and Breakfast\" and named \"Lamp and Shade\"");
+    CHECK(query.kind == DeviceKind::Light);
+    CHECK(query.room == "Bed and Breakfast");
+    CHECK(query.namePrefix == "Lamp and Shade");
+    CHECK_THROWS(DeviceQuery::parse("in \"Bed and Breakfast"), std::invalid_argument);
+    CHECK_THROWS(DeviceQuery::parse("in \"\""), std::invalid_argument);
+}
+
+TEST_CASE(query_removed_rooms_free_their_entries) {
+    DeviceIndex index;
+    auto light = std::make_shared<SmartLight>("QR1", "Lamp", "Den");
+    index.add(light);
+    index.addToRoom("Room 0", *light);
+    index.removeRoom("Room 0");
+    std::size_t bytes = index.getMemoryUsage();
+    for (int i = 1; i <= 100; ++i) {
+        std::string room = "Room " + std::to_string(i);
+        index.addToRoom(room, *light);
+        CHECK_EQ(index.roomSlots(room).size(), std::size_t(1));
+        index.removeRoom(room);
+        CHECK(index.roomSlots(room).empty());
+    }
+    CHECK_EQ(index.getMemoryUsage(), bytes);
+    CHECK(index.roomSlots("Room 0").empty());
+    index.addToRoom("Room 0", *light);
+    CHECK_EQ(index.count(DeviceQuery::parse("in \"Room 0\"")), std::size_t(1));
+}
+
+// random changes, every query checked against a plain scan of the devices
+TEST_CASE(query_index_matches_a_full_scan) {
+    DeviceIndex index;
+    IndexFeed feed(index);
+    std::vector<std::shared_ptr<Device>> devices;
+    std::mt19937 rng(5);
+    auto addDevice = [&](std::size_t n) {
+        std::string id = std::to_string(n);
+        std::string location = "Spot " + std::to_string(n % 7);
+        std::shared_ptr<Device> device;
+        if (n % 3 == 0) device = std::make_shared<SmartLight>("QL" + id, "Lamp " + id, location);
+        else if (n % 3 == 1) device = std::make_shared<Thermostat>("QT" + id, "Heat " + id, location);
+        else device = std::make_shared<SecurityCamera>("QC" + id, "Cam " + id, location);
+        device->setObserver(&feed);
+        index.add(device);
+        index.addToRoom("Room " + std::to_string(n % 5), *device);
+        devices.push_back(device);
+    };
+    for (std::size_t n = 0; n < 300; ++n) {
+        addDevice(n);
+    }
+    const char* queries[] = {"all", "lights and on", "thermostats and off and at Spot 3", "cameras and recording",
+                             "cameras and not recording and on", "power above 0.05", "power from 0.5 to 1",
+                             "lights and power below 0.06 and in Room 2", "named Lamp 1", "in Room 4 and on",
+                             "at Spot 6 and named Cam", "thermostats and power above 20"};
+    std::size_t nextId = devices.size();
+    for (int round = 0; round < 40; ++round) {
+        for (int change = 0; change < 60; ++change) {
+            auto& device = devices[rng() % devices.size()];
+            switch (rng() % 8) {
+                case 0: device->turnOn(); break;
+                case 1: device->turnOff(); break;
+                case 2: (void)device->applyCommand(DeviceCommand{CommandType::SetBrightness, static_cast<float>(rng() % 101), ""}); break;
+                case 3: (void)device->applyCommand(DeviceCommand{CommandType::StartRecording, 0.0f, ""}); break;
+                case 4: (void)device->applyCommand(DeviceCommand{CommandType::StopRecording, 0.0f, ""}); break;
+                case 5: (void)device->applyCommand(DeviceCommand{CommandType::SetDesiredTemperature, static_cast<float>(10 + rng() % 20), ""}); break;
+                case 6: device->setDeviceLocation("Spot " + std::to_string(rng() % 7)); break;
+                default:
+                    index.remove(*device);
+                    device->setObserver(nullptr);
+                    device = devices.back();
+                    devices.pop_back();
+                    addDevice(nextId++);
+                    break;
+            }
+        }
+        for (const char* text : queries) {
+            DeviceQuery query = DeviceQuery::parse(text);
+            std::vector<std::string> expected;
+            for (const auto& device : devices) {
+                auto* camera = dynamic_cast<SecurityCamera*>(device.get());
+                DeviceKind kind = camera ? DeviceKind::Camera
+                                : dynamic_cast<SmartLight*>(device.get()) ? DeviceKind::Light : DeviceKind::Thermostat;
+                bool in = query.kind == DeviceKind::Unknown || query.kind == kind;
+                in = in && (query.on < 0 || device->getIsOn() == (query.on == 1));
+                in = in && (query.recording < 0 || (camera && camera->getIsRecording()) == (query.recording == 1));
+                in = in && (query.location.empty() || device->getDeviceLocation() == query.location);
+                in = in && (query.room.empty() || "Room " + std::to_string(std::stoul(device->getDeviceID().substr(2)) % 5) == query.room);
+                in = in && query.powerMatches(static_cast<float>(device->getPowerUsage()));
+                in = in && device->getDeviceName().compare(0, query.namePrefix.size(), query.namePrefix) == 0;
+                if (in) expected.push_back(device->getDeviceID());
+            }
+            std::vector<std::string> selected;
+            for (const auto& device : index.select(query)) {
+                selected.push_back(device->getDeviceID());
+            }
+            std::sort(expected.begin(), expected.end());
+            std::sort(selected.begin(), selected.end());
+            CHECK(selected == expected);
+            CHECK_EQ(index.count(query), expected.size());
+        }
+    }
+    CHECK_EQ(index.size(), devices.size());
+    for (const auto& device : devices) {
+        device->setObserver(nullptr);
+    }
+}
+
+TEST_CASE(query_home_selects_and_applies) {
+    HomeController* home = HomeController::getInstance();
+    home->addRoom("UQ Den");
+    auto lamp = std::make_shared<SmartLight>("UQ1", "UQ Lamp", "UQ Corner");
+    auto reading = std::make_shared<SmartLight>("UQ2", "UQ Reading Light", "UQ Corner");
+    auto camera = std::make_shared<SecurityCamera>("UQ3", "UQ Camera", "UQ Door");
+    for (const auto& device : std::vector<std::shared_ptr<Device>>{lamp, reading, camera}) {
+        home->addDevice(device);
+        home->assignDeviceToRoom(device->getDeviceID(), "UQ Den");
+    }
+    CHECK_EQ(home->countDevices("in UQ Den"), 3u);
+    CHECK_EQ(home->countDevices("in UQ Den and on"), 0u);
+    CHECK_EQ(home->applyToSelection("in UQ Den", DeviceCommand{CommandType::TurnOn, 0.0f, ""}), 3u);
+    CHECK(lamp->getIsOn() && reading->getIsOn() && camera->getIsOn());
+    CHECK_EQ(home->applyToSelection("at UQ Corner", DeviceCommand{CommandType::SetBrightness, 40.0f, ""}), 2u);
+    CHECK_EQ(reading->getBrightness(), 40);
+    (void)home->applyCommand("UQ1", DeviceCommand{CommandType::SetBrightness, 90.0f, ""});
+    auto bright = home->selectDevices("lights and in UQ Den and power above 0.05");
+    REQUIRE(bright.size() == 1);
+    CHECK(bright[0] == lamp);
+    CHECK_EQ(home->countDevices("named UQ Reading"), 1u);
+    (void)home->applyCommand("UQ3", DeviceCommand{CommandType::StartRecording, 0.0f, ""});
+    CHECK_EQ(home->countDevices("cameras and recording and at UQ Door"), 1u);
+    camera->setDeviceLocation("UQ Porch");
+    CHECK_EQ(home->countDevices("at UQ Door"), 0u);
+    CHECK_EQ(home->countDevices("at UQ Porch and in UQ Den"), 1u);
+    // a command some selected devices reject counts only the ones that took it
+    CHECK_EQ(home->applyToSelection("in UQ Den", DeviceCommand{CommandType::SetBrightness, 10.0f, ""}), 2u);
+    home->removeDevice("UQ2");
+    CHECK_EQ(home->countDevices("in UQ Den"), 2u);
+    home->removeRoom("UQ Den");
+    CHECK_EQ(home->countDevices("in UQ Den"), 0u);
+    CHECK_THROWS(home->selectDevices("lights or cameras"), std::invalid_argument);
+    home->removeDevice("UQ1");
+    home->removeDevice("UQ3");
+    CHECK_EQ(home->countDevices("named UQ"), 0u);
+}
+
+// home hosting, homes made here are not the singleton and may reuse device IDs
+
+TEST_CASE(host_homes_are_independent) {
+    double defaultBefore = EnergyMonitor::getInstance()->getTotalUsage("UH1");
+    HomeController first;
+    HomeController second;
+    auto firstLight = std::make_shared<SmartLight>("UH1", "Hall Light", "Hall");
+    auto secondLight = std::make_shared<SmartLight>("UH1", "Hall Light", "Hall");
+    first.addDevice(firstLight);
+    second.addDevice(secondLight);
+    first.addRoom("Hall");
+    first.assignDeviceToRoom("UH1", "Hall");
+    CHECK_EQ(first.countDevices("in Hall"), 1u);
+    CHECK_EQ(second.countDevices("in Hall"), 0u);
+    (void)first.applyCommand("UH1", DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+    (void)first.applyCommand("UH1", DeviceCommand{CommandType::SetBrightness, 100.0f, ""});
+    CHECK(firstLight->getIsOn());
+    CHECK(!secondLight->getIsOn());
+    CHECK(first.getEnergyMonitor().getTotalUsage("UH1") > 0.0);
+    CHECK_EQ(second.getEnergyMonitor().getTotalUsage("UH1"), 0.0);
+    CHECK_EQ(EnergyMonitor::getInstance()->getTotalUsage("UH1"), defaultBefore);
+    CHECK(&first.getEnergyMonitor() != &second.getEnergyMonitor());
+    CHECK(&HomeController::getInstance()->getEnergyMonitor() == EnergyMonitor::getInstance());
+
+    // a device that outlives its home reports to the default monitor again
+    {
+        HomeController shortLived;
+        shortLived.addDevice(secondLight);
+    }
+    secondLight->turnOn();
+    CHECK(EnergyMonitor::getInstance()->getTotalUsage("UH1") > defaultBefore);
+}
+
+TEST_CASE(host_runs_each_homes_work_in_order) {
+    HomeHost host(3);
+    CHECK_EQ(host.getShardCount(), 3u);
+    std::vector<std::vector<int>> seen(7);
+    for (std::size_t i = 0; i < seen.size(); ++i) {
+        CHECK_EQ(host.addHome(), i);
+    }
+    for (int step = 0; step < 200; ++step) {
+        for (std::size_t id = 0; id < seen.size(); ++id) {
+            host.post(id, [&seen, id, step](HomeController& home) {
+                if (step == 0) {
+                    home.addDevice(std::make_shared<SmartLight>("L", "Light", "Room"));
+                }
+                (void)home.applyCommand("L", DeviceCommand{step % 2 ? CommandType::TurnOff : CommandType::TurnOn, 0.0f, ""});
+                seen[id].push_back(step);
+            });
+        }
+    }
+    host.post(4, [](HomeController&) { throw std::runtime_error("home task failure"); });
+    host.wait();
+    CHECK_EQ(host.getExecutedCount(), 7u * 200u + 1u);
+    CHECK_EQ(host.getFailedCount(), 1u);
+    for (std::size_t id = 0; id < seen.size(); ++id) {
+        REQUIRE(seen[id].size() == 200u);
+        CHECK(std::is_sorted(seen[id].begin(), seen[id].end()));
+        CHECK_EQ(host.getHome(id).getDevices().size(), 1u);
+        CHECK(!host.getHome(id).getDevices()[0]->getIsOn());
+    }
+    CHECK_THROWS(host.post(seen.size(), [](HomeController&) {}), std::out_of_range);
+}
+
+// memory accounting and compact device state
+
+TEST_CASE(memory_compact_device_state) {
+    SmartLight hallLight("UM1", "Hall Light", "UM Hall");
+    Thermostat hallThermostat("UM2", "Hall Thermostat", "UM Hall");
+    CHECK(&hallLight.getDeviceLocation() == &hallThermostat.getDeviceLocation()); // interned
+    hallThermostat.setDeviceLocation("UM Landing");
+    CHECK_EQ(hallThermostat.getDeviceLocation(), std::string("UM Landing"));
+    CHECK_EQ(hallLight.getDeviceLocation(), std::string("UM Hall"));
+
+    CHECK(hallThermostat.getThermostatMode() == ThermostatMode::Auto);
+    CHECK(hallThermostat.trySetMode("cooling") == DeviceResult::Ok);
+    CHECK(hallThermostat.getThermostatMode() == ThermostatMode::Cooling);
+    CHECK_EQ(hallThermostat.getMode(), std::string("cooling"));
+    CHECK(hallThermostat.trySetMode("turbo") == DeviceResult::InvalidMode);
+    hallThermostat.setMode(ThermostatMode::Heating);
+    CHECK_EQ(hallThermostat.getMode(), std::string("heating"));
+
+    SecurityCamera camera("UM3", "Hall Camera", "UM Hall");
+    CHECK(camera.getCameraResolution() == CameraResolution::Hd1080);
+    CHECK(camera.trySetResolution("4K") == DeviceResult::Ok);
+    CHECK(camera.getCameraResolution() == CameraResolution::Uhd4K);
+    CHECK_EQ(camera.getResolution(), std::string("4K"));
+    CHECK(camera.trySetResolution("8K") == DeviceResult::InvalidResolution);
+    CHECK_EQ(camera.getFrameSize().width, 3840);
+}
+
+TEST_CASE(memory_homes_intern_locations_apart) {
+    std::size_t defaultSize = StringPool::getInstance()->size();
+    auto kept = std::make_shared<SmartLight>("UMP1", "Kept Light", "UMP Attic");
+    {
+        HomeController first;
+        HomeController second;
+        CHECK(&first.getStringPool() != &second.getStringPool());
+        auto light = std::make_shared<SmartLight>("UMP2", "Porch Light", "UMP Porch", &first.getStringPool());
+        first.addDevice(light);
+        first.addDevice(kept);
+        CHECK_EQ(first.getStringPool().size(), 2u); // kept moved its location over
+        light->setDeviceLocation("UMP Gate");
+        CHECK_EQ(first.getStringPool().size(), 3u);
+        CHECK_EQ(second.getStringPool().size(), 0u);
+        CHECK_EQ(StringPool::getInstance()->size(), defaultSize + 1); // only kept's location, from before
+
+        first.removeDevice("UMP2");
+        CHECK_EQ(light->getDeviceLocation(), std::string("UMP Gate"));
+        light->setDeviceLocation("UMP Shed"); // no home, the default pool again
+        CHECK_EQ(first.getStringPool().size(), 3u);
+    }
+    CHECK_EQ(kept->getDeviceLocation(), std::string("UMP Attic")); // outlived its home and its pool
+    CHECK_EQ(StringPool::getInstance()->size(), defaultSize + 3);
+}
+
+TEST_CASE(memory_report_accounts_devices_and_subsystems) {
+    HomeController home;
+    home.addRoom("UM Den");
+    for (int i = 0; i < 3; ++i) {
+        home.addDevice(std::make_shared<SmartLight>("UML" + std::to_string(i), "A light with a rather long name", "UM Den"));
+        home.assignDeviceToRoom("UML" + std::to_string(i), "UM Den");
+    }
+    home.addDevice(std::make_shared<Thermostat>("UMT", "Den Thermostat", "UM Den"));
+    auto camera = std::make_shared<SecurityCamera>("UMC", "Den Camera", "UM Den");
+    home.addDevice(camera);
+
+    MemoryReport report = home.measureMemory();
+    CHECK_EQ(report.deviceCount, 5u);
+    REQUIRE(report.deviceTypes.size() == 3u);
+    CHECK_EQ(report.deviceTypes[0].name, std::string("lights"));
+    CHECK_EQ(report.deviceTypes[0].count, 3u);
+    CHECK(report.deviceTypes[0].bytes >= 3 * (sizeof(SmartLight) + 32)); // long names are on the heap
+    CHECK_EQ(report.deviceTypes[1].count, 1u);
+    CHECK_EQ(report.deviceTypes[2].count, 1u);
+    std::size_t subsystemTotal = 0;
+    for (const auto& subsystem : report.subsystems) {
+        subsystemTotal += subsystem.bytes;
+        if (subsystem.name == "device lookup" || subsystem.name == "query index" || subsystem.name == "rooms") {
+            CHECK(subsystem.bytes > 0);
+        }
+    }
+    CHECK_EQ(report.subsystemBytes(), subsystemTotal);
+    CHECK_EQ(report.totalBytes(), report.deviceBytes() + subsystemTotal);
+    CHECK_NEAR(report.bytesPerDevice(), static_cast<double>(report.totalBytes()) / 5.0, 1e-9);
+
+    // the motion detector's background model belongs to the camera
+    std::size_t cameraBytes = report.deviceTypes[2].bytes;
+    camera->turnOn();
+    camera->enableMotionDetection();
+    CHECK(home.measureMemory().deviceTypes[2].bytes >= cameraBytes + 1920u * 1080u);
+
+    std::ostringstream text;
+    text << std::setprecision(3);
+    report.print(text);
+    CHECK(text.str().find("query index") != std::string::npos);
+    CHECK(text.str().find("total") != std::string::npos);
+    text << 2.0 / 3.0; // the caller's formatting is back
+    CHECK(text.str().size() > 6 && text.str().compare(text.str().size() - 5, 5, "0.667") == 0);
+}
+
+// epoch reclamation and home snapshots
+
+// counts live instances, to see when retired versions are freed
+struct EpochTracked {
+    static std::atomic<int> alive;
+    int value;
+    explicit EpochTracked(int v) : value(v) { ++alive; }
+    ~EpochTracked() { --alive; }
+};
+std::atomic<int> EpochTracked::alive{0};
+
+TEST_CASE(epoch_retired_versions_outlive_their_readers) {
+    EpochDomain* domain = EpochDomain::getInstance();
+    {
+        RcuPointer<EpochTracked> pointer;
+        pointer.publish(std::make_unique<const EpochTracked>(1));
+        {
+            EpochDomain::ReadGuard reader = domain->read();
+            const EpochTracked* first = pointer.load(reader);
+            {
+                EpochDomain::ReadGuard nested = domain->read(); // reads nest on a thread
+            }
+            pointer.publish(std::make_unique<const EpochTracked>(2));
+            domain->reclaim();
+            CHECK_EQ(first->value, 1); // still pinned
+            CHECK_EQ(EpochTracked::alive.load(), 2);
+            CHECK_EQ(pointer.load(reader)->value, 2);
+        }
+        domain->reclaim();
+        CHECK_EQ(EpochTracked::alive.load(), 1);
+    }
+    domain->reclaim();
+    CHECK_EQ(EpochTracked::alive.load(), 0);
+    CHECK_EQ(domain->getRetiredCount(), 0u);
+}
+
+TEST_CASE(snapshot_outlives_its_home) {
+    std::unique_ptr<PinnedSnapshot> pinned;
+    std::string status;
+    {
+        HomeController home;
+        auto light = std::make_shared<SmartLight>("US9", "Attic Light", "US Attic Over The Garage");
+        home.addDevice(light);
+        light->turnOn();
+        status = light->getDeviceStatus();
+        pinned = std::make_unique<PinnedSnapshot>(home.readCurrentSnapshot());
+        home.removeDevice("US9"); // its location leaves the home's string pool
+    }
+    CHECK_EQ((*pinned)->at(0).location, std::string("US Attic Over The Garage"));
+    CHECK_EQ((*pinned)->at(0).status(), status);
+    EnergySnapshot energy = (*pinned)->measureEnergy();
+    CHECK_EQ(energy.wattsByLocation.count("US Attic Over The Garage"), 1u);
+}
+
+TEST_CASE(snapshot_versions_are_immutable) {
+    HomeController home;
+    auto light = std::make_shared<SmartLight>("US1", "Den Light", "US Den");
+    auto thermostat = std::make_shared<Thermostat>("US2", "Den Thermostat", "US Den");
+    auto camera = std::make_shared<SecurityCamera>("US3", "Den Camera", "US Hall");
+    home.addDevice(light);
+    home.addDevice(thermostat);
+    home.addDevice(camera);
+    home.addRoom("US Den");
+    home.assignDeviceToRoom("US2", "US Den");
+    home.assignDeviceToRoom("US1", "US Den");
+
+    PinnedSnapshot first = home.readSnapshot();
+    CHECK_EQ(first->getVersion(), 1u);
+    CHECK_EQ(first->getDeviceCount(), 3u);
+    CHECK_EQ(first->at(0).status(), light->getDeviceStatus());
+    CHECK_EQ(first->at(1).status(), thermostat->getDeviceStatus());
+    CHECK_EQ(first->at(2).status(), camera->getDeviceStatus());
+    REQUIRE(first->getRooms().size() == 1u);
+    CHECK(first->getRooms()[0].slots == (std::vector<std::uint32_t>{1, 0}));
+    CHECK_THROWS(first->at(3), std::out_of_range);
+
+    // single changes show from the next publish, the pinned version never changes
+    (void)home.applyCommand("US1", DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+    (void)home.applyCommand("US3", DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+    (void)home.applyCommand("US3", DeviceCommand{CommandType::SetResolution, 0.0f, "4K"});
+    CHECK_EQ(home.readSnapshot()->getVersion(), 1u);
+    PinnedSnapshot second = home.readCurrentSnapshot(); // publishes them first
+    CHECK_EQ(second->getVersion(), 2u);
+    CHECK_EQ(home.publishSnapshot(), 2u); // nothing changed since
+    CHECK_EQ(home.readCurrentSnapshot()->getVersion(), 2u);
+    CHECK(!first->at(0).on);
+    CHECK(second->at(0).on);
+    CHECK_EQ(second->at(2).status(), camera->getDeviceStatus());
+    CHECK(&second->getRooms() == &first->getRooms()); // unchanged rooms are shared
+    CHECK(second->measureEnergy().totalWatts > first->measureEnergy().totalWatts);
+
+    // bulk operations publish when they finish, removed devices leave their slot and rooms
+    home.removeDevice("US2");
+    CHECK_EQ(home.applyToSelection("in US Den", DeviceCommand{CommandType::TurnOff, 0.0f, ""}), 1u);
+    PinnedSnapshot third = home.readSnapshot();
+    CHECK_EQ(third->getVersion(), 3u);
+    CHECK_EQ(third->getDeviceCount(), 2u);
+    CHECK(!third->at(1).live);
+    CHECK(!third->at(0).on);
+    CHECK(third->getRooms()[0].slots == std::vector<std::uint32_t>{0});
+    CHECK_EQ(third->findNth(1)->id, std::string("US3"));
+    CHECK_EQ(first->getDeviceCount(), 3u);
+    CHECK_EQ(first->at(1).id, std::string("US2"));
+
+    // the console lists every change so far, not the last published version
+    (void)home.applyCommand("US1", DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+    std::ostringstream shown;
+    std::streambuf* console = std::cout.rdbuf(shown.rdbuf());
+    home.showDevices();
+    home.listRooms();
+    std::cout.rdbuf(console);
+    CHECK_EQ(home.readSnapshot()->getVersion(), 4u);
+    CHECK(shown.str().find("1. " + light->getDeviceStatus() + "\n") != std::string::npos);
+    CHECK(shown.str().find("Smart Light US1 is on") != std::string::npos);
+}
+
+TEST_CASE(snapshot_readers_see_whole_batches) {
+    HomeController home;
+    home.setExecutorThreads(2);
+    home.addRoom("US Hall");
+    for (int i = 0; i < 2048; ++i) {
+        std::string id = "USB" + std::to_string(i);
+        home.addDevice(std::make_shared<SmartLight>(id, "Hall Light", "US Hall"));
+        home.assignDeviceToRoom(id, "US Hall");
+    }
+    (void)home.readSnapshot();
+
+    // readers on other threads check that every version has the whole room on or the whole room off
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+    std::atomic<int> reads{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&home, &done, &torn, &reads] {
+            std::uint64_t lastVersion = 0;
+            while (!done.load()) {
+                PinnedSnapshot snapshot = home.readSnapshot();
+                EnergySnapshot energy = snapshot->measureEnergy();
+                if ((energy.devicesOn != 0 && energy.devicesOn != 2048) || snapshot->getVersion() < lastVersion) {
+                    ++torn;
+                }
+                lastVersion = snapshot->getVersion();
+                ++reads;
+            }
+        });
+    }
+    for (int round = 0; round < 40; ++round) {
+        home.setRoomPower("US Hall", round % 2 == 0);
+    }
+    while (reads.load() < 20) {
+        std::this_thread::yield();
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    CHECK_EQ(torn.load(), 0);
+    CHECK_EQ(home.readSnapshot()->getVersion(), 41u);
+    CHECK_EQ(home.readSnapshot()->measureEnergy().devicesOn, 0u);
+}
+
+// thermostat control loop
+
+TEST_CASE(control_pid_drives_towards_setpoint) {
+    ControlLoopConfig config;
+    config.simulatePlant = false;
+    ThermostatControlLoop loop(config);
+    auto thermostat = std::make_shared<Thermostat>("UK1", "Loop Thermostat", "Loft");
+    thermostat->turnOn();
+    thermostat->setDesiredTemperature(24.0f);
+    loop.addThermostat(thermostat);
+    CHECK_EQ(loop.getThermostatCount(), 1u);
+    loop.runTick(1.0f);
+    CHECK(thermostat->isClosedLoop());
+    CHECK(thermostat->getControlOutput() > 0.0f);
+    thermostat->setDesiredTemperature(16.0f);
+    loop.runTick(1.0f);
+    CHECK(thermostat->getControlOutput() < 0.0f);
+    CHECK(loop.removeThermostat("UK1"));
+    CHECK(!thermostat->isClosedLoop());
+    CHECK(!loop.removeThermostat("UK1"));
+}
+
+TEST_CASE(control_plant_and_config) {
+    ControlLoopConfig config;
+    config.strategy = ControlStrategy::Hysteresis;
+    ThermostatControlLoop loop(config);
+    auto thermostat = std::make_shared<Thermostat>("UK2", "Loop Thermostat", "Loft");
+    thermostat->turnOn();
+    thermostat->setMode("heating");
+    thermostat->setDesiredTemperature(30.0f);
+    loop.addThermostat(thermostat);
+    for (int tick = 0; tick < 60; ++tick) loop.runTick(1.0f);
+    CHECK(thermostat->getTemperature() > 20.0f);
+    CHECK_EQ(loop.publishTemperatureChanges([](Thermostat&) {}), 1u);
+    CHECK_EQ(loop.publishTemperatureChanges([](Thermostat&) {}), 0u);
+    ControlLoopConfig bad;
+    bad.periodMillis = 0;
+    CHECK_THROWS(loop.setConfig(bad), std::invalid_argument);
+    CHECK(loop.getConfig().strategy == ControlStrategy::Hysteresis);
+}
+
+TEST_CASE(control_worker_starts_and_stops) {
+    ControlLoopConfig config;
+    config.periodMillis = 5;
+    ThermostatControlLoop loop(config);
+    loop.start();
+    CHECK(loop.isRunning());
+    loop.stop();
+    CHECK(!loop.isRunning());
+}
+
+TEST_CASE(control_worker_applies_a_new_period_from_the_next_tick) {
+    ControlLoopConfig config;
+    config.periodMillis = 100;
+    ThermostatControlLoop loop(config);
+    loop.start();
+    config.periodMillis = 2;
+    loop.setConfig(config); // while the worker waits for its first tick
+    while (loop.getStats().ticks == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    CHECK(loop.getStats().ticks >= 3); // one more 100 ms period would allow only the first
+    loop.stop();
+}
+
+// home generator
+
+TEST_CASE(generator_is_reproducible) {
+    HomeSpec spec;
+    spec.lights = 30;
+    spec.thermostats = 5;
+    spec.cameras = 5;
+    spec.rooms = 4;
+    GeneratedHome home = generateHome(spec);
+    CHECK_EQ(home.devices.size(), 40u);
+    CHECK_EQ(home.rooms.size(), 4u);
+    CHECK_EQ(home.deviceRoom.size(), 40u);
+    CHECK_EQ(home.devices[0]->getDeviceID(), std::string("L0"));
+    CommandStream first = generateCommands(home, CommandMix(), 200, 7);
+    CommandStream second = generateCommands(home, CommandMix(), 200, 7);
+    REQUIRE(first.size() == 200);
+    bool same = true;
+    for (size_t i = 0; i < first.size(); ++i) {
+        same = same && first[i].first == second[i].first && first[i].second.type == second[i].second.type;
+    }
+    CHECK(same);
+}
+
+TEST_CASE(generator_layout_round_trip) {
+    std::istringstream text(
+        "# two rooms\n"
+        "room Bedroom\n"
+        "room \"Living Room\"   # trailing comment\n"
+        "\n"
+        "light UG1 \"Bedroom Light\" Bedroom room=Bedroom on brightness=40 color=\"warm white\"\n"
+        "thermostat UG2 Thermostat \"Living Room\" room=\"Living Room\" on setpoint=21.5 mode=heating\n"
+        "camera UG3 \"Front Door Camera\" \"Front Door\" on resolution=4K rotation=90 motion=on record");
+    HomeLayout layout = parseHomeLayout(text);
+    REQUIRE(layout.rooms.size() == 2);
+    REQUIRE(layout.devices.size() == 3);
+    CHECK_EQ(layout.rooms[1], std::string("Living Room"));
+    CHECK_EQ(layout.deviceRoom[1], 1);
+    CHECK_EQ(layout.deviceRoom[2], -1);
+    auto light = std::dynamic_pointer_cast<SmartLight>(layout.devices[0]);
+    REQUIRE(light != nullptr);
+    CHECK_EQ(light->getDeviceName(), std::string("Bedroom Light"));
+    CHECK_EQ(light->getBrightness(), 40);
+    auto camera = std::dynamic_pointer_cast<SecurityCamera>(layout.devices[2]);
+    REQUIRE(camera != nullptr);
+    CHECK(camera->getIsRecording());
+    CHECK_EQ(camera->getRotation(), 90);
+
+    // written out and read back, every device reports the same status
+    std::stringstream written;
+    writeHomeLayout(written, layout);
+    HomeLayout reread = parseHomeLayout(written);
+    REQUIRE(reread.devices.size() == 3);
+    CHECK(reread.rooms == layout.rooms);
+    CHECK(reread.deviceRoom == layout.deviceRoom);
+    for (size_t i = 0; i < 3; ++i) {
+        CHECK_EQ(reread.devices[i]->getDeviceStatus(), layout.devices[i]->getDeviceStatus());
+    }
+}
+
+TEST_CASE(generator_layout_errors_name_the_line) {
+    auto errorFor = [](const std::string& text) {
+        std::istringstream in(text);
+        try {
+            (void)parseHomeLayout(in);
+        } catch (const std::invalid_argument& e) {
+            return std::string(e.what());
+        }
+        return std::string();
+    };
+    CHECK_EQ(errorFor("room A\nlight UG1 L A room=B").substr(0, 13), std::string("layout line 2"));
+    CHECK_EQ(errorFor("light UG1 L A\nlight UG1 L A").substr(0, 13), std::string("layout line 2"));
+    CHECK_EQ(errorFor("light UG1 L A brightness=140").substr(0, 13), std::string("layout line 1"));
+    CHECK_EQ(errorFor("light UG1 L A fly").substr(0, 13), std::string("layout line 1"));
+    CHECK_EQ(errorFor("\n\nlight UG1 \"L A").substr(0, 13), std::string("layout line 3"));
+    CHECK_EQ(errorFor("room A\nroom A").substr(0, 13), std::string("layout line 2"));
+    CHECK_EQ(errorFor("lamp UG1 L A").substr(0, 13), std::string("layout line 1"));
+    CHECK_THROWS(loadHomeLayout("/nonexistent/home.layout"), std::runtime_error);
+}
+
+// command server
+
+TEST_CASE(server_handles_requests) {
+    HomeController* home = HomeController::getInstance();
+    auto light = std::make_shared<SmartLight>("UV1", "Server Light", "Lab");
+    home->addDevice(light);
+    CommandServerConfig config;
+    config.socketPath = "";
+    CommandServer server(*home, config);
+    CHECK_EQ(server.handleRequest("ping"), std::string("OK pong"));
+    CHECK_EQ(server.handleRequest("UV1 on"), std::string("OK"));
+    CHECK_EQ(server.handleRequest("UV1 color Warm White"), std::string("OK"));
+    CHECK_EQ(server.handleRequest("UV1  brightness  40"), std::string("OK"));
+    CHECK_EQ(light->getBrightness(), 40);
+    CHECK_EQ(server.handleRequest("UV1 brightness 140"), std::string("ERR Brightness must be between 0 and 100"));
+    CHECK_EQ(server.handleRequest("UV1 mode heating"), std::string("ERR Command not supported by this device"));
+    CHECK_EQ(server.handleRequest("UV9 on"), std::string("ERR Device not found"));
+    CHECK_EQ(server.handleRequest("UV1 fly"), std::string("ERR Malformed request"));
+    CHECK_EQ(server.handleRequest(""), std::string("ERR Malformed request"));
+    CHECK_EQ(server.handleRequest("status UV1"), "OK " + light->getDeviceStatus());
+    CHECK_EQ(server.getRequestCount(), 10u);
+    home->removeDevice("UV1");
+}
+
+// reads lines from a blocking socket until count have arrived
+static std::vector<std::string> readLines(int fd, std::size_t count) {
+    std::vector<std::string> lines(1);
+    char buffer[4096];
+    while (lines.size() <= count) {
+        ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0) break;
+        for (ssize_t i = 0; i < received; ++i) {
+            if (buffer[i] == '\n') lines.emplace_back();
+            else lines.back().push_back(buffer[i]);
+        }
+    }
+    lines.pop_back();
+    return lines;
+}
+
+TEST_CASE(server_pipelines_over_unix_socket) {
+    HomeController* home = HomeController::getInstance();
+    auto camera = std::make_shared<SecurityCamera>("UV2", "Server Camera", "Lab");
+    home->addDevice(camera);
+    CommandServerConfig config;
+    config.socketPath = "/tmp/unit_tests." + std::to_string(::getpid()) + ".sock";
+    config.maxLineLength = 64;
+    CommandServer server(*home, config);
+    server.start();
+    REQUIRE(server.isRunning());
+    std::vector<int> clients;
+    for (int i = 0; i < 8; ++i) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", config.socketPath.c_str());
+        REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+        clients.push_back(fd);
+    }
+
+    // one write with several requests, split across a second write mid-line
+    std::string first = "ping\nUV2 on\nUV2 record\nUV2 resolution 4K\r\nsta";
+    std::string second = "tus UV2\nUV2 rotation 400\n";
+    REQUIRE(::send(clients[3], first.data(), first.size(), 0) == static_cast<ssize_t>(first.size()));
+    REQUIRE(::send(clients[3], second.data(), second.size(), 0) == static_cast<ssize_t>(second.size()));
+    std::vector<std::string> responses = readLines(clients[3], 6);
+    REQUIRE(responses.size() == 6);
+    CHECK_EQ(responses[0], std::string("OK pong"));
+    CHECK_EQ(responses[1], std::string("OK"));
+    CHECK_EQ(responses[2], std::string("OK"));
+    CHECK_EQ(responses[3], std::string("OK"));
+    CHECK(responses[4].find("Recording: Yes, Resolution: 4K") != std::string::npos);
+    CHECK_EQ(responses[5], std::string("ERR Rotation angle must be between 0 and 360 degrees"));
+    CHECK(camera->getIsRecording());
+    CHECK_EQ(server.getConnectionCount(), 8u);
+
+    // every client gets its own answers
+    for (std::size_t i = 0; i < clients.size(); ++i) {
+        std::string request = "UV2 rotation " + std::to_string(i * 10) + "\nping\n";
+        ::send(clients[i], request.data(), request.size(), 0);
+    }
+    for (int fd : clients) {
+        std::vector<std::string> answers = readLines(fd, 2);
+        CHECK(answers.size() == 2 && answers[0] == "OK" && answers[1] == "OK pong");
+    }
+
+    // an overlong request is answered and the client closed
+    std::string flood(100, 'x');
+    ::send(clients[0], flood.data(), flood.size(), 0);
+    std::vector<std::string> rejected = readLines(clients[0], 2);
+    CHECK(rejected.size() == 1 && rejected[0] == "ERR Request too long");
+    for (int fd : clients) ::close(fd);
+    server.stop();
+    CHECK(!server.isRunning());
+    CHECK(::access(config.socketPath.c_str(), F_OK) != 0);
+    home->removeDevice("UV2");
+}
+
+TEST_CASE(server_holds_back_pipelined_lines_while_output_is_full) {
+    HomeController* home = HomeController::getInstance();
+    home->addDevice(std::make_shared<SmartLight>("UV3", "Pipelined Light", "Lab"));
+    CommandServerConfig config;
+    config.socketPath = "/tmp/unit_tests." + std::to_string(::getpid()) + ".pipelined.sock";
+    config.maxLineLength = 64;
+    config.maxPendingOutput = 1024;
+    CommandServer server(*home, config);
+    server.start();
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", config.socketPath.c_str());
+    REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+
+    // far more responses than maxPendingOutput and the socket buffers hold, read only after sending
+    const std::size_t count = 50000;
+    std::string requests;
+    for (std::size_t i = 0; i < count; ++i) {
+        requests += "status UV3\n";
+    }
+    std::thread writer([&] {
+        std::size_t sent = 0;
+        while (sent < requests.size()) {
+            ssize_t written = ::send(fd, requests.data() + sent, requests.size() - sent, MSG_NOSIGNAL);
+            if (written <= 0) break;
+            sent += static_cast<std::size_t>(written);
+        }
+    });
+    std::vector<std::string> responses = readLines(fd, count);
+    writer.join();
+    REQUIRE(responses.size() == count);
+    std::size_t ok = 0;
+    for (const std::string& response : responses) {
+        ok += response.compare(0, 3, "OK ") == 0;
+    }
+    CHECK_EQ(ok, count);
+    ::send(fd, "ping\n", 5, MSG_NOSIGNAL);
+    std::vector<std::string> answers = readLines(fd, 1);
+    CHECK(answers.size() == 1 && answers[0] == "OK pong");
+    ::close(fd);
+    server.stop();
+    home->removeDevice("UV3");
+}
+
+TEST_CASE(server_listens_on_localhost_tcp) {
+    CommandServerConfig config;
+    config.socketPath = "";
+    config.tcpPort = 0;
+    CommandServer server(*HomeController::getInstance(), config);
+    server.start();
+    REQUIRE(server.getTcpPort() > 0);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<std::uint16_t>(server.getTcpPort()));
+    REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    ::send(fd, "ping\n", 5, 0);
+    std::vector<std::string> answers = readLines(fd, 1);
+    CHECK(answers.size() == 1 && answers[0] == "OK pong");
+    ::close(fd);
+}
+
+// broker
+
+TEST_CASE(broker_wildcard_matching) {
+    CHECK(MessageBroker::matches("home/+/L1/power", "home/Kitchen/L1/power"));
+    CHECK(!MessageBroker::matches("home/+/L1/power", "home/Kitchen/Shelf/L1/power"));
+    CHECK(MessageBroker::matches("home/#", "home/Kitchen/L1/power"));
+    CHECK(MessageBroker::matches("home/#", "home"));
+    CHECK(!MessageBroker::matches("home/Kitchen", "home/Kitchen/L1"));
+    MessageBroker broker;
+    auto room = broker.subscribe("home/Kitchen/#");
+    auto power = broker.subscribe("home/+/+/power");
+    auto everything = broker.subscribe("#");
+    CHECK_EQ(broker.publish("home/Kitchen/L1/power", "on"), 3u);
+    CHECK_EQ(broker.publish("home/Hall/L2/brightness", "40"), 1u);
+    CHECK_EQ(broker.publish("home/Kitchen", "x"), 2u);
+    CHECK_EQ(room->size(), 2u);
+    CHECK_EQ(power->size(), 1u);
+    auto message = power->poll();
+    REQUIRE(message != nullptr);
+    CHECK_EQ(message->topic, std::string("home/Kitchen/L1/power"));
+    CHECK_EQ(message->payload, std::string("on"));
+    CHECK(power->poll() == nullptr);
+    CHECK_THROWS(broker.subscribe("home/Kit#"), std::invalid_argument);
+    CHECK_THROWS(broker.subscribe("home/#/power"), std::invalid_argument);
+    CHECK_THROWS(broker.subscribe(""), std::invalid_argument);
+    CHECK_THROWS(broker.publish("home/+/L1", "on"), std::invalid_argument);
+}
+
+TEST_CASE(broker_overlapping_filters_deliver_once) {
+    MessageBroker broker;
+    auto subscriber = broker.subscribe("home/Kitchen/#");
+    broker.addFilter(subscriber, "home/+/L1/power");
+    CHECK_EQ(broker.getSubscriptionCount(), 1u);
+    CHECK_EQ(broker.publish("home/Kitchen/L1/power", "on"), 1u);
+    CHECK_EQ(subscriber->size(), 1u);
+    broker.unsubscribe(subscriber);
+    CHECK_EQ(broker.getSubscriptionCount(), 0u);
+    CHECK(!broker.hasSubscribers());
+    CHECK_EQ(broker.publish("home/Kitchen/L1/power", "off"), 0u);
+    CHECK(subscriber->getFilters().empty());
+    CHECK_EQ(broker.getPublishedCount(), 2u);
+}
+
+TEST_CASE(broker_overflow_policies) {
+    MessageBroker broker(std::chrono::milliseconds(1));
+    auto oldest = broker.subscribe("t", 2, OverflowPolicy::DropOldest);
+    auto newest = broker.subscribe("t", 2, OverflowPolicy::DropNewest);
+    auto blocking = broker.subscribe("t", 2, OverflowPolicy::Block);
+    for (int i = 1; i <= 4; ++i) broker.publish("t", std::to_string(i));
+    std::vector<std::shared_ptr<const BrokerMessage>> kept;
+    CHECK_EQ(oldest->drain(kept), 2u);
+    CHECK(kept[0]->payload == "3" && kept[1]->payload == "4");
+    CHECK_EQ(oldest->getDropped(), 2u);
+    kept.clear();
+    CHECK_EQ(newest->drain(kept), 2u);
+    CHECK(kept[0]->payload == "1" && kept[1]->payload == "2");
+    CHECK_EQ(newest->getDropped(), 2u);
+    CHECK_EQ(blocking->getDropped(), 2u);
+    CHECK_EQ(blocking->getDelivered(), 2u);
+    CHECK(blocking->poll() != nullptr);
+    CHECK_EQ(broker.publish("t", "5"), 3u);
+    CHECK(blocking->waitFor(std::chrono::milliseconds(1)) != nullptr);
+}
+
+TEST_CASE(broker_block_waits_outside_the_trie_lock) {
+    MessageBroker broker(std::chrono::milliseconds(2000));
+    auto slow = broker.subscribe("t", 1, OverflowPolicy::Block);
+    broker.publish("t", "1"); // full from here
+    std::thread publisher([&broker] { broker.publish("t", "2"); });
+    while (broker.getPublishedCount() < 2) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50)); // the publisher is waiting for room
+    auto start = std::chrono::steady_clock::now();
+    auto other = broker.subscribe("u"); // needs the trie exclusively while the publisher waits
+    broker.unsubscribe(other);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000));
+    CHECK(slow->poll() != nullptr); // makes room, the waiting publisher delivers
+    publisher.join();
+    CHECK_EQ(slow->getDelivered(), 2u);
+    broker.unsubscribe(slow);
+}
+
+TEST_CASE(broker_home_telemetry) {
+    HomeController* home = HomeController::getInstance();
+    auto light = std::make_shared<SmartLight>("UB1", "Telemetry Light", "Lab");
+    home->addDevice(light);
+    auto subscriber = home->getTelemetry().subscribe("home/Lab/UB1/#");
+    light->turnOn();
+    light->setBrightness(40);
+    std::vector<std::shared_ptr<const BrokerMessage>> messages;
+    subscriber->drain(messages);
+    REQUIRE(messages.size() == 2);
+    CHECK_EQ(messages[0]->topic, std::string("home/Lab/UB1/power"));
+    CHECK_EQ(messages[0]->payload, std::string("on"));
+    CHECK_EQ(messages[1]->topic, std::string("home/Lab/UB1/brightness"));
+    CHECK_EQ(messages[1]->payload, std::string("40"));
+    CHECK(messages[0]->sequence < messages[1]->sequence);
+    home->getTelemetry().unsubscribe(subscriber);
+    home->removeDevice("UB1");
+}
+
+// binary telemetry
+
+TEST_CASE(telemetry_round_trips_every_device_type) {
+    SmartLight light("UW1", "Wire Light", "Lab");
+    light.turnOn();
+    light.setBrightness(40);
+    light.setColor("2700K");
+    Thermostat thermostat("UW2", "Wire Thermostat", "Lab");
+    thermostat.turnOn();
+    thermostat.setMode("cooling");
+    thermostat.setDesiredTemperature(18.5f);
+    thermostat.applyControlOutput(-0.25f);
+    SecurityCamera camera("UW3", "Wire Camera", "Lab");
+    camera.turnOn();
+    camera.startRecording();
+    camera.setResolution("4K");
+    camera.setRotation(270);
+    std::vector<std::uint8_t> bytes(3, 0xee); // records need no alignment
+    std::size_t lightSize = encodeTelemetry(light, bytes);
+    std::size_t thermostatSize = encodeTelemetry(thermostat, bytes);
+    encodeTelemetry(camera, bytes);
+
+    TelemetryRecord record = TelemetryRecord::decode(bytes.data() + 3, bytes.size() - 3);
+    CHECK(record.getType() == TelemetryDeviceType::Light);
+    CHECK_EQ(record.getSize(), lightSize);
+    CHECK(record.getDeviceID() == "UW1");
+    CHECK(record.getIsOn());
+    CHECK_EQ(record.getBrightness(), 40);
+    CHECK(record.getColor() == light.getColor());
+    CHECK_NEAR(record.getPowerUsage(), light.getPowerUsage(), 1e-6);
+
+    std::size_t offset = 3 + lightSize;
+    record = TelemetryRecord::decode(bytes.data() + offset, bytes.size() - offset);
+    CHECK(record.getType() == TelemetryDeviceType::Thermostat);
+    CHECK_NEAR(record.getDesiredTemperature(), 18.5, 1e-6);
+    CHECK_NEAR(record.getTemperature(), thermostat.getTemperature(), 1e-6);
+    CHECK_NEAR(record.getControlOutput(), thermostat.getControlOutput(), 1e-6);
+    CHECK_EQ(std::string(record.getMode()), std::string("cooling"));
+    CHECK(record.isClosedLoop());
+
+    offset += thermostatSize;
+    record = TelemetryRecord::decode(bytes.data() + offset, bytes.size() - offset);
+    CHECK(record.getType() == TelemetryDeviceType::Camera);
+    CHECK(record.getDeviceID() == "UW3");
+    CHECK(record.getIsRecording());
+    CHECK(!record.getMotionDetection());
+    CHECK_EQ(record.getRotation(), 270);
+    CHECK_EQ(std::string(record.getResolution()), std::string("4K"));
+    CHECK_EQ(record.getMotionEventCount(), 0u);
+}
+
+TEST_CASE(telemetry_batches_and_malformed_input) {
+    HomeController* home = HomeController::getInstance();
+    home->addDevice(std::make_shared<SmartLight>("UW4", "Wire Light", "Lab"));
+    home->addDevice(std::make_shared<Thermostat>("UW5", "Wire Thermostat", "Lab"));
+    TelemetryBatchWriter writer;
+    std::size_t added = home->snapshotTelemetry(writer);
+    CHECK_EQ(static_cast<std::size_t>(writer.getRecordCount()), added);
+    std::vector<std::uint8_t> batch = writer.finish();
+    TelemetryBatchReader reader(batch.data(), batch.size());
+    TelemetryRecord record;
+    std::vector<std::string> ids;
+    while (reader.next(record)) ids.emplace_back(record.getDeviceID());
+    CHECK_EQ(ids.size(), added);
+    CHECK(std::find(ids.begin(), ids.end(), "UW4") != ids.end());
+    CHECK(std::find(ids.begin(), ids.end(), "UW5") != ids.end());
+    home->removeDevice("UW4");
+    home->removeDevice("UW5");
+
+    // a record of a type this reader does not know still gives its ID, and is stepped over
+    std::vector<std::uint8_t> future = batch;
+    future[16 + 1] = 9;
+    TelemetryBatchReader skipping(future.data(), future.size());
+    REQUIRE(skipping.next(record));
+    CHECK(record.getType() == TelemetryDeviceType::Unknown);
+    CHECK(record.getDeviceID() == ids[0]);
+    CHECK(skipping.next(record));
+
+    std::vector<std::uint8_t> truncated(batch.begin(), batch.end() - 1);
+    CHECK_THROWS(TelemetryBatchReader(truncated.data(), truncated.size()), std::invalid_argument);
+    std::vector<std::uint8_t> newer = batch;
+    newer[4] = telemetryVersion + 1;
+    CHECK_THROWS(TelemetryBatchReader(newer.data(), newer.size()), std::invalid_argument);
+    std::vector<std::uint8_t> oversized = batch;
+    oversized[16 + 4] = 0xff;
+    oversized[16 + 5] = 0xff;
+    TelemetryBatchReader broken(oversized.data(), oversized.size());
+    CHECK_THROWS(broken.next(record), std::invalid_argument);
+    CHECK(!TelemetryRecord::tryDecode(batch.data() + 16, 11, record));
+    SmartLight longName(std::string(256, 'x'), "Long", "Lab");
+    std::vector<std::uint8_t> out;
+    CHECK_THROWS(encodeTelemetry(longName, out), std::invalid_argument);
+}
+
+// asynchronous device I/O
+
+static Task<int> doubled(int value) {
+    co_return value * 2;
+}
+
+static Task<int> failing() {
+    throw std::runtime_error("task failed");
+    co_return 0;
+}
+
+TEST_CASE(async_tasks_compose) {
+    CHECK_EQ(syncWait(doubled(21)), 42);
+    std::vector<Task<int>> tasks;
+    for (int i = 0; i < 5; ++i) tasks.push_back(doubled(i));
+    std::vector<int> results = syncWait(whenAll(std::move(tasks)));
+    CHECK(results == std::vector<int>({0, 2, 4, 6, 8}));
+    CHECK(syncWait(whenAll(std::vector<Task<int>>())).empty());
+    std::vector<Task<int>> mixed;
+    mixed.push_back(doubled(1));
+    mixed.push_back(failing());
+    CHECK_THROWS(syncWait(whenAll(std::move(mixed))), std::runtime_error);
+}
+
+TEST_CASE(async_device_commands_over_transport) {
+    TransportConfig config;
+    config.latencyMillis = 2;
+    DeviceTransport transport(config);
+    auto light = std::make_shared<SmartLight>("UA1", "Async Light", "Lab");
+    CHECK(syncWait(turnOnAsync(transport, light)) == DeviceResult::Ok);
+    CHECK(syncWait(setBrightnessAsync(transport, light, 30)) == DeviceResult::Ok);
+    CHECK(syncWait(setBrightnessAsync(transport, light, 130)) == DeviceResult::InvalidBrightness);
+    CHECK(syncWait(setModeAsync(transport, light, "heating")) == DeviceResult::NotSupported);
+    CHECK(light->getIsOn());
+    CHECK_EQ(light->getBrightness(), 30);
+    CHECK_EQ(transport.getRequestCount(), 4u);
+    CHECK(syncWait(turnOnAsync(transport, nullptr)) == DeviceResult::UnknownDevice);
+
+    TransportConfig lossy;
+    lossy.lossRate = 1.0;
+    lossy.timeoutMillis = 1;
+    lossy.retries = 2;
+    DeviceTransport dead(lossy);
+    CHECK(syncWait(turnOffAsync(dead, light)) == DeviceResult::Timeout);
+    CHECK_EQ(dead.getRequestCount(), 3u);
+    CHECK_EQ(dead.getLostCount(), 3u);
+    CHECK(light->getIsOn());
+    CHECK_EQ(std::string(describeResult(DeviceResult::Timeout)), std::string("Device did not respond"));
+}
+
+TEST_CASE(async_home_commands_run_concurrently) {
+    HomeController* home = HomeController::getInstance();
+    home->addRoom("Async Lab");
+    std::vector<std::pair<std::string, DeviceCommand>> commands;
+    for (int i = 0; i < 200; ++i) {
+        std::string id = "UA-" + std::to_string(i);
+        home->addDevice(std::make_shared<SmartLight>(id, "Async Light", "Async Lab"));
+        home->assignDeviceToRoom(id, "Async Lab");
+        commands.emplace_back(id, DeviceCommand{CommandType::SetBrightness, 50.0f, ""});
+    }
+    commands.emplace_back("UA-missing", DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+    TransportConfig config;
+    config.latencyMillis = 50;
+    DeviceTransport transport(config);
+    auto start = std::chrono::steady_clock::now();
+    CHECK_EQ(syncWait(home->setRoomPowerAsync(transport, "Async Lab", true)), 200u);
+    std::vector<DeviceResult> results;
+    CHECK_EQ(home->applyCommandsAsync(transport, commands, results), 200u);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    CHECK(elapsed < std::chrono::seconds(2)); // two round trips, not four hundred
+    CHECK(results.back() == DeviceResult::UnknownDevice);
+    CHECK_EQ(std::static_pointer_cast<SmartLight>(home->findDevice("UA-7"))->getBrightness(), 50);
+    CHECK_EQ(syncWait(home->setRoomPowerAsync(transport, "No Such Room", true)), 0u);
+
+    // the room can go while its commands are in flight
+    auto switching = std::async(std::launch::async, [home, &transport] {
+        return syncWait(home->setRoomPowerAsync(transport, "Async Lab", false));
+    });
+    while (transport.getInFlight() == 0) {
+        std::this_thread::yield();
+    }
+    home->removeRoom("Async Lab");
+    CHECK_EQ(switching.get(), 200u);
+    CHECK(!home->findDevice("UA-7")->getIsOn());
+    for (int i = 0; i < 200; ++i) home->removeDevice("UA-" + std::to_string(i));
+}
+
+// work-stealing pool
+
+TEST_CASE(pool_futures_and_parallel_for) {
+    WorkStealingPool pool(4);
+    CHECK_EQ(pool.getWorkerCount(), 4u);
+    std::future<int> answer = pool.submit([] { return 6 * 7; });
+    std::future<int> pinned = pool.submitTo(9, [] { return WorkStealingPool::currentWorker(); });
+    CHECK_EQ(answer.get(), 42);
+    int worker = pinned.get();
+    CHECK(worker >= 0 && worker < 4);
+    CHECK_EQ(WorkStealingPool::currentWorker(), -1);
+    std::future<void> failed = pool.submit([] { throw std::runtime_error("task failed"); });
+    CHECK_THROWS(failed.get(), std::runtime_error);
+
+    std::vector<int> values(100000, 1);
+    std::atomic<long> sum(0);
+    pool.parallelFor(values.size(), 1000, [&values, &sum](std::size_t begin, std::size_t end) {
+        long part = 0;
+        for (std::size_t i = begin; i < end; ++i) part += values[i];
+        sum += part;
+    });
+    CHECK_EQ(sum.load(), 100000L);
+
+    // nested loops finish on the caller when every worker is busy
+    std::atomic<int> cells(0);
+    pool.parallelFor(8, 1, [&pool, &cells](std::size_t, std::size_t) {
+        pool.parallelFor(8, 1, [&cells](std::size_t begin, std::size_t end) { cells += static_cast<int>(end - begin); });
+    });
+    CHECK_EQ(cells.load(), 64);
+    CHECK_THROWS(pool.parallelFor(10, 1, [](std::size_t begin, std::size_t) {
+                     if (begin == 7) throw std::invalid_argument("chunk 7");
+                 }),
+                 std::invalid_argument);
+}
+
+TEST_CASE(pool_steals_and_shuts_down) {
+    WorkStealingPool pool(2);
+    // everything is queued on the worker that is held up, so the other one has to steal it
+    std::promise<int> started;
+    std::promise<void> release;
+    std::shared_future<void> gate = release.get_future().share();
+    std::vector<std::future<void>> tasks;
+    tasks.push_back(pool.submitTo(0, [&started, gate] {
+        started.set_value(WorkStealingPool::currentWorker());
+        gate.wait();
+    }));
+    int blocked = started.get_future().get();
+    std::atomic<int> ran(0);
+    for (int i = 0; i < 20; ++i) tasks.push_back(pool.submitTo(static_cast<std::size_t>(blocked), [&ran] { ++ran; }));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (ran.load() < 20 && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+    CHECK_EQ(ran.load(), 20);
+    CHECK(pool.getStolenCount() >= 20u);
+    release.set_value();
+    for (auto& task : tasks) task.get();
+    CHECK(pool.getExecutedCount() >= 20u); // counted just after each task returns
+
+    // queued work still runs, later work is rejected
+    std::atomic<int> drained(0);
+    for (int i = 0; i < 50; ++i) pool.submit([&drained] { ++drained; });
+    pool.shutdown();
+    pool.shutdown();
+    CHECK_EQ(drained.load(), 50);
+    CHECK_THROWS(pool.submit([] { return 1; }), std::runtime_error);
+    std::size_t covered = 0;
+    pool.parallelFor(10, 3, [&covered](std::size_t begin, std::size_t end) { covered += end - begin; });
+    CHECK_EQ(covered, 10u); // on the caller
+}
+
+TEST_CASE(home_parallel_batches_match_serial) {
+    HomeController* home = HomeController::getInstance();
+    home->setExecutorThreads(4);
+    home->addRoom("Pool Hall");
+    auto trigger = std::make_shared<SmartLight>("UP-switch", "Switch", "Pool Hall");
+    home->addDevice(trigger);
+    std::vector<std::pair<std::string, DeviceCommand>> commands;
+    const int lights = 2000;
+    for (int i = 0; i < lights; ++i) {
+        std::string id = "UP-" + std::to_string(i);
+        home->addDevice(std::make_shared<SmartLight>(id, "Pool Light", "Pool Hall"));
+        home->assignDeviceToRoom(id, "Pool Hall");
+        commands.emplace_back(id, DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+    }
+    for (int i = 0; i < lights; ++i) { // per-device order is kept across shards
+        commands.emplace_back("UP-" + std::to_string(i), DeviceCommand{CommandType::SetBrightness, static_cast<float>(i % 101), ""});
+    }
+    commands.emplace_back("UP-missing", DeviceCommand{CommandType::TurnOn, 0.0f, ""});
+    commands.emplace_back("UP-3", DeviceCommand{CommandType::SetBrightness, 300.0f, ""});
+    auto subscriber = home->getTelemetry().subscribe("home/Pool Hall/+/power", 4 * lights);
+    std::vector<DeviceResult> results;
+    CHECK_EQ(home->applyCommands(commands, results), static_cast<std::size_t>(2 * lights));
+    REQUIRE(results.size() == commands.size());
+    CHECK(results[2 * lights] == DeviceResult::UnknownDevice);
+    CHECK(results[2 * lights + 1] == DeviceResult::InvalidBrightness);
+    CHECK_EQ(std::static_pointer_cast<SmartLight>(home->findDevice("UP-1234"))->getBrightness(), 1234 % 101);
+    std::vector<std::shared_ptr<const BrokerMessage>> messages;
+    subscriber->drain(messages);
+    CHECK_EQ(messages.size(), static_cast<std::size_t>(lights)); // replayed on the caller after the batch
+
+    // automation rules see the changes of a parallel room switch
+    std::uint32_t rule = home->addAutomationRule("when UP-switch turns off, set Pool Hall lights to 30%");
+    home->assignDeviceToRoom("UP-switch", "Pool Hall");
+    trigger->turnOn();
+    CHECK_EQ(home->setRoomPower("Pool Hall", false), static_cast<std::size_t>(lights + 1));
+    CHECK_EQ(std::static_pointer_cast<SmartLight>(home->findDevice("UP-77"))->getBrightness(), 30); // after the room went off
+    CHECK_EQ(home->setRoomPower("No Such Room", true), 0u);
+
+    EnergySnapshot energy = home->measureEnergy();
+    CHECK(energy.deviceCount >= static_cast<std::size_t>(lights + 1));
+    CHECK_EQ(energy.wattsByLocation.count("Pool Hall"), 1u);
+    home->setRoomPower("Pool Hall", true);
+    EnergySnapshot lit = home->measureEnergy();
+    CHECK(lit.wattsByLocation["Pool Hall"] > energy.wattsByLocation["Pool Hall"]);
+    CHECK(lit.devicesOn >= static_cast<std::size_t>(lights + 1));
+
+    home->getTelemetry().unsubscribe(subscriber);
+    CHECK(home->getAutomation().removeRule(rule));
+    for (int i = 0; i < lights; ++i) home->removeDevice("UP-" + std::to_string(i));
+    home->removeDevice("UP-switch");
+    home->removeRoom("Pool Hall");
+    home->setExecutorThreads(0);
+}
+
+// metrics
+
+TEST_CASE(metrics_counters_and_histograms) {
+    MetricsRegistry* registry = MetricsRegistry::getInstance();
+    Counter counter = registry->counter("unit_test_events_total", "Unit test counter", "kind=\"a\"");
+    Counter again = registry->counter("unit_test_events_total", "Unit test counter", "kind=\"a\"");
+    CHECK_EQ(counter.getIndex(), again.getIndex());
+    std::uint64_t before = registry->read(counter);
+    counter.increment();
+    counter.increment(4);
+    CHECK_EQ(registry->read(counter) - before, 5u);
+    Histogram histogram = registry->histogram("unit_test_latency_seconds", "Unit test histogram");
+    for (int i = 1; i <= 100; ++i) histogram.record(static_cast<std::uint64_t>(i) * 1000);
+    HistogramSnapshot snapshot = registry->read(histogram);
+    CHECK_EQ(snapshot.count, 100u);
+    CHECK_NEAR(snapshot.percentile(0.5), 50000.0, 5000.0);
+    Gauge gauge = registry->gauge("unit_test_level", "Unit test gauge");
+    gauge.set(2.0);
+    gauge.add(0.5);
+    CHECK_NEAR(gauge.get(), 2.5, 1e-9);
+    std::ostringstream text;
+    registry->writePrometheus(text);
+    CHECK(text.str().find("unit_test_events_total{kind=\"a\"}") != std::string::npos);
+    CHECK(text.str().find("# TYPE unit_test_latency_seconds histogram") != std::string::npos);
+}
+
+TEST_CASE(metrics_switch_off_stops_recording) {
+    MetricsRegistry* registry = MetricsRegistry::getInstance();
+    Counter counter = registry->counter("unit_test_switched_total", "Unit test counter");
+    MetricsRegistry::setEnabled(false);
+    counter.increment();
+    MetricsRegistry::setEnabled(true);
+    CHECK_EQ(registry->read(counter), 0u);
+}
+
+// tracing
+
+TEST_CASE(tracing_records_only_while_started) {
+    Tracer* tracer = Tracer::getInstance();
+    { TraceSpan span("unit.disabled", "unit"); CHECK(!span.isActive()); }
+    tracer->start();
+    {
+        TraceSpan span("unit.enabled", "unit", "first");
+        span.setDetail("quote \" here");
+    }
+    SmartLight light("UT-TRACE", "Traced Light", "Lab");
+    light.turnOn(); // the light's span and the energy reading under it
+    tracer->stop();
+    CHECK_EQ(tracer->getEventCount(), 3u);
+    std::ostringstream json;
+    tracer->writeChromeTrace(json);
+    CHECK(json.str().find("\"unit.enabled\"") != std::string::npos);
+    CHECK(json.str().find("quote \\\" here") != std::string::npos);
+    CHECK(json.str().find("SmartLight::turnOn") != std::string::npos);
+    CHECK(json.str().find("EnergyMonitor::recordUsage") != std::string::npos);
+    CHECK(json.str().find("unit.disabled") == std::string::npos);
+    tracer->clear();
+    CHECK_EQ(tracer->getEventCount(), 0u);
+}
+
+// clock
+
+TEST_CASE(clock_virtual_time_only_moves_forward) {
+    VirtualClock clock(1000, 23 * 60 + 59);
+    CHECK_EQ(clock.nowMillis(), 1000u);
+    CHECK_EQ(clock.minuteOfDay(), 23 * 60 + 59);
+    clock.advanceBy(60 * 1000);
+    CHECK_EQ(clock.minuteOfDay(), 0); // past midnight
+    clock.advanceTo(500);
+    CHECK_EQ(clock.nowMillis(), 61000u);
+    clock.advanceTo(24ull * 3600 * 1000 + 61000);
+    CHECK_EQ(clock.minuteOfDay(), 0);
+    CHECK_THROWS(VirtualClock(0, 1440), std::invalid_argument);
+    std::uint64_t system = systemClock().nowMillis();
+    CHECK(systemClock().nowMillis() >= system);
+    CHECK(systemClock().minuteOfDay() >= 0 && systemClock().minuteOfDay() < 1440);
+}
+
+// logger
+
+TEST_CASE(logger_levels_and_sinks) {
+    Logger* logger = Logger::getInstance();
+    std::FILE* info = std::tmpfile();
+    std::FILE* error = std::tmpfile();
+    REQUIRE(info != nullptr && error != nullptr);
+    logger->setSinks(info, error);
+    logger->setLevel(LogLevel::Info);
+    logDebug("hidden debug line");
+    logInfo("count ", 42, " ratio ", 0.5);
+    logError("broken ", std::string("pipe"));
+    logger->flush();
+    CHECK(!logger->isEnabled(LogLevel::Debug));
+    CHECK(logger->isEnabled(LogLevel::Warning));
+    logger->setSinks(stdout, stderr);
+    logger->setLevel(LogLevel::Warning);
+    auto contents = [](std::FILE* file) {
+        std::string text;
+        std::rewind(file);
+        for (int c = std::fgetc(file); c != EOF; c = std::fgetc(file)) text.push_back(static_cast<char>(c));
+        std::fclose(file);
+        return text;
+    };
+    std::string infoText = contents(info), errorText = contents(error);
+    CHECK(infoText.find("count 42 ratio 0.5") != std::string::npos);
+    CHECK(infoText.find("hidden debug line") == std::string::npos);
+    CHECK(errorText.find("broken pipe") != std::string::npos);
+}
+
+int main(int argc, char* argv[]) {
+    Logger::getInstance()->setLevel(LogLevel::Warning); // keep the test output readable
+    return runTests(argc, argv);
+}